@@ -0,0 +1,362 @@
+#pragma once
+
+#include "kernels.hpp"
+
+#include "../templated-script/script.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace columnar
+{
+
+/// Значения одной переменной для всех строк блока.
+template< typename T >
+struct alignas(64) column_t
+{
+	T _values[ block_size ];
+};
+
+/// Блок строк: по колонке на каждую переменную программы.
+template< typename T >
+class batch_t
+{
+	std::vector< column_t<T> > _columns;
+	std::size_t _rows{};
+
+public:
+	explicit batch_t( std::size_t columns_count )
+		: _columns( columns_count )
+	{}
+
+	[[nodiscard]] std::size_t
+	rows() const noexcept { return _rows; }
+
+	void
+	set_rows( std::size_t rows )
+	{
+		if( rows > block_size )
+			throw std::invalid_argument{ "batch_t: too many rows" };
+		_rows = rows;
+	}
+
+	[[nodiscard]] T *
+	column( std::size_t index ) noexcept { return _columns[ index ]._values; }
+
+	[[nodiscard]] const T *
+	column( std::size_t index ) const noexcept { return _columns[ index ]._values; }
+};
+
+/// Инструкция, выполняемая над выбранными строками блока.
+template< typename T >
+class vector_statement_t
+{
+public:
+	virtual ~vector_statement_t() = default;
+
+	virtual void
+	exec( batch_t<T> & batch, const selection_t & sel ) const = 0;
+};
+
+template< typename T >
+using vector_statement_uptr_t = std::unique_ptr< vector_statement_t<T> >;
+
+/// Условие, которое отбирает строки блока.
+template< typename T >
+class vector_condition_t
+{
+public:
+	virtual ~vector_condition_t() = default;
+
+	virtual void
+	select(
+		const batch_t<T> & batch,
+		const selection_t & sel,
+		selection_t & out ) const = 0;
+};
+
+template< typename T >
+using vector_condition_uptr_t = std::unique_ptr< vector_condition_t<T> >;
+
+namespace ops
+{
+
+template< typename T >
+class block_t final : public vector_statement_t<T>
+{
+	const std::vector< vector_statement_uptr_t<T> > _statements;
+
+public:
+	explicit block_t( std::vector< vector_statement_uptr_t<T> > statements )
+		: _statements{ std::move(statements) }
+	{}
+
+	void
+	exec( batch_t<T> & batch, const selection_t & sel ) const override
+	{
+		for( const auto & s : _statements )
+			s->exec( batch, sel );
+	}
+};
+
+/// Цикл выполняется для всех выбранных строк сразу: на каждой
+/// итерации условие сужает выбор, а тело выполняется только для
+/// строк, в которых цикл еще продолжается.
+template< typename T >
+class while_loop_t final : public vector_statement_t<T>
+{
+	const vector_condition_uptr_t<T> _condition;
+	const vector_statement_uptr_t<T> _body;
+
+public:
+	while_loop_t(
+		vector_condition_uptr_t<T> condition,
+		vector_statement_uptr_t<T> body )
+		: _condition{ std::move(condition) }
+		, _body{ std::move(body) }
+	{}
+
+	void
+	exec( batch_t<T> & batch, const selection_t & sel ) const override
+	{
+		selection_t active[ 2 ];
+		_condition->select( batch, sel, active[ 0 ] );
+		for( std::size_t current = 0; active[ current ]._count; current ^= 1u )
+		{
+			_body->exec( batch, active[ current ] );
+			_condition->select( batch, active[ current ], active[ current ^ 1u ] );
+		}
+	}
+};
+
+template< typename T >
+class assign_t final : public vector_statement_t<T>
+{
+	const std::size_t _column;
+	const T _value;
+
+public:
+	assign_t( std::size_t column, T value )
+		: _column{ column }, _value{ value }
+	{}
+
+	void
+	exec( batch_t<T> & batch, const selection_t & sel ) const override
+	{
+		kernels::fill( kernels_t::scalar, batch.column( _column ), sel, _value );
+	}
+};
+
+template< typename T >
+class increment_t final : public vector_statement_t<T>
+{
+	const std::size_t _column;
+	const T _value;
+	const kernels_t _kernels;
+
+public:
+	increment_t( std::size_t column, T value, kernels_t kernels )
+		: _column{ column }, _value{ value }, _kernels{ kernels }
+	{}
+
+	void
+	exec( batch_t<T> & batch, const selection_t & sel ) const override
+	{
+		kernels::add( _kernels, batch.column( _column ), sel, _value );
+	}
+};
+
+template< typename T >
+class less_than_t final : public vector_condition_t<T>
+{
+	const std::size_t _column;
+	const T _value;
+	const kernels_t _kernels;
+
+public:
+	less_than_t( std::size_t column, T value, kernels_t kernels )
+		: _column{ column }, _value{ value }, _kernels{ kernels }
+	{}
+
+	void
+	select(
+		const batch_t<T> & batch,
+		const selection_t & sel,
+		selection_t & out ) const override
+	{
+		kernels::less_than( _kernels, batch.column( _column ), sel, _value, out );
+	}
+};
+
+} /* namespace ops */
+
+/// Скрипт, скомпилированный для выполнения блоками строк.
+///
+/// Исходным представлением служат узлы templated-script. Поддерживаются
+/// compound_stmt_t, while_loop_t, assign_to_t, increment_by_t и
+/// less_than_t; для остальных узлов compile бросает исключение.
+template< typename T >
+class program_t
+{
+	/// Имена переменных, индекс в векторе -- номер колонки.
+	///
+	/// Сперва идут входные колонки в заданном порядке.
+	std::vector< std::string > _variables;
+
+	vector_statement_uptr_t<T> _root;
+
+	program_t() = default;
+
+	/// Компиляция одного узла.
+	///
+	/// defined -- переменные, которые гарантированно получили
+	/// значение до выполнения узла; по аналогии с исключением
+	/// "there is no such variable" при выполнении скрипта, чтение
+	/// переменной, которая могла не получить значение, считается
+	/// ошибкой.
+	class compiler_t
+	{
+		program_t & _program;
+		const kernels_t _kernels;
+
+		[[nodiscard]] std::size_t
+		column_of( const std::string & name )
+		{
+			const auto it = std::find(
+					_program._variables.begin(), _program._variables.end(), name );
+			if( it != _program._variables.end() )
+				return static_cast< std::size_t >( it - _program._variables.begin() );
+
+			_program._variables.push_back( name );
+			return _program._variables.size() - 1u;
+		}
+
+		[[nodiscard]] std::size_t
+		defined_column_of(
+			const std::string & name,
+			const std::set< std::string > & defined )
+		{
+			if( !defined.count( name ) )
+				throw std::invalid_argument{
+						"columnar: variable may be used before assignment: "
+						+ name };
+			return column_of( name );
+		}
+
+	public:
+		compiler_t( program_t & program, kernels_t kernels )
+			: _program{ program }, _kernels{ kernels }
+		{}
+
+		[[nodiscard]] vector_condition_uptr_t<T>
+		compile(
+			const script::logical_expression_shptr_t<T> & what,
+			const std::set< std::string > & defined )
+		{
+			if( const auto * lt = dynamic_cast<
+					const script::expressions::less_than_t<T> * >( what.get() ) )
+				return std::make_unique< ops::less_than_t<T> >(
+						defined_column_of( lt->var_name(), defined ),
+						lt->value(), _kernels );
+
+			throw std::invalid_argument{
+					"columnar: unsupported expression node" };
+		}
+
+		[[nodiscard]] vector_statement_uptr_t<T>
+		compile(
+			const script::statement_shptr_t<T> & what,
+			std::set< std::string > & defined )
+		{
+			namespace stm = script::statements;
+			const auto * node = what.get();
+
+			if( const auto * c = dynamic_cast< const stm::compound_stmt_t<T> * >( node ) )
+			{
+				std::vector< vector_statement_uptr_t<T> > statements;
+				for( const auto & s : c->statements() )
+					statements.push_back( compile( s, defined ) );
+				return std::make_unique< ops::block_t<T> >( std::move(statements) );
+			}
+
+			if( const auto * w = dynamic_cast< const stm::while_loop_t<T> * >( node ) )
+			{
+				auto condition = compile( w->condition(), defined );
+				// Тело может не выполниться ни разу, поэтому переменные,
+				// получившие значение в теле, после цикла не считаются
+				// определенными.
+				auto body_defined = defined;
+				auto body = compile( w->body(), body_defined );
+				return std::make_unique< ops::while_loop_t<T> >(
+						std::move(condition), std::move(body) );
+			}
+
+			if( const auto * a = dynamic_cast< const stm::assign_to_t<T> * >( node ) )
+			{
+				defined.insert( a->var_name() );
+				return std::make_unique< ops::assign_t<T> >(
+						column_of( a->var_name() ), a->value() );
+			}
+
+			if( const auto * i = dynamic_cast< const stm::increment_by_t<T> * >( node ) )
+				return std::make_unique< ops::increment_t<T> >(
+						defined_column_of( i->var_name(), defined ),
+						i->value_to_add(), _kernels );
+
+			throw std::invalid_argument{ "columnar: unsupported statement node" };
+		}
+	};
+
+public:
+	/// Скомпилировать скрипт.
+	///
+	/// inputs -- переменные, значения которых берутся из входных
+	/// данных; они получают первые номера колонок.
+	[[nodiscard]] static program_t
+	compile(
+		const script::statement_shptr_t<T> & script,
+		const std::vector< std::string > & inputs,
+		kernels_t kernels )
+	{
+		program_t result;
+		result._variables = inputs;
+
+		std::set< std::string > defined( inputs.begin(), inputs.end() );
+		compiler_t compiler{ result, kernels };
+		result._root = compiler.compile( script, defined );
+
+		return result;
+	}
+
+	[[nodiscard]] const std::vector< std::string > &
+	variables() const noexcept { return _variables; }
+
+	/// Номер колонки для переменной.
+	[[nodiscard]] std::size_t
+	column_of( const std::string & name ) const
+	{
+		const auto it = std::find( _variables.begin(), _variables.end(), name );
+		if( it == _variables.end() )
+			throw std::runtime_error{ "there is no such variable: " + name };
+		return static_cast< std::size_t >( it - _variables.begin() );
+	}
+
+	[[nodiscard]] batch_t<T>
+	make_batch() const
+	{
+		return batch_t<T>{ _variables.size() };
+	}
+
+	/// Выполнить программу для всех строк блока.
+	void
+	exec( batch_t<T> & batch ) const
+	{
+		_root->exec( batch, selection_t::all( batch.rows() ) );
+	}
+};
+
+} /* namespace columnar */
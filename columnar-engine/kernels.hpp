@@ -0,0 +1,373 @@
+#pragma once
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+		(defined(__GNUC__) || defined(__clang__))
+	#include <immintrin.h>
+	#define COLUMNAR_HAS_AVX2_KERNELS 1
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace columnar
+{
+
+/// Количество строк в одном блоке.
+inline constexpr std::size_t block_size = 1024u;
+
+/// Индекс строки внутри блока.
+using row_index_t = std::uint16_t;
+
+static_assert( block_size - 1u <= UINT16_MAX );
+
+/// Вектор выбора: какие строки блока участвуют в операции.
+struct selection_t
+{
+	/// Количество выбранных строк.
+	std::size_t _count{};
+
+	/// Выбраны ли все строки [0, _count).
+	///
+	/// В этом случае _rows не заполняется, а операции выполняются
+	/// над непрерывным диапазоном.
+	bool _dense{ true };
+
+	alignas(64) row_index_t _rows[ block_size ];
+
+	[[nodiscard]] static selection_t
+	all( std::size_t count ) noexcept
+	{
+		selection_t result;
+		result._count = count;
+		result._dense = true;
+		return result;
+	}
+};
+
+/// Какие реализации ядер использовать.
+enum class kernels_t
+{
+	/// Простые циклы (компилятор может их векторизовать сам).
+	scalar,
+	/// Явная векторизация через AVX2, если процессор ее поддерживает.
+	simd
+};
+
+namespace kernels
+{
+
+namespace impl
+{
+
+/// Поддерживает ли процессор AVX2.
+[[nodiscard]] inline bool
+has_avx2() noexcept
+{
+#if defined(COLUMNAR_HAS_AVX2_KERNELS)
+	static const bool value = __builtin_cpu_supports( "avx2" );
+	return value;
+#else
+	return false;
+#endif
+}
+
+#if defined(COLUMNAR_HAS_AVX2_KERNELS)
+
+/// Таблица для упаковки выбранных 16-битных индексов.
+///
+/// Для каждой маски из 8 бит содержит управляющие байты для
+/// _mm_shuffle_epi8, которые переносят индексы выбранных дорожек
+/// в начало вектора с сохранением порядка.
+struct compress_table_t
+{
+	alignas(16) std::uint8_t _shuffles[ 256 ][ 16 ];
+
+	compress_table_t() noexcept
+	{
+		for( unsigned mask = 0; mask != 256u; ++mask )
+		{
+			unsigned k = 0;
+			for( unsigned lane = 0; lane != 8u; ++lane )
+				if( mask & (1u << lane) )
+				{
+					_shuffles[ mask ][ k * 2u ] = static_cast< std::uint8_t >( lane * 2u );
+					_shuffles[ mask ][ k * 2u + 1u ] =
+							static_cast< std::uint8_t >( lane * 2u + 1u );
+					++k;
+				}
+			for( ; k != 8u; ++k )
+				_shuffles[ mask ][ k * 2u ] = _shuffles[ mask ][ k * 2u + 1u ] = 0x80u;
+		}
+	}
+};
+
+inline const compress_table_t compress_table;
+
+/// Дописать в out индексы из rows (8 штук по 16 бит), для которых
+/// установлены биты mask.
+///
+/// В out всегда записывается 16 байт, поэтому после позиции k
+/// должно быть место как минимум для 8-ми индексов.
+__attribute__((target("avx2"))) inline std::size_t
+append_selected( unsigned mask, __m128i rows, row_index_t * out, std::size_t k ) noexcept
+{
+	const __m128i shuffle = _mm_load_si128(
+			reinterpret_cast< const __m128i * >( compress_table._shuffles[ mask ] ) );
+	_mm_storeu_si128( reinterpret_cast< __m128i * >( out + k ),
+			_mm_shuffle_epi8( rows, shuffle ) );
+	return k + static_cast< std::size_t >( __builtin_popcount( mask ) );
+}
+
+/// Индексы base, base+1, ..., base+7.
+__attribute__((target("avx2"))) inline __m128i
+iota_rows( std::size_t base ) noexcept
+{
+	return _mm_add_epi16(
+			_mm_set1_epi16( static_cast< short >( base ) ),
+			_mm_setr_epi16( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+}
+
+__attribute__((target("avx2"))) inline void
+add_dense_avx2( int * col, std::size_t n, int v ) noexcept
+{
+	const __m256i add = _mm256_set1_epi32( v );
+	std::size_t i = 0;
+	for( ; i + 8u <= n; i += 8u )
+	{
+		auto * p = reinterpret_cast< __m256i * >( col + i );
+		_mm256_storeu_si256( p, _mm256_add_epi32( _mm256_loadu_si256( p ), add ) );
+	}
+	for( ; i != n; ++i )
+		col[ i ] += v;
+}
+
+__attribute__((target("avx2"))) inline void
+add_dense_avx2( double * col, std::size_t n, double v ) noexcept
+{
+	const __m256d add = _mm256_set1_pd( v );
+	std::size_t i = 0;
+	for( ; i + 4u <= n; i += 4u )
+		_mm256_storeu_pd( col + i, _mm256_add_pd( _mm256_loadu_pd( col + i ), add ) );
+	for( ; i != n; ++i )
+		col[ i ] += v;
+}
+
+__attribute__((target("avx2"))) inline std::size_t
+less_than_dense_avx2(
+	const int * col, std::size_t n, int v, row_index_t * out ) noexcept
+{
+	const __m256i limit = _mm256_set1_epi32( v );
+	std::size_t k = 0;
+	std::size_t i = 0;
+	for( ; i + 8u <= n; i += 8u )
+	{
+		const __m256i x = _mm256_loadu_si256(
+				reinterpret_cast< const __m256i * >( col + i ) );
+		const auto mask = static_cast< unsigned >( _mm256_movemask_ps(
+				_mm256_castsi256_ps( _mm256_cmpgt_epi32( limit, x ) ) ) );
+		k = append_selected( mask, iota_rows( i ), out, k );
+	}
+	for( ; i != n; ++i )
+	{
+		out[ k ] = static_cast< row_index_t >( i );
+		k += col[ i ] < v ? 1u : 0u;
+	}
+	return k;
+}
+
+__attribute__((target("avx2"))) inline std::size_t
+less_than_dense_avx2(
+	const double * col, std::size_t n, double v, row_index_t * out ) noexcept
+{
+	const __m256d limit = _mm256_set1_pd( v );
+	std::size_t k = 0;
+	std::size_t i = 0;
+	for( ; i + 8u <= n; i += 8u )
+	{
+		const auto mask = static_cast< unsigned >( _mm256_movemask_pd(
+				_mm256_cmp_pd( _mm256_loadu_pd( col + i ), limit, _CMP_LT_OQ ) ) )
+			| static_cast< unsigned >( _mm256_movemask_pd(
+				_mm256_cmp_pd( _mm256_loadu_pd( col + i + 4u ), limit, _CMP_LT_OQ ) ) ) << 4;
+		k = append_selected( mask, iota_rows( i ), out, k );
+	}
+	for( ; i != n; ++i )
+	{
+		out[ k ] = static_cast< row_index_t >( i );
+		k += col[ i ] < v ? 1u : 0u;
+	}
+	return k;
+}
+
+__attribute__((target("avx2"))) inline std::size_t
+less_than_sparse_avx2(
+	const int * col, const row_index_t * rows, std::size_t n, int v,
+	row_index_t * out ) noexcept
+{
+	const __m256i limit = _mm256_set1_epi32( v );
+	std::size_t k = 0;
+	std::size_t i = 0;
+	for( ; i + 8u <= n; i += 8u )
+	{
+		const __m128i packed = _mm_loadu_si128(
+				reinterpret_cast< const __m128i * >( rows + i ) );
+		const __m256i x = _mm256_i32gather_epi32(
+				col, _mm256_cvtepu16_epi32( packed ), 4 );
+		const auto mask = static_cast< unsigned >( _mm256_movemask_ps(
+				_mm256_castsi256_ps( _mm256_cmpgt_epi32( limit, x ) ) ) );
+		k = append_selected( mask, packed, out, k );
+	}
+	for( ; i != n; ++i )
+	{
+		out[ k ] = rows[ i ];
+		k += col[ rows[ i ] ] < v ? 1u : 0u;
+	}
+	return k;
+}
+
+__attribute__((target("avx2"))) inline std::size_t
+less_than_sparse_avx2(
+	const double * col, const row_index_t * rows, std::size_t n, double v,
+	row_index_t * out ) noexcept
+{
+	const __m256d limit = _mm256_set1_pd( v );
+	// Маскированная форма сбора с явным исходным регистром: для
+	// _mm256_i32gather_pd GCC выдает -Wmaybe-uninitialized.
+	const __m256d all = _mm256_castsi256_pd( _mm256_set1_epi64x( -1 ) );
+	std::size_t k = 0;
+	std::size_t i = 0;
+	for( ; i + 8u <= n; i += 8u )
+	{
+		const __m128i packed = _mm_loadu_si128(
+				reinterpret_cast< const __m128i * >( rows + i ) );
+		const __m256i indexes = _mm256_cvtepu16_epi32( packed );
+		const __m256d lo = _mm256_mask_i32gather_pd( _mm256_setzero_pd(),
+				col, _mm256_castsi256_si128( indexes ), all, 8 );
+		const __m256d hi = _mm256_mask_i32gather_pd( _mm256_setzero_pd(),
+				col, _mm256_extracti128_si256( indexes, 1 ), all, 8 );
+		const auto mask = static_cast< unsigned >( _mm256_movemask_pd(
+				_mm256_cmp_pd( lo, limit, _CMP_LT_OQ ) ) )
+			| static_cast< unsigned >( _mm256_movemask_pd(
+				_mm256_cmp_pd( hi, limit, _CMP_LT_OQ ) ) ) << 4;
+		k = append_selected( mask, packed, out, k );
+	}
+	for( ; i != n; ++i )
+	{
+		out[ k ] = rows[ i ];
+		k += col[ rows[ i ] ] < v ? 1u : 0u;
+	}
+	return k;
+}
+
+#endif
+
+/// Есть ли SIMD-реализации для типа T.
+template< typename T >
+inline constexpr bool has_simd_kernels =
+		std::is_same_v< T, int > || std::is_same_v< T, double >;
+
+template< typename T >
+[[nodiscard]] bool
+use_simd( kernels_t kind ) noexcept
+{
+	if constexpr( has_simd_kernels< T > )
+		return kernels_t::simd == kind && has_avx2();
+	else
+		return false;
+}
+
+} /* namespace impl */
+
+/// Используются ли SIMD-реализации при выборе kind на этом процессоре.
+template< typename T >
+[[nodiscard]] bool
+simd_available( kernels_t kind ) noexcept
+{
+	return impl::use_simd< T >( kind );
+}
+
+/// col[row] = v для выбранных строк.
+template< typename T >
+void
+fill( kernels_t, T * col, const selection_t & sel, T v ) noexcept
+{
+	if( sel._dense )
+		std::fill_n( col, sel._count, v );
+	else
+		for( std::size_t i = 0; i != sel._count; ++i )
+			col[ sel._rows[ i ] ] = v;
+}
+
+/// col[row] += v для выбранных строк.
+template< typename T >
+void
+add( kernels_t kind, T * col, const selection_t & sel, T v ) noexcept
+{
+	if( sel._dense )
+	{
+#if defined(COLUMNAR_HAS_AVX2_KERNELS)
+		if constexpr( impl::has_simd_kernels< T > )
+			if( impl::use_simd< T >( kind ) )
+				return impl::add_dense_avx2( col, sel._count, v );
+#else
+		(void)kind;
+#endif
+		for( std::size_t i = 0; i != sel._count; ++i )
+			col[ i ] += v;
+	}
+	else
+		for( std::size_t i = 0; i != sel._count; ++i )
+			col[ sel._rows[ i ] ] += v;
+}
+
+/// Отобрать из выбранных строк те, для которых col[row] < v.
+///
+/// Результат всегда разреженный.
+template< typename T >
+void
+less_than(
+	kernels_t kind,
+	const T * col,
+	const selection_t & sel,
+	T v,
+	selection_t & out ) noexcept
+{
+	out._dense = false;
+
+#if defined(COLUMNAR_HAS_AVX2_KERNELS)
+	if constexpr( impl::has_simd_kernels< T > )
+		if( impl::use_simd< T >( kind ) )
+		{
+			out._count = sel._dense ?
+					impl::less_than_dense_avx2( col, sel._count, v, out._rows ) :
+					impl::less_than_sparse_avx2(
+							col, sel._rows, sel._count, v, out._rows );
+			return;
+		}
+#else
+	(void)kind;
+#endif
+
+	// Без ветвлений: индекс пишется всегда, а счетчик сдвигается
+	// только для подходящих строк.
+	std::size_t k = 0;
+	if( sel._dense )
+		for( std::size_t i = 0; i != sel._count; ++i )
+		{
+			out._rows[ k ] = static_cast< row_index_t >( i );
+			k += col[ i ] < v ? 1u : 0u;
+		}
+	else
+		for( std::size_t i = 0; i != sel._count; ++i )
+		{
+			const auto row = sel._rows[ i ];
+			out._rows[ k ] = row;
+			k += col[ row ] < v ? 1u : 0u;
+		}
+	out._count = k;
+}
+
+} /* namespace kernels */
+
+} /* namespace columnar */
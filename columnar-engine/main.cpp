@@ -0,0 +1,192 @@
+#include "columnar.hpp"
+
+#include "../templated-script/demo_script.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace
+{
+
+/// Входные данные: значения колонок по строкам.
+template< typename T >
+struct dataset_t
+{
+	std::vector< std::string > _columns;
+	std::size_t _rows{};
+
+	/// Значения строка за строкой.
+	std::vector< T > _values;
+};
+
+template< typename T >
+[[nodiscard]] dataset_t<T>
+make_dataset( std::size_t rows )
+{
+	dataset_t<T> result{ { "x", "y" }, rows, {} };
+	result._values.reserve( rows * result._columns.size() );
+
+	// Значения по обе стороны от границы демо-скрипта, чтобы циклы
+	// в разных строках выполняли разное количество итераций.
+	std::mt19937_64 generator{ 0x5eed'c01u };
+	std::uniform_int_distribution< int > dist{
+			0, static_cast< int >( record_demo_script_limit ) + 4 };
+	for( std::size_t i = 0; i != rows * result._columns.size(); ++i )
+		result._values.push_back( static_cast< T >( dist( generator ) ) );
+
+	return result;
+}
+
+/// Результат одного способа выполнения.
+template< typename T >
+struct run_result_t
+{
+	double _seconds{};
+	std::vector< T > _outputs;
+};
+
+template< typename F >
+[[nodiscard]] double
+timed( F && f )
+{
+	const auto started_at = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration< double >(
+			std::chrono::steady_clock::now() - started_at ).count();
+}
+
+/// Выполнение скрипта отдельно для каждой строки.
+template< typename T >
+[[nodiscard]] run_result_t<T>
+run_row_at_a_time(
+	const script::statement_shptr_t<T> & demo,
+	const dataset_t<T> & data,
+	const std::string & output )
+{
+	run_result_t<T> result;
+	result._outputs.reserve( data._rows );
+
+	script::exec_context_t<T> ctx;
+	std::vector< T * > inputs;
+	for( const auto & c : data._columns )
+		ctx.assign_to( c, T{} );
+	for( const auto & c : data._columns )
+		inputs.push_back( &ctx.get_mutable_ref( c ) );
+	ctx.assign_to( output, T{} );
+	const T & out = ctx.get_mutable_ref( output );
+
+	result._seconds = timed( [&] {
+			const T * values = data._values.data();
+			for( std::size_t r = 0; r != data._rows; ++r )
+			{
+				for( T * in : inputs )
+					*in = *values++;
+				demo->exec( ctx );
+				result._outputs.push_back( out );
+			}
+		} );
+
+	return result;
+}
+
+/// Выполнение скрипта блоками по columnar::block_size строк.
+template< typename T >
+[[nodiscard]] run_result_t<T>
+run_columnar(
+	const script::statement_shptr_t<T> & demo,
+	const dataset_t<T> & data,
+	const std::string & output,
+	columnar::kernels_t kernels )
+{
+	run_result_t<T> result;
+	result._outputs.reserve( data._rows );
+
+	const auto program = columnar::program_t<T>::compile(
+			demo, data._columns, kernels );
+	auto batch = program.make_batch();
+	const auto output_column = program.column_of( output );
+	const std::size_t columns = data._columns.size();
+
+	result._seconds = timed( [&] {
+			for( std::size_t first = 0; first < data._rows;
+					first += columnar::block_size )
+			{
+				const auto n = std::min( columnar::block_size, data._rows - first );
+				batch.set_rows( n );
+
+				// Транспонирование строк во входные колонки.
+				const T * values = data._values.data() + first * columns;
+				for( std::size_t c = 0; c != columns; ++c )
+				{
+					T * col = batch.column( c );
+					for( std::size_t r = 0; r != n; ++r )
+						col[ r ] = values[ r * columns + c ];
+				}
+
+				program.exec( batch );
+
+				const T * out = batch.column( output_column );
+				result._outputs.insert( result._outputs.end(), out, out + n );
+			}
+		} );
+
+	return result;
+}
+
+template< typename T >
+void
+run_comparison( const std::string & type_name, std::size_t rows )
+{
+	const auto data = make_dataset<T>( rows );
+	const auto demo = make_record_demo_script<T>( data._columns );
+	const auto & output = record_demo_script_output;
+
+	const auto row = run_row_at_a_time<T>( demo, data, output );
+	const auto scalar = run_columnar<T>(
+			demo, data, output, columnar::kernels_t::scalar );
+	const auto simd = run_columnar<T>(
+			demo, data, output, columnar::kernels_t::simd );
+
+	const auto report = [&]( const char * name, const run_result_t<T> & r ) {
+		const double rows_per_second = static_cast< double >( rows ) / r._seconds;
+		std::cout << "  " << std::left << std::setw( 28 ) << name << std::right
+				<< std::fixed << std::setprecision( 0 )
+				<< std::setw( 14 ) << rows_per_second << " rows/s"
+				<< std::setprecision( 2 )
+				<< std::setw( 9 ) << row._seconds / r._seconds << "x"
+				<< (r._outputs == row._outputs ? "" : "  RESULTS DIFFER")
+				<< std::defaultfloat << std::endl;
+	};
+
+	std::cout << type_name << ", rows: " << rows << ", block: "
+			<< columnar::block_size << " rows" << std::endl;
+	report( "row-at-a-time", row );
+	report( "columnar (scalar kernels)", scalar );
+	report( columnar::kernels::simd_available<T>( columnar::kernels_t::simd ) ?
+				"columnar (AVX2 kernels)" : "columnar (no AVX2, scalar)",
+			simd );
+}
+
+} /* namespace anonymous */
+
+int main(int argc, char ** argv)
+{
+	try
+	{
+		const std::size_t rows = (2 == argc) ?
+				std::stoull( argv[1] ) : std::size_t{ 10'000'000 };
+
+		run_comparison<int>( "int", rows );
+		run_comparison<double>( "double", rows );
+	}
+	catch(const std::exception & x)
+	{
+		std::cerr << "main: exception caught: " << x.what() << std::endl;
+		return 2;
+	}
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Учет динамических аллокаций.
+///
+/// Сами счетчики есть всегда, но изменяются они только перехватчиками
+/// глобальных operator new/delete, которые подключаются к программе
+/// отдельно (см. linux-affinity/alloc_hooks.cpp). Подключение
+/// перехватчиков должно сопровождаться определением символа
+/// SCRIPT_INTERPRETER_ALLOC_ACCOUNTING, тогда while_loop_t будет
+/// отмечать выполнение своего тела, а enabled() вернет true.
+///
+/// Все счетчики относятся к текущей нити, поэтому их изменение не
+/// требует синхронизации.
+namespace alloc_accounting
+{
+
+/// Значения счетчиков одной нити.
+struct counters_t
+{
+	/// Количество выделений памяти.
+	std::uint64_t _allocations{};
+
+	/// Количество освобождений памяти.
+	std::uint64_t _deallocations{};
+
+	/// Сколько байт было запрошено.
+	std::uint64_t _bytes_allocated{};
+
+	/// Сколько байт сейчас занято блоками, выделенными этой нитью.
+	///
+	/// Учитывается реальный размер блоков с точки зрения malloc.
+	/// Если блок освобождается другой нитью, то он вычитается из
+	/// счетчика освободившей нити, поэтому значение может оказаться
+	/// отрицательным.
+	std::int64_t _live_bytes{};
+
+	/// Максимальное значение _live_bytes.
+	std::int64_t _peak_live_bytes{};
+
+	/// Сколько выделений памяти произошло внутри тела while_loop_t.
+	std::uint64_t _loop_body_allocations{};
+
+	/// Сколько байт было запрошено внутри тела while_loop_t.
+	std::uint64_t _loop_body_bytes{};
+};
+
+namespace impl
+{
+
+inline thread_local counters_t tls_counters{};
+
+/// Глубина вложенности тел while_loop_t, выполняемых сейчас нитью.
+inline thread_local unsigned tls_loop_body_depth{};
+
+} /* namespace impl */
+
+/// Подключены ли перехватчики operator new/delete.
+[[nodiscard]] constexpr bool
+enabled() noexcept
+{
+#if defined(SCRIPT_INTERPRETER_ALLOC_ACCOUNTING)
+	return true;
+#else
+	return false;
+#endif
+}
+
+/// Учесть выделение блока памяти.
+///
+/// requested -- сколько байт было запрошено, actual -- реальный
+/// размер выделенного блока.
+inline void
+on_allocate( std::size_t requested, std::size_t actual ) noexcept
+{
+	auto & c = impl::tls_counters;
+	++c._allocations;
+	c._bytes_allocated += requested;
+	c._live_bytes += static_cast< std::int64_t >( actual );
+	if( c._live_bytes > c._peak_live_bytes )
+		c._peak_live_bytes = c._live_bytes;
+
+	if( impl::tls_loop_body_depth )
+	{
+		++c._loop_body_allocations;
+		c._loop_body_bytes += requested;
+	}
+}
+
+/// Учесть освобождение блока памяти реального размера actual.
+inline void
+on_deallocate( std::size_t actual ) noexcept
+{
+	auto & c = impl::tls_counters;
+	++c._deallocations;
+	c._live_bytes -= static_cast< std::int64_t >( actual );
+}
+
+/// Текущие значения счетчиков нити.
+[[nodiscard]] inline counters_t
+current() noexcept
+{
+	return impl::tls_counters;
+}
+
+/// Отметка о том, что нить выполняет тело while_loop_t.
+class loop_body_scope_t
+{
+public:
+	loop_body_scope_t() noexcept { ++impl::tls_loop_body_depth; }
+	~loop_body_scope_t() { --impl::tls_loop_body_depth; }
+
+	loop_body_scope_t( const loop_body_scope_t & ) = delete;
+	loop_body_scope_t &
+	operator=( const loop_body_scope_t & ) = delete;
+};
+
+/// Замер аллокаций на отдельном участке кода.
+///
+/// Пиковое значение занятой памяти на время замера отсчитывается
+/// от объема, занятого в момент начала замера.
+class scope_t
+{
+	counters_t _started{ current() };
+
+public:
+	scope_t() noexcept
+	{
+		impl::tls_counters._peak_live_bytes = _started._live_bytes;
+	}
+
+	scope_t( const scope_t & ) = delete;
+	scope_t &
+	operator=( const scope_t & ) = delete;
+
+	/// Что изменилось с момента начала замера.
+	///
+	/// Для _live_bytes возвращается прирост занятой памяти, для
+	/// _peak_live_bytes -- максимальный прирост. Пиковое значение
+	/// для нити в целом восстанавливается.
+	[[nodiscard]] counters_t
+	finish() noexcept
+	{
+		auto & c = impl::tls_counters;
+		counters_t result{
+			c._allocations - _started._allocations,
+			c._deallocations - _started._deallocations,
+			c._bytes_allocated - _started._bytes_allocated,
+			c._live_bytes - _started._live_bytes,
+			c._peak_live_bytes - _started._live_bytes,
+			c._loop_body_allocations - _started._loop_body_allocations,
+			c._loop_body_bytes - _started._loop_body_bytes
+		};
+
+		if( _started._peak_live_bytes > c._peak_live_bytes )
+			c._peak_live_bytes = _started._peak_live_bytes;
+
+		return result;
+	}
+};
+
+} /* namespace alloc_accounting */
@@ -0,0 +1,195 @@
+#pragma once
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/// Счетчики продвижения рабочих нитей.
+///
+/// Каждая рабочая нить получает свой счетчик итераций циклов
+/// while_loop_t, а отдельная нить периодически читает все счетчики и
+/// по ним вычисляет пропускную способность каждой рабочей нити во
+/// времени.
+///
+/// В счетчик пишет только его нить, поэтому вместо атомарного
+/// fetch_add достаточно relaxed-чтения и relaxed-записи. Чтобы не
+/// трогать разделяемую строку кэша на каждой итерации, итерации
+/// накапливаются локально и публикуются пачками.
+///
+/// В тех же точках, где публикуется пачка итераций, нить может
+/// отмечать, на каком процессоре она сейчас работает (см. cpu_trace_t).
+namespace progress
+{
+
+/// Через сколько итераций накопленное значение публикуется в счетчике.
+inline constexpr std::uint32_t publish_batch = 1024u;
+
+/// Счетчик одной нити.
+///
+/// Занимает отдельную строку кэша, чтобы запись одной нити не
+/// мешала остальным.
+struct alignas(64) counter_t
+{
+	std::atomic< std::uint64_t > _iterations{ 0 };
+
+	/// Прочитать текущее значение из другой нити.
+	[[nodiscard]] std::uint64_t
+	load() const noexcept
+	{
+		return _iterations.load( std::memory_order_relaxed );
+	}
+};
+
+/// Процессоры, на которых была замечена нить.
+///
+/// Заполняется только своей нитью. Тривиально копируемый, чтобы его
+/// можно было передать из рабочего процесса.
+struct cpu_trace_t
+{
+	/// Сколько процессоров можно отметить.
+	static constexpr unsigned max_cpus = 1024u;
+
+	/// Битовая маска замеченных процессоров.
+	std::array< std::uint64_t, max_cpus / 64u > _seen{};
+
+	/// Сколько раз выполнялась проверка.
+	std::uint64_t _observations{};
+
+	/// Сколько раз процессор отличался от предыдущей проверки.
+	std::uint64_t _changes{};
+
+	/// Процессор при последней проверке.
+	int _last_cpu{ -1 };
+
+	/// Отметить процессор, на котором нить работает сейчас.
+	void
+	observe() noexcept
+	{
+#if defined(__linux__)
+		const int cpu = ::sched_getcpu();
+		if( cpu < 0 )
+			return;
+
+		++_observations;
+		if( _last_cpu >= 0 && _last_cpu != cpu )
+			++_changes;
+		_last_cpu = cpu;
+
+		if( static_cast< unsigned >( cpu ) < max_cpus )
+			_seen[ static_cast< unsigned >( cpu ) / 64u ] |=
+					std::uint64_t{ 1 } << (static_cast< unsigned >( cpu ) % 64u);
+#endif
+	}
+
+	/// Номера замеченных процессоров по возрастанию.
+	[[nodiscard]] std::vector< unsigned >
+	cpus() const
+	{
+		std::vector< unsigned > result;
+		for( unsigned cpu = 0; cpu != max_cpus; ++cpu )
+			if( _seen[ cpu / 64u ] & (std::uint64_t{ 1 } << (cpu % 64u)) )
+				result.push_back( cpu );
+		return result;
+	}
+};
+
+namespace impl
+{
+
+/// Счетчик текущей нити. Нужен узлам скрипта, которые ничего не знают
+/// о рабочих нитях.
+inline thread_local counter_t * tls_counter{};
+
+/// Куда текущая нить отмечает процессоры.
+inline thread_local cpu_trace_t * tls_cpu_trace{};
+
+} /* namespace impl */
+
+/// Назначение счетчика текущей нити на время жизни объекта.
+class thread_scope_t
+{
+	counter_t * _previous;
+
+public:
+	explicit thread_scope_t( counter_t * counter ) noexcept
+		: _previous{ impl::tls_counter }
+	{
+		impl::tls_counter = counter;
+	}
+
+	~thread_scope_t() { impl::tls_counter = _previous; }
+
+	thread_scope_t( const thread_scope_t & ) = delete;
+	thread_scope_t & operator=( const thread_scope_t & ) = delete;
+};
+
+/// Назначение cpu_trace_t текущей нити на время жизни объекта.
+class cpu_trace_scope_t
+{
+	cpu_trace_t * _previous;
+
+public:
+	explicit cpu_trace_scope_t( cpu_trace_t * trace ) noexcept
+		: _previous{ impl::tls_cpu_trace }
+	{
+		impl::tls_cpu_trace = trace;
+	}
+
+	~cpu_trace_scope_t() { impl::tls_cpu_trace = _previous; }
+
+	cpu_trace_scope_t( const cpu_trace_scope_t & ) = delete;
+	cpu_trace_scope_t & operator=( const cpu_trace_scope_t & ) = delete;
+};
+
+/// Подсчет итераций одного выполнения цикла.
+///
+/// Счетчик и cpu_trace_t нити читаются один раз при входе в цикл.
+/// Если их нет, то на каждой итерации остается лишь проверка флага
+/// в регистре.
+class loop_tracker_t
+{
+	counter_t * const _counter{ impl::tls_counter };
+	cpu_trace_t * const _cpu_trace{ impl::tls_cpu_trace };
+	const bool _active{ _counter || _cpu_trace };
+	std::uint32_t _pending{};
+
+	void
+	publish() noexcept
+	{
+		if( _counter )
+			_counter->_iterations.store(
+					_counter->_iterations.load( std::memory_order_relaxed )
+							+ _pending,
+					std::memory_order_relaxed );
+		if( _cpu_trace )
+			_cpu_trace->observe();
+		_pending = 0u;
+	}
+
+public:
+	loop_tracker_t() noexcept = default;
+
+	~loop_tracker_t()
+	{
+		if( _active && _pending )
+			publish();
+	}
+
+	loop_tracker_t( const loop_tracker_t & ) = delete;
+	loop_tracker_t & operator=( const loop_tracker_t & ) = delete;
+
+	/// Отметить переход на следующую итерацию.
+	void
+	on_back_edge() noexcept
+	{
+		if( _active && publish_batch == ++_pending )
+			publish();
+	}
+};
+
+} /* namespace progress */
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+namespace run_timeline
+{
+
+using steady_clock_t = std::chrono::steady_clock;
+
+/// Абсолютные моменты начала и завершения работы одной нити.
+struct interval_t
+{
+	steady_clock_t::time_point _started_at{};
+	steady_clock_t::time_point _finished_at{};
+};
+
+/// Сводная информация о том, насколько одновременно работали нити.
+struct summary_t
+{
+	/// Разница между самым поздним и самым ранним стартом.
+	steady_clock_t::duration _start_skew{};
+
+	/// Разница между самым поздним и самым ранним завершением.
+	steady_clock_t::duration _finish_skew{};
+
+	/// Окно, в котором работали все нити одновременно: от самого
+	/// позднего старта до самого раннего завершения.
+	///
+	/// Нулевое, если такого окна не было.
+	steady_clock_t::duration _overlap{};
+
+	/// От самого раннего старта до самого позднего завершения.
+	steady_clock_t::duration _span{};
+
+	/// Задержка между сигналом на старт и стартом самой поздней нити.
+	///
+	/// Пусто, если момент подачи сигнала неизвестен.
+	std::optional< steady_clock_t::duration > _release_latency{};
+};
+
+/// Вычислить сводную информацию по интервалам работы нитей.
+[[nodiscard]] inline summary_t
+summarize(
+	const std::vector< interval_t > & intervals,
+	std::optional< steady_clock_t::time_point > released_at = std::nullopt )
+{
+	summary_t result;
+	if( intervals.empty() )
+		return result;
+
+	auto min_start = intervals.front()._started_at;
+	auto max_start = min_start;
+	auto min_finish = intervals.front()._finished_at;
+	auto max_finish = min_finish;
+	for( const auto & i : intervals )
+	{
+		min_start = std::min( min_start, i._started_at );
+		max_start = std::max( max_start, i._started_at );
+		min_finish = std::min( min_finish, i._finished_at );
+		max_finish = std::max( max_finish, i._finished_at );
+	}
+
+	result._start_skew = max_start - min_start;
+	result._finish_skew = max_finish - min_finish;
+	result._overlap = min_finish > max_start ?
+			min_finish - max_start : steady_clock_t::duration::zero();
+	result._span = max_finish - min_start;
+	if( released_at )
+		result._release_latency = max_start - *released_at;
+
+	return result;
+}
+
+/// Печать сводной информации одной строкой.
+inline void
+print_summary( std::ostream & to, const summary_t & summary )
+{
+	using std::chrono::duration_cast;
+	using us_t = std::chrono::duration< double, std::micro >;
+	using s_t = std::chrono::duration< double >;
+
+	const double span = duration_cast< s_t >( summary._span ).count();
+	const double overlap = duration_cast< s_t >( summary._overlap ).count();
+
+	to << std::fixed << std::setprecision(3)
+			<< "start skew: "
+			<< duration_cast< us_t >( summary._start_skew ).count() << "us"
+			<< ", finish skew: "
+			<< duration_cast< us_t >( summary._finish_skew ).count() << "us";
+	if( summary._release_latency )
+		to << ", release latency: "
+				<< duration_cast< us_t >( *summary._release_latency ).count()
+				<< "us";
+	to << std::setprecision(6)
+			<< ", overlap: " << overlap << "s ("
+			<< std::setprecision(2)
+			<< (span > 0.0 ? overlap / span * 100.0 : 0.0) << "% of span)"
+			<< std::defaultfloat << std::endl;
+}
+
+} /* namespace run_timeline */
@@ -0,0 +1,377 @@
+#pragma once
+
+#if defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#include <immintrin.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace start_barrier
+{
+
+/// Признак того, должна ли рабочая нить выполнять свою работу
+/// в нормальном режиме.
+enum class wakeup_type_t : std::uint32_t
+{
+	/// Рабочая нить должна дождаться сигнала о том, нужно ли ей
+	/// работать или нет. Пока такого сигнала еще нет.
+	standby,
+	/// Рабочая нить должна выполнить свою нормальную работу.
+	normal,
+	/// Рабочая нить должна сразу же завершиться без выполнения
+	/// реальной работы.
+	should_shutdown
+};
+
+namespace impl
+{
+
+using futex_word_t = std::atomic< std::uint32_t >;
+
+static_assert( sizeof(futex_word_t) == sizeof(std::uint32_t) );
+static_assert( futex_word_t::is_always_lock_free );
+
+/// Сколько раз проверять значение активным ожиданием перед тем,
+/// как уснуть на futex-е.
+///
+/// Активное ожидание должно длиться десятки микросекунд: этого
+/// достаточно, чтобы уже прибывшие к барьеру нити стартовали без
+/// участия планировщика, но не настолько долго, чтобы при нехватке
+/// ядер отнимать время у еще не прибывших нитей.
+///
+/// Каждая проверка сопровождается cpu_relax(). pause на Intel начиная
+/// со Skylake занимает около 140 тактов, т.е. 1024 проверки длятся
+/// примерно 40-50 мкс. На процессорах с коротким pause (старые Intel,
+/// AMD) ожидание получается короче, порядка единиц микросекунд.
+///
+/// Значение используется и в process_workers::start_sync_t.
+inline constexpr unsigned spin_iterations = 1u << 10;
+
+inline void
+cpu_relax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	_mm_pause();
+#elif defined(__aarch64__)
+	asm volatile( "yield" ::: "memory" );
+#endif
+}
+
+inline void
+futex_wait( futex_word_t & word, std::uint32_t expected ) noexcept
+{
+#if defined(__linux__)
+	syscall( SYS_futex,
+			reinterpret_cast< std::uint32_t * >( std::addressof(word) ),
+			FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0 );
+#else
+	word.wait( expected, std::memory_order_acquire );
+#endif
+}
+
+inline void
+futex_wake_all( futex_word_t & word ) noexcept
+{
+#if defined(__linux__)
+	syscall( SYS_futex,
+			reinterpret_cast< std::uint32_t * >( std::addressof(word) ),
+			FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0 );
+#else
+	word.notify_all();
+#endif
+}
+
+/// Ждать, пока значение не станет отличным от value.
+///
+/// Сперва используется активное ожидание, затем futex.
+inline std::uint32_t
+wait_while_equal( futex_word_t & word, std::uint32_t value ) noexcept
+{
+	for( unsigned i = 0; i != spin_iterations; ++i )
+	{
+		if( const auto v = word.load( std::memory_order_acquire ); v != value )
+			return v;
+		cpu_relax();
+	}
+
+	for(;;)
+	{
+		if( const auto v = word.load( std::memory_order_acquire ); v != value )
+			return v;
+		futex_wait( word, value );
+	}
+}
+
+/// Узел дерева объединения.
+///
+/// Каждый узел занимает свою строку кэша, чтобы нити из разных
+/// поддеревьев не мешали друг другу.
+struct alignas(64) node_t
+{
+	/// Сколько участников еще не прибыло к этому узлу.
+	futex_word_t _remaining{};
+
+	/// Сигнал для нитей, ожидающих на этом узле.
+	futex_word_t _state{ static_cast< std::uint32_t >( wakeup_type_t::standby ) };
+
+	/// Индекс родительского узла. Для корня совпадает с индексом
+	/// самого узла.
+	std::size_t _parent{};
+};
+
+} /* namespace impl */
+
+/// Барьер для синхронизации старта рабочих нитей.
+///
+/// Рабочие нити прибывают к барьеру через arrive_and_wait, а
+/// управляющая нить, дождавшись прибытия всех, одновременно их
+/// отпускает. Пока управляющая нить не дала сигнал, рабочие нити
+/// крутятся в активном ожидании и лишь затем засыпают на futex-е,
+/// поэтому старт происходит без задержек на пробуждение.
+///
+/// Прибытие организовано в виде дерева объединения (combining tree)
+/// с заданной степенью ветвления: к каждому узлу прибывает не более
+/// fan_in участников, последний из них переходит к родительскому узлу.
+/// Отпускание идет в обратном порядке: каждая нить, прошедшая узел
+/// последней, будит ожидающих на этом узле. Благодаря этому при
+/// сотнях нитей нет одной строки кэша, за которую конкурируют все.
+/// Если fan_in не меньше количества нитей, то дерево вырождается
+/// в один узел.
+class start_sync_t
+{
+	/// Сколько всего рабочих нитей участвует.
+	const std::size_t _threads_count;
+
+	/// Степень ветвления дерева.
+	const std::size_t _fan_in;
+
+	/// Количество узлов дерева.
+	std::size_t _nodes_count{};
+
+	/// Узлы дерева. Сперва идут листья, корень -- последний.
+	std::unique_ptr< impl::node_t[] > _nodes;
+
+	/// Признак того, что все рабочие нити прибыли к барьеру.
+	alignas(64) impl::futex_word_t _all_arrived{ 0 };
+
+	[[nodiscard]] std::size_t
+	root_index() const noexcept
+	{
+		return _nodes_count - 1u;
+	}
+
+	void
+	build_tree()
+	{
+		// Сколько узлов на каждом уровне и сколько у каждого участников.
+		std::vector< std::vector< std::uint32_t > > levels;
+
+		std::size_t participants = _threads_count;
+		do
+		{
+			auto & level = levels.emplace_back();
+			for( std::size_t left = participants; left; )
+			{
+				const auto n = std::min( left, _fan_in );
+				level.push_back( static_cast< std::uint32_t >( n ) );
+				left -= n;
+			}
+			participants = level.size();
+		}
+		while( participants > 1u );
+
+		for( const auto & level : levels )
+			_nodes_count += level.size();
+		_nodes = std::make_unique< impl::node_t[] >( _nodes_count );
+
+		std::size_t level_start{};
+		for( std::size_t l = 0; l != levels.size(); ++l )
+		{
+			const auto next_level_start = level_start + levels[ l ].size();
+			for( std::size_t j = 0; j != levels[ l ].size(); ++j )
+			{
+				auto & node = _nodes[ level_start + j ];
+				node._remaining.store( levels[ l ][ j ], std::memory_order_relaxed );
+				node._parent = (l + 1u == levels.size()) ?
+						level_start + j : next_level_start + j / _fan_in;
+			}
+			level_start = next_level_start;
+		}
+	}
+
+	void
+	signal_node( std::size_t index, wakeup_type_t signal ) noexcept
+	{
+		auto & node = _nodes[ index ];
+		node._state.store(
+				static_cast< std::uint32_t >( signal ),
+				std::memory_order_release );
+		impl::futex_wake_all( node._state );
+	}
+
+	/// Дождаться прибытия всех рабочих нитей.
+	void
+	wait_for_all_arrived() noexcept
+	{
+		(void)impl::wait_while_equal( _all_arrived, 0u );
+	}
+
+	/// Отпустить все рабочие нити с указанным сигналом.
+	///
+	/// Для wakeup_type_t::normal должен вызываться только после
+	/// прибытия всех нитей: тогда достаточно дать сигнал корню, а
+	/// дальше нити сами разбудят друг друга вниз по дереву. Для
+	/// wakeup_type_t::should_shutdown сигнал дается всем узлам,
+	/// поскольку часть нитей может еще не прибыть.
+	void
+	release( wakeup_type_t signal ) noexcept
+	{
+		if( wakeup_type_t::normal == signal )
+			signal_node( root_index(), signal );
+		else
+			for( std::size_t i = 0; i != _nodes_count; ++i )
+				signal_node( i, signal );
+	}
+
+public:
+	/// Степень ветвления по умолчанию.
+	///
+	/// До 16 нитей используется один узел, для большего количества
+	/// строится дерево с ветвлением 8.
+	[[nodiscard]] static std::size_t
+	default_fan_in( std::size_t threads_count ) noexcept
+	{
+		return threads_count <= 16u ? threads_count : 8u;
+	}
+
+	/// Тип вспомогательного объекта, который в своем деструкторе
+	/// дает рабочим нитям сигнал на завершение, если нормальный
+	/// сигнал на старт так и не был дан.
+	///
+	/// Этот сигнал не может быть отдан в деструкторе самого
+	/// start_sync_t, т.к. рабочие нити должны у себя держать
+	/// валидную ссылку на start_sync_t. А когда запускается
+	/// деструктор, эта ссылка перестает быть валидной.
+	class wakeup_controller_t
+	{
+		/// Кто реально занимается синхронизацией.
+		start_sync_t & _parent;
+
+		/// Был ли уже дан сигнал.
+		bool _signaled{ false };
+
+	public:
+		wakeup_controller_t( start_sync_t & parent )
+			: _parent{ parent }
+		{}
+
+		~wakeup_controller_t()
+		{
+			if( !_signaled )
+				_parent.release( wakeup_type_t::should_shutdown );
+		}
+
+		wakeup_controller_t( const wakeup_controller_t & ) = delete;
+		wakeup_controller_t &
+		operator=( const wakeup_controller_t & ) = delete;
+
+		/// Дождаться прибытия всех рабочих нитей и дать им команду
+		/// на старт.
+		///
+		/// Возвращает момент, когда команда была дана.
+		std::chrono::steady_clock::time_point
+		wakeup_threads()
+		{
+			_parent.wait_for_all_arrived();
+
+			_signaled = true;
+			const auto released_at = std::chrono::steady_clock::now();
+			_parent.release( wakeup_type_t::normal );
+
+			return released_at;
+		}
+	};
+
+	start_sync_t(
+		std::size_t threads_count,
+		std::size_t fan_in )
+		: _threads_count{ threads_count }
+		, _fan_in{ fan_in }
+	{
+		if( !_threads_count )
+			throw std::invalid_argument{ "start_sync_t: threads_count can't be 0" };
+		if( _fan_in < 2u && _threads_count > 1u )
+			throw std::invalid_argument{ "start_sync_t: fan_in must be at least 2" };
+
+		build_tree();
+	}
+
+	explicit start_sync_t( std::size_t threads_count )
+		: start_sync_t{ threads_count, default_fan_in( threads_count ) }
+	{}
+
+	start_sync_t( const start_sync_t & ) = delete;
+	start_sync_t & operator=( const start_sync_t & ) = delete;
+
+	/// Ожидание возможности стартовать.
+	///
+	/// Должно вызываться ровно один раз каждой рабочей нитью,
+	/// worker_index должен быть в диапазоне [0, threads_count).
+	[[nodiscard]] wakeup_type_t
+	arrive_and_wait( std::size_t worker_index ) noexcept
+	{
+		// Узлы, к которым эта нить прибыла последней. Их ожидающих
+		// нужно будет разбудить. Глубины в 64 уровня хватит с запасом.
+		std::size_t won_nodes[ 64 ];
+		std::size_t won_count{};
+
+		std::size_t current = worker_index / _fan_in;
+		for(;;)
+		{
+			auto & node = _nodes[ current ];
+			if( 1u != node._remaining.fetch_sub( 1u, std::memory_order_acq_rel ) )
+				// Прибыли не последними, нужно ждать на этом узле.
+				break;
+
+			won_nodes[ won_count++ ] = current;
+			if( node._parent == current )
+			{
+				// Последними прибыли к корню, значит прибыли все.
+				_all_arrived.store( 1u, std::memory_order_release );
+				impl::futex_wake_all( _all_arrived );
+				break;
+			}
+
+			current = node._parent;
+		}
+
+		const auto signal = static_cast< wakeup_type_t >(
+				impl::wait_while_equal(
+						_nodes[ current ]._state,
+						static_cast< std::uint32_t >( wakeup_type_t::standby ) ) );
+
+		// Будим ожидающих на пройденных нами узлах сверху вниз.
+		while( won_count )
+		{
+			const auto index = won_nodes[ --won_count ];
+			if( index != current )
+				signal_node( index, signal );
+		}
+
+		return signal;
+	}
+};
+
+} /* namespace start_barrier */
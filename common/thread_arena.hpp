@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+/// Источники памяти для рабочих нитей.
+///
+/// Каждая рабочая нить создает свою арену и размещает в ней и дерево
+/// скрипта, и контекст выполнения. Ресурсы из std::pmr, используемые
+/// аренами, не синхронизированы, поэтому одну арену нельзя
+/// использовать из нескольких нитей.
+namespace thread_arena
+{
+
+/// Откуда берется память.
+enum class arena_kind_t
+{
+	/// Глобальный хип (malloc из glibc), общий для всех нитей.
+	global_heap,
+	/// std::pmr::monotonic_buffer_resource поверх заранее выделенного
+	/// буфера. Освобождение памяти ничего не делает, вся память
+	/// возвращается при уничтожении арены.
+	monotonic,
+	/// std::pmr::unsynchronized_pool_resource: пулы блоков разного
+	/// размера, освобожденные блоки используются повторно.
+	pool
+};
+
+[[nodiscard]] inline const char *
+to_string( arena_kind_t kind ) noexcept
+{
+	switch( kind )
+	{
+	case arena_kind_t::global_heap: return "malloc";
+	case arena_kind_t::monotonic: return "monotonic";
+	case arena_kind_t::pool: return "pool";
+	}
+	return "unknown";
+}
+
+/// Разбор имени, которое возвращает to_string.
+[[nodiscard]] inline std::optional< arena_kind_t >
+from_string( std::string_view name ) noexcept
+{
+	for( const auto kind : { arena_kind_t::global_heap,
+			arena_kind_t::monotonic, arena_kind_t::pool } )
+		if( name == to_string( kind ) )
+			return kind;
+	return std::nullopt;
+}
+
+/// Размер начального буфера арены по умолчанию.
+///
+/// Демо-скриптам хватает нескольких килобайт, а больший буфер
+/// лишь дольше создается.
+inline constexpr std::size_t default_initial_bytes = 64u * 1024u;
+
+/// Арена одной рабочей нити.
+///
+/// Создается и уничтожается той нитью, которая ее использует, чтобы
+/// начальный буфер оказался в памяти ее NUMA-узла. Все объекты,
+/// размещенные в арене, должны быть уничтожены раньше нее.
+class arena_t
+{
+	const arena_kind_t _kind;
+
+	/// Начальный буфер для monotonic_buffer_resource.
+	std::unique_ptr< std::byte[] > _buffer;
+
+	std::optional< std::pmr::monotonic_buffer_resource > _monotonic;
+	std::optional< std::pmr::unsynchronized_pool_resource > _pool;
+
+public:
+	explicit arena_t(
+		arena_kind_t kind,
+		std::size_t initial_bytes = default_initial_bytes )
+		: _kind{ kind }
+	{
+		switch( kind )
+		{
+		case arena_kind_t::global_heap:
+		break;
+
+		case arena_kind_t::monotonic:
+			if( !initial_bytes )
+				throw std::invalid_argument{
+						"arena_t: initial buffer must not be empty" };
+			_buffer = std::make_unique< std::byte[] >( initial_bytes );
+			// Если буфера не хватит, то дополнительные блоки берутся
+			// из глобального хипа.
+			_monotonic.emplace( _buffer.get(), initial_bytes,
+					std::pmr::new_delete_resource() );
+		break;
+
+		case arena_kind_t::pool:
+			_pool.emplace( std::pmr::new_delete_resource() );
+		break;
+		}
+	}
+
+	arena_t( const arena_t & ) = delete;
+	arena_t & operator=( const arena_t & ) = delete;
+
+	[[nodiscard]] arena_kind_t
+	kind() const noexcept { return _kind; }
+
+	/// Ресурс, через который нужно выделять память.
+	[[nodiscard]] std::pmr::memory_resource *
+	resource() noexcept
+	{
+		if( _monotonic )
+			return std::addressof( *_monotonic );
+		if( _pool )
+			return std::addressof( *_pool );
+		return std::pmr::new_delete_resource();
+	}
+};
+
+} /* namespace thread_arena */
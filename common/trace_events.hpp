@@ -0,0 +1,344 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/// Запись временной шкалы работы рабочих нитей в формате Chrome
+/// trace events (JSON), который открывается в Perfetto и в
+/// chrome://tracing.
+///
+/// У каждой нити своя дорожка (lane) с заранее выделенным буфером
+/// событий. В дорожку пишет только одна нить, поэтому запись не
+/// требует ни блокировок, ни атомарных read-modify-write операций:
+/// достаточно опубликовать новый размер через release-store.
+/// Читаются дорожки после завершения (join) пишущих нитей.
+namespace trace_events
+{
+
+/// Одно событие.
+struct event_t
+{
+	/// Имя события. Должно указывать на строку со статическим временем
+	/// жизни: в горячем пути строки не копируются.
+	const char * _name{};
+
+	/// Начало события, наносекунды от начала записи.
+	std::uint64_t _started_ns{};
+
+	/// Продолжительность события в наносекундах. Для мгновенных
+	/// событий не используется.
+	std::uint64_t _duration_ns{};
+
+	/// Является ли событие мгновенным (фаза "i") или имеет
+	/// продолжительность (фаза "X").
+	bool _instant{ false };
+};
+
+/// Дорожка одной нити.
+class lane_t
+{
+	std::chrono::steady_clock::time_point _origin{};
+
+	std::unique_ptr< event_t[] > _events;
+	std::size_t _capacity{};
+
+	/// Сколько событий уже записано. Изменяется только владельцем.
+	std::atomic< std::size_t > _size{ 0 };
+
+	/// Сколько событий не поместилось в буфер.
+	std::atomic< std::uint64_t > _dropped{ 0 };
+
+	/// Минимальная продолжительность цикла, при которой он попадает
+	/// в дорожку. Пусто, если циклы не записываются.
+	std::optional< std::uint64_t > _min_loop_ns{};
+
+public:
+	lane_t() = default;
+
+	void
+	reset(
+		std::chrono::steady_clock::time_point origin,
+		std::size_t capacity,
+		std::optional< std::uint64_t > min_loop_ns )
+	{
+		_origin = origin;
+		_events = std::make_unique< event_t[] >( capacity );
+		_capacity = capacity;
+		_min_loop_ns = min_loop_ns;
+	}
+
+	/// Текущее время в наносекундах от начала записи.
+	[[nodiscard]] std::uint64_t
+	now_ns() const noexcept
+	{
+		return static_cast< std::uint64_t >(
+				std::chrono::duration_cast< std::chrono::nanoseconds >(
+						std::chrono::steady_clock::now() - _origin ).count() );
+	}
+
+	[[nodiscard]] const std::optional< std::uint64_t > &
+	min_loop_ns() const noexcept { return _min_loop_ns; }
+
+	void
+	add( const event_t & e ) noexcept
+	{
+		const auto n = _size.load( std::memory_order_relaxed );
+		if( n == _capacity )
+		{
+			_dropped.fetch_add( 1u, std::memory_order_relaxed );
+			return;
+		}
+		_events[ n ] = e;
+		_size.store( n + 1u, std::memory_order_release );
+	}
+
+	/// Записать событие, начавшееся в started_ns и закончившееся сейчас.
+	void
+	complete( const char * name, std::uint64_t started_ns ) noexcept
+	{
+		add( event_t{ name, started_ns, now_ns() - started_ns, false } );
+	}
+
+	/// Записать мгновенное событие.
+	void
+	instant( const char * name ) noexcept
+	{
+		add( event_t{ name, now_ns(), 0u, true } );
+	}
+
+	[[nodiscard]] std::size_t
+	size() const noexcept { return _size.load( std::memory_order_acquire ); }
+
+	[[nodiscard]] const event_t &
+	operator[]( std::size_t i ) const noexcept { return _events[ i ]; }
+
+	[[nodiscard]] std::uint64_t
+	dropped() const noexcept
+	{
+		return _dropped.load( std::memory_order_relaxed );
+	}
+};
+
+namespace impl
+{
+
+/// Дорожка, в которую пишет текущая нить. Нужна узлам скрипта,
+/// которые ничего не знают о рабочих нитях.
+inline thread_local lane_t * tls_lane{};
+
+} /* namespace impl */
+
+/// Назначение дорожки текущей нити на время жизни объекта.
+class thread_scope_t
+{
+	lane_t * _previous;
+
+public:
+	explicit thread_scope_t( lane_t * lane ) noexcept
+		: _previous{ impl::tls_lane }
+	{
+		impl::tls_lane = lane;
+	}
+
+	~thread_scope_t() { impl::tls_lane = _previous; }
+
+	thread_scope_t( const thread_scope_t & ) = delete;
+	thread_scope_t & operator=( const thread_scope_t & ) = delete;
+};
+
+/// Событие с продолжительностью, которое записывается в дорожку при
+/// разрушении объекта.
+///
+/// Если дорожки нет, то ничего не делает.
+class span_t
+{
+	lane_t * _lane;
+	const char * _name;
+	std::uint64_t _started_ns{};
+
+public:
+	span_t( lane_t * lane, const char * name ) noexcept
+		: _lane{ lane }
+		, _name{ name }
+	{
+		if( _lane )
+			_started_ns = _lane->now_ns();
+	}
+
+	~span_t()
+	{
+		if( _lane )
+			_lane->complete( _name, _started_ns );
+	}
+
+	span_t( const span_t & ) = delete;
+	span_t & operator=( const span_t & ) = delete;
+};
+
+/// Отметка о выполнении цикла while_loop_t.
+///
+/// Записывается, только если у нити есть дорожка, запись циклов
+/// включена и цикл длился не меньше заданного порога. Если дорожки
+/// нет, то вся стоимость -- чтение thread_local указателя.
+class loop_span_t
+{
+	lane_t * _lane{ impl::tls_lane };
+	std::uint64_t _started_ns{};
+
+public:
+	loop_span_t() noexcept
+	{
+		if( _lane && !_lane->min_loop_ns() )
+			_lane = nullptr;
+		if( _lane )
+			_started_ns = _lane->now_ns();
+	}
+
+	~loop_span_t()
+	{
+		if( _lane )
+		{
+			const auto duration = _lane->now_ns() - _started_ns;
+			if( duration >= *_lane->min_loop_ns() )
+				_lane->add( event_t{ "while_loop_t", _started_ns, duration, false } );
+		}
+	}
+
+	loop_span_t( const loop_span_t & ) = delete;
+	loop_span_t & operator=( const loop_span_t & ) = delete;
+};
+
+/// Параметры записи.
+struct config_t
+{
+	/// Сколько событий может поместиться в дорожку одной нити.
+	std::size_t _events_per_lane{ 1u << 16 };
+
+	/// Порог продолжительности циклов while_loop_t для записи.
+	/// Пусто, если циклы не записываются.
+	std::optional< std::uint64_t > _min_loop_ns{};
+};
+
+/// Все дорожки одной записи.
+///
+/// Дорожка 0 принадлежит управляющей нити, дорожки с 1 по N --
+/// рабочим нитям. Количество дорожек можно увеличить между прогонами,
+/// но не во время работы нитей.
+class recorder_t
+{
+	const config_t _config;
+	const std::chrono::steady_clock::time_point _origin{
+			std::chrono::steady_clock::now() };
+
+	/// Дорожки создаются по одной, чтобы их адреса не менялись.
+	std::vector< std::unique_ptr< lane_t > > _lanes;
+
+public:
+	explicit recorder_t( config_t config )
+		: _config{ std::move(config) }
+	{
+		ensure_lanes( 1u );
+	}
+
+	recorder_t( const recorder_t & ) = delete;
+	recorder_t & operator=( const recorder_t & ) = delete;
+
+	/// Создать недостающие дорожки так, чтобы их было не меньше count.
+	void
+	ensure_lanes( std::size_t count )
+	{
+		while( _lanes.size() < count )
+		{
+			auto & lane = _lanes.emplace_back( std::make_unique< lane_t >() );
+			lane->reset( _origin, _config._events_per_lane,
+					// Управляющая нить скрипт не выполняет.
+					_lanes.size() == 1u ? std::nullopt : _config._min_loop_ns );
+		}
+	}
+
+	/// Дорожка управляющей нити.
+	[[nodiscard]] lane_t &
+	control_lane() noexcept { return *_lanes.front(); }
+
+	/// Дорожка рабочей нити с индексом worker_index.
+	[[nodiscard]] lane_t &
+	worker_lane( std::size_t worker_index ) noexcept
+	{
+		return *_lanes[ worker_index + 1u ];
+	}
+
+	/// Сколько событий не поместилось во все дорожки.
+	[[nodiscard]] std::uint64_t
+	dropped() const noexcept
+	{
+		std::uint64_t result{};
+		for( const auto & l : _lanes )
+			result += l->dropped();
+		return result;
+	}
+
+	/// Сохранение всех дорожек в файл в формате Chrome trace events.
+	///
+	/// Вызывается после завершения всех рабочих нитей.
+	void
+	write_json( const std::string & file_name ) const
+	{
+		std::ofstream file{ file_name, std::ios::out | std::ios::trunc };
+		if( !file )
+			throw std::runtime_error{
+					"unable to open output file: " + file_name };
+
+		// Временные метки в формате задаются в микросекундах, дробная
+		// часть сохраняет наносекунды.
+		const auto us = [&]( std::uint64_t ns ) {
+			file << ns / 1000u << '.' << std::setw( 3 ) << std::setfill( '0' )
+					<< ns % 1000u << std::setfill( ' ' );
+		};
+
+		file << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+		file << "{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": 1, "
+				"\"tid\": 0, \"args\": {\"name\": \"script-interpreter\"}}";
+		for( std::size_t l = 0; l != _lanes.size(); ++l )
+		{
+			file << ",\n{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, "
+					"\"tid\": " << l << ", \"args\": {\"name\": \"";
+			if( l )
+				file << "worker #" << l;
+			else
+				file << "control";
+			file << "\"}}";
+
+			const auto & lane = *_lanes[ l ];
+			for( std::size_t i = 0, n = lane.size(); i != n; ++i )
+			{
+				const auto & e = lane[ i ];
+				file << ",\n{\"ph\": \"" << (e._instant ? "i" : "X")
+						<< "\", \"name\": \"" << e._name
+						<< "\", \"pid\": 1, \"tid\": " << l << ", \"ts\": ";
+				us( e._started_ns );
+				if( e._instant )
+					file << ", \"s\": \"t\"";
+				else
+				{
+					file << ", \"dur\": ";
+					us( e._duration_ns );
+				}
+				file << "}";
+			}
+		}
+		file << "\n]}\n";
+
+		if( !file )
+			throw std::runtime_error{ "unable to write file: " + file_name };
+	}
+};
+
+} /* namespace trace_events */
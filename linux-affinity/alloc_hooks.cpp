@@ -0,0 +1,125 @@
+// Замена глобальных operator new/delete для учета аллокаций.
+//
+// Подключается к программе только при сборке с опцией
+// SCRIPT_INTERPRETER_ALLOC_HOOKS, которая также определяет
+// SCRIPT_INTERPRETER_ALLOC_ACCOUNTING.
+
+#include "../common/alloc_accounting.hpp"
+
+#include <malloc.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+[[nodiscard]] void *
+allocate( std::size_t size, std::size_t alignment ) noexcept
+{
+	if( !size )
+		size = 1u;
+
+	void * p = nullptr;
+	if( alignment <= alignof(std::max_align_t) )
+		p = std::malloc( size );
+	else if( 0 != ::posix_memalign( &p, alignment, size ) )
+		p = nullptr;
+
+	if( p )
+		alloc_accounting::on_allocate( size, ::malloc_usable_size( p ) );
+
+	return p;
+}
+
+[[nodiscard]] void *
+allocate_or_throw( std::size_t size, std::size_t alignment )
+{
+	for(;;)
+	{
+		if( void * p = allocate( size, alignment ) )
+			return p;
+
+		if( const auto handler = std::get_new_handler() )
+			handler();
+		else
+			throw std::bad_alloc{};
+	}
+}
+
+void
+deallocate( void * p ) noexcept
+{
+	if( p )
+	{
+		alloc_accounting::on_deallocate( ::malloc_usable_size( p ) );
+		std::free( p );
+	}
+}
+
+constexpr std::size_t default_alignment = alignof(std::max_align_t);
+
+} /* namespace anonymous */
+
+void *
+operator new( std::size_t size )
+{
+	return allocate_or_throw( size, default_alignment );
+}
+
+void *
+operator new[]( std::size_t size )
+{
+	return allocate_or_throw( size, default_alignment );
+}
+
+void *
+operator new( std::size_t size, const std::nothrow_t & ) noexcept
+{
+	return allocate( size, default_alignment );
+}
+
+void *
+operator new[]( std::size_t size, const std::nothrow_t & ) noexcept
+{
+	return allocate( size, default_alignment );
+}
+
+void *
+operator new( std::size_t size, std::align_val_t alignment )
+{
+	return allocate_or_throw( size, static_cast< std::size_t >( alignment ) );
+}
+
+void *
+operator new[]( std::size_t size, std::align_val_t alignment )
+{
+	return allocate_or_throw( size, static_cast< std::size_t >( alignment ) );
+}
+
+void *
+operator new(
+	std::size_t size, std::align_val_t alignment, const std::nothrow_t & ) noexcept
+{
+	return allocate( size, static_cast< std::size_t >( alignment ) );
+}
+
+void *
+operator new[](
+	std::size_t size, std::align_val_t alignment, const std::nothrow_t & ) noexcept
+{
+	return allocate( size, static_cast< std::size_t >( alignment ) );
+}
+
+void operator delete( void * p ) noexcept { deallocate( p ); }
+void operator delete[]( void * p ) noexcept { deallocate( p ); }
+void operator delete( void * p, std::size_t ) noexcept { deallocate( p ); }
+void operator delete[]( void * p, std::size_t ) noexcept { deallocate( p ); }
+void operator delete( void * p, const std::nothrow_t & ) noexcept { deallocate( p ); }
+void operator delete[]( void * p, const std::nothrow_t & ) noexcept { deallocate( p ); }
+void operator delete( void * p, std::align_val_t ) noexcept { deallocate( p ); }
+void operator delete[]( void * p, std::align_val_t ) noexcept { deallocate( p ); }
+void operator delete( void * p, std::size_t, std::align_val_t ) noexcept { deallocate( p ); }
+void operator delete[]( void * p, std::size_t, std::align_val_t ) noexcept { deallocate( p ); }
+void operator delete( void * p, std::align_val_t, const std::nothrow_t & ) noexcept { deallocate( p ); }
+void operator delete[]( void * p, std::align_val_t, const std::nothrow_t & ) noexcept { deallocate( p ); }
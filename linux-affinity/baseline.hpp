@@ -0,0 +1,408 @@
+#pragma once
+
+#include "bench_report.hpp"
+#include "host_info.hpp"
+#include "stats.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace baseline
+{
+
+/// Код завершения программы, если обнаружена регрессия.
+inline constexpr int regression_exit_code = 1;
+
+/// Сохраненные эталонные результаты.
+struct baseline_t
+{
+	/// Имя эталона.
+	std::string _name;
+
+	/// Машина, на которой были получены эталонные результаты.
+	host_info::host_info_t _host;
+
+	/// Конфигурация запуска.
+	bench_report::run_config_t _config;
+
+	/// Исходные замеры.
+	///
+	/// Ключ -- имя метрики, значения -- все замеры без отбрасывания
+	/// выбросов. Для всех метрик меньшее значение лучше.
+	std::map< std::string, std::vector< double > > _metrics;
+};
+
+/// Параметры сравнения с эталоном.
+struct comparison_params_t
+{
+	/// На сколько процентов должна ухудшиться медиана, чтобы
+	/// это считалось регрессией.
+	double _threshold_percent{};
+
+	/// Уровень значимости для U-критерия Манна-Уитни.
+	double _alpha{};
+
+	/// Разрешено ли сравнивать с результатами с другого железа.
+	bool _allow_host_mismatch{ false };
+};
+
+/// Результат сравнения одной метрики.
+struct metric_comparison_t
+{
+	std::string _name;
+	double _baseline_median{};
+	double _current_median{};
+
+	/// Изменение медианы в процентах (положительное -- ухудшение).
+	double _change_percent{};
+
+	stats::mann_whitney_t _test;
+
+	/// Является ли изменение статистически значимой регрессией,
+	/// превышающей порог.
+	bool _regression{ false };
+};
+
+/// Результат сравнения с эталоном.
+struct comparison_t
+{
+	std::vector< metric_comparison_t > _metrics;
+
+	/// Метрики, которые есть только в эталоне или только в текущих
+	/// результатах (например, счетчики производительности оказались
+	/// недоступны).
+	std::vector< std::string > _unmatched;
+
+	/// Машина, на которой получены текущие результаты.
+	host_info::host_info_t _current_host;
+
+	/// Было ли разрешено сравнение с другим железом.
+	bool _host_mismatch{ false };
+
+	[[nodiscard]] bool
+	has_regression() const
+	{
+		for( const auto & m : _metrics )
+			if( m._regression )
+				return true;
+		return false;
+	}
+};
+
+namespace impl
+{
+
+/// Сигнатура файла с эталоном, включает версию формата.
+inline const std::string file_signature{ "script-interpreter-baseline 1" };
+
+[[nodiscard]] inline std::string
+file_name_for( const std::string & directory, const std::string & name )
+{
+	return (std::filesystem::path{ directory } / (name + ".baseline")).string();
+}
+
+[[nodiscard]] inline double
+median_of( std::vector< double > values )
+{
+	std::sort( values.begin(), values.end() );
+	return stats::quantile_of_sorted( values, 0.5 );
+}
+
+[[nodiscard]] inline std::string
+describe( const host_info::host_info_t & host )
+{
+	return host._cpu_model + ", " + std::to_string( host._logical_cpus )
+			+ " CPU(s), " + host._kernel + ", " + host._compiler
+			+ ", host " + host._hostname;
+}
+
+/// Проверить, что эталон получен при той же конфигурации запуска.
+inline void
+ensure_same_config(
+	const baseline_t & base,
+	const bench_report::run_config_t & current )
+{
+	const auto & b = base._config;
+	const auto mismatch = [&]( const char * what,
+			const std::string & was, const std::string & now ) {
+		throw std::runtime_error{
+				"baseline `" + base._name + "` has different " + what
+				+ ": `" + was + "` vs `" + now + "`" };
+	};
+
+	if( b._value_type != current._value_type )
+		mismatch( "value type", b._value_type, current._value_type );
+	if( b._script != current._script )
+		mismatch( "script", b._script, current._script );
+	if( b._threads_count != current._threads_count )
+		mismatch( "thread count",
+				std::to_string( b._threads_count ),
+				std::to_string( current._threads_count ) );
+	if( b._pinning != current._pinning )
+		mismatch( "pinning", b._pinning, current._pinning );
+	if( b._workers != current._workers )
+		mismatch( "workers", b._workers, current._workers );
+	if( b._memory != current._memory )
+		mismatch( "memory", b._memory, current._memory );
+	if( b._loop_iterations != current._loop_iterations )
+		mismatch( "loop iterations",
+				std::to_string( b._loop_iterations ),
+				std::to_string( current._loop_iterations ) );
+}
+
+} /* namespace impl */
+
+/// Метрики из отчета, которые сохраняются в эталон и сравниваются.
+///
+/// Время самой медленной нити по каждому прогону, время всех нитей
+/// и счетчики производительности на одну итерацию.
+[[nodiscard]] inline std::map< std::string, std::vector< double > >
+metrics_of( const bench_report::report_t & report )
+{
+	std::map< std::string, std::vector< double > > result;
+
+	auto & slowest = result[ "seconds.slowest" ];
+	auto & all = result[ "seconds.all" ];
+	for( const auto & run : report._seconds )
+	{
+		double max_value{};
+		for( const double v : run )
+		{
+			all.push_back( v );
+			max_value = std::max( max_value, v );
+		}
+		slowest.push_back( max_value );
+	}
+
+	for( const auto & [ name, values ] : report._counters_per_iteration )
+		if( !values.empty() )
+			result[ name + "/iter" ] = values;
+
+	return result;
+}
+
+/// Сохранить результаты как эталон с указанным именем.
+///
+/// Возвращает имя файла, в который эталон был сохранен.
+inline std::string
+save(
+	const std::string & directory,
+	const std::string & name,
+	const bench_report::report_t & report )
+{
+	std::filesystem::create_directories( directory );
+
+	const auto file_name = impl::file_name_for( directory, name );
+	std::ofstream file{ file_name, std::ios::out | std::ios::trunc };
+	if( !file )
+		throw std::runtime_error{ "unable to open baseline file: " + file_name };
+
+	const auto & host = report._host;
+	const auto & cfg = report._config;
+	file << impl::file_signature << '\n'
+			<< "name " << name << '\n'
+			<< "host.hostname " << host._hostname << '\n'
+			<< "host.cpu_model " << host._cpu_model << '\n'
+			<< "host.logical_cpus " << host._logical_cpus << '\n'
+			<< "host.kernel " << host._kernel << '\n'
+			<< "host.compiler " << host._compiler << '\n'
+			<< "config.value_type " << cfg._value_type << '\n'
+			<< "config.script " << cfg._script << '\n'
+			<< "config.threads " << cfg._threads_count << '\n'
+			<< "config.pinning " << cfg._pinning << '\n'
+			<< "config.workers " << cfg._workers << '\n'
+			<< "config.memory " << cfg._memory << '\n'
+			<< "config.warmup_runs " << cfg._warmup_runs << '\n'
+			<< "config.repetitions " << cfg._repetitions << '\n'
+			<< "config.loop_iterations " << cfg._loop_iterations << '\n';
+
+	file << std::setprecision( 17 );
+	for( const auto & [ metric, values ] : metrics_of( report ) )
+	{
+		file << "metric " << metric;
+		for( const double v : values )
+			file << ' ' << v;
+		file << '\n';
+	}
+
+	if( !file )
+		throw std::runtime_error{ "unable to write baseline file: " + file_name };
+
+	return file_name;
+}
+
+/// Загрузить эталон с указанным именем.
+[[nodiscard]] inline baseline_t
+load( const std::string & directory, const std::string & name )
+{
+	const auto file_name = impl::file_name_for( directory, name );
+	std::ifstream file{ file_name };
+	if( !file )
+		throw std::runtime_error{ "unable to open baseline file: " + file_name };
+
+	std::string line;
+	if( !std::getline( file, line ) || impl::file_signature != line )
+		throw std::runtime_error{ "not a baseline file: " + file_name };
+
+	baseline_t result;
+	while( std::getline( file, line ) )
+	{
+		if( line.empty() )
+			continue;
+
+		const auto space = line.find( ' ' );
+		const auto key = line.substr( 0, space );
+		const auto value = std::string::npos == space ?
+				std::string{} : line.substr( space + 1u );
+
+		if( "name" == key ) result._name = value;
+		else if( "host.hostname" == key ) result._host._hostname = value;
+		else if( "host.cpu_model" == key ) result._host._cpu_model = value;
+		else if( "host.logical_cpus" == key )
+			result._host._logical_cpus = std::stol( value );
+		else if( "host.kernel" == key ) result._host._kernel = value;
+		else if( "host.compiler" == key ) result._host._compiler = value;
+		else if( "config.value_type" == key ) result._config._value_type = value;
+		else if( "config.script" == key ) result._config._script = value;
+		else if( "config.threads" == key )
+			result._config._threads_count = std::stoul( value );
+		else if( "config.pinning" == key ) result._config._pinning = value;
+		// Эталоны, сохраненные до появления рабочих процессов, не
+		// содержат этого ключа, для них остается значение "threads".
+		else if( "config.workers" == key ) result._config._workers = value;
+		// Аналогично, для старых эталонов остается значение "malloc".
+		else if( "config.memory" == key ) result._config._memory = value;
+		else if( "config.warmup_runs" == key )
+			result._config._warmup_runs =
+					static_cast< unsigned >( std::stoul( value ) );
+		else if( "config.repetitions" == key )
+			result._config._repetitions =
+					static_cast< unsigned >( std::stoul( value ) );
+		else if( "config.loop_iterations" == key )
+			result._config._loop_iterations = std::stoll( value );
+		else if( "metric" == key )
+		{
+			std::istringstream values{ value };
+			std::string metric;
+			values >> metric;
+			auto & samples = result._metrics[ metric ];
+			for( double v; values >> v; )
+				samples.push_back( v );
+		}
+		else
+			throw std::runtime_error{
+					"unknown key `" + key + "` in baseline file: " + file_name };
+	}
+
+	return result;
+}
+
+/// Сравнить текущие результаты с эталоном.
+///
+/// Бросает исключение, если конфигурация запуска отличается, а
+/// также если эталон получен на другом железе и это не было
+/// явно разрешено.
+[[nodiscard]] inline comparison_t
+compare(
+	const baseline_t & base,
+	const bench_report::report_t & report,
+	const comparison_params_t & params )
+{
+	impl::ensure_same_config( base, report._config );
+
+	comparison_t result;
+	result._current_host = report._host;
+	if( !host_info::same_hardware( base._host, report._host ) )
+	{
+		if( !params._allow_host_mismatch )
+			throw std::runtime_error{
+					"baseline `" + base._name + "` was recorded on different "
+					"hardware (" + impl::describe( base._host ) + "), current: "
+					+ impl::describe( report._host )
+					+ "; use allow-host-mismatch to compare anyway" };
+		result._host_mismatch = true;
+	}
+
+	const auto current = metrics_of( report );
+	for( const auto & [ name, base_values ] : base._metrics )
+	{
+		const auto it = current.find( name );
+		if( current.end() == it || it->second.empty() || base_values.empty() )
+		{
+			result._unmatched.push_back( name );
+			continue;
+		}
+
+		metric_comparison_t m;
+		m._name = name;
+		m._baseline_median = impl::median_of( base_values );
+		m._current_median = impl::median_of( it->second );
+		if( m._baseline_median > 0.0 )
+			m._change_percent = (m._current_median - m._baseline_median)
+					/ m._baseline_median * 100.0;
+		m._test = stats::mann_whitney_u( base_values, it->second );
+		m._regression = m._change_percent > params._threshold_percent
+				&& m._test._p_greater < params._alpha;
+
+		result._metrics.push_back( std::move(m) );
+	}
+
+	for( const auto & [ name, values ] : current )
+		if( !base._metrics.count( name ) )
+			result._unmatched.push_back( name );
+
+	return result;
+}
+
+/// Печать результатов сравнения.
+inline void
+print_comparison(
+	std::ostream & to,
+	const baseline_t & base,
+	const comparison_params_t & params,
+	const comparison_t & comparison )
+{
+	to << "comparison with baseline `" << base._name << "` (threshold: "
+			<< params._threshold_percent << "%, alpha: " << params._alpha
+			<< "):" << std::endl;
+	if( comparison._host_mismatch )
+		to << "  WARNING: baseline was recorded on different hardware: "
+				<< impl::describe( base._host ) << std::endl;
+	else if( base._host._hostname != comparison._current_host._hostname
+			|| base._host._kernel != comparison._current_host._kernel
+			|| base._host._compiler != comparison._current_host._compiler )
+		to << "  note: baseline host/kernel/compiler differ: "
+				<< impl::describe( base._host ) << std::endl;
+
+	for( const auto & m : comparison._metrics )
+	{
+		to << "  " << std::left << std::setw( 26 ) << m._name << std::right
+				<< std::setprecision( 6 )
+				<< " baseline=" << m._baseline_median
+				<< " current=" << m._current_median
+				<< std::fixed << std::setprecision( 2 )
+				<< " change=" << std::showpos << m._change_percent << "%"
+				<< std::noshowpos << std::setprecision( 4 )
+				<< " p=" << m._test._p_greater
+				<< (m._test._exact ? " (exact)" : " (normal approx.)")
+				<< std::defaultfloat
+				<< (m._regression ? "  REGRESSION" : "") << std::endl;
+	}
+
+	for( const auto & name : comparison._unmatched )
+		to << "  " << name << ": present only in one of the results, skipped"
+				<< std::endl;
+
+	to << (comparison.has_regression() ?
+				"result: regression detected" : "result: no regression")
+			<< std::endl;
+}
+
+} /* namespace baseline */
@@ -0,0 +1,335 @@
+#pragma once
+
+#include "stats.hpp"
+#include "host_info.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace bench_report
+{
+
+/// Конфигурация запуска, которая сохраняется вместе с результатами.
+struct run_config_t
+{
+	/// Тип значений в скрипте (int или double).
+	std::string _value_type;
+
+	/// Какой скрипт выполнялся.
+	std::string _script;
+
+	/// Количество рабочих нитей.
+	std::size_t _threads_count{};
+
+	/// Описание способа привязки нитей к ядрам.
+	std::string _pinning;
+
+	/// Чем были рабочие: нитями (threads) или процессами (processes).
+	std::string _workers{ "threads" };
+
+	/// Откуда рабочие брали память: malloc, monotonic или pool.
+	std::string _memory{ "malloc" };
+
+	/// Количество прогонов для прогрева.
+	unsigned _warmup_runs{};
+
+	/// Количество прогонов для сбора статистики.
+	unsigned _repetitions{};
+
+	/// Количество итераций цикла в скрипте.
+	long long _loop_iterations{};
+};
+
+/// Итоговый отчет по серии прогонов.
+struct report_t
+{
+	run_config_t _config;
+
+	/// Время работы каждой нити в секундах.
+	///
+	/// Первый индекс -- номер прогона, второй -- номер нити.
+	std::vector< std::vector< double > > _seconds;
+
+	/// Статистика по каждой нити в отдельности.
+	std::vector< stats::summary_t > _per_thread;
+
+	/// Статистика по всем замерам всех нитей вместе.
+	stats::summary_t _all_threads;
+
+	/// Статистика по самой медленной нити каждого прогона.
+	stats::summary_t _slowest_thread;
+
+	/// Значения счетчиков производительности в пересчете на одну
+	/// итерацию цикла скрипта.
+	///
+	/// Ключ -- имя счетчика, значения -- по одному на каждую нить
+	/// каждого прогона. Счетчики, которые не удалось снять,
+	/// отсутствуют.
+	std::map< std::string, std::vector< double > > _counters_per_iteration;
+
+	/// Машина, на которой были получены результаты.
+	host_info::host_info_t _host;
+};
+
+/// Сформировать отчет по результатам замеров.
+[[nodiscard]] inline report_t
+make_report(
+	run_config_t config,
+	std::vector< std::vector< double > > seconds,
+	std::map< std::string, std::vector< double > > counters_per_iteration = {} )
+{
+	report_t result{ std::move(config), std::move(seconds), {}, {}, {},
+			std::move(counters_per_iteration), host_info::collect() };
+
+	std::vector< double > all;
+	std::vector< double > slowest;
+	for( std::size_t t = 0; t != result._config._threads_count; ++t )
+	{
+		std::vector< double > thread_samples;
+		for( const auto & run : result._seconds )
+			thread_samples.push_back( run.at( t ) );
+
+		all.insert( all.end(), thread_samples.begin(), thread_samples.end() );
+		result._per_thread.push_back( stats::summarize( thread_samples ) );
+	}
+
+	for( const auto & run : result._seconds )
+	{
+		double max_value{};
+		for( const double v : run )
+			max_value = std::max( max_value, v );
+		slowest.push_back( max_value );
+	}
+
+	result._all_threads = stats::summarize( all );
+	result._slowest_thread = stats::summarize( slowest );
+
+	return result;
+}
+
+namespace impl
+{
+
+inline void
+print_summary_line(
+	std::ostream & to,
+	const std::string & scope,
+	const stats::summary_t & s )
+{
+	to << "  " << std::left << std::setw( 10 ) << scope << std::right
+			<< std::fixed << std::setprecision( 6 )
+			<< " n=" << s._samples << " (rejected: " << s._rejected << ")"
+			<< " min=" << s._min
+			<< " median=" << s._median
+			<< " p90=" << s._p90
+			<< " p99=" << s._p99
+			<< " stddev=" << s._stddev
+			<< " ci95=[" << s._ci95_low << ", " << s._ci95_high << "]"
+			<< std::defaultfloat << std::endl;
+}
+
+/// Строка для JSON: кавычки, обратная косая черта и управляющие
+/// символы экранируются.
+[[nodiscard]] inline std::string
+json_escape( const std::string & what )
+{
+	static constexpr char hex_digits[] = "0123456789abcdef";
+
+	std::string result;
+	for( const char ch : what )
+	{
+		const auto code = static_cast< unsigned char >( ch );
+		switch( ch )
+		{
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\b': result += "\\b"; break;
+		case '\f': result += "\\f"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		case '\t': result += "\\t"; break;
+		default:
+			if( code < 0x20u )
+			{
+				result += "\\u00";
+				result += hex_digits[ code >> 4 ];
+				result += hex_digits[ code & 0x0fu ];
+			}
+			else
+				result += ch;
+		}
+	}
+	return result;
+}
+
+inline void
+write_json_summary( std::ostream & to, const stats::summary_t & s )
+{
+	to << "{\"samples\": " << s._samples
+			<< ", \"rejected\": " << s._rejected
+			<< ", \"min\": " << s._min
+			<< ", \"median\": " << s._median
+			<< ", \"p90\": " << s._p90
+			<< ", \"p99\": " << s._p99
+			<< ", \"mean\": " << s._mean
+			<< ", \"stddev\": " << s._stddev
+			<< ", \"ci95_low\": " << s._ci95_low
+			<< ", \"ci95_high\": " << s._ci95_high
+			<< "}";
+}
+
+inline void
+write_csv_summary_row(
+	std::ostream & to,
+	const run_config_t & cfg,
+	const std::string & scope,
+	const stats::summary_t & s )
+{
+	to << scope << ','
+			<< cfg._value_type << ','
+			<< '"' << cfg._script << "\","
+			<< cfg._threads_count << ','
+			<< '"' << cfg._pinning << "\","
+			<< cfg._workers << ','
+			<< cfg._memory << ','
+			<< cfg._warmup_runs << ','
+			<< cfg._repetitions << ','
+			<< cfg._loop_iterations << ','
+			<< s._samples << ','
+			<< s._rejected << ','
+			<< s._min << ','
+			<< s._median << ','
+			<< s._p90 << ','
+			<< s._p99 << ','
+			<< s._mean << ','
+			<< s._stddev << ','
+			<< s._ci95_low << ','
+			<< s._ci95_high << '\n';
+}
+
+[[nodiscard]] inline std::ofstream
+open_output_file( const std::string & file_name )
+{
+	std::ofstream file{ file_name, std::ios::out | std::ios::trunc };
+	if( !file )
+		throw std::runtime_error{ "unable to open output file: " + file_name };
+
+	file << std::setprecision( 9 );
+	return file;
+}
+
+} /* namespace impl */
+
+/// Печать сводной статистики в человекочитаемом виде.
+inline void
+print_report( std::ostream & to, const report_t & report )
+{
+	to << "statistics over " << report._seconds.size()
+			<< " run(s), seconds:" << std::endl;
+
+	for( std::size_t t = 0; t != report._per_thread.size(); ++t )
+		impl::print_summary_line(
+				to, "#" + std::to_string( t + 1 ), report._per_thread[ t ] );
+
+	impl::print_summary_line( to, "all", report._all_threads );
+	impl::print_summary_line( to, "slowest", report._slowest_thread );
+}
+
+/// Сохранение отчета в формате JSON.
+///
+/// Сохраняются конфигурация запуска, все исходные замеры и статистика.
+inline void
+write_json( const std::string & file_name, const report_t & report )
+{
+	auto file = impl::open_output_file( file_name );
+	const auto & cfg = report._config;
+
+	file << "{\n"
+		<< "  \"config\": {"
+		<< "\"value_type\": \"" << impl::json_escape( cfg._value_type ) << "\""
+		<< ", \"script\": \"" << impl::json_escape( cfg._script ) << "\""
+		<< ", \"threads\": " << cfg._threads_count
+		<< ", \"pinning\": \"" << impl::json_escape( cfg._pinning ) << "\""
+		<< ", \"workers\": \"" << impl::json_escape( cfg._workers ) << "\""
+		<< ", \"memory\": \"" << impl::json_escape( cfg._memory ) << "\""
+		<< ", \"warmup_runs\": " << cfg._warmup_runs
+		<< ", \"repetitions\": " << cfg._repetitions
+		<< ", \"loop_iterations\": " << cfg._loop_iterations
+		<< "},\n";
+
+	const auto & host = report._host;
+	file << "  \"host\": {"
+		<< "\"hostname\": \"" << impl::json_escape( host._hostname ) << "\""
+		<< ", \"cpu_model\": \"" << impl::json_escape( host._cpu_model ) << "\""
+		<< ", \"logical_cpus\": " << host._logical_cpus
+		<< ", \"kernel\": \"" << impl::json_escape( host._kernel ) << "\""
+		<< ", \"compiler\": \"" << impl::json_escape( host._compiler ) << "\""
+		<< "},\n";
+
+	file << "  \"seconds\": [";
+	for( std::size_t r = 0; r != report._seconds.size(); ++r )
+	{
+		file << (r ? ", " : "") << "[";
+		for( std::size_t t = 0; t != report._seconds[ r ].size(); ++t )
+			file << (t ? ", " : "") << report._seconds[ r ][ t ];
+		file << "]";
+	}
+	file << "],\n";
+
+	file << "  \"per_thread\": [";
+	for( std::size_t t = 0; t != report._per_thread.size(); ++t )
+	{
+		file << (t ? ",\n    " : "\n    ");
+		impl::write_json_summary( file, report._per_thread[ t ] );
+	}
+	file << "\n  ],\n";
+
+	file << "  \"counters_per_iteration\": {";
+	bool first_counter = true;
+	for( const auto & [ name, values ] : report._counters_per_iteration )
+	{
+		file << (first_counter ? "\n    " : ",\n    ")
+				<< "\"" << impl::json_escape( name ) << "\": [";
+		for( std::size_t i = 0; i != values.size(); ++i )
+			file << (i ? ", " : "") << values[ i ];
+		file << "]";
+		first_counter = false;
+	}
+	file << (first_counter ? "},\n" : "\n  },\n");
+
+	file << "  \"all_threads\": ";
+	impl::write_json_summary( file, report._all_threads );
+	file << ",\n  \"slowest_thread\": ";
+	impl::write_json_summary( file, report._slowest_thread );
+	file << "\n}\n";
+}
+
+/// Сохранение сводной статистики в формате CSV.
+///
+/// Каждая строка содержит полную конфигурацию запуска, поэтому
+/// файлы от разных запусков можно просто склеивать.
+inline void
+write_csv( const std::string & file_name, const report_t & report )
+{
+	auto file = impl::open_output_file( file_name );
+	const auto & cfg = report._config;
+
+	file << "scope,value_type,script,threads,pinning,workers,memory,"
+			"warmup_runs,repetitions,loop_iterations,samples,rejected,min,"
+			"median,p90,p99,mean,stddev,ci95_low,ci95_high\n";
+
+	for( std::size_t t = 0; t != report._per_thread.size(); ++t )
+		impl::write_csv_summary_row(
+				file, cfg, "thread#" + std::to_string( t + 1 ),
+				report._per_thread[ t ] );
+
+	impl::write_csv_summary_row( file, cfg, "all", report._all_threads );
+	impl::write_csv_summary_row( file, cfg, "slowest", report._slowest_thread );
+}
+
+} /* namespace bench_report */
@@ -0,0 +1,314 @@
+#pragma once
+
+#include "cpu_budget.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/// Классы ядер на гибридных процессорах (P-ядра и E-ядра).
+///
+/// На гибридных процессорах одинаковые скрипты на разных ядрах
+/// выполняются за разное время, и общее время работы определяется самым
+/// медленным ядром. Классы ядер определяются по sysfs:
+///
+/// - devices/system/cpu/cpuN/cpu_capacity (относительная
+///   производительность ядра, 1024 у самых быстрых);
+/// - devices/system/cpu/cpuN/cpufreq/cpuinfo_max_freq;
+/// - каталоги PMU гибридных процессоров (devices/cpu_core,
+///   devices/cpu_atom и т.п.) с перечнем их процессоров в файле cpus.
+///
+/// Все файлы читаются относительно корня sysfs, поэтому работу можно
+/// проверить на фиктивном дереве каталогов.
+namespace core_classes
+{
+
+using cpu_budget::cpu_list_t;
+
+/// Сведения об одном процессоре.
+struct cpu_info_t
+{
+	unsigned _cpu{};
+
+	/// Значение cpu_capacity, если оно есть.
+	std::optional< unsigned > _capacity;
+
+	/// Значение cpuinfo_max_freq в кГц, если оно есть.
+	std::optional< std::uint64_t > _max_freq_khz;
+
+	/// Имя PMU гибридного процессора, к которому относится процессор.
+	/// Пусто, если процессор не гибридный.
+	std::string _pmu;
+};
+
+/// Класс ядер с одинаковыми характеристиками.
+struct class_t
+{
+	/// Имя для отчетов: "P-core", "E-core", имя PMU или "class N".
+	std::string _name;
+
+	cpu_list_t _cpus;
+
+	/// Производительность относительно самого быстрого класса, (0, 1].
+	double _relative_capacity{ 1.0 };
+
+	std::optional< unsigned > _capacity;
+	std::optional< std::uint64_t > _max_freq_khz;
+};
+
+/// Классы ядер для заданного набора процессоров.
+struct topology_t
+{
+	std::vector< cpu_info_t > _cpus;
+
+	/// Классы в порядке убывания производительности.
+	std::vector< class_t > _classes;
+
+	/// Есть ли ядра с разной производительностью.
+	[[nodiscard]] bool
+	hybrid() const noexcept { return _classes.size() > 1u; }
+
+	/// Класс процессора. nullptr, если процессор неизвестен.
+	[[nodiscard]] const class_t *
+	class_of( unsigned cpu ) const noexcept
+	{
+		for( const auto & c : _classes )
+			if( c._cpus.end() != std::find( c._cpus.begin(), c._cpus.end(), cpu ) )
+				return &c;
+		return nullptr;
+	}
+
+	/// Относительная производительность процессора. Для неизвестных
+	/// процессоров -- 1.
+	[[nodiscard]] double
+	relative_capacity( unsigned cpu ) const noexcept
+	{
+		const auto * c = class_of( cpu );
+		return c ? c->_relative_capacity : 1.0;
+	}
+};
+
+namespace impl
+{
+
+template< typename V >
+[[nodiscard]] std::optional< V >
+read_number( const std::filesystem::path & file_name )
+{
+	const auto line = cpu_budget::impl::read_first_line( file_name );
+	if( !line || line->empty()
+			|| line->find_first_not_of( "0123456789" ) != line->npos )
+		return std::nullopt;
+	return static_cast< V >( std::stoull( *line ) );
+}
+
+/// Понятное имя для PMU гибридного процессора.
+[[nodiscard]] inline std::string
+pmu_class_name( const std::string & pmu )
+{
+	if( "cpu_core" == pmu )
+		return "P-core";
+	if( "cpu_atom" == pmu )
+		return "E-core";
+	return pmu;
+}
+
+} /* namespace impl */
+
+/// PMU гибридного процессора для каждого процессора.
+///
+/// PMU -- это каталог в devices/ с файлами type и cpus. У не гибридных
+/// процессоров файла cpus нет.
+[[nodiscard]] inline std::map< unsigned, std::string >
+detect_hybrid_pmus( const std::filesystem::path & sysfs_root )
+{
+	namespace fs = std::filesystem;
+
+	std::map< unsigned, std::string > result;
+
+	std::error_code ec;
+	const auto devices = sysfs_root / "devices";
+	for( const auto & entry : fs::directory_iterator{ devices, ec } )
+	{
+		if( !fs::exists( entry.path() / "type" ) )
+			continue;
+		const auto cpus = cpu_budget::impl::read_first_line(
+				entry.path() / "cpus" );
+		if( !cpus )
+			continue;
+
+		for( const auto cpu : cpu_budget::parse_cpu_list( *cpus ) )
+			result[ cpu ] = entry.path().filename().string();
+	}
+
+	return result;
+}
+
+/// Определить классы для указанных процессоров.
+[[nodiscard]] inline topology_t
+detect( const std::filesystem::path & sysfs_root, const cpu_list_t & cpus )
+{
+	topology_t result;
+
+	const auto pmus = detect_hybrid_pmus( sysfs_root );
+	const auto cpu_dir = sysfs_root / "devices/system/cpu";
+	for( const auto cpu : cpus )
+	{
+		const auto dir = cpu_dir / ("cpu" + std::to_string( cpu ));
+
+		cpu_info_t info;
+		info._cpu = cpu;
+		info._capacity = impl::read_number< unsigned >( dir / "cpu_capacity" );
+		info._max_freq_khz = impl::read_number< std::uint64_t >(
+				dir / "cpufreq/cpuinfo_max_freq" );
+		if( const auto it = pmus.find( cpu ); it != pmus.end() )
+			info._pmu = it->second;
+		result._cpus.push_back( info );
+	}
+
+	// Ключ класса. Если известен PMU, то ядра одного PMU относятся к
+	// одному классу даже при небольших различиях в частоте (у
+	// "любимых" ядер Intel максимальная частота выше).
+	const bool any_pmu = std::any_of( result._cpus.begin(), result._cpus.end(),
+			[]( const auto & i ) { return !i._pmu.empty(); } );
+	const bool any_capacity = std::any_of(
+			result._cpus.begin(), result._cpus.end(),
+			[]( const auto & i ) { return i._capacity.has_value(); } );
+
+	using key_t = std::tuple< std::string, unsigned, std::uint64_t >;
+	const auto key_of = [&]( const cpu_info_t & i ) -> key_t {
+		if( any_pmu )
+			return { i._pmu, 0u, 0u };
+		if( any_capacity )
+			return { {}, i._capacity.value_or( 0u ), 0u };
+		return { {}, 0u, i._max_freq_khz.value_or( 0u ) };
+	};
+
+	std::map< key_t, class_t > classes;
+	for( const auto & info : result._cpus )
+	{
+		auto & c = classes[ key_of( info ) ];
+		c._cpus.push_back( info._cpu );
+		if( info._capacity )
+			c._capacity = std::max( c._capacity.value_or( 0u ), *info._capacity );
+		if( info._max_freq_khz )
+			c._max_freq_khz = std::max(
+					c._max_freq_khz.value_or( 0u ), *info._max_freq_khz );
+		if( !info._pmu.empty() )
+			c._name = impl::pmu_class_name( info._pmu );
+	}
+
+	// Производительность класса: cpu_capacity, если он известен для
+	// всех классов, иначе максимальная частота.
+	const auto metric = [&]( const class_t & c ) -> double {
+		if( any_capacity && c._capacity )
+			return static_cast< double >( *c._capacity );
+		if( !any_capacity && c._max_freq_khz )
+			return static_cast< double >( *c._max_freq_khz );
+		return 0.0;
+	};
+
+	for( auto & kv : classes )
+		result._classes.push_back( std::move(kv.second) );
+	std::stable_sort( result._classes.begin(), result._classes.end(),
+			[&]( const class_t & a, const class_t & b ) {
+				return metric( a ) > metric( b );
+			} );
+
+	const double best = result._classes.empty()
+			? 0.0 : metric( result._classes.front() );
+	for( std::size_t i = 0; i != result._classes.size(); ++i )
+	{
+		auto & c = result._classes[ i ];
+		const double m = metric( c );
+		c._relative_capacity = best > 0.0 && m > 0.0 ? m / best : 1.0;
+		if( c._name.empty() )
+			c._name = "class " + std::to_string( i );
+	}
+
+	return result;
+}
+
+/// Упорядочить процессоры по убыванию производительности их классов.
+///
+/// Внутри одного класса исходный порядок сохраняется.
+[[nodiscard]] inline cpu_list_t
+fastest_first( const topology_t & topology, cpu_list_t cpus )
+{
+	std::stable_sort( cpus.begin(), cpus.end(),
+			[&]( unsigned a, unsigned b ) {
+				return topology.relative_capacity( a )
+						> topology.relative_capacity( b );
+			} );
+	return cpus;
+}
+
+/// Разделить jobs заданий пропорционально весам.
+///
+/// Используется метод наибольших остатков: сумма долей всегда равна
+/// jobs, а каждая доля отличается от точной пропорции меньше чем на 1.
+[[nodiscard]] inline std::vector< std::size_t >
+split_jobs( std::size_t jobs, const std::vector< double > & weights )
+{
+	std::vector< std::size_t > result( weights.size(), 0u );
+	const double total = std::accumulate( weights.begin(), weights.end(), 0.0 );
+	if( weights.empty() )
+		return result;
+	if( !(total > 0.0) )
+	{
+		for( std::size_t i = 0; i != jobs; ++i )
+			++result[ i % result.size() ];
+		return result;
+	}
+
+	std::vector< std::pair< double, std::size_t > > remainders;
+	std::size_t assigned{};
+	for( std::size_t i = 0; i != weights.size(); ++i )
+	{
+		const double exact = static_cast< double >( jobs ) * weights[ i ] / total;
+		result[ i ] = static_cast< std::size_t >( exact );
+		assigned += result[ i ];
+		remainders.emplace_back( exact - static_cast< double >( result[ i ] ), i );
+	}
+
+	std::stable_sort( remainders.begin(), remainders.end(),
+			[]( const auto & a, const auto & b ) { return a.first > b.first; } );
+	for( std::size_t k = 0; assigned < jobs; ++k, ++assigned )
+		++result[ remainders[ k % remainders.size() ].second ];
+
+	return result;
+}
+
+/// Печать классов ядер.
+inline void
+report( std::ostream & to, const topology_t & topology )
+{
+	to << "  core classes" << (topology.hybrid() ? " (hybrid)" : "") << ":";
+	if( topology._classes.empty() )
+		to << " n/a";
+	to << std::endl;
+
+	for( const auto & c : topology._classes )
+	{
+		to << "    " << c._name << ": cpus " << cpu_budget::format_cpu_list( c._cpus )
+				<< ", relative capacity " << std::fixed << std::setprecision( 2 )
+				<< c._relative_capacity << std::defaultfloat;
+		if( c._capacity )
+			to << ", cpu_capacity " << *c._capacity;
+		if( c._max_freq_khz )
+			to << ", max freq " << std::fixed << std::setprecision( 2 )
+					<< static_cast< double >( *c._max_freq_khz ) / 1e6 << " GHz"
+					<< std::defaultfloat;
+		to << std::endl;
+	}
+}
+
+} /* namespace core_classes */
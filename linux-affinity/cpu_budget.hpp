@@ -0,0 +1,335 @@
+#pragma once
+
+#include <sched.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Какие процессоры действительно доступны программе.
+///
+/// В контейнерах std::thread::hardware_concurrency() возвращает
+/// количество процессоров машины, хотя процессу может быть разрешена
+/// лишь их часть. Здесь учитываются:
+///
+/// - маска sched_getaffinity процесса;
+/// - cgroup v2: cpuset.cpus.effective (на каких процессорах можно
+///   работать) и cpu.max (сколько процессорного времени можно
+///   потратить);
+/// - процессоры, изолированные через isolcpus и nohz_full.
+///
+/// Все файлы читаются относительно корня sysfs, поэтому работу можно
+/// проверить на фиктивном дереве каталогов. Путь к cgroup процесса
+/// берется из /proc/self/cgroup.
+namespace cpu_budget
+{
+
+using cpu_list_t = std::vector< unsigned >;
+
+/// Что удалось узнать о доступных процессорах.
+struct budget_t
+{
+	/// Маска sched_getaffinity процесса.
+	cpu_list_t _affinity;
+
+	/// Путь к cgroup процесса (в иерархии cgroup v2).
+	std::string _cgroup_path;
+
+	/// cpuset.cpus.effective ближайшей cgroup, где он есть. Пусто,
+	/// если cgroup v2 или контроллер cpuset недоступны.
+	std::optional< cpu_list_t > _cgroup_cpus;
+
+	/// Квота из cpu.max в процессорах (quota / period), самая жесткая
+	/// из квот cgroup процесса и ее предков. Пусто, если квоты нет.
+	std::optional< double > _quota_cpus;
+
+	/// Изолированные процессоры (isolcpus).
+	cpu_list_t _isolated;
+
+	/// Процессоры без периодического таймера (nohz_full).
+	cpu_list_t _nohz_full;
+
+	/// К каким процессорам можно привязывать рабочих, в порядке
+	/// предпочтения: сперва изолированные, затем остальные.
+	///
+	/// isolcpus убирает изолированные процессоры из маски по
+	/// умолчанию, но привязаться к ним можно, если их разрешает cpuset.
+	/// Поэтому изолированные процессоры вне маски процесса добавляются
+	/// только тогда, когда найден cpuset.cpus.effective и они в нем
+	/// есть. Такие процессоры перечислены в _isolated_beyond_affinity.
+	cpu_list_t _usable;
+
+	/// Изолированные процессоры, которые не входят в маску процесса,
+	/// но добавлены в _usable, потому что их разрешает cpuset.
+	cpu_list_t _isolated_beyond_affinity;
+
+	/// Сколько рабочих имеет смысл запускать: количество доступных
+	/// процессоров, ограниченное квотой cpu.max.
+	std::size_t _capacity{ 1u };
+
+	/// Является ли процессор изолированным.
+	[[nodiscard]] bool
+	is_isolated( unsigned cpu ) const
+	{
+		return _isolated.end()
+				!= std::find( _isolated.begin(), _isolated.end(), cpu );
+	}
+};
+
+namespace impl
+{
+
+[[nodiscard]] inline std::optional< std::string >
+read_first_line( const std::filesystem::path & file_name )
+{
+	std::ifstream file{ file_name };
+	std::string line;
+	if( !file || !std::getline( file, line ) )
+		return std::nullopt;
+	return line;
+}
+
+} /* namespace impl */
+
+/// Разобрать список процессоров в формате ядра, например "0-3,8,10-11".
+///
+/// Пустая строка означает пустой список.
+[[nodiscard]] inline cpu_list_t
+parse_cpu_list( std::string_view text )
+{
+	const auto to_cpu = [&]( std::string_view v ) {
+		if( v.empty() || v.find_first_not_of( "0123456789" ) != v.npos )
+			throw std::runtime_error{
+					"invalid cpu list: `" + std::string{ text } + "`" };
+		return static_cast< unsigned >( std::stoul( std::string{ v } ) );
+	};
+
+	while( !text.empty() && (text.back() == '\n' || text.back() == ' ') )
+		text.remove_suffix( 1u );
+
+	std::set< unsigned > result;
+	std::string_view rest = text;
+	while( !rest.empty() )
+	{
+		const auto comma = rest.find( ',' );
+		const auto item = rest.substr( 0, comma );
+		if( const auto dash = item.find( '-' ); dash != item.npos )
+		{
+			const auto from = to_cpu( item.substr( 0, dash ) );
+			const auto to = to_cpu( item.substr( dash + 1u ) );
+			if( from > to )
+				throw std::runtime_error{
+						"invalid cpu list: `" + std::string{ text } + "`" };
+			for( auto cpu = from; cpu <= to; ++cpu )
+				result.insert( cpu );
+		}
+		else
+			result.insert( to_cpu( item ) );
+
+		if( comma == rest.npos )
+			break;
+		rest.remove_prefix( comma + 1u );
+	}
+
+	return { result.begin(), result.end() };
+}
+
+/// Представить список процессоров в формате ядра.
+[[nodiscard]] inline std::string
+format_cpu_list( const cpu_list_t & cpus )
+{
+	std::string result;
+	for( std::size_t i = 0; i != cpus.size(); )
+	{
+		auto j = i;
+		while( j + 1u != cpus.size() && cpus[ j + 1u ] == cpus[ j ] + 1u )
+			++j;
+
+		if( !result.empty() )
+			result += ',';
+		result += std::to_string( cpus[ i ] );
+		if( j != i )
+			result += '-' + std::to_string( cpus[ j ] );
+		i = j + 1u;
+	}
+	return result.empty() ? "none" : result;
+}
+
+/// Маска sched_getaffinity процесса.
+[[nodiscard]] inline cpu_list_t
+process_affinity()
+{
+	cpu_set_t cpu_set;
+	CPU_ZERO( &cpu_set );
+	if( 0 != sched_getaffinity( 0, sizeof(cpu_set), &cpu_set ) )
+		throw std::runtime_error{ "sched_getaffinity failed" };
+
+	cpu_list_t result;
+	for( int cpu = 0; cpu != CPU_SETSIZE; ++cpu )
+		if( CPU_ISSET( cpu, &cpu_set ) )
+			result.push_back( static_cast< unsigned >( cpu ) );
+	return result;
+}
+
+/// Путь к cgroup процесса в иерархии cgroup v2 (строка "0::<path>"
+/// из /proc/self/cgroup).
+[[nodiscard]] inline std::string
+own_cgroup_path( const std::filesystem::path & proc_cgroup = "/proc/self/cgroup" )
+{
+	std::ifstream file{ proc_cgroup };
+	std::string line;
+	while( std::getline( file, line ) )
+		if( line.starts_with( "0::" ) )
+			return line.substr( 3u );
+	return "/";
+}
+
+/// Собрать сведения о доступных процессорах.
+///
+/// affinity -- маска процесса (передается явно, чтобы можно было
+/// проверить работу с фиктивным sysfs).
+[[nodiscard]] inline budget_t
+detect(
+	const std::filesystem::path & sysfs_root,
+	cpu_list_t affinity,
+	std::string cgroup_path )
+{
+	namespace fs = std::filesystem;
+
+	budget_t result;
+	result._affinity = std::move(affinity);
+	result._cgroup_path = std::move(cgroup_path);
+
+	const auto cpu_dir = sysfs_root / "devices/system/cpu";
+	if( const auto line = impl::read_first_line( cpu_dir / "isolated" ) )
+		result._isolated = parse_cpu_list( *line );
+	if( const auto line = impl::read_first_line( cpu_dir / "nohz_full" ) )
+		// Если nohz_full не задан, то файл содержит "(null)".
+		if( line->find_first_not_of( "0123456789,-" ) == line->npos )
+			result._nohz_full = parse_cpu_list( *line );
+
+	// В чисто cgroup v2 системах иерархия смонтирована в fs/cgroup,
+	// в гибридных -- в fs/cgroup/unified.
+	std::optional< fs::path > cgroup_root;
+	for( const auto & candidate : { sysfs_root / "fs/cgroup",
+			sysfs_root / "fs/cgroup/unified" } )
+		if( fs::exists( candidate / "cgroup.controllers" ) )
+		{
+			cgroup_root = candidate;
+			break;
+		}
+
+	if( cgroup_root )
+	{
+		// Идем от cgroup процесса к корню. cpuset.cpus.effective берется
+		// из ближайшей cgroup, где он есть, а квоты действуют на всех
+		// уровнях, поэтому берется самая жесткая.
+		fs::path relative = fs::path{ result._cgroup_path }.relative_path();
+		for(;;)
+		{
+			const auto dir = *cgroup_root / relative;
+			if( !result._cgroup_cpus )
+				if( const auto line = impl::read_first_line(
+						dir / "cpuset.cpus.effective" ) )
+					result._cgroup_cpus = parse_cpu_list( *line );
+
+			if( const auto line = impl::read_first_line( dir / "cpu.max" ) )
+				if( !line->starts_with( "max" ) )
+				{
+					const auto space = line->find( ' ' );
+					const double quota = std::stod( line->substr( 0, space ) );
+					const double period = space == line->npos
+							? 100000.0 : std::stod( line->substr( space + 1u ) );
+					if( period > 0.0 )
+					{
+						const double cpus = quota / period;
+						if( !result._quota_cpus || cpus < *result._quota_cpus )
+							result._quota_cpus = cpus;
+					}
+				}
+
+			if( relative.empty() )
+				break;
+			relative = relative.parent_path();
+		}
+	}
+
+	const auto contains = []( const cpu_list_t & cpus, unsigned cpu ) {
+		return cpus.end() != std::find( cpus.begin(), cpus.end(), cpu );
+	};
+	const auto allowed = [&]( unsigned cpu ) {
+		return !result._cgroup_cpus || contains( *result._cgroup_cpus, cpu );
+	};
+
+	// Сперва изолированные процессоры, затем остальные из маски.
+	// Изолированный процессор вне маски процесса берется, только если
+	// его явно разрешает найденный cpuset: без cpuset неизвестно, можно
+	// ли к нему привязаться.
+	for( const auto cpu : result._isolated )
+		if( contains( result._affinity, cpu ) )
+		{
+			if( allowed( cpu ) )
+				result._usable.push_back( cpu );
+		}
+		else if( result._cgroup_cpus && allowed( cpu ) )
+		{
+			result._usable.push_back( cpu );
+			result._isolated_beyond_affinity.push_back( cpu );
+		}
+	for( const auto cpu : result._affinity )
+		if( allowed( cpu ) && !result.is_isolated( cpu ) )
+			result._usable.push_back( cpu );
+
+	result._capacity = std::max< std::size_t >( 1u, result._usable.size() );
+	if( result._quota_cpus )
+		result._capacity = std::clamp< std::size_t >(
+				static_cast< std::size_t >( std::floor( *result._quota_cpus ) ),
+				1u, result._capacity );
+
+	return result;
+}
+
+/// Собрать сведения о доступных процессорах текущего процесса.
+[[nodiscard]] inline budget_t
+detect( const std::filesystem::path & sysfs_root = "/sys" )
+{
+	return detect( sysfs_root, process_affinity(), own_cgroup_path() );
+}
+
+/// Печать собранных сведений.
+inline void
+report( std::ostream & to, const budget_t & budget )
+{
+	to << "  process affinity: " << format_cpu_list( budget._affinity )
+			<< " (" << budget._affinity.size() << " CPU(s))\n"
+			<< "  cgroup: " << budget._cgroup_path << "\n"
+			<< "  cgroup cpuset.cpus.effective: "
+			<< (budget._cgroup_cpus ? format_cpu_list( *budget._cgroup_cpus )
+					: std::string{ "n/a" }) << "\n"
+			<< "  cgroup cpu.max quota: ";
+	if( budget._quota_cpus )
+		to << *budget._quota_cpus << " CPU(s)";
+	else
+		to << "none";
+	to << "\n"
+			<< "  isolcpus: " << format_cpu_list( budget._isolated ) << "\n"
+			<< "  nohz_full: " << format_cpu_list( budget._nohz_full ) << "\n";
+	if( !budget._isolated_beyond_affinity.empty() )
+		to << "  isolated CPUs added beyond process affinity (allowed by cpuset): "
+				<< format_cpu_list( budget._isolated_beyond_affinity ) << "\n";
+	to
+			<< "  usable for workers (preferred first): "
+			<< format_cpu_list( budget._usable ) << "\n"
+			<< "  effective capacity: " << budget._capacity << " worker(s)"
+			<< std::endl;
+}
+
+} /* namespace cpu_budget */
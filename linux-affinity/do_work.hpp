@@ -0,0 +1,2754 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../templated-script/script.hpp"
+#include "../templated-script/verifier.hpp"
+#include "../templated-script/demo_script.hpp"
+#include "../templated-script/script_library.hpp"
+#include "../templated-script/engines.hpp"
+#include "../templated-script/checkpoint.hpp"
+
+#include "../common/start_barrier.hpp"
+#include "../common/run_timeline.hpp"
+#include "../common/alloc_accounting.hpp"
+#include "../common/thread_arena.hpp"
+#include "../common/trace_events.hpp"
+
+#include "run_params.hpp"
+#include "perf_counters.hpp"
+#include "bench_report.hpp"
+#include "baseline.hpp"
+#include "scalability.hpp"
+#include "sysfs_sampler.hpp"
+#include "progress_sampler.hpp"
+#include "os_accounting.hpp"
+#include "cpu_budget.hpp"
+#include "core_classes.hpp"
+#include "record_stream.hpp"
+#include "process_workers.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <memory_resource>
+#include <syncstream>
+
+namespace linux_affinity
+{
+
+namespace impl
+{
+
+void
+pin_to_core(
+	run_params::core_index_t core_index)
+{
+	cpu_set_t cpu_set;
+	CPU_ZERO( &cpu_set );
+	CPU_SET( core_index, &cpu_set );
+
+	// Привязываем себя к конкретному ядру.
+	if( const int rc = pthread_setaffinity_np( pthread_self(),
+			sizeof(cpu_set),
+			&cpu_set );
+			0 != rc )
+	{
+		throw std::runtime_error{
+				"pthread_setaffinity_np failed, core_index="
+				+ std::to_string( core_index )
+				+ ", error: " + std::strerror( rc )
+			};
+	}
+}
+
+/// Результаты работы одной рабочей нити.
+struct thread_results_t
+{
+	/// Время выполнения скрипта.
+	std::chrono::steady_clock::duration _time{
+			std::chrono::steady_clock::duration::zero()
+		};
+
+	/// Абсолютные моменты начала и завершения выполнения скрипта.
+	run_timeline::interval_t _interval;
+
+	/// Был ли скрипт выполнен до конца.
+	bool _completed{ false };
+
+	/// Совпали ли значения переменных после выполнения с ожидаемыми.
+	bool _final_values_ok{ false };
+
+	/// Обращения к кэшу результатов чистых циклов во время выполнения
+	/// скрипта (только для движка memo).
+	script::engines::memo::stats_t _memo;
+
+	/// Значения счетчиков производительности во время выполнения скрипта.
+	perf_counters::counter_values_t _counters;
+
+	/// Аллокации во время script::execute.
+	///
+	/// Заполняется, только если учет аллокаций включен при сборке.
+	alloc_accounting::counters_t _execute_allocations;
+
+	/// Аллокации за все время жизни рабочей нити, включая подготовку
+	/// к работе.
+	alloc_accounting::counters_t _thread_allocations;
+
+	/// Ресурсы ОС, потраченные нитью во время выполнения скрипта.
+	os_accounting::usage_t _os_usage;
+
+	/// На каких процессорах нить была замечена во время выполнения
+	/// скрипта.
+	progress::cpu_trace_t _cpu_trace;
+};
+
+/// Результаты одного прогона на всех рабочих нитях.
+struct run_results_t
+{
+	/// Результаты каждой из нитей.
+	std::vector< thread_results_t > _threads;
+
+	/// Момент, когда рабочим нитям был дан сигнал на старт.
+	run_timeline::steady_clock_t::time_point _released_at;
+
+	/// Данные о частоте процессоров и температуре, если опрос
+	/// был включен.
+	std::optional< sysfs_sampler::samples_t > _sysfs_samples;
+
+	/// Снимки счетчиков продвижения рабочих нитей, если опрос
+	/// был включен.
+	std::optional< progress_sampler::samples_t > _progress_samples;
+};
+
+/// Скрипт, который выполняют рабочие нити, и сведения о нем.
+template< typename T >
+struct workload_t
+{
+	/// Описание скрипта для отчетов.
+	std::string _name;
+
+	/// Скрипт проверяется при создании и выполняется без проверок
+	/// наличия переменных.
+	///
+	/// Он размещен в глобальном хипе и разделяется всеми рабочими
+	/// нитями, если они работают с malloc.
+	script::verified_script_t<T> _script;
+
+	/// Построение такого же скрипта в памяти из указанного ресурса.
+	///
+	/// Используется рабочими нитями, у которых своя арена: каждая из
+	/// них строит свою копию скрипта.
+	std::function< script::statement_shptr_t<T>(
+			std::pmr::memory_resource * ) > _build;
+
+	/// Сколько итераций циклов выполняет скрипт.
+	///
+	/// Значения счетчиков производительности приводятся к одной
+	/// итерации.
+	long long _loop_iterations{};
+
+	/// Сколько байт памяти читает и записывает скрипт, если он
+	/// работает с массивами.
+	std::optional< double > _bytes_processed{};
+
+	/// Значения переменных после выполнения скрипта.
+	///
+	/// Проверяются каждой рабочей нитью после замера.
+	std::vector< script_library::expected_value_t<T> > _expected{};
+
+	/// Чем выполняется скрипт.
+	script::engines::engine_shptr_t<T> _engine{};
+
+	/// _script, подготовленный движком _engine.
+	///
+	/// Рабочие нити со своей ареной подготавливают свою копию скрипта.
+	script::engines::prepared_script_shptr_t<T> _prepared{};
+};
+
+/// Работа одной рабочей нити (или единственной нити рабочего процесса).
+///
+/// Start_Sync -- тип барьера: start_barrier::start_sync_t для нитей
+/// или process_workers::start_sync_t для процессов.
+template< typename T, typename Start_Sync = start_barrier::start_sync_t >
+void
+exec_demo_script_thread_body(
+	/// Порядковый номер нити, нужен для барьера.
+	std::size_t worker_index,
+	/// Куда нужно привязывать нить. Если core_index пуст, то
+	/// привязки нити к ядру не выполняется.
+	std::optional<run_params::core_index_t> core_index,
+	/// Для синхронизации момента старта.
+	Start_Sync & start_latch,
+	/// Что нужно запускать.
+	const workload_t<T> & workload,
+	/// Откуда брать память под скрипт и контекст выполнения.
+	thread_arena::arena_kind_t memory,
+	/// Дорожка временной шкалы этой нити. Пусто, если временная
+	/// шкала не записывается.
+	trace_events::lane_t * trace,
+	/// Счетчик итераций этой нити. Пусто, если продвижение нитей
+	/// не отслеживается.
+	progress::counter_t * progress_counter,
+	/// Куда нужно помещать результаты измерений.
+	thread_results_t & results_receiver)
+{
+	trace_events::thread_scope_t trace_scope{ trace };
+	progress::thread_scope_t progress_scope{ progress_counter };
+
+	// Процессор отмечается на границах пачек итераций циклов, а также
+	// в начале и в конце выполнения скрипта.
+	progress::cpu_trace_t cpu_trace;
+	progress::cpu_trace_scope_t cpu_trace_scope{ &cpu_trace };
+	if( trace )
+		trace->instant( "thread started" );
+
+	// Даже если подготовка не удалась, к барьеру нужно прибыть,
+	// иначе остальные нити никогда не стартуют.
+	bool prepared = false;
+	std::optional< perf_counters::thread_counters_t > counters;
+	// Арена должна пережить свою копию скрипта.
+	std::optional< thread_arena::arena_t > arena;
+	std::optional< script::verified_script_t<T> > own_script;
+	script::engines::prepared_script_shptr_t<T> own_prepared;
+	try
+	{
+		// Сперва привяжемся к указанному ядру, если это нужно,
+		// затем будем ждать сигнала на начало работы.
+		if( core_index.has_value() )
+		{
+			trace_events::span_t span{ trace, "pin_to_core" };
+			pin_to_core( *core_index );
+		}
+
+		trace_events::span_t span{ trace, "prepare" };
+
+		// Арена и копия скрипта создаются уже после привязки, чтобы
+		// их память оказалась на NUMA-узле этой нити.
+		if( thread_arena::arena_kind_t::global_heap != memory )
+		{
+			arena.emplace( memory );
+			own_script.emplace( script::verify(
+					workload._build( arena->resource() ) ) );
+			own_prepared = workload._engine->prepare( *own_script );
+		}
+
+		// Счетчики создаются заранее, чтобы стоимость perf_event_open
+		// не попадала в замеры.
+		counters.emplace();
+		prepared = true;
+	}
+	catch( const std::exception & x)
+	{
+		std::osyncstream{ std::cerr }
+				<< "exec_demo_script_thread_body: exception caught: "
+				<< x.what() << std::endl;
+	}
+
+	const auto wakeup_type = [&] {
+		trace_events::span_t span{ trace, "arrive_and_wait" };
+		return start_latch.arrive_and_wait( worker_index );
+	}();
+	if( start_barrier::wakeup_type_t::should_shutdown == wakeup_type
+			|| !prepared )
+	{
+		// Работать нельзя и нужно быстро завершить свои действия.
+		return;
+	}
+
+	try
+	{
+		// Раз оказались здесь, значит можно работать в нормальном режиме.
+		//
+		// Контекст должен пережить замер: значения переменных в нем
+		// проверяются уже после остановки счетчиков.
+		script::exec_context_t<T> ctx{ arena
+				? arena->resource() : std::pmr::get_default_resource() };
+		const auto usage_before = os_accounting::snapshot();
+		const auto memo_before = script::engines::memo::thread_stats();
+		cpu_trace.observe();
+		const auto started_at = std::chrono::steady_clock::now();
+		counters->start();
+		alloc_accounting::scope_t allocations;
+		{
+			trace_events::span_t span{ trace, "execute" };
+			script::engines::execute(
+					own_prepared ? *own_prepared : *workload._prepared, ctx );
+		}
+		results_receiver._execute_allocations = allocations.finish();
+		results_receiver._counters = counters->stop();
+		const auto finished_at = std::chrono::steady_clock::now();
+		cpu_trace.observe();
+		results_receiver._memo =
+				script::engines::memo::thread_stats() - memo_before;
+		results_receiver._os_usage = os_accounting::snapshot() - usage_before;
+		results_receiver._cpu_trace = cpu_trace;
+
+		results_receiver._time = finished_at - started_at;
+		results_receiver._interval = { started_at, finished_at };
+		results_receiver._completed = true;
+		results_receiver._thread_allocations = alloc_accounting::current();
+
+		const auto mismatch = script_library::check_final_values(
+				workload._name, workload._expected, ctx );
+		results_receiver._final_values_ok = !mismatch;
+		if( mismatch )
+			std::osyncstream{ std::cerr }
+					<< "exec_demo_script_thread_body: wrong final values: "
+					<< *mismatch << std::endl;
+	}
+	catch( const std::exception & x)
+	{
+		std::osyncstream{ std::cerr }
+				<< "exec_demo_script_thread_body: exception caught: "
+				<< x.what() << std::endl;
+	}
+}
+
+/// Печать сведений об аллокациях одной рабочей нити.
+///
+/// Аллокации внутри тела while_loop_t отмечаются отдельно: они
+/// повторяются на каждой итерации и при большом количестве нитей
+/// приводят к конкуренции за аллокатор.
+void
+report_allocations(
+	std::ostream & to,
+	std::size_t thread_index,
+	const thread_results_t & results)
+{
+	const auto print = [&]( const alloc_accounting::counters_t & c ) {
+		to << c._allocations << " alloc(s), " << c._deallocations
+				<< " free(s), " << c._bytes_allocated << " bytes, peak live: "
+				<< c._peak_live_bytes << " bytes";
+	};
+
+	to << "  #" << (thread_index + 1) << ": per execute: ";
+	print( results._execute_allocations );
+	to << "; whole thread: ";
+	print( results._thread_allocations );
+	to << std::endl;
+
+	if( const auto & e = results._execute_allocations; e._loop_body_allocations )
+		to << "  #" << (thread_index + 1) << ": WARNING: "
+				<< e._loop_body_allocations << " allocation(s) ("
+				<< e._loop_body_bytes << " bytes) inside while_loop_t body"
+				<< std::endl;
+}
+
+/// Печать сводки по кэшу результатов чистых циклов.
+void
+report_memo(
+	std::ostream & to,
+	const script::engines::memo::stats_t & memo )
+{
+	to << "  memo cache: ";
+	if( !memo._hits && !memo._misses && !memo._bypassed )
+	{
+		to << "no pure loops were executed" << std::endl;
+		return;
+	}
+
+	to << memo._hits << " hit(s), " << memo._misses << " miss(es), hit rate "
+			<< std::fixed << std::setprecision( 1 ) << memo.hit_rate() * 100.0
+			<< "%, " << memo._evictions << " eviction(s), ~"
+			<< std::setprecision( 6 ) << memo._saved_seconds << "s saved"
+			<< std::defaultfloat;
+	if( memo._bypassed )
+		to << ", " << memo._bypassed << " loop(s) run without the cache "
+				"because of shared variables";
+	to << std::endl;
+}
+
+/// Сбор и печать доступной информации о системе.
+void
+collect_and_report_some_system_info( const std::string & sysfs_root )
+{
+	std::osyncstream cout{ std::cout };
+
+	cout << "some system related information:\n" << std::flush;
+
+	cout << "  sysconf(_SC_NPROCESSORS_CONF): "
+			<< sysconf( _SC_NPROCESSORS_CONF ) << std::endl;
+	cout << "  sysconf(_SC_NPROCESSORS_ONLN): "
+			<< sysconf( _SC_NPROCESSORS_ONLN ) << std::endl;
+
+	cout << "  ---\n";
+
+	cout << "  std::thread::hardware_concurrency: "
+			<< std::thread::hardware_concurrency() << std::endl;
+
+	cout << "  ---\n";
+
+	// Что реально доступно процессу с учетом cgroup и изоляции ядер?
+	const auto budget = cpu_budget::detect( sysfs_root );
+	cpu_budget::report( cout, budget );
+	core_classes::report( cout,
+			core_classes::detect( sysfs_root, budget._usable ) );
+
+	cout << "  ---\n";
+
+	if( const auto paranoid = perf_counters::read_perf_event_paranoid();
+			paranoid.has_value() )
+		cout << "  perf_event_paranoid: " << *paranoid << std::endl;
+	else
+		cout << "  perf_event_paranoid: unknown" << std::endl;
+}
+
+[[nodiscard]]
+std::size_t
+detect_threads_count( const run_params::run_params_t & params )
+{
+	std::size_t count = params._threads_count.value_or( std::size_t{ 0 } );
+
+	if( const auto * selected_cores =
+			std::get_if< run_params::selective_pinning_t >(
+					std::addressof(params._pinning) ) )
+	{
+		// Количество нитей не может превышать количество ядер,
+		// которые были явно указаны для привязки.
+		// Но если thread_count не был указан вообще, то нужно брать
+		// количество перечисленных пользователем ядер.
+		if( params._threads_count.has_value() )
+			count = std::min( count, selected_cores->_cores.size() );
+		else
+			count = selected_cores->_cores.size();
+	}
+
+	// Если количество не задано, то берем столько нитей, сколько
+	// процессорного времени реально доступно процессу.
+	if( !params._threads_count.has_value() && !count )
+		count = cpu_budget::detect( params._sysfs_root )._capacity;
+
+	if( !count )
+		throw std::runtime_error{ "thread_count can't be 0" };
+
+	return count;
+}
+
+/// Вспомогательный класс для вычисления номера следующего
+/// ядра для привязки рабочей нити.
+class core_index_selector_t
+{
+	/// Интерфейс объекта, который будет вычислять номер ядра.
+	class abstract_selector_t
+	{
+	public:
+		virtual ~abstract_selector_t() = default;
+
+		[[nodiscard]] virtual
+		std::optional< run_params::core_index_t >
+		current_index() const = 0;
+
+		virtual void
+		advance() = 0;
+	};
+
+	/// Реализация для случая, когда привязка вообще не нужна.
+	class no_pinning_selector_t final : public abstract_selector_t
+	{
+	public:
+		std::optional< run_params::core_index_t >
+		current_index() const override
+		{
+			return std::nullopt;
+		}
+
+		void
+		advance() override
+		{ /* Ничего не нужно делать. */ }
+	};
+
+	/// Реализация для случая, когда нужно просто последовательно
+	/// привязывать к следующему ядру.
+	///
+	/// Перебираются только ядра, доступные процессу (с учетом cgroup),
+	/// начиная с _start_from. Изолированные ядра идут первыми, а если
+	/// нужны самые производительные ядра, то сперва идут они.
+	class seq_selector_t final : public abstract_selector_t
+	{
+		std::vector< run_params::core_index_t > _cores;
+		std::size_t _index_in_cores{};
+
+	public:
+		seq_selector_t(
+			const run_params::seq_pinning_t & params,
+			const cpu_budget::budget_t & budget,
+			const core_classes::topology_t & topology )
+		{
+			for( const auto cpu : budget._usable )
+				if( cpu >= params._start_from )
+					_cores.push_back( cpu );
+			if( params._fastest_first )
+				_cores = core_classes::fastest_first( topology, std::move(_cores) );
+		}
+
+		std::optional< run_params::core_index_t >
+		current_index() const override
+		{
+			if( _index_in_cores >= _cores.size() )
+				throw std::runtime_error{
+						"not enough usable logical processors for sequential "
+						"pinning, usable: " + std::to_string( _cores.size() ) };
+			return { _cores[ _index_in_cores ] };
+		}
+
+		void
+		advance() override
+		{
+			++_index_in_cores;
+		}
+	};
+
+	/// Реализация для случая, когда нужно использовать указанные ядра.
+	class selected_selector_t final : public abstract_selector_t
+	{
+		const std::vector< run_params::core_index_t > _cores;
+		std::size_t _index_in_cores{};
+
+	public:
+		selected_selector_t( const run_params::selective_pinning_t & params )
+			: _cores{ params._cores }
+		{}
+
+		std::optional< run_params::core_index_t >
+		current_index() const override
+		{
+			return { _cores.at( _index_in_cores ) };
+		}
+
+		void
+		advance() override
+		{
+			++_index_in_cores;
+		}
+	};
+
+	/// Актуальный селектор для вычисления номеров ядер для привязки.
+	std::unique_ptr< abstract_selector_t > _selector;
+
+	/// Вспомогательный визитор для создания актуального селектора.
+	///
+	/// Предназначен для использования совместно с std::visit.
+	struct selector_maker_t
+	{
+		const std::string & _sysfs_root;
+
+		[[nodiscard]] std::unique_ptr< abstract_selector_t >
+		operator()( const run_params::no_pinning_t & ) const
+		{
+			std::osyncstream{ std::cout }
+					<< "no pinning will be used" << std::endl;
+			return std::make_unique< no_pinning_selector_t >();
+		}
+
+		[[nodiscard]] std::unique_ptr< abstract_selector_t >
+		operator()( const run_params::seq_pinning_t & params ) const
+		{
+			const auto budget = cpu_budget::detect( _sysfs_root );
+			const auto topology = core_classes::detect(
+					_sysfs_root, budget._usable );
+			std::osyncstream{ std::cout }
+					<< "simple sequential pinning will be used "
+					"(starting from: " << params._start_from
+					<< (params._fastest_first ? ", fastest cores first" : "")
+					<< ", usable: " << cpu_budget::format_cpu_list( budget._usable )
+					<< ")" << std::endl;
+			return std::make_unique< seq_selector_t >(
+					params, budget, topology );
+		}
+
+		[[nodiscard]] std::unique_ptr< abstract_selector_t >
+		operator()( const run_params::selective_pinning_t & params ) const
+		{
+			std::osyncstream{ std::cout }
+					<< "pinning to selected cores will be used" << std::endl;
+			return std::make_unique< selected_selector_t >( params );
+		}
+	};
+public:
+	core_index_selector_t(
+		const run_params::pinning_params_t & params,
+		const std::string & sysfs_root )
+		: _selector{ std::visit( selector_maker_t{ sysfs_root }, params ) }
+	{
+	}
+
+	[[nodiscard]]
+	std::optional< run_params::core_index_t >
+	current_index() const
+	{
+		return _selector->current_index();
+	}
+
+	void
+	advance()
+	{
+		_selector->advance();
+	}
+};
+
+/// Печать значений счетчиков производительности для одной нити.
+///
+/// Все значения, кроме IPC и количества переключений контекста,
+/// приводятся к одной итерации цикла скрипта.
+void
+report_perf_counters(
+	std::ostream & to,
+	std::size_t thread_index,
+	const thread_results_t & results,
+	long long loop_iterations)
+{
+	using perf_counters::counter_kind_t;
+
+	const auto & counters = results._counters;
+	const double iterations = static_cast<double>( loop_iterations );
+	const double ns = static_cast<double>(
+			std::chrono::duration_cast< std::chrono::nanoseconds >(
+					results._time ).count() );
+
+	to << "  #" << (thread_index + 1) << ": ns/iter: "
+			<< std::setprecision(4) << (ns / iterations);
+
+	if( !counters.available() )
+	{
+		to << ", counters: n/a (" << counters._failure_reason << ")"
+				<< std::endl;
+		return;
+	}
+
+	const auto report_per_iter = [&]( const char * name, counter_kind_t kind ) {
+		to << ", " << name << "/iter: ";
+		if( const auto v = counters.get( kind ); v.has_value() )
+			to << (static_cast<double>( *v ) / iterations);
+		else
+			to << "n/a";
+	};
+
+	const auto cycles = counters.get( counter_kind_t::cycles );
+	const auto instructions = counters.get( counter_kind_t::instructions );
+	to << ", IPC: ";
+	if( cycles.has_value() && instructions.has_value() && *cycles )
+		to << (static_cast<double>( *instructions ) /
+				static_cast<double>( *cycles ));
+	else
+		to << "n/a";
+
+	report_per_iter( "cycles", counter_kind_t::cycles );
+	report_per_iter( "branch-misses", counter_kind_t::branch_misses );
+	report_per_iter( "L1D-misses", counter_kind_t::l1d_read_misses );
+	report_per_iter( "LLC-misses", counter_kind_t::llc_read_misses );
+
+	to << ", ctx-switches: ";
+	if( const auto v = counters.get( counter_kind_t::context_switches );
+			v.has_value() )
+		to << *v;
+	else
+		to << "n/a";
+
+	to << std::endl;
+}
+
+/// Вычислить ядра, к которым нужно привязывать рабочие нити.
+///
+/// Для каждой нити возвращается либо номер ядра, либо пустое значение,
+/// если привязка не нужна.
+[[nodiscard]]
+std::vector< std::optional< run_params::core_index_t > >
+detect_worker_cores(
+	std::size_t threads_count,
+	const run_params::pinning_params_t & pinning,
+	const std::string & sysfs_root = "/sys" )
+{
+	std::vector< std::optional< run_params::core_index_t > > cores;
+	cores.reserve( threads_count );
+
+	// Вспомогательный объект для вычисления ядер, к которым может
+	// потребоваться привязка рабочих нитей.
+	core_index_selector_t cores_selector{ pinning, sysfs_root };
+
+	// Класс ядра печатается только на гибридных процессорах.
+	const auto topology = core_classes::detect(
+			sysfs_root, cpu_budget::detect( sysfs_root )._usable );
+
+	for( std::size_t i = 0; i != threads_count;
+			++i,
+			cores_selector.advance() )
+	{
+		// NOTE: если индекс очередного ядра не будет найден,
+		// то вылетит исключение.
+		const auto core_index = cores_selector.current_index();
+		if( core_index.has_value() )
+		{
+			std::osyncstream cout{ std::cout };
+			cout << "worker #" << (i+1)
+					<< " will be started on logical processor "
+					<< *core_index;
+			if( const auto * c = topology.class_of( *core_index );
+					c && topology.hybrid() )
+				cout << " (" << c->_name << ")";
+			cout << std::endl;
+		}
+
+		cores.push_back( core_index );
+	}
+
+	return cores;
+}
+
+/// Подготовить параметры для опроса частоты процессоров и термозон.
+///
+/// Если все рабочие нити привязаны к ядрам, то опрашиваются только
+/// их ядра, а нить опроса привязывается к любому другому доступному
+/// ядру. Иначе опрашиваются все доступные процессу ядра, а нить
+/// опроса не привязывается.
+[[nodiscard]]
+sysfs_sampler::config_t
+make_sampler_config(
+	const run_params::run_params_t & params,
+	const std::vector< std::optional< run_params::core_index_t > > & cores )
+{
+	sysfs_sampler::config_t config;
+	config._sysfs_root = params._sysfs_root;
+	config._period = std::chrono::milliseconds{ *params._sampling_period_ms };
+
+	bool all_pinned = true;
+	for( const auto & c : cores )
+	{
+		if( c )
+		{
+			if( config._cpus.end() == std::find(
+					config._cpus.begin(), config._cpus.end(), *c ) )
+				config._cpus.push_back( *c );
+		}
+		else
+			all_pinned = false;
+	}
+
+	// Непривязанные рабочие нити могут работать на любом ядре, поэтому
+	// отдельного ядра для нити опроса нет и она тоже не привязывается.
+	if( all_pinned )
+		config._sampler_cpu = sysfs_sampler::select_sampler_cpu( config._cpus );
+	else
+		config._cpus = sysfs_sampler::allowed_cpus();
+
+	return config;
+}
+
+/// Один прогон скрипта на всех рабочих нитях.
+template< typename T >
+[[nodiscard]]
+run_results_t
+run_worker_threads(
+	const run_params::run_params_t & params,
+	const std::vector< std::optional< run_params::core_index_t > > & cores,
+	const workload_t<T> & workload,
+	thread_arena::arena_kind_t memory,
+	trace_events::recorder_t * tracer )
+{
+	const auto threads_count = cores.size();
+	trace_events::lane_t * control_lane = nullptr;
+	if( tracer )
+	{
+		tracer->ensure_lanes( threads_count + 1u );
+		control_lane = &tracer->control_lane();
+	}
+
+	// Очень важно, чтобы данный объект закончил свою жизнь уже
+	// после того, как все рабочие нити будут уничтожены.
+	start_barrier::start_sync_t start_latch{ threads_count };
+
+	// Приемник итоговых результатов каждой из рабочих нитей.
+	run_results_t results;
+	results._threads.resize( threads_count );
+
+	// Счетчики продвижения должны пережить нити и опрос.
+	std::unique_ptr< progress::counter_t[] > progress_counters;
+	if( params._progress_period_ms )
+		progress_counters = std::make_unique< progress::counter_t[] >(
+				threads_count );
+
+	// Создаем и запускаем рабочие нити.
+	std::vector< std::jthread > threads;
+	threads.reserve(threads_count);
+
+	// Очень важно, чтобы этот объект закончил свою жизнь
+	// до того, как threads будет разрушен. Это нужно для того,
+	// чтобы при преждевременном выходе из функции start_sync_t
+	// дал сигнал на завершение рабочих нитей.
+	start_barrier::start_sync_t::wakeup_controller_t wakeup_controller{
+			start_latch };
+
+	// Непосредственный запуск рабочих нитей.
+	for( std::size_t i = 0; i != threads_count; ++i )
+	{
+		trace_events::span_t span{ control_lane, "create thread" };
+		threads.push_back(
+			std::jthread{
+				exec_demo_script_thread_body<T>,
+				i,
+				cores[i],
+				std::ref(start_latch),
+				std::cref(workload),
+				memory,
+				tracer ? &tracer->worker_lane( i ) : nullptr,
+				progress_counters ? &progress_counters[ i ] : nullptr,
+				std::ref(results._threads[i])
+			}
+		);
+	}
+
+	// Опрос частоты и температуры запускается непосредственно перед
+	// стартом, чтобы не мешать запуску рабочих нитей.
+	std::optional< sysfs_sampler::sampler_t > sampler;
+	if( params._sampling_period_ms )
+		sampler.emplace( make_sampler_config( params, cores ) );
+	std::optional< progress_sampler::sampler_t > progress_sampler;
+	if( progress_counters )
+		progress_sampler.emplace(
+				progress_sampler::config_t{
+					std::chrono::milliseconds{ *params._progress_period_ms },
+					params._slow_fraction
+				},
+				progress_counters.get(),
+				threads_count );
+
+	// Рабочие нити запущены, как только все они прибудут к барьеру,
+	// можно дать им сигнал на начало работы.
+	{
+		trace_events::span_t span{ control_lane, "wait and release" };
+		results._released_at = wakeup_controller.wakeup_threads();
+	}
+
+	// Ждем пока все завершиться.
+	for( auto & thr : threads )
+	{
+		trace_events::span_t span{ control_lane, "join" };
+		thr.join();
+	}
+
+	if( sampler )
+		results._sysfs_samples = sampler->finish();
+	if( progress_sampler )
+		results._progress_samples = progress_sampler->finish();
+
+	return results;
+}
+
+/// Результаты рабочего процесса в виде, пригодном для передачи
+/// через process_workers::result_ring_t.
+///
+/// Моменты времени передаются как отсчеты steady_clock: он основан
+/// на CLOCK_MONOTONIC, который един для всех процессов системы.
+struct process_message_t
+{
+	std::uint32_t _worker_index{};
+
+	std::int64_t _started_at{};
+	std::int64_t _finished_at{};
+
+	/// Значения счетчиков и признаки их доступности (по битам).
+	std::array< std::uint64_t, perf_counters::counters_count > _counter_values{};
+	std::uint32_t _available_counters{};
+
+	/// Почему счетчики не удалось задействовать (с усечением).
+	std::array< char, 128 > _counters_failure_reason{};
+
+	alloc_accounting::counters_t _execute_allocations;
+	alloc_accounting::counters_t _thread_allocations;
+
+	os_accounting::usage_t _os_usage;
+	progress::cpu_trace_t _cpu_trace;
+
+	bool _final_values_ok{};
+
+	script::engines::memo::stats_t _memo;
+};
+
+/// Упаковать результаты рабочего процесса в сообщение.
+[[nodiscard]]
+process_message_t
+to_process_message(
+	std::size_t worker_index,
+	const thread_results_t & results )
+{
+	process_message_t msg;
+	msg._worker_index = static_cast< std::uint32_t >( worker_index );
+	msg._started_at =
+			results._interval._started_at.time_since_epoch().count();
+	msg._finished_at =
+			results._interval._finished_at.time_since_epoch().count();
+
+	for( std::size_t i = 0; i != perf_counters::counters_count; ++i )
+		if( const auto & v = results._counters._values[ i ] )
+		{
+			msg._counter_values[ i ] = *v;
+			msg._available_counters |= (1u << i);
+		}
+
+	const auto & reason = results._counters._failure_reason;
+	std::memcpy( msg._counters_failure_reason.data(), reason.data(),
+			std::min( reason.size(), msg._counters_failure_reason.size() - 1u ) );
+
+	msg._execute_allocations = results._execute_allocations;
+	msg._thread_allocations = results._thread_allocations;
+
+	msg._os_usage = results._os_usage;
+	msg._cpu_trace = results._cpu_trace;
+
+	msg._final_values_ok = results._final_values_ok;
+	msg._memo = results._memo;
+
+	return msg;
+}
+
+/// Распаковать результаты рабочего процесса из сообщения.
+[[nodiscard]]
+thread_results_t
+from_process_message( const process_message_t & msg )
+{
+	using clock_t = std::chrono::steady_clock;
+
+	thread_results_t results;
+	results._interval = {
+			clock_t::time_point{ clock_t::duration{ msg._started_at } },
+			clock_t::time_point{ clock_t::duration{ msg._finished_at } } };
+	results._time = results._interval._finished_at
+			- results._interval._started_at;
+	results._completed = true;
+	results._final_values_ok = msg._final_values_ok;
+	results._memo = msg._memo;
+
+	for( std::size_t i = 0; i != perf_counters::counters_count; ++i )
+		if( msg._available_counters & (1u << i) )
+			results._counters._values[ i ] = msg._counter_values[ i ];
+	results._counters._failure_reason = msg._counters_failure_reason.data();
+
+	results._execute_allocations = msg._execute_allocations;
+	results._thread_allocations = msg._thread_allocations;
+
+	results._os_usage = msg._os_usage;
+	results._cpu_trace = msg._cpu_trace;
+
+	return results;
+}
+
+/// Рабочие процессы одного прогона.
+///
+/// Если прогон прерывается исключением, то деструктор дает процессам
+/// сигнал на завершение и дожидается их, чтобы не оставлять зомби.
+class worker_processes_t
+{
+	process_workers::start_sync_t & _start_latch;
+	std::vector< pid_t > _pids;
+	bool _released{ false };
+
+public:
+	explicit worker_processes_t( process_workers::start_sync_t & start_latch )
+		: _start_latch{ start_latch }
+	{}
+
+	~worker_processes_t()
+	{
+		if( !_released )
+			_start_latch.release( start_barrier::wakeup_type_t::should_shutdown );
+		(void)wait_all();
+	}
+
+	worker_processes_t( const worker_processes_t & ) = delete;
+	worker_processes_t & operator=( const worker_processes_t & ) = delete;
+
+	void
+	add( pid_t pid ) { _pids.push_back( pid ); }
+
+	/// Проверить, не завершился ли какой-нибудь процесс раньше времени.
+	[[nodiscard]] bool
+	any_exited()
+	{
+		for( auto & pid : _pids )
+			if( pid > 0 && ::waitpid( pid, nullptr, WNOHANG ) == pid )
+			{
+				pid = -1;
+				return true;
+			}
+		return false;
+	}
+
+	/// Дать сигнал на старт.
+	[[nodiscard]] std::chrono::steady_clock::time_point
+	release()
+	{
+		_released = true;
+		const auto released_at = std::chrono::steady_clock::now();
+		_start_latch.release( start_barrier::wakeup_type_t::normal );
+		return released_at;
+	}
+
+	/// Дождаться завершения всех процессов.
+	///
+	/// Возвращает количество процессов, завершившихся аварийно.
+	std::size_t
+	wait_all()
+	{
+		std::size_t failed{};
+		for( auto & pid : _pids )
+		{
+			if( pid <= 0 )
+				continue;
+
+			int status{};
+			while( ::waitpid( pid, &status, 0 ) < 0 && EINTR == errno )
+				;
+			if( !WIFEXITED( status ) || 0 != WEXITSTATUS( status ) )
+				++failed;
+			pid = -1;
+		}
+		return failed;
+	}
+};
+
+/// Один прогон скрипта на рабочих процессах.
+///
+/// Каждый рабочий создается через fork, привязывается к своему ядру
+/// и ждет старта на барьере в разделяемой памяти. Результаты
+/// возвращаются через кольцевой буфер в той же разделяемой памяти.
+/// Процессы, от которых не пришло результатов, считаются не
+/// завершившими работу.
+template< typename T >
+[[nodiscard]]
+run_results_t
+run_worker_processes(
+	const run_params::run_params_t & params,
+	const std::vector< std::optional< run_params::core_index_t > > & cores,
+	const workload_t<T> & workload,
+	thread_arena::arena_kind_t memory )
+{
+	using ring_t = process_workers::result_ring_t< process_message_t >;
+
+	const auto processes_count = cores.size();
+	const auto capacity = std::bit_ceil( processes_count );
+
+	constexpr std::size_t ring_offset =
+			(sizeof(process_workers::start_sync_t) + 63u) / 64u * 64u;
+	process_workers::shared_memory_t shared_memory{
+			ring_offset + ring_t::bytes_for( capacity ) };
+
+	auto * start_latch = new( shared_memory.address() )
+			process_workers::start_sync_t{
+					static_cast< std::uint32_t >( processes_count ) };
+	auto * ring = ring_t::create(
+			static_cast< char * >( shared_memory.address() ) + ring_offset,
+			capacity );
+
+	run_results_t results;
+	results._threads.resize( processes_count );
+
+	// Иначе содержимое буферов будет напечатано каждым из процессов.
+	std::cout.flush();
+	std::cerr.flush();
+
+	worker_processes_t workers{ *start_latch };
+	for( std::size_t i = 0; i != processes_count; ++i )
+	{
+		const pid_t pid = ::fork();
+		if( pid < 0 )
+			throw std::runtime_error{
+					std::string{ "fork failed: " } + std::strerror( errno ) };
+
+		if( 0 == pid )
+		{
+			// Рабочий процесс. Он не должен возвращаться в код
+			// родителя, поэтому завершается через _exit.
+			int exit_code = 0;
+			try
+			{
+				thread_results_t r;
+				exec_demo_script_thread_body< T, process_workers::start_sync_t >(
+						i, cores[ i ], *start_latch, workload, memory,
+						nullptr, nullptr, r );
+				if( r._completed && !ring->try_push( to_process_message( i, r ) ) )
+				{
+					std::osyncstream{ std::cerr }
+							<< "worker process #" << (i + 1)
+							<< ": result ring is full" << std::endl;
+					exit_code = 1;
+				}
+			}
+			catch( ... )
+			{
+				exit_code = 1;
+			}
+			std::cout.flush();
+			std::cerr.flush();
+			::_exit( exit_code );
+		}
+
+		workers.add( pid );
+	}
+
+	// Если какой-то процесс завершится, не прибыв к барьеру, то
+	// остальные никогда не получат сигнал на старт.
+	while( !start_latch->wait_for_all_arrived( std::chrono::milliseconds{ 10 } ) )
+		if( workers.any_exited() )
+			throw std::runtime_error{
+					"worker process exited before the start" };
+
+	std::optional< sysfs_sampler::sampler_t > sampler;
+	if( params._sampling_period_ms )
+		sampler.emplace( make_sampler_config( params, cores ) );
+
+	results._released_at = workers.release();
+
+	if( const auto failed = workers.wait_all() )
+		std::osyncstream{ std::cerr }
+				<< failed << " worker process(es) failed" << std::endl;
+
+	if( sampler )
+		results._sysfs_samples = sampler->finish();
+
+	while( const auto msg = ring->try_pop() )
+		if( msg->_worker_index < processes_count )
+			results._threads[ msg->_worker_index ] = from_process_message( *msg );
+
+	return results;
+}
+
+/// Один прогон скрипта на рабочих указанного вида.
+template< typename T >
+[[nodiscard]]
+run_results_t
+run_workers(
+	const run_params::run_params_t & params,
+	const std::vector< std::optional< run_params::core_index_t > > & cores,
+	const workload_t<T> & workload,
+	run_params::workers_kind_t workers,
+	thread_arena::arena_kind_t memory,
+	/// Куда записывать временную шкалу (только для нитей).
+	trace_events::recorder_t * tracer = nullptr )
+{
+	if( run_params::workers_kind_t::processes == workers )
+		return run_worker_processes<T>( params, cores, workload, memory );
+
+	return run_worker_threads<T>( params, cores, workload, memory, tracer );
+}
+
+/// Печать информации о том, насколько одновременно работали нити.
+void
+report_timeline(
+	std::ostream & to,
+	const run_results_t & results )
+{
+	std::vector< run_timeline::interval_t > intervals;
+	for( const auto & r : results._threads )
+		if( r._completed )
+			intervals.push_back( r._interval );
+
+	to << "timeline: ";
+	run_timeline::print_summary( to,
+			run_timeline::summarize( intervals, results._released_at ) );
+}
+
+/// Печать данных о частоте процессоров и температуре.
+///
+/// Для привязанных нитей частота показывается за время работы нити
+/// на ее ядре. Для непривязанных нитей неизвестно, на каком ядре они
+/// работали, поэтому показываются все ядра за время всего прогона.
+void
+report_sysfs_samples(
+	std::ostream & to,
+	const std::vector< std::optional< run_params::core_index_t > > & cores,
+	const run_results_t & results )
+{
+	if( !results._sysfs_samples )
+		return;
+
+	const auto & data = *results._sysfs_samples;
+	to << "cpu frequency and thermal samples: " << data._samples.size()
+			<< " (period " << data._config._period.count() << "ms, sampler ";
+	if( data._config._sampler_cpu )
+		to << "on cpu " << *data._config._sampler_cpu;
+	else
+		to << "isn't pinned";
+	to << ")" << std::endl;
+
+	std::optional< run_timeline::interval_t > whole_run;
+	for( std::size_t i = 0; i != results._threads.size(); ++i )
+	{
+		const auto & r = results._threads[ i ];
+		if( !r._completed )
+			continue;
+
+		if( cores[ i ] )
+			sysfs_sampler::report_for_cpu( to, data,
+					"#" + std::to_string( i + 1 ), *cores[ i ], r._interval );
+		else if( !whole_run )
+			whole_run = r._interval;
+		else
+		{
+			whole_run->_started_at = std::min(
+					whole_run->_started_at, r._interval._started_at );
+			whole_run->_finished_at = std::max(
+					whole_run->_finished_at, r._interval._finished_at );
+		}
+	}
+
+	if( whole_run )
+		for( const auto cpu : data._config._cpus )
+			sysfs_sampler::report_for_cpu( to, data, "(unpinned)", cpu, *whole_run );
+
+	sysfs_sampler::report_thermal( to, data );
+}
+
+/// Имя типа значений для отчетов.
+template< typename T >
+[[nodiscard]]
+std::string
+value_type_name()
+{
+	if constexpr( std::is_same_v< T, int > )
+		return "int";
+	else if constexpr( std::is_same_v< T, double > )
+		return "double";
+	else
+		return "unknown";
+}
+
+/// Перевод продолжительности в секунды без потери точности.
+[[nodiscard]]
+double
+to_seconds( std::chrono::steady_clock::duration d )
+{
+	return std::chrono::duration_cast<
+			std::chrono::duration< double > >( d ).count();
+}
+
+/// Добавить значения счетчиков производительности каждой нити,
+/// приведенные к одной итерации цикла, к накопленным значениям.
+///
+/// Переключения контекста не приводятся к итерации и не собираются.
+void
+collect_counters_per_iteration(
+	const run_results_t & results,
+	long long loop_iterations,
+	std::map< std::string, std::vector< double > > & receiver )
+{
+	using perf_counters::counter_kind_t;
+
+	const std::pair< const char *, counter_kind_t > kinds[]{
+		{ "cycles", counter_kind_t::cycles },
+		{ "instructions", counter_kind_t::instructions },
+		{ "branch-misses", counter_kind_t::branch_misses },
+		{ "L1D-misses", counter_kind_t::l1d_read_misses },
+		{ "LLC-misses", counter_kind_t::llc_read_misses }
+	};
+
+	const double iterations = static_cast<double>( loop_iterations );
+	for( const auto & r : results._threads )
+	{
+		if( !r._completed )
+			continue;
+
+		for( const auto & [ name, kind ] : kinds )
+			if( const auto v = r._counters.get( kind ); v.has_value() )
+				receiver[ name ].push_back(
+						static_cast<double>( *v ) / iterations );
+	}
+}
+
+/// Создать скрипт для выполнения в соответствии с параметрами.
+template< typename T >
+[[nodiscard]]
+workload_t<T>
+make_workload( const run_params::run_params_t & params )
+{
+	auto source = params._array
+			? script_library::make_array<T>( array_demo_params_t{
+					params._array->_elements,
+					params._array->_passes,
+					params._array->_huge_pages
+				} )
+			: script_library::make<T>( params._script.value_or( "demo" ) );
+
+	auto engine = script::engines::make<T>( params._engine );
+	auto verified = script::verify(
+			source._build( std::pmr::get_default_resource() ) );
+	auto prepared = engine->prepare( verified );
+
+	// Результаты разных движков не должны смешиваться в эталонах.
+	return {
+			"tree" == params._engine
+				? source._name : source._name + "@" + params._engine,
+			std::move(verified),
+			std::move(source._build),
+			source._loop_iterations,
+			source._bytes_processed,
+			std::move(source._expected),
+			std::move(engine),
+			std::move(prepared)
+		};
+}
+
+/// Скрипты, на которых сравниваются движки, если скрипт не указан.
+[[nodiscard]] inline const std::vector< std::string > &
+default_differential_scripts()
+{
+	static const std::vector< std::string > scripts{
+			"nested", "vars:1", "vars:16", "vars:256", "vars:4096",
+			"straight", "print", "array:100000"
+		};
+	return scripts;
+}
+
+/// Сравнение результатов и скорости всех движков.
+///
+/// Каждый скрипт выполняется на всех движках в одной нити без
+/// привязки. Итоговые контексты и напечатанный текст сравниваются с
+/// результатами обхода дерева в точности, скорость приводится
+/// относительно него же.
+template< typename T >
+[[nodiscard]]
+int
+do_differential_work( const run_params::run_params_t & params )
+{
+	std::vector< std::string > scripts;
+	if( params._script || params._array )
+		scripts.push_back( {} );
+	else
+		scripts = default_differential_scripts();
+
+	std::osyncstream{ std::cout } << "differential check of engines, "
+			<< params._repetitions << " run(s) per engine" << std::endl;
+
+	struct row_t
+	{
+		std::string _script;
+		std::vector< script::engines::differential_result_t > _results;
+	};
+	std::vector< row_t > rows;
+	for( const auto & name : scripts )
+	{
+		auto script_params = params;
+		script_params._engine = "tree";
+		if( !name.empty() )
+			script_params._script = name;
+		const auto workload = make_workload<T>( script_params );
+
+		std::osyncstream{ std::cout } << "=== " << workload._name << std::endl;
+		rows.push_back( { workload._name, script::engines::run_differential(
+				workload._script, params._repetitions ) } );
+	}
+
+	bool mismatch = false;
+	std::osyncstream cout{ std::cout };
+	cout << "\ndifferential results (reference: tree):\n" << std::left
+			<< std::setw( 20 ) << "script" << std::setw( 10 ) << "engine"
+			<< std::right << std::setw( 12 ) << "median, s"
+			<< std::setw( 12 ) << "prepare, s" << std::setw( 10 ) << "speedup"
+			<< "  result" << std::endl;
+	for( const auto & row : rows )
+	{
+		const double reference = row._results.front()._median_seconds;
+		for( const auto & r : row._results )
+		{
+			cout << std::left << std::setw( 20 ) << row._script
+					<< std::setw( 10 ) << r._engine << std::right
+					<< std::fixed << std::setprecision( 6 )
+					<< std::setw( 12 ) << r._median_seconds
+					<< std::setw( 12 ) << r._prepare_seconds
+					<< std::setprecision( 2 ) << std::setw( 9 )
+					<< (r._median_seconds > 0.0
+							? reference / r._median_seconds : 0.0)
+					<< "x" << std::defaultfloat;
+			if( r._mismatch )
+			{
+				cout << "  DIFFERENT: " << *r._mismatch;
+				mismatch = true;
+			}
+			else
+				cout << "  same";
+			cout << std::endl;
+		}
+	}
+
+	return mismatch ? 1 : 0;
+}
+
+/// Приостановка выполнения скрипта и его продолжение со снимка.
+///
+/// Скрипт компилируется в байткод, выполняется в отдельной нити и
+/// через заданное время приостанавливается на ближайшем переходе в
+/// начало цикла. Снимок либо записывается в файл (чтобы продолжить
+/// выполнение в другом процессе через resume:<file>), либо сразу
+/// используется для продолжения в другой нити. После завершения
+/// проверяются значения переменных.
+template< typename T >
+[[nodiscard]]
+int
+do_checkpoint_work( const run_params::run_params_t & params )
+{
+	using clock_t = std::chrono::steady_clock;
+	const auto us = []( clock_t::duration d ) {
+		return std::chrono::duration< double, std::micro >( d ).count();
+	};
+
+	const auto & checkpoint = *params._checkpoint;
+
+	auto script_params = params;
+	script_params._engine = "bytecode";
+	const auto workload = make_workload<T>( script_params );
+	const auto & prepared = dynamic_cast<
+			const script::engines::bytecode::prepared_t<T> & >(
+					*workload._prepared );
+	std::osyncstream{ std::cout } << "script: " << workload._name << std::endl;
+
+	std::string snapshot;
+	if( checkpoint._resume_file )
+	{
+		std::ifstream file{ *checkpoint._resume_file, std::ios::binary };
+		if( !file )
+			throw std::runtime_error{
+					"unable to open snapshot: " + *checkpoint._resume_file };
+		std::ostringstream content;
+		content << file.rdbuf();
+		snapshot = content.str();
+
+		std::osyncstream{ std::cout } << "snapshot loaded from "
+				<< *checkpoint._resume_file << ": " << snapshot.size()
+				<< " bytes" << std::endl;
+	}
+	else
+	{
+		std::atomic< bool > pause_requested{ false };
+		script::exec_context_t<T> ctx;
+		std::optional< script::checkpoint::position_t > position;
+		bool failed = false;
+		clock_t::time_point started_at;
+		clock_t::time_point stopped_at;
+		clock_t::time_point requested_at;
+		{
+			std::jthread worker{ [&] {
+				started_at = clock_t::now();
+				try
+				{
+					position = script::checkpoint::run_pausable(
+							prepared, ctx, pause_requested );
+				}
+				catch( const std::exception & x )
+				{
+					std::osyncstream{ std::cerr }
+							<< "do_checkpoint_work: exception caught: "
+							<< x.what() << std::endl;
+					failed = true;
+				}
+				stopped_at = clock_t::now();
+			} };
+
+			std::this_thread::sleep_for(
+					std::chrono::milliseconds{ *checkpoint._pause_after_ms } );
+			requested_at = clock_t::now();
+			pause_requested.store( true, std::memory_order_relaxed );
+		}
+		if( failed )
+			return 1;
+
+		std::osyncstream cout{ std::cout };
+		if( !position )
+		{
+			const auto mismatch = script_library::check_final_values(
+					workload._name, workload._expected, ctx );
+			cout << "the script finished in " << to_seconds(
+					stopped_at - started_at ) << "s before the pause request, "
+					"nothing to checkpoint; final values: "
+					<< (mismatch ? "WRONG, " + *mismatch : std::string{ "ok" })
+					<< std::endl;
+			return mismatch ? 1 : 0;
+		}
+
+		script::checkpoint::snapshot_info_t info;
+		const auto serialize_started_at = clock_t::now();
+		snapshot = script::checkpoint::serialize( *position, ctx, &info );
+		const auto serialized_at = clock_t::now();
+
+		cout << std::fixed << std::setprecision( 3 )
+				<< "paused at instruction " << position->_pc << " (loop head) after "
+				<< to_seconds( stopped_at - started_at ) << "s of execution\n"
+				<< "pause latency: " << us( stopped_at - requested_at )
+				<< "us (request to stop at a back-edge, context written back)\n"
+				<< "snapshot: " << snapshot.size() << " bytes (" << info._vars
+				<< " variable(s), " << info._arrays << " array(s) with "
+				<< info._array_elements << " element(s)), serialized in "
+				<< us( serialized_at - serialize_started_at ) << "us"
+				<< std::defaultfloat << std::endl;
+
+		if( checkpoint._output_file )
+		{
+			std::ofstream file{ *checkpoint._output_file, std::ios::binary };
+			file.write( snapshot.data(),
+					static_cast< std::streamsize >( snapshot.size() ) );
+			if( !file )
+				throw std::runtime_error{
+						"unable to write snapshot: " + *checkpoint._output_file };
+			cout << "snapshot written to " << *checkpoint._output_file
+					<< ", continue with resume:" << *checkpoint._output_file
+					<< std::endl;
+			return 0;
+		}
+	}
+
+	// Продолжение в другой нити (а после resume:<file> -- и в другом
+	// процессе).
+	script::exec_context_t<T> ctx;
+	std::optional< std::string > failure;
+	clock_t::time_point started_at;
+	clock_t::time_point restored_at;
+	clock_t::time_point finished_at;
+	std::jthread{ [&] {
+		try
+		{
+			const std::atomic< bool > never{ false };
+			started_at = clock_t::now();
+			const auto position = script::checkpoint::restore( snapshot, ctx );
+			restored_at = clock_t::now();
+			(void)script::checkpoint::run_pausable(
+					prepared, ctx, never, position );
+			finished_at = clock_t::now();
+		}
+		catch( const std::exception & x )
+		{
+			failure = x.what();
+		}
+	} }.join();
+
+	if( failure )
+		throw std::runtime_error{ "resume failed: " + *failure };
+
+	const auto mismatch = script_library::check_final_values(
+			workload._name, workload._expected, ctx );
+	std::osyncstream{ std::cout } << std::fixed << std::setprecision( 3 )
+			<< "resume latency: " << us( restored_at - started_at )
+			<< "us (snapshot parsed and context restored)\n"
+			<< "resumed in another thread, finished in "
+			<< to_seconds( finished_at - restored_at ) << "s\n"
+			<< "final values: "
+			<< (mismatch ? "WRONG, " + *mismatch : std::string{ "ok" })
+			<< std::defaultfloat << std::endl;
+
+	return mismatch ? 1 : 0;
+}
+
+/// Печать достигнутой пропускной способности памяти по каждой нити.
+///
+/// Используется медианное время работы нити.
+void
+report_memory_throughput(
+	std::ostream & to,
+	const bench_report::report_t & report,
+	double bytes_processed )
+{
+	to << "memory throughput (median per thread, GB/s):";
+	for( std::size_t t = 0; t != report._per_thread.size(); ++t )
+	{
+		const double median = report._per_thread[ t ]._median;
+		to << " #" << (t + 1) << ": ";
+		if( median > 0.0 )
+			to << std::fixed << std::setprecision(3)
+					<< bytes_processed / median / 1e9 << std::defaultfloat;
+		else
+			to << "n/a";
+	}
+	to << std::endl;
+}
+
+/// Серия прогонов (прогрев и замеры) для заданного количества
+/// рабочих, способа привязки, вида рабочих и источника памяти.
+///
+/// Если в каком-то прогоне рабочий не выполнил скрипт до конца или
+/// получил неверные значения переменных, то порождается исключение:
+/// такие замеры не должны попасть ни в статистику, ни в эталоны.
+template< typename T >
+[[nodiscard]]
+bench_report::report_t
+measure_series(
+	const run_params::run_params_t & params,
+	std::size_t threads_count,
+	const run_params::pinning_params_t & pinning,
+	run_params::workers_kind_t workers,
+	thread_arena::arena_kind_t memory,
+	const workload_t<T> & workload,
+	trace_events::recorder_t * tracer = nullptr )
+{
+	const auto cores = detect_worker_cores(
+			threads_count, pinning, params._sysfs_root );
+	trace_events::lane_t * control_lane =
+			tracer ? &tracer->control_lane() : nullptr;
+
+	// Сперва прогоны для прогрева, их результаты не нужны.
+	for( unsigned run = 0; run != params._warmup_runs; ++run )
+	{
+		std::osyncstream{ std::cout }
+				<< "warmup run " << (run + 1) << " of "
+				<< params._warmup_runs << std::endl;
+		trace_events::span_t span{ control_lane, "warmup run" };
+		(void)run_workers<T>(
+				params, cores, workload, workers, memory, tracer );
+	}
+
+	// Время работы нитей в каждом из прогонов.
+	std::vector< std::vector< double > > seconds;
+	seconds.reserve( params._repetitions );
+
+	// Значения счетчиков на одну итерацию по всем нитям всех прогонов.
+	std::map< std::string, std::vector< double > > counters_per_iteration;
+
+	for( unsigned run = 0; run != params._repetitions; ++run )
+	{
+		std::osyncstream{ std::cout }
+				<< "measured run " << (run + 1) << " of "
+				<< params._repetitions << std::endl;
+
+		const auto results = [&] {
+			trace_events::span_t span{ control_lane, "measured run" };
+			return run_workers<T>(
+					params, cores, workload, workers, memory, tracer );
+		}();
+
+		for( std::size_t i = 0; i != results._threads.size(); ++i )
+		{
+			const auto & r = results._threads[ i ];
+			if( !r._completed )
+				throw std::runtime_error{ "measured run "
+						+ std::to_string( run + 1 ) + ": worker #"
+						+ std::to_string( i + 1 )
+						+ " did not complete, results are discarded" };
+			if( !r._final_values_ok )
+				throw std::runtime_error{ "measured run "
+						+ std::to_string( run + 1 ) + ": worker #"
+						+ std::to_string( i + 1 ) + " got wrong final values, "
+						"the script was executed incorrectly, results are discarded" };
+		}
+
+		std::osyncstream cout{ std::cout };
+		auto & run_seconds = seconds.emplace_back();
+		for( const auto & r : results._threads )
+		{
+			run_seconds.push_back( to_seconds( r._time ) );
+			cout << std::fixed << std::setprecision(6) << run_seconds.back();
+			if( workload._bytes_processed && run_seconds.back() > 0.0 )
+				cout << std::setprecision(3) << " (" << *workload._bytes_processed
+						/ run_seconds.back() / 1e9 << " GB/s)";
+			cout << std::defaultfloat << std::endl;
+		}
+		if( "memo" == workload._engine->name() )
+		{
+			script::engines::memo::stats_t memo;
+			for( const auto & r : results._threads )
+				memo += r._memo;
+			report_memo( cout, memo );
+		}
+
+		report_timeline( cout, results );
+		report_sysfs_samples( cout, cores, results );
+		if( results._progress_samples )
+			progress_sampler::report(
+					cout, *results._progress_samples, results._released_at );
+
+		cout << "performance counters:" << std::endl;
+		for( std::size_t i = 0; i != results._threads.size(); ++i )
+			report_perf_counters(
+					cout, i, results._threads[ i ], workload._loop_iterations );
+
+		cout << "os resources:" << std::endl;
+		for( std::size_t i = 0; i != results._threads.size(); ++i )
+			if( const auto & r = results._threads[ i ]; r._completed )
+				os_accounting::report( cout, i, r._time, r._os_usage,
+						r._cpu_trace, cores[ i ] );
+
+		if constexpr( alloc_accounting::enabled() )
+		{
+			cout << "allocations:" << std::endl;
+			for( std::size_t i = 0; i != results._threads.size(); ++i )
+				report_allocations( cout, i, results._threads[ i ] );
+		}
+
+		collect_counters_per_iteration(
+				results, workload._loop_iterations, counters_per_iteration );
+	}
+
+	return bench_report::make_report(
+			bench_report::run_config_t{
+				value_type_name<T>(),
+				workload._name,
+				threads_count,
+				run_params::to_string( pinning ),
+				run_params::to_string( workers ),
+				thread_arena::to_string( memory ),
+				params._warmup_runs,
+				params._repetitions,
+				workload._loop_iterations
+			},
+			std::move(seconds),
+			std::move(counters_per_iteration) );
+}
+
+/// Сохранение результатов как эталона и сравнение с эталоном,
+/// если это было задано.
+///
+/// Возвращает код завершения программы.
+[[nodiscard]]
+int
+handle_baselines(
+	const run_params::run_params_t & params,
+	const bench_report::report_t & report )
+{
+	const auto & bp = params._baseline;
+	int exit_code = 0;
+
+	// Сперва сравнение, чтобы можно было сравнить с эталоном и
+	// сразу же перезаписать его.
+	if( bp._compare_with )
+	{
+		const auto base = baseline::load( bp._directory, *bp._compare_with );
+		const baseline::comparison_params_t comparison_params{
+				bp._threshold_percent, bp._alpha, bp._allow_host_mismatch };
+		const auto comparison = baseline::compare(
+				base, report, comparison_params );
+
+		std::osyncstream cout{ std::cout };
+		baseline::print_comparison( cout, base, comparison_params, comparison );
+		if( comparison.has_regression() )
+			exit_code = baseline::regression_exit_code;
+	}
+
+	if( bp._save_as )
+	{
+		const auto file_name = baseline::save(
+				bp._directory, *bp._save_as, report );
+		std::osyncstream{ std::cout }
+				<< "baseline `" << *bp._save_as << "` saved to "
+				<< file_name << std::endl;
+	}
+
+	return exit_code;
+}
+
+/// Выполнение основной работы.
+///
+/// Возвращает код завершения программы.
+template< typename T >
+[[nodiscard]]
+int
+do_main_work( const run_params::run_params_t & params )
+{
+	collect_and_report_some_system_info( params._sysfs_root );
+
+	// Сколько же нам потребуется нитей?
+	const auto threads_count = detect_threads_count( params );
+	std::osyncstream{ std::cout }
+			<< "thread(s) to be used: " << threads_count << std::endl;
+
+	// Сам скрипт для выполнения.
+	const auto workload = make_workload<T>( params );
+	std::osyncstream{ std::cout }
+			<< "script: " << workload._name << std::endl;
+	if( params._array && params._array->_huge_pages )
+	{
+		// Пробное выделение, чтобы узнать, удается ли получить huge pages.
+		const script::array_storage_t<T> probe{ 1u, T{}, true };
+		std::osyncstream{ std::cout }
+				<< "array memory: " << script::to_string( probe.memory_kind() )
+				<< std::endl;
+	}
+
+	std::optional< trace_events::recorder_t > tracer;
+	if( params._trace_file )
+	{
+		trace_events::config_t config;
+		if( params._trace_loops_us )
+			config._min_loop_ns = std::uint64_t{ *params._trace_loops_us } * 1000u;
+		tracer.emplace( config );
+	}
+
+	const auto report = measure_series<T>(
+			params, threads_count, params._pinning,
+			params._workers.front(), params._memory.front(), workload,
+			tracer ? &*tracer : nullptr );
+
+	if( tracer )
+	{
+		tracer->write_json( *params._trace_file );
+		std::osyncstream cout{ std::cout };
+		cout << "timeline written to " << *params._trace_file;
+		if( const auto dropped = tracer->dropped() )
+			cout << " (" << dropped << " event(s) dropped: buffers are full)";
+		cout << std::endl;
+	}
+
+	{
+		std::osyncstream cout{ std::cout };
+		bench_report::print_report( cout, report );
+		if( workload._bytes_processed )
+			report_memory_throughput( cout, report, *workload._bytes_processed );
+	}
+
+	if( params._json_output_file )
+		bench_report::write_json( *params._json_output_file, report );
+	if( params._csv_output_file )
+		bench_report::write_csv( *params._csv_output_file, report );
+
+	return handle_baselines( params, report );
+}
+
+/// Выполнение замеров для разного количества нитей и разных
+/// способов привязки с оценкой масштабируемости.
+template< typename T >
+void
+do_sweep_work( const run_params::run_params_t & params )
+{
+	collect_and_report_some_system_info( params._sysfs_root );
+
+	const auto & sweep = *params._sweep;
+
+	// Сам скрипт для выполнения.
+	const auto workload = make_workload<T>( params );
+
+	std::vector< scalability::series_t > all_series;
+	for( const auto & pinning : sweep._pinnings )
+		for( const auto workers : params._workers )
+			for( const auto memory : params._memory )
+			{
+				std::vector< unsigned > threads;
+				std::vector< double > seconds;
+
+				for( const auto n : sweep._threads_counts )
+				{
+					// Если задан перечень ядер, то количество нитей им
+					// ограничено.
+					run_params::run_params_t point_params{ params };
+					point_params._threads_count = n;
+					point_params._pinning = pinning;
+					if( detect_threads_count( point_params ) != n )
+					{
+						std::osyncstream{ std::cout }
+								<< "skipping " << n << " thread(s) for pinning `"
+								<< run_params::to_string( pinning )
+								<< "`: not enough cores specified" << std::endl;
+						continue;
+					}
+
+					std::osyncstream{ std::cout }
+							<< "=== sweep point: " << n << " "
+							<< run_params::to_string( workers ) << ", memory "
+							<< thread_arena::to_string( memory ) << ", pinning `"
+							<< run_params::to_string( pinning ) << "` ==="
+							<< std::endl;
+
+					// Неудачная точка пропускается, остальные замеры
+					// продолжаются.
+					std::optional< bench_report::report_t > report;
+					try
+					{
+						report = measure_series<T>(
+								params, n, pinning, workers, memory, workload );
+					}
+					catch( const std::exception & x )
+					{
+						std::osyncstream{ std::cout }
+								<< "skipping " << n << " thread(s) for pinning `"
+								<< run_params::to_string( pinning ) << "`: "
+								<< x.what() << std::endl;
+						continue;
+					}
+
+					threads.push_back( n );
+					seconds.push_back( report->_slowest_thread._median );
+				}
+
+				all_series.push_back( scalability::make_series(
+						run_params::to_string( pinning ),
+						run_params::to_string( workers ),
+						thread_arena::to_string( memory ),
+						threads,
+						seconds,
+						workload._loop_iterations ) );
+			}
+
+	{
+		std::osyncstream cout{ std::cout };
+		for( const auto & series : all_series )
+			scalability::print_series( cout, series );
+		scalability::print_comparison( cout, all_series );
+	}
+
+	if( params._csv_output_file )
+		scalability::write_csv(
+				*params._csv_output_file, value_type_name<T>(), all_series );
+}
+
+/// Все, что нужно рабочим нитям для потоковой обработки записей.
+template< typename T >
+struct stream_job_t
+{
+	const run_params::stream_params_t & _params;
+
+	/// Разметка входного файла.
+	const record_stream::layout_t & _layout;
+
+	/// Скрипт для обработки одной записи.
+	script::verified_script_t<T> _script;
+
+	/// Имена выходных переменных.
+	std::vector< std::string > _outputs;
+
+	/// Раздача фрагментов рабочим нитям.
+	record_stream::chunk_dispenser_t & _dispenser;
+
+	/// Результаты по каждому фрагменту.
+	std::vector< record_stream::chunk_results_t<T> > & _chunk_results;
+};
+
+/// Результаты потоковой обработки одной рабочей нитью.
+struct stream_thread_results_t
+{
+	std::chrono::steady_clock::duration _time{
+			std::chrono::steady_clock::duration::zero()
+		};
+
+	/// Сколько записей обработано.
+	std::size_t _records{};
+
+	/// Сколько байт входных данных обработано.
+	std::size_t _bytes{};
+
+	/// Сколько фрагментов обработано.
+	std::size_t _chunks{};
+
+	bool _completed{ false };
+};
+
+template< typename T >
+void
+stream_records_thread_body(
+	std::size_t worker_index,
+	std::optional<run_params::core_index_t> core_index,
+	start_barrier::start_sync_t & start_latch,
+	const stream_job_t<T> & job,
+	stream_thread_results_t & results_receiver)
+{
+	// Даже если подготовка не удалась, к барьеру нужно прибыть,
+	// иначе остальные нити никогда не стартуют.
+	std::optional< record_stream::record_executor_t<T> > executor;
+	try
+	{
+		if( core_index.has_value() )
+			pin_to_core( *core_index );
+
+		// Контекст со входными и выходными переменными создается
+		// заранее, чтобы это не попадало в замеры.
+		executor.emplace( job._script, job._layout._columns, job._outputs );
+	}
+	catch( const std::exception & x)
+	{
+		std::osyncstream{ std::cerr }
+				<< "stream_records_thread_body: exception caught: "
+				<< x.what() << std::endl;
+	}
+
+	const auto wakeup_type = start_latch.arrive_and_wait( worker_index );
+	if( start_barrier::wakeup_type_t::should_shutdown == wakeup_type
+			|| !executor )
+	{
+		return;
+	}
+
+	try
+	{
+		const auto chunks_count = job._layout._chunks.size();
+		const auto started_at = std::chrono::steady_clock::now();
+		for( auto index = job._dispenser.next();
+				index != chunks_count;
+				index = job._dispenser.next() )
+		{
+			const auto & chunk = job._layout._chunks[ index ];
+			auto & receiver = job._chunk_results[ index ];
+			receiver._records = job._params._binary ?
+					executor->process_binary( chunk, receiver._outputs ) :
+					executor->process_csv( chunk, receiver._outputs );
+
+			results_receiver._records += receiver._records;
+			results_receiver._bytes += static_cast< std::size_t >(
+					chunk._end - chunk._begin );
+			++results_receiver._chunks;
+		}
+		const auto finished_at = std::chrono::steady_clock::now();
+
+		results_receiver._time = finished_at - started_at;
+		results_receiver._completed = true;
+	}
+	catch( const std::exception & x)
+	{
+		std::osyncstream{ std::cerr }
+				<< "stream_records_thread_body: exception caught: "
+				<< x.what() << std::endl;
+	}
+}
+
+/// Один прогон потоковой обработки всего входного файла.
+template< typename T >
+[[nodiscard]]
+std::vector< stream_thread_results_t >
+run_stream_workers(
+	const std::vector< std::optional< run_params::core_index_t > > & cores,
+	const stream_job_t<T> & job )
+{
+	const auto threads_count = cores.size();
+
+	// Очень важно, чтобы данный объект закончил свою жизнь уже
+	// после того, как все рабочие нити будут уничтожены.
+	start_barrier::start_sync_t start_latch{ threads_count };
+
+	std::vector< stream_thread_results_t > results( threads_count );
+
+	std::vector< std::jthread > threads;
+	threads.reserve(threads_count);
+
+	start_barrier::start_sync_t::wakeup_controller_t wakeup_controller{
+			start_latch };
+
+	for( std::size_t i = 0; i != threads_count; ++i )
+	{
+		threads.push_back(
+			std::jthread{
+				stream_records_thread_body<T>,
+				i,
+				cores[i],
+				std::ref(start_latch),
+				std::cref(job),
+				std::ref(results[i])
+			}
+		);
+	}
+
+	(void)wakeup_controller.wakeup_threads();
+
+	for( auto & thr : threads )
+	{
+		thr.join();
+	}
+
+	return results;
+}
+
+/// Сохранение значений выходных переменных в формате CSV в порядке
+/// следования записей во входном файле.
+template< typename T >
+void
+write_stream_outputs(
+	const std::string & file_name,
+	const std::vector< std::string > & outputs,
+	const std::vector< record_stream::chunk_results_t<T> > & chunk_results )
+{
+	std::ofstream file{ file_name, std::ios::out | std::ios::trunc };
+	if( !file )
+		throw std::runtime_error{ "unable to open output file: " + file_name };
+
+	for( std::size_t i = 0; i != outputs.size(); ++i )
+		file << (i ? "," : "") << outputs[ i ];
+	file << '\n';
+
+	file << std::setprecision( 17 );
+	for( const auto & chunk : chunk_results )
+		for( std::size_t i = 0; i != chunk._outputs.size(); ++i )
+			file << chunk._outputs[ i ]
+					<< ((i + 1u) % outputs.size() ? ',' : '\n');
+}
+
+/// Результаты выполнения своей доли пачки заданий одной рабочей нитью.
+struct batch_thread_results_t
+{
+	std::chrono::steady_clock::duration _time{
+			std::chrono::steady_clock::duration::zero()
+		};
+
+	/// Сколько заданий выполнено.
+	std::size_t _jobs{};
+
+	bool _completed{ false };
+
+	/// Обращения к кэшу результатов чистых циклов (только для движка
+	/// memo).
+	script::engines::memo::stats_t _memo;
+};
+
+template< typename T >
+void
+batch_thread_body(
+	std::size_t worker_index,
+	std::optional<run_params::core_index_t> core_index,
+	start_barrier::start_sync_t & start_latch,
+	const workload_t<T> & workload,
+	/// Сколько раз нужно выполнить скрипт.
+	std::size_t jobs,
+	batch_thread_results_t & results_receiver)
+{
+	// Даже если подготовка не удалась, к барьеру нужно прибыть,
+	// иначе остальные нити никогда не стартуют.
+	bool prepared = false;
+	try
+	{
+		if( core_index.has_value() )
+			pin_to_core( *core_index );
+		prepared = true;
+	}
+	catch( const std::exception & x)
+	{
+		std::osyncstream{ std::cerr }
+				<< "batch_thread_body: exception caught: "
+				<< x.what() << std::endl;
+	}
+
+	const auto wakeup_type = start_latch.arrive_and_wait( worker_index );
+	if( start_barrier::wakeup_type_t::should_shutdown == wakeup_type
+			|| !prepared )
+	{
+		return;
+	}
+
+	try
+	{
+		const auto memo_before = script::engines::memo::thread_stats();
+		const auto started_at = std::chrono::steady_clock::now();
+		for( std::size_t j = 0; j != jobs; ++j )
+		{
+			script::exec_context_t<T> ctx;
+			script::engines::execute( *workload._prepared, ctx );
+			++results_receiver._jobs;
+		}
+		const auto finished_at = std::chrono::steady_clock::now();
+		results_receiver._memo =
+				script::engines::memo::thread_stats() - memo_before;
+
+		results_receiver._time = finished_at - started_at;
+		results_receiver._completed = true;
+	}
+	catch( const std::exception & x)
+	{
+		std::osyncstream{ std::cerr }
+				<< "batch_thread_body: exception caught: "
+				<< x.what() << std::endl;
+	}
+}
+
+/// Один прогон пачки заданий: нить i выполняет shares[i] заданий.
+template< typename T >
+[[nodiscard]]
+std::vector< batch_thread_results_t >
+run_batch_workers(
+	const std::vector< std::optional< run_params::core_index_t > > & cores,
+	const workload_t<T> & workload,
+	const std::vector< std::size_t > & shares )
+{
+	const auto threads_count = cores.size();
+
+	// Очень важно, чтобы данный объект закончил свою жизнь уже
+	// после того, как все рабочие нити будут уничтожены.
+	start_barrier::start_sync_t start_latch{ threads_count };
+
+	std::vector< batch_thread_results_t > results( threads_count );
+
+	std::vector< std::jthread > threads;
+	threads.reserve(threads_count);
+
+	start_barrier::start_sync_t::wakeup_controller_t wakeup_controller{
+			start_latch };
+
+	for( std::size_t i = 0; i != threads_count; ++i )
+	{
+		threads.push_back(
+			std::jthread{
+				batch_thread_body<T>,
+				i,
+				cores[i],
+				std::ref(start_latch),
+				std::cref(workload),
+				shares[i],
+				std::ref(results[i])
+			}
+		);
+	}
+
+	(void)wakeup_controller.wakeup_threads();
+
+	for( auto & thr : threads )
+	{
+		thr.join();
+	}
+
+	return results;
+}
+
+/// Производительность ядер рабочих нитей для разделения пачки.
+///
+/// Для batch_weights_t::measured каждая нить выполняет одинаковое
+/// количество заданий, и производительность -- это заданий в секунду.
+/// Для batch_weights_t::sysfs берется относительная производительность
+/// класса ядра, а у непривязанных нитей она считается равной 1.
+template< typename T >
+[[nodiscard]]
+std::vector< double >
+detect_batch_weights(
+	const run_params::run_params_t & params,
+	const std::vector< std::optional< run_params::core_index_t > > & cores,
+	const workload_t<T> & workload )
+{
+	const auto & batch = *params._batch;
+	std::vector< double > weights( cores.size(), 1.0 );
+
+	if( run_params::batch_weights_t::sysfs == batch._weights )
+	{
+		const auto topology = core_classes::detect( params._sysfs_root,
+				cpu_budget::detect( params._sysfs_root )._usable );
+		for( std::size_t i = 0; i != cores.size(); ++i )
+			if( cores[ i ] )
+				weights[ i ] = topology.relative_capacity( *cores[ i ] );
+		return weights;
+	}
+
+	// Калибровка занимает примерно четверть от одного прогона пачки.
+	const std::size_t calibration_jobs = std::max< std::size_t >(
+			1u, batch._jobs / cores.size() / 4u );
+	std::osyncstream{ std::cout } << "calibration run: " << calibration_jobs
+			<< " job(s) per worker" << std::endl;
+
+	const auto results = run_batch_workers<T>( cores, workload,
+			std::vector< std::size_t >( cores.size(), calibration_jobs ) );
+	for( std::size_t i = 0; i != results.size(); ++i )
+	{
+		const double seconds = to_seconds( results[ i ]._time );
+		if( !results[ i ]._completed || !(seconds > 0.0) )
+			throw std::runtime_error{ "calibration run failed for worker #"
+					+ std::to_string( i + 1 ) };
+		weights[ i ] = static_cast< double >( calibration_jobs ) / seconds;
+	}
+
+	return weights;
+}
+
+/// Выполнение пачки заданий с равным разделением и с разделением
+/// пропорционально производительности ядер.
+///
+/// На гибридных процессорах при равном разделении все ждут самое
+/// медленное ядро, поэтому сравнивается время выполнения всей пачки
+/// (makespan).
+template< typename T >
+[[nodiscard]]
+int
+do_batch_work( const run_params::run_params_t & params )
+{
+	collect_and_report_some_system_info( params._sysfs_root );
+
+	const auto & batch = *params._batch;
+
+	const auto threads_count = detect_threads_count( params );
+	const auto cores = detect_worker_cores(
+			threads_count, params._pinning, params._sysfs_root );
+
+	const auto workload = make_workload<T>( params );
+	std::osyncstream{ std::cout } << "script: " << workload._name
+			<< ", batch of " << batch._jobs << " job(s)" << std::endl;
+
+	const auto weights = detect_batch_weights<T>( params, cores, workload );
+	const auto even = core_classes::split_jobs(
+			batch._jobs, std::vector< double >( threads_count, 1.0 ) );
+	const auto weighted = core_classes::split_jobs( batch._jobs, weights );
+
+	{
+		std::osyncstream cout{ std::cout };
+		const double best = *std::max_element( weights.begin(), weights.end() );
+		cout << "worker capacity ("
+				<< (run_params::batch_weights_t::sysfs == batch._weights
+						? "sysfs" : "measured")
+				<< ") and jobs:" << std::endl;
+		for( std::size_t t = 0; t != threads_count; ++t )
+			cout << "  #" << (t + 1) << ": relative capacity " << std::fixed
+					<< std::setprecision( 2 ) << weights[ t ] / best
+					<< std::defaultfloat << ", jobs: " << even[ t ]
+					<< " even, " << weighted[ t ] << " weighted" << std::endl;
+	}
+
+	struct split_t
+	{
+		const char * _name;
+		const std::vector< std::size_t > & _shares;
+		std::vector< double > _makespans{};
+	};
+	std::array< split_t, 2 > splits{
+			split_t{ "even", even },
+			split_t{ "weighted", weighted }
+		};
+
+	bool failed = false;
+	const unsigned total_runs = params._warmup_runs + params._repetitions;
+	for( unsigned run = 0; run != total_runs; ++run )
+	{
+		const bool warmup = run < params._warmup_runs;
+		std::osyncstream{ std::cout }
+				<< (warmup ? "warmup run " : "measured run ")
+				<< (warmup ? run + 1 : run - params._warmup_runs + 1) << " of "
+				<< (warmup ? params._warmup_runs : params._repetitions)
+				<< std::endl;
+
+		for( auto & split : splits )
+		{
+			const auto results = run_batch_workers<T>(
+					cores, workload, split._shares );
+			if( warmup )
+				continue;
+
+			std::osyncstream cout{ std::cout };
+			cout << "  " << split._name << ":";
+			double makespan = 0.0;
+			double fastest = std::numeric_limits< double >::max();
+			for( std::size_t t = 0; t != results.size(); ++t )
+			{
+				const auto & r = results[ t ];
+				if( !r._completed )
+				{
+					cout << " #" << (t + 1) << " failed";
+					failed = true;
+					continue;
+				}
+				const double seconds = to_seconds( r._time );
+				makespan = std::max( makespan, seconds );
+				fastest = std::min( fastest, seconds );
+				cout << " #" << (t + 1) << ": " << r._jobs << " in "
+						<< std::fixed << std::setprecision( 6 ) << seconds << "s"
+						<< std::defaultfloat;
+			}
+			cout << "; makespan " << std::fixed << std::setprecision( 6 )
+					<< makespan << "s, idle of fastest " << std::setprecision( 1 )
+					<< (makespan > 0.0 && fastest <= makespan
+							? (makespan - fastest) / makespan * 100.0 : 0.0)
+					<< "%" << std::defaultfloat
+					<< std::endl;
+			if( "memo" == workload._engine->name() )
+			{
+				script::engines::memo::stats_t memo;
+				for( const auto & r : results )
+					memo += r._memo;
+				report_memo( cout, memo );
+			}
+			split._makespans.push_back( makespan );
+		}
+	}
+
+	if( failed )
+		return 1;
+
+	{
+		std::osyncstream cout{ std::cout };
+		const auto even_makespan = stats::summarize( splits[ 0 ]._makespans );
+		const auto weighted_makespan = stats::summarize( splits[ 1 ]._makespans );
+		cout << "batch makespan over " << params._repetitions
+				<< " run(s), median: even " << std::fixed << std::setprecision( 6 )
+				<< even_makespan._median << "s, weighted "
+				<< weighted_makespan._median << "s";
+		if( even_makespan._median > 0.0 )
+			cout << " (" << std::showpos << std::setprecision( 1 )
+					<< (even_makespan._median - weighted_makespan._median)
+							/ even_makespan._median * 100.0
+					<< std::noshowpos << "% saved)";
+		cout << std::defaultfloat << std::endl;
+	}
+
+	return 0;
+}
+
+/// Потоковая обработка записей из входного файла.
+///
+/// Если в каком-либо из замеряемых прогонов рабочая нить не
+/// завершилась нормально, то часть записей осталась необработанной:
+/// выходной файл не пишется, а код возврата равен 1.
+template< typename T >
+int
+do_stream_work( const run_params::run_params_t & params )
+{
+	collect_and_report_some_system_info( params._sysfs_root );
+
+	const auto & stream = *params._stream;
+
+	const auto threads_count = detect_threads_count( params );
+	const auto cores = detect_worker_cores(
+			threads_count, params._pinning, params._sysfs_root );
+
+	const record_stream::mapped_file_t file{ stream._input_file };
+	const auto layout = stream._binary ?
+			record_stream::make_binary_layout<T>(
+					file, stream._columns, stream._chunk_bytes ) :
+			record_stream::make_csv_layout( file, stream._chunk_bytes );
+
+	{
+		std::osyncstream cout{ std::cout };
+		cout << "input: " << stream._input_file
+				<< (stream._binary ? " (binary, " : " (CSV, ")
+				<< file.size() << " bytes, "
+				<< layout._chunks.size() << " chunk(s)), columns:";
+		for( const auto & c : layout._columns )
+			cout << ' ' << c;
+		cout << std::endl;
+	}
+
+	const std::vector< std::string > outputs{ record_demo_script_output };
+	const auto record_script = script::verify(
+			make_record_demo_script<T>( layout._columns ), layout._columns );
+
+	// Скорость обработки каждой нитью в каждом из прогонов.
+	std::vector< std::vector< double > > records_per_second( threads_count );
+	std::vector< std::vector< double > > bytes_per_second( threads_count );
+
+	std::vector< record_stream::chunk_results_t<T> > chunk_results;
+
+	bool failed = false;
+	const unsigned total_runs = params._warmup_runs + params._repetitions;
+	for( unsigned run = 0; run != total_runs; ++run )
+	{
+		const bool warmup = run < params._warmup_runs;
+		std::osyncstream{ std::cout }
+				<< (warmup ? "warmup run " : "measured run ")
+				<< (warmup ? run + 1 : run - params._warmup_runs + 1) << " of "
+				<< (warmup ? params._warmup_runs : params._repetitions)
+				<< std::endl;
+
+		record_stream::chunk_dispenser_t dispenser{ layout._chunks.size() };
+		chunk_results.assign( layout._chunks.size(), {} );
+		const stream_job_t<T> job{
+				stream,
+				layout,
+				record_script,
+				outputs,
+				dispenser,
+				chunk_results
+			};
+
+		const auto results = run_stream_workers<T>( cores, job );
+		if( warmup )
+			continue;
+
+		std::osyncstream cout{ std::cout };
+		for( std::size_t t = 0; t != results.size(); ++t )
+		{
+			const auto & r = results[ t ];
+			const double seconds = to_seconds( r._time );
+			cout << "  #" << (t + 1) << ": ";
+			if( !r._completed )
+			{
+				cout << "failed" << std::endl;
+				failed = true;
+				continue;
+			}
+
+			cout << r._records << " record(s), " << r._bytes << " bytes, "
+					<< r._chunks << " chunk(s), "
+					<< std::fixed << std::setprecision(6) << seconds << "s";
+			if( seconds > 0.0 )
+			{
+				records_per_second[ t ].push_back(
+						static_cast< double >( r._records ) / seconds );
+				bytes_per_second[ t ].push_back(
+						static_cast< double >( r._bytes ) / seconds );
+				cout << std::setprecision(0)
+						<< ", " << records_per_second[ t ].back() << " records/s"
+						<< std::setprecision(2)
+						<< ", " << bytes_per_second[ t ].back() / 1e6 << " MB/s";
+			}
+			cout << std::defaultfloat << std::endl;
+		}
+	}
+
+	{
+		std::osyncstream cout{ std::cout };
+		cout << "stream throughput over " << params._repetitions
+				<< " run(s), median per thread:" << std::endl;
+		for( std::size_t t = 0; t != threads_count; ++t )
+		{
+			// У нити нет замеров, если она ни разу не завершилась
+			// нормально.
+			if( records_per_second[ t ].empty() )
+			{
+				cout << "  #" << (t + 1) << ": no samples" << std::endl;
+				continue;
+			}
+
+			const auto records = stats::summarize( records_per_second[ t ] );
+			const auto bytes = stats::summarize( bytes_per_second[ t ] );
+			cout << "  #" << (t + 1) << ": " << std::fixed
+					<< std::setprecision(0) << records._median << " records/s, "
+					<< std::setprecision(2) << bytes._median / 1e6 << " MB/s"
+					<< std::defaultfloat << std::endl;
+		}
+	}
+
+	if( failed )
+	{
+		if( stream._output_file )
+			std::osyncstream{ std::cout } << "some workers failed, "
+					<< *stream._output_file << " is not written" << std::endl;
+		return 1;
+	}
+
+	if( stream._output_file )
+		write_stream_outputs< T >(
+				*stream._output_file, outputs, chunk_results );
+
+	return 0;
+}
+
+/// Специальный visitor для обработки результатов парсинга
+/// аргументов коммандной строки.
+template< typename T >
+class cmd_line_args_handler_t
+{
+	const char * _argv_0;
+
+public:
+	explicit cmd_line_args_handler_t( const char * argv_0 )
+		: _argv_0{ argv_0 }
+	{}
+
+	int
+	operator()( const run_params::help_requested_t & ) const
+	{
+		std::osyncstream{ std::cout } << "Usage:\n\t"
+			<< _argv_0
+			<< " [thread_count] [pin[:<core-index(es)>]] [warmup:N] [reps:N]"
+				" [json:<file>] [csv:<file>] [sample:<ms>] [sysfs:<path>]"
+				" [trace:<file> [trace-loops:<us>]]"
+				" [progress:<ms> [slow-below:<f>]]\n\t"
+			<< _argv_0
+			<< " sweep:<thread-counts> [nopin] [pin[:<core-index(es)>]]..."
+				" [warmup:N] [reps:N] [csv:<file>]\n\n"
+			<< "where `pin` can be in one of the following formats:\n\n"
+				"pin             pin threads to logical processes sequentially\n"
+				"                starting from 0\n"
+				"pin:N+          pin threads to logical processes sequentially\n"
+				"                starting from N\n"
+				"                For example: pin:3+\n"
+				"pin:I,J,K[,..]  pin thread only to specified logical processes\n"
+				"                For example: pin:0,1,3,4\n"
+				"pin:fast        pin threads sequentially, the most capable\n"
+				"                cores (P-cores of hybrid CPUs) first\n"
+				"\n"
+				"NOTE: if `thread_count` is omitted then the number of listed\n"
+				"logical processors is used for `pin:I,J,K`, otherwise the\n"
+				"effective CPU capacity of the process: usable CPUs from\n"
+				"sched_getaffinity, cgroup v2 cpuset.cpus.effective and\n"
+				"isolcpus, limited by the cgroup v2 cpu.max quota.\n"
+				"Sequential pinning uses only usable CPUs, isolated ones first.\n"
+				"For example:\n\n"
+			<< "\t" << _argv_0 << " pin:0,2,4\n"
+			<< "\t" << _argv_0 << " pin:1+\n"
+			<< "\t" << _argv_0 << " 10 pin:1+\n\n"
+			<< "Statistics related arguments:\n\n"
+				"warmup:N        make N runs before measurements (default: 0)\n"
+				"reps:N          make N measured runs (default: 1)\n"
+				"json:<file>     store config, raw times and statistics as JSON\n"
+				"csv:<file>      store config and statistics as CSV\n"
+				"\n"
+			<< "CPU frequency and thermal sampling:\n\n"
+				"sample:<ms>     sample scaling_cur_freq/scaling_governor of\n"
+				"                workers' CPUs and thermal zones every <ms>\n"
+				"                milliseconds, flag throttled intervals\n"
+				"sysfs:<path>    use <path> instead of /sys (for a fake sysfs)\n"
+				"\n"
+			<< "Worker progress:\n\n"
+				"progress:<ms>       sample iterations of while_loop_t done by\n"
+				"                    every worker each <ms> milliseconds and\n"
+				"                    print throughput over time\n"
+				"slow-below:<f>      flag intervals where a worker's throughput\n"
+				"                    drops below <f> of its median\n"
+				"                    (default: 0.8)\n"
+				"\n"
+			<< "Worker timeline:\n\n"
+				"trace:<file>        write thread creation, pinning, barrier\n"
+				"                    wait, script execution and join of every\n"
+				"                    worker as Chrome trace events (open the\n"
+				"                    file in https://ui.perfetto.dev)\n"
+				"trace-loops:<us>    also record while_loop_t executions that\n"
+				"                    take at least <us> microseconds\n"
+				"\n"
+			<< "Sweep mode:\n\n"
+				"sweep:1-4,8,16  run the script for every listed thread count\n"
+				"                and estimate speedup, parallel efficiency and\n"
+				"                Amdahl/USL coefficients. Every `pin` argument\n"
+				"                (and `nopin`) adds a pinning policy to check.\n"
+				"                Without any of them no pinning is used.\n"
+				"                For example:\n\n"
+			<< "\t" << _argv_0 << " sweep:1-8 nopin pin reps:5 csv:sweep.csv\n"
+			<< "\n"
+			<< "Scripts:\n\n"
+				"script:<name>  run a script from the library instead of\n"
+				"               the demo script. Final values of variables\n"
+				"               are checked after every run. Names:\n\n"
+			<< script_library::names_help()
+			<< "\n"
+			<< "Memory-bound script:\n\n"
+				"array:<elements>  every worker writes, increments and scans\n"
+				"                  its own array of <elements> values instead\n"
+				"                  of running the demo script, GB/s is reported\n"
+				"array-passes:N    process the array N times (default: 1)\n"
+				"huge-pages        place arrays in huge pages (MAP_HUGETLB,\n"
+				"                  transparent huge pages as a fallback)\n"
+				"\n"
+			<< "Streaming of records:\n\n"
+				"stream:<file>         run a per-record script for every record\n"
+				"                      of <file>, chunks are distributed among\n"
+				"                      workers, records/s and bytes/s are reported\n"
+				"stream-format:<fmt>   `csv` (header with column names) or\n"
+				"                      `binary` (values of the script's type),\n"
+				"                      default: by `.csv` extension\n"
+				"columns:<a,b,..>      column names for binary input\n"
+				"chunk:<KiB>           chunk size (default: 1024)\n"
+				"stream-out:<file>     store output variables as CSV\n"
+				"                      For example:\n\n"
+			<< "\t" << _argv_0 << " 4 pin stream:input.csv stream-out:out.csv\n"
+			<< "\n"
+			<< "Baselines and regression checks:\n\n"
+				"save-baseline:<name>     store results as baseline <name>\n"
+				"compare-baseline:<name>  compare results with baseline <name>\n"
+				"                         (Mann-Whitney U test), exit code is 1\n"
+				"                         if a regression is detected\n"
+				"baselines:<dir>          directory with baselines\n"
+				"                         (default: baselines)\n"
+				"threshold:<percent>      minimal slowdown of the median to be\n"
+				"                         treated as regression (default: 5)\n"
+				"alpha:<p>                significance level (default: 0.05)\n"
+				"allow-host-mismatch      allow comparison with a baseline\n"
+				"                         recorded on different hardware\n"
+				"                         For example:\n\n"
+			<< "\t" << _argv_0 << " 4 pin reps:10 save-baseline:main\n"
+			<< "\t" << _argv_0 << " 4 pin reps:10 compare-baseline:main\n"
+			<< "\n"
+			<< "Engines:\n\n"
+				"engine:tree      walk the script tree (default)\n"
+				"engine:bytecode  compile the script to bytecode with\n"
+				"                 variables resolved to slots\n"
+				"engine:memo      walk the script tree, but take results of\n"
+				"                 pure loops (only scalar variables, no\n"
+				"                 print) from a per-thread cache keyed by\n"
+				"                 the values of the variables they read and\n"
+				"                 write; hit rates and the time saved are\n"
+				"                 reported. The cache lives as long as the\n"
+				"                 worker thread, so it pays off with batch:\n"
+				"differential     run the script (or, without script: and\n"
+				"                 array:, a set of library scripts) on every\n"
+				"                 engine, compare final contexts and printed\n"
+				"                 output with the tree engine exactly and\n"
+				"                 report relative speed. reps:N sets the\n"
+				"                 number of runs per engine. For example:\n\n"
+			<< "\t" << _argv_0 << " differential reps:3\n"
+			<< "\t" << _argv_0 << " 4 pin engine:bytecode script:vars:256\n"
+			<< "\t" << _argv_0 << " 2 engine:memo script:nested batch:100\n"
+			<< "\n"
+			<< "Checkpoint and resume (always with the bytecode engine):\n\n"
+				"checkpoint:<ms>        pause the script <ms> milliseconds after\n"
+				"                       start at the nearest loop back-edge,\n"
+				"                       serialize its context and position and\n"
+				"                       resume it in another thread; pause and\n"
+				"                       resume latency and snapshot size are\n"
+				"                       reported\n"
+				"checkpoint-out:<file>  write the snapshot to <file> instead of\n"
+				"                       resuming\n"
+				"resume:<file>          resume the same script from <file>\n"
+				"                       For example:\n\n"
+			<< "\t" << _argv_0 << " script:nested:20000x20000 checkpoint:500"
+				" checkpoint-out:run.ckpt\n"
+			<< "\t" << _argv_0 << " script:nested:20000x20000 resume:run.ckpt\n"
+			<< "\n"
+			<< "Batch of jobs on cores of different capacity:\n\n"
+				"batch:<jobs>             run the script <jobs> times by all\n"
+				"                         workers together, once split evenly\n"
+				"                         and once in proportion to the\n"
+				"                         capacity of workers' cores, and\n"
+				"                         compare the makespans\n"
+				"batch-weights:measured   capacity from a calibration run of\n"
+				"                         every worker (default)\n"
+				"batch-weights:sysfs      capacity from core classes in sysfs\n"
+				"                         (cpu_capacity, cpuinfo_max_freq,\n"
+				"                         hybrid PMUs)\n"
+				"                         For example:\n\n"
+			<< "\t" << _argv_0 << " pin:fast batch:200 reps:5\n"
+			<< "\n"
+			<< "Workers:\n\n"
+				"workers:threads            run the script in worker threads\n"
+				"                           (default)\n"
+				"workers:processes          run the script in forked worker\n"
+				"                           processes, each with its own\n"
+				"                           allocator and page tables\n"
+				"workers:threads,processes  (sweep mode only) measure both\n"
+				"                           and compare their scaling\n"
+				"                           For example:\n\n"
+			<< "\t" << _argv_0 << " sweep:1-8 pin workers:threads,processes\n"
+			<< "\n"
+			<< "Memory for the script and its execution context:\n\n"
+				"memory:malloc     global heap shared by all workers (default)\n"
+				"memory:monotonic  per-worker std::pmr::monotonic_buffer_resource\n"
+				"                  over a preallocated buffer\n"
+				"memory:pool       per-worker\n"
+				"                  std::pmr::unsynchronized_pool_resource\n"
+				"                  Several kinds can be listed in sweep mode,\n"
+				"                  for example:\n\n"
+			<< "\t" << _argv_0 << " sweep:1-8 pin memory:malloc,monotonic,pool\n"
+			<< "\n"
+			<< "Allocations per script::execute and per worker are reported\n"
+				"if the program is built with -DSCRIPT_INTERPRETER_ALLOC_HOOKS=ON"
+				" (now: " << (alloc_accounting::enabled() ? "on" : "off") << ")\n"
+			<< std::endl;
+
+		return 0;
+	}
+
+	int
+	operator()( const run_params::run_params_t & params ) const
+	{
+		if( params._differential )
+			return do_differential_work<T>( params );
+		else if( params._checkpoint )
+			return do_checkpoint_work<T>( params );
+		else if( params._stream )
+			return do_stream_work<T>( params );
+		else if( params._batch )
+			return do_batch_work<T>( params );
+		else if( params._sweep )
+			do_sweep_work<T>( params );
+		else
+			return do_main_work<T>( params );
+
+		return 0;
+	}
+};
+
+} // namespace impl
+
+/// Возвращает код завершения программы.
+template< typename T >
+[[nodiscard]]
+int
+do_work(int argc, char ** argv)
+{
+	using namespace impl;
+
+	const auto parsed_args = run_params::parse_cmd_line_args( argc, argv );
+
+	return std::visit(
+			cmd_line_args_handler_t<T>{ argv[0] },
+			parsed_args );
+}
+
+} // namespace linux_affinity
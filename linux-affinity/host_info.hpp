@@ -0,0 +1,133 @@
+#pragma once
+
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace host_info
+{
+
+/// Сведения о машине и сборке, на которых были получены результаты.
+///
+/// Сохраняются вместе с результатами, чтобы результаты с разного
+/// железа нельзя было сравнить незаметно для пользователя.
+struct host_info_t
+{
+	std::string _hostname;
+
+	/// Модель процессора из /proc/cpuinfo.
+	std::string _cpu_model;
+
+	/// Количество сконфигурированных логических процессоров.
+	long _logical_cpus{};
+
+	/// Версия ядра и архитектура (из uname).
+	std::string _kernel;
+
+	/// Компилятор и режим сборки.
+	std::string _compiler;
+};
+
+namespace impl
+{
+
+[[nodiscard]] inline std::string
+trim( const std::string & what )
+{
+	const auto first = what.find_first_not_of( " \t" );
+	if( std::string::npos == first )
+		return {};
+	const auto last = what.find_last_not_of( " \t" );
+	return what.substr( first, last - first + 1u );
+}
+
+/// Модель процессора.
+///
+/// На x86 она указывается в строке `model name`, на ARM может
+/// быть только `Hardware` или `CPU part`.
+[[nodiscard]] inline std::string
+read_cpu_model()
+{
+	const std::vector< std::string > keys{ "model name", "Hardware", "CPU part" };
+
+	std::ifstream file{ "/proc/cpuinfo" };
+	std::string line;
+	std::vector< std::string > found( keys.size() );
+	while( std::getline( file, line ) )
+	{
+		const auto colon = line.find( ':' );
+		if( std::string::npos == colon )
+			continue;
+
+		const auto key = trim( line.substr( 0, colon ) );
+		for( std::size_t i = 0; i != keys.size(); ++i )
+			if( key == keys[ i ] && found[ i ].empty() )
+				found[ i ] = trim( line.substr( colon + 1u ) );
+	}
+
+	for( const auto & v : found )
+		if( !v.empty() )
+			return v;
+	return "unknown";
+}
+
+[[nodiscard]] inline std::string
+compiler_description()
+{
+	std::string result;
+#if defined(__clang__)
+	result = "clang " __clang_version__;
+#elif defined(__GNUC__)
+	result = "gcc " __VERSION__;
+#else
+	result = "unknown";
+#endif
+#if defined(NDEBUG)
+	result += ", NDEBUG";
+#endif
+	return result;
+}
+
+} /* namespace impl */
+
+/// Собрать сведения о текущей машине.
+[[nodiscard]] inline host_info_t
+collect()
+{
+	host_info_t result;
+
+	char hostname[ 256 ]{};
+	if( 0 == gethostname( hostname, sizeof(hostname) - 1u ) )
+		result._hostname = hostname;
+	else
+		result._hostname = "unknown";
+
+	result._cpu_model = impl::read_cpu_model();
+	result._logical_cpus = sysconf( _SC_NPROCESSORS_CONF );
+
+	if( utsname info; 0 == uname( &info ) )
+		result._kernel = std::string{ info.sysname } + " " + info.release
+				+ " " + info.machine;
+	else
+		result._kernel = "unknown";
+
+	result._compiler = impl::compiler_description();
+
+	return result;
+}
+
+/// Совпадает ли железо, на котором были получены результаты.
+///
+/// Имя машины, версия ядра и компилятор не учитываются: их
+/// изменение -- это как раз то, влияние чего может потребоваться
+/// оценить.
+[[nodiscard]] inline bool
+same_hardware( const host_info_t & a, const host_info_t & b )
+{
+	return a._cpu_model == b._cpu_model && a._logical_cpus == b._logical_cpus;
+}
+
+} /* namespace host_info */
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include "../common/progress_counters.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+/// Учет ресурсов ОС, потраченных рабочей нитью.
+///
+/// Позволяет убедиться, что привязка действительно удержала нить на
+/// ее ядре, и что нить не вытеснялась: время работы нити сравнивается
+/// с процессорным временем, а переключения контекста и страничные
+/// отказы берутся из getrusage(RUSAGE_THREAD).
+namespace os_accounting
+{
+
+/// Если процессорное время нити меньше этой доли от времени работы
+/// (wall time), то нить считается вытесненной.
+inline constexpr double low_cpu_share = 0.9;
+
+/// Потребление ресурсов нитью.
+///
+/// Тривиально копируемый, чтобы его можно было передать из рабочего
+/// процесса.
+struct usage_t
+{
+	/// Процессорное время нити (CLOCK_THREAD_CPUTIME_ID).
+	std::chrono::nanoseconds _cpu_time{};
+
+	/// Добровольные переключения контекста (ожидание, блокировки).
+	std::int64_t _voluntary_switches{};
+
+	/// Принудительные переключения контекста (вытеснение).
+	std::int64_t _involuntary_switches{};
+
+	/// Страничные отказы без обращения к диску.
+	std::int64_t _minor_faults{};
+
+	/// Страничные отказы с обращением к диску.
+	std::int64_t _major_faults{};
+};
+
+/// Текущие значения для вызывающей нити.
+[[nodiscard]] inline usage_t
+snapshot()
+{
+	usage_t result;
+
+	timespec ts{};
+	if( 0 != ::clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts ) )
+		throw std::runtime_error{
+				std::string{ "clock_gettime(CLOCK_THREAD_CPUTIME_ID) failed: " }
+				+ std::strerror( errno ) };
+	result._cpu_time = std::chrono::seconds{ ts.tv_sec }
+			+ std::chrono::nanoseconds{ ts.tv_nsec };
+
+	rusage ru{};
+	if( 0 != ::getrusage( RUSAGE_THREAD, &ru ) )
+		throw std::runtime_error{
+				std::string{ "getrusage(RUSAGE_THREAD) failed: " }
+				+ std::strerror( errno ) };
+	result._voluntary_switches = ru.ru_nvcsw;
+	result._involuntary_switches = ru.ru_nivcsw;
+	result._minor_faults = ru.ru_minflt;
+	result._major_faults = ru.ru_majflt;
+
+	return result;
+}
+
+/// Что изменилось между двумя снимками.
+[[nodiscard]] inline usage_t
+operator-( const usage_t & finish, const usage_t & start ) noexcept
+{
+	return {
+		finish._cpu_time - start._cpu_time,
+		finish._voluntary_switches - start._voluntary_switches,
+		finish._involuntary_switches - start._involuntary_switches,
+		finish._minor_faults - start._minor_faults,
+		finish._major_faults - start._major_faults
+	};
+}
+
+/// Печать сведений для одной нити.
+///
+/// wall_time -- время работы нити, core -- ядро, к которому она была
+/// привязана (если была).
+inline void
+report(
+	std::ostream & to,
+	std::size_t thread_index,
+	std::chrono::steady_clock::duration wall_time,
+	const usage_t & usage,
+	const progress::cpu_trace_t & cpus,
+	std::optional< unsigned > core )
+{
+	const double wall = std::chrono::duration< double >( wall_time ).count();
+	const double cpu = std::chrono::duration< double >( usage._cpu_time ).count();
+	const double share = wall > 0.0 ? cpu / wall : 0.0;
+
+	to << "  #" << (thread_index + 1) << ": cpu " << std::fixed
+			<< std::setprecision( 6 ) << cpu << "s / wall " << wall << "s ("
+			<< std::setprecision( 1 ) << share * 100.0 << "%)"
+			<< std::defaultfloat
+			<< ", csw: " << usage._voluntary_switches << " voluntary, "
+			<< usage._involuntary_switches << " involuntary"
+			<< ", faults: " << usage._minor_faults << " minor, "
+			<< usage._major_faults << " major"
+			<< ", cpus seen:";
+
+	const auto seen = cpus.cpus();
+	if( seen.empty() )
+		to << " n/a";
+	for( std::size_t i = 0; i != seen.size(); ++i )
+		to << (i ? "," : " ") << seen[ i ];
+	to << " (" << cpus._changes << " change(s) in " << cpus._observations
+			<< " observation(s))" << std::endl;
+
+	if( wall > 0.0 && share < low_cpu_share )
+		to << "  #" << (thread_index + 1) << ": WARNING: cpu time is only "
+				<< std::fixed << std::setprecision( 1 ) << share * 100.0
+				<< std::defaultfloat << "% of wall time, the worker was "
+				"preempted or waiting" << std::endl;
+
+	if( core )
+		for( const auto c : seen )
+			if( c != *core )
+			{
+				to << "  #" << (thread_index + 1) << ": WARNING: pinned to "
+						"cpu " << *core << " but was seen on cpu " << c
+						<< std::endl;
+				break;
+			}
+}
+
+} /* namespace os_accounting */
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace perf_counters
+{
+
+/// Виды аппаратных и программных счетчиков, которые снимаются
+/// для каждой рабочей нити.
+enum class counter_kind_t : std::size_t
+{
+	cycles,
+	instructions,
+	branch_misses,
+	l1d_read_misses,
+	llc_read_misses,
+	context_switches,
+	/// Должен быть самым последним.
+	total_kinds
+};
+
+/// Общее количество счетчиков в группе.
+inline constexpr std::size_t counters_count =
+		static_cast< std::size_t >( counter_kind_t::total_kinds );
+
+/// Значения счетчиков, снятые для одной рабочей нити.
+struct counter_values_t
+{
+	/// Значения отдельных счетчиков.
+	///
+	/// Пустое значение означает, что счетчик недоступен.
+	std::array< std::optional< std::uint64_t >, counters_count > _values{};
+
+	/// Почему счетчики вообще не удалось задействовать.
+	///
+	/// Пуста, если хотя бы один счетчик был доступен.
+	std::string _failure_reason{};
+
+	[[nodiscard]]
+	std::optional< std::uint64_t >
+	get( counter_kind_t kind ) const
+	{
+		return _values[ static_cast< std::size_t >( kind ) ];
+	}
+
+	[[nodiscard]]
+	bool
+	available() const
+	{
+		for( const auto & v : _values )
+			if( v.has_value() )
+				return true;
+		return false;
+	}
+};
+
+namespace impl
+{
+
+/// Описание одного события для perf_event_open.
+struct event_description_t
+{
+	counter_kind_t _kind;
+	std::uint32_t _type;
+	std::uint64_t _config;
+	/// Нужно ли учитывать события в режиме ядра.
+	///
+	/// Переключения контекста происходят только в ядре, поэтому
+	/// с exclude_kernel они всегда будут нулевыми.
+	bool _count_kernel;
+};
+
+[[nodiscard]] constexpr std::uint64_t
+make_cache_config(
+	std::uint64_t cache_id,
+	std::uint64_t op_id,
+	std::uint64_t result_id )
+{
+	return cache_id | (op_id << 8) | (result_id << 16);
+}
+
+/// Все события, которые пытаемся открыть.
+///
+/// Первое успешно открытое событие становится лидером группы.
+inline constexpr std::array< event_description_t, counters_count > events{
+	event_description_t{
+		counter_kind_t::cycles,
+		PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, false
+	},
+	event_description_t{
+		counter_kind_t::instructions,
+		PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, false
+	},
+	event_description_t{
+		counter_kind_t::branch_misses,
+		PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, false
+	},
+	event_description_t{
+		counter_kind_t::l1d_read_misses,
+		PERF_TYPE_HW_CACHE,
+		make_cache_config(
+				PERF_COUNT_HW_CACHE_L1D,
+				PERF_COUNT_HW_CACHE_OP_READ,
+				PERF_COUNT_HW_CACHE_RESULT_MISS ),
+		false
+	},
+	event_description_t{
+		counter_kind_t::llc_read_misses,
+		PERF_TYPE_HW_CACHE,
+		make_cache_config(
+				PERF_COUNT_HW_CACHE_LL,
+				PERF_COUNT_HW_CACHE_OP_READ,
+				PERF_COUNT_HW_CACHE_RESULT_MISS ),
+		false
+	},
+	event_description_t{
+		counter_kind_t::context_switches,
+		PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, true
+	}
+};
+
+[[nodiscard]] inline int
+open_event(
+	const event_description_t & event,
+	int group_fd )
+{
+	perf_event_attr attr;
+	std::memset( std::addressof(attr), 0, sizeof(attr) );
+
+	attr.size = sizeof(attr);
+	attr.type = event._type;
+	attr.config = event._config;
+	// Вся группа включается и выключается через лидера.
+	attr.disabled = (-1 == group_fd) ? 1 : 0;
+	attr.exclude_kernel = event._count_kernel ? 0 : 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP
+			| PERF_FORMAT_ID
+			| PERF_FORMAT_TOTAL_TIME_ENABLED
+			| PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// pid=0 и cpu=-1: считаем только для текущей нити на любом ядре.
+	return static_cast< int >( syscall(
+			SYS_perf_event_open,
+			std::addressof(attr),
+			0, -1, group_fd,
+			PERF_FLAG_FD_CLOEXEC ) );
+}
+
+[[nodiscard]] inline std::string
+explain_open_failure( int error_code )
+{
+	std::string result{ "perf_event_open failed: " };
+	result += std::strerror( error_code );
+
+	switch( error_code )
+	{
+	case EACCES: [[fallthrough]];
+	case EPERM:
+		result += " (access is forbidden, see "
+				"/proc/sys/kernel/perf_event_paranoid)";
+	break;
+
+	case ENOENT: [[fallthrough]];
+	case EOPNOTSUPP: [[fallthrough]];
+	case ENODEV:
+		result += " (no PMU available, running inside a VM?)";
+	break;
+
+	case ENOSYS:
+		result += " (perf_event_open isn't supported by the kernel)";
+	break;
+	}
+
+	return result;
+}
+
+} /* namespace impl */
+
+/// Группа счетчиков для одной рабочей нити.
+///
+/// Должна создаваться и использоваться на той нити, для которой
+/// нужно снимать значения счетчиков.
+///
+/// Конструктор не бросает исключений если perf_event_open
+/// недоступен: в этом случае stop() вернет пустые значения
+/// с описанием причины.
+class thread_counters_t
+{
+	/// Описатели открытых событий. Первый из них является лидером.
+	std::vector< int > _fds;
+
+	/// Какому счетчику соответствует каждый из _fds.
+	std::vector< counter_kind_t > _kinds;
+
+	/// Идентификаторы событий, по которым они ищутся в результатах read.
+	std::vector< std::uint64_t > _ids;
+
+	/// Описание причины неудачи, если ни одно событие не было открыто.
+	std::string _failure_reason;
+
+	[[nodiscard]] int
+	leader_fd() const noexcept
+	{
+		return _fds.empty() ? -1 : _fds.front();
+	}
+
+public:
+	thread_counters_t()
+	{
+		int first_error{};
+		for( const auto & event : impl::events )
+		{
+			const int fd = impl::open_event( event, leader_fd() );
+			if( -1 == fd )
+			{
+				if( !first_error )
+					first_error = errno;
+				continue;
+			}
+
+			std::uint64_t id{};
+			if( -1 == ioctl( fd, PERF_EVENT_IOC_ID, std::addressof(id) ) )
+			{
+				close( fd );
+				continue;
+			}
+
+			_fds.push_back( fd );
+			_kinds.push_back( event._kind );
+			_ids.push_back( id );
+		}
+
+		if( _fds.empty() )
+			_failure_reason = impl::explain_open_failure( first_error );
+	}
+
+	~thread_counters_t()
+	{
+		// Участников группы закрываем до лидера.
+		for( auto it = _fds.rbegin(); it != _fds.rend(); ++it )
+			close( *it );
+	}
+
+	thread_counters_t( const thread_counters_t & ) = delete;
+	thread_counters_t & operator=( const thread_counters_t & ) = delete;
+
+	/// Сбросить и запустить все счетчики группы.
+	void
+	start() noexcept
+	{
+		if( const int fd = leader_fd(); -1 != fd )
+		{
+			ioctl( fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+			ioctl( fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+		}
+	}
+
+	/// Остановить счетчики группы и получить их значения.
+	///
+	/// Если группа вытеснялась другими событиями (мультиплексирование),
+	/// то значения масштабируются пропорционально времени работы.
+	[[nodiscard]] counter_values_t
+	stop() const
+	{
+		counter_values_t result;
+
+		const int fd = leader_fd();
+		if( -1 == fd )
+		{
+			result._failure_reason = _failure_reason;
+			return result;
+		}
+
+		ioctl( fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+
+		// Формат: nr, time_enabled, time_running, { value, id }[nr].
+		std::vector< std::uint64_t > buf( 3u + 2u * _fds.size() );
+		const auto bytes_expected = buf.size() * sizeof(std::uint64_t);
+		if( const auto rc = read( fd, buf.data(), bytes_expected );
+				rc < 0 || static_cast< std::size_t >( rc ) != bytes_expected )
+		{
+			result._failure_reason = "unable to read perf counters group";
+			return result;
+		}
+
+		const auto nr = buf[ 0 ];
+		const auto time_enabled = buf[ 1 ];
+		const auto time_running = buf[ 2 ];
+		if( !time_running )
+		{
+			result._failure_reason = "perf counters group was never scheduled";
+			return result;
+		}
+
+		const double scale = static_cast< double >( time_enabled ) /
+				static_cast< double >( time_running );
+
+		for( std::uint64_t i = 0; i != nr; ++i )
+		{
+			const auto value = buf[ 3u + 2u * i ];
+			const auto id = buf[ 3u + 2u * i + 1u ];
+			for( std::size_t j = 0; j != _ids.size(); ++j )
+				if( _ids[ j ] == id )
+				{
+					result._values[ static_cast< std::size_t >( _kinds[ j ] ) ] =
+							static_cast< std::uint64_t >( value * scale );
+					break;
+				}
+		}
+
+		return result;
+	}
+};
+
+/// Прочитать текущее значение perf_event_paranoid.
+///
+/// Возвращает пустое значение, если файл недоступен.
+[[nodiscard]] inline std::optional< int >
+read_perf_event_paranoid()
+{
+	std::ifstream file{ "/proc/sys/kernel/perf_event_paranoid" };
+	int value{};
+	if( file >> value )
+		return value;
+	return std::nullopt;
+}
+
+} /* namespace perf_counters */
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../common/start_barrier.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+/// Средства для запуска рабочих процессов вместо рабочих нитей.
+///
+/// Все объекты, через которые взаимодействуют процессы, размещаются
+/// в разделяемой памяти, созданной через shm_open до fork. Поэтому
+/// в них используются только атомарные переменные, не зависящие от
+/// адреса (lock-free), и futex-ы без FUTEX_PRIVATE_FLAG.
+namespace process_workers
+{
+
+namespace impl
+{
+
+using futex_word_t = std::atomic< std::uint32_t >;
+
+static_assert( futex_word_t::is_always_lock_free );
+static_assert( std::atomic< std::uint64_t >::is_always_lock_free );
+
+/// Ожидание на futex-е, разделяемом между процессами.
+///
+/// Если timeout не пуст, то ожидание ограничено по времени.
+inline void
+futex_wait(
+	futex_word_t & word,
+	std::uint32_t expected,
+	const timespec * timeout = nullptr ) noexcept
+{
+	syscall( SYS_futex,
+			reinterpret_cast< std::uint32_t * >( std::addressof(word) ),
+			FUTEX_WAIT, expected, timeout, nullptr, 0 );
+}
+
+inline void
+futex_wake_all( futex_word_t & word ) noexcept
+{
+	syscall( SYS_futex,
+			reinterpret_cast< std::uint32_t * >( std::addressof(word) ),
+			FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0 );
+}
+
+[[nodiscard]] inline std::runtime_error
+make_errno_error( const std::string & what )
+{
+	return std::runtime_error{ what + ": " + std::strerror( errno ) };
+}
+
+} /* namespace impl */
+
+/// Блок разделяемой памяти.
+///
+/// Создается через shm_open и сразу же удаляется из файловой системы
+/// через shm_unlink: доступ к нему нужен только процессам, созданным
+/// через fork, а они наследуют отображение. Благодаря этому блок не
+/// остается в /dev/shm даже при аварийном завершении программы.
+class shared_memory_t
+{
+	void * _address{ MAP_FAILED };
+	std::size_t _size{};
+
+public:
+	explicit shared_memory_t( std::size_t size )
+		: _size{ size }
+	{
+		static std::atomic< unsigned > counter{};
+		const std::string name = "/script-interpreter-"
+				+ std::to_string( ::getpid() ) + "-"
+				+ std::to_string( counter.fetch_add( 1u ) );
+
+		const int fd = ::shm_open( name.c_str(),
+				O_RDWR | O_CREAT | O_EXCL, 0600 );
+		if( fd < 0 )
+			throw impl::make_errno_error( "shm_open(" + name + ") failed" );
+		::shm_unlink( name.c_str() );
+
+		if( 0 != ::ftruncate( fd, static_cast< off_t >( _size ) ) )
+		{
+			const auto error = impl::make_errno_error( "ftruncate failed" );
+			::close( fd );
+			throw error;
+		}
+
+		_address = ::mmap( nullptr, _size, PROT_READ | PROT_WRITE,
+				MAP_SHARED, fd, 0 );
+		::close( fd );
+		if( MAP_FAILED == _address )
+			throw impl::make_errno_error( "mmap of shared memory failed" );
+	}
+
+	~shared_memory_t()
+	{
+		if( MAP_FAILED != _address )
+			::munmap( _address, _size );
+	}
+
+	shared_memory_t( const shared_memory_t & ) = delete;
+	shared_memory_t & operator=( const shared_memory_t & ) = delete;
+
+	[[nodiscard]] void *
+	address() const noexcept { return _address; }
+
+	[[nodiscard]] std::size_t
+	size() const noexcept { return _size; }
+};
+
+/// Барьер для синхронизации старта рабочих процессов.
+///
+/// Аналог start_barrier::start_sync_t, но без дерева объединения:
+/// рабочих процессов не бывает сотни, а все данные барьера должны
+/// находиться в разделяемой памяти без указателей.
+class alignas(64) start_sync_t
+{
+	/// Сколько процессов уже прибыло к барьеру.
+	impl::futex_word_t _arrived{ 0 };
+
+	/// Сигнал на старт (значение start_barrier::wakeup_type_t).
+	alignas(64) impl::futex_word_t _state{
+			static_cast< std::uint32_t >( start_barrier::wakeup_type_t::standby ) };
+
+	const std::uint32_t _participants;
+
+public:
+	explicit start_sync_t( std::uint32_t participants )
+		: _participants{ participants }
+	{}
+
+	start_sync_t( const start_sync_t & ) = delete;
+	start_sync_t & operator=( const start_sync_t & ) = delete;
+
+	/// Прибыть к барьеру и дождаться сигнала на старт.
+	///
+	/// Вызывается рабочим процессом ровно один раз. Индекс рабочего
+	/// не используется и нужен лишь для совместимости с
+	/// start_barrier::start_sync_t.
+	[[nodiscard]] start_barrier::wakeup_type_t
+	arrive_and_wait( std::size_t /*worker_index*/ ) noexcept
+	{
+		if( _participants == 1u + _arrived.fetch_add( 1u, std::memory_order_acq_rel ) )
+			impl::futex_wake_all( _arrived );
+
+		const auto standby = static_cast< std::uint32_t >(
+				start_barrier::wakeup_type_t::standby );
+		for( unsigned i = 0; i != start_barrier::impl::spin_iterations; ++i )
+		{
+			if( const auto v = _state.load( std::memory_order_acquire ); v != standby )
+				return static_cast< start_barrier::wakeup_type_t >( v );
+			start_barrier::impl::cpu_relax();
+		}
+
+		for(;;)
+		{
+			if( const auto v = _state.load( std::memory_order_acquire ); v != standby )
+				return static_cast< start_barrier::wakeup_type_t >( v );
+			impl::futex_wait( _state, standby );
+		}
+	}
+
+	/// Дождаться прибытия всех процессов, но не дольше timeout.
+	///
+	/// Возвращает true, если прибыли все. Управляющий процесс вызывает
+	/// этот метод в цикле, проверяя между вызовами, не завершился ли
+	/// какой-нибудь из рабочих процессов раньше времени.
+	[[nodiscard]] bool
+	wait_for_all_arrived( std::chrono::milliseconds timeout ) noexcept
+	{
+		const auto seconds =
+				std::chrono::duration_cast< std::chrono::seconds >( timeout );
+		const timespec ts{
+				static_cast< time_t >( seconds.count() ),
+				static_cast< long >( std::chrono::duration_cast<
+						std::chrono::nanoseconds >( timeout - seconds ).count() ) };
+
+		const auto arrived = _arrived.load( std::memory_order_acquire );
+		if( arrived >= _participants )
+			return true;
+
+		impl::futex_wait( _arrived, arrived, &ts );
+		return _arrived.load( std::memory_order_acquire ) >= _participants;
+	}
+
+	/// Отпустить рабочие процессы с указанным сигналом.
+	void
+	release( start_barrier::wakeup_type_t signal ) noexcept
+	{
+		_state.store( static_cast< std::uint32_t >( signal ),
+				std::memory_order_release );
+		impl::futex_wake_all( _state );
+	}
+};
+
+/// Кольцевой буфер фиксированной емкости в разделяемой памяти.
+///
+/// Lock-free очередь для нескольких писателей и нескольких читателей
+/// на основе порядковых номеров ячеек (bounded MPMC queue Д. Вьюкова).
+/// Писатель захватывает ячейку через CAS позиции записи, заполняет
+/// ее и публикует, изменяя порядковый номер ячейки. Блокировок нет,
+/// но если писатель аварийно завершится между захватом ячейки и ее
+/// публикацией, то читатель остановится на этой ячейке: сообщения
+/// от такого рабочего и следующих за ним считаются потерянными.
+///
+/// Message должен быть тривиально копируемым: сообщения передаются
+/// между адресными пространствами побайтно.
+///
+/// Объект создается функцией create в заранее выделенной памяти
+/// размером bytes_for( capacity ).
+template< typename Message >
+class result_ring_t
+{
+	static_assert( std::is_trivially_copyable_v< Message > );
+
+	struct alignas(64) slot_t
+	{
+		std::atomic< std::uint64_t > _sequence;
+		Message _message;
+	};
+
+	alignas(64) std::atomic< std::uint64_t > _enqueue_pos{ 0 };
+	alignas(64) std::atomic< std::uint64_t > _dequeue_pos{ 0 };
+	const std::uint64_t _mask;
+
+	/// Ячейки идут сразу за заголовком.
+	[[nodiscard]] slot_t *
+	slots() noexcept
+	{
+		return reinterpret_cast< slot_t * >( this + 1 );
+	}
+
+	explicit result_ring_t( std::uint64_t capacity )
+		: _mask{ capacity - 1u }
+	{
+		for( std::uint64_t i = 0; i != capacity; ++i )
+			new( slots() + i ) slot_t{ { i }, Message{} };
+	}
+
+public:
+	result_ring_t( const result_ring_t & ) = delete;
+	result_ring_t & operator=( const result_ring_t & ) = delete;
+
+	/// Сколько памяти нужно для буфера с указанной емкостью.
+	///
+	/// Емкость должна быть степенью двойки.
+	[[nodiscard]] static constexpr std::size_t
+	bytes_for( std::size_t capacity ) noexcept
+	{
+		return sizeof(result_ring_t) + capacity * sizeof(slot_t);
+	}
+
+	/// Создать буфер в памяти where размером не менее bytes_for( capacity ).
+	[[nodiscard]] static result_ring_t *
+	create( void * where, std::size_t capacity )
+	{
+		if( !capacity || (capacity & (capacity - 1u)) )
+			throw std::invalid_argument{
+					"result_ring_t: capacity must be a power of 2" };
+		return new( where ) result_ring_t{ capacity };
+	}
+
+	/// Поместить сообщение в буфер.
+	///
+	/// Возвращает false, если буфер заполнен.
+	[[nodiscard]] bool
+	try_push( const Message & message ) noexcept
+	{
+		auto pos = _enqueue_pos.load( std::memory_order_relaxed );
+		for(;;)
+		{
+			auto & slot = slots()[ pos & _mask ];
+			const auto seq = slot._sequence.load( std::memory_order_acquire );
+			const auto diff = static_cast< std::int64_t >( seq - pos );
+			if( 0 == diff )
+			{
+				if( _enqueue_pos.compare_exchange_weak( pos, pos + 1u,
+						std::memory_order_relaxed ) )
+				{
+					slot._message = message;
+					slot._sequence.store( pos + 1u, std::memory_order_release );
+					return true;
+				}
+			}
+			else if( diff < 0 )
+				return false;
+			else
+				pos = _enqueue_pos.load( std::memory_order_relaxed );
+		}
+	}
+
+	/// Извлечь сообщение из буфера, если оно там есть.
+	[[nodiscard]] std::optional< Message >
+	try_pop() noexcept
+	{
+		auto pos = _dequeue_pos.load( std::memory_order_relaxed );
+		for(;;)
+		{
+			auto & slot = slots()[ pos & _mask ];
+			const auto seq = slot._sequence.load( std::memory_order_acquire );
+			const auto diff = static_cast< std::int64_t >( seq - (pos + 1u) );
+			if( 0 == diff )
+			{
+				if( _dequeue_pos.compare_exchange_weak( pos, pos + 1u,
+						std::memory_order_relaxed ) )
+				{
+					Message result = slot._message;
+					slot._sequence.store( pos + _mask + 1u,
+							std::memory_order_release );
+					return result;
+				}
+			}
+			else if( diff < 0 )
+				return std::nullopt;
+			else
+				pos = _dequeue_pos.load( std::memory_order_relaxed );
+		}
+	}
+};
+
+} /* namespace process_workers */
@@ -0,0 +1,279 @@
+#pragma once
+
+#include "../common/progress_counters.hpp"
+#include "../common/run_timeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Периодический опрос счетчиков продвижения рабочих нитей.
+///
+/// Время работы нити целиком скрывает то, что происходило по ходу
+/// работы: троттлинг, соседей по ядру, миграции. Поэтому счетчики
+/// итераций всех нитей опрашиваются с фиксированным периодом, и для
+/// каждой нити строится ряд значений пропускной способности.
+namespace progress_sampler
+{
+
+/// Параметры опроса.
+struct config_t
+{
+	/// Период опроса.
+	std::chrono::milliseconds _period{ 100 };
+
+	/// Интервал считается медленным, если пропускная способность нити
+	/// на нем ниже этой доли от ее медианной пропускной способности.
+	double _slow_fraction{ 0.8 };
+};
+
+/// Один снимок всех счетчиков.
+struct sample_t
+{
+	run_timeline::steady_clock_t::time_point _at;
+
+	/// Значения счетчиков по порядку рабочих нитей.
+	std::vector< std::uint64_t > _iterations;
+};
+
+/// Все, что было собрано за время прогона.
+struct samples_t
+{
+	config_t _config;
+	std::vector< sample_t > _samples;
+};
+
+/// Нить, которая опрашивает счетчики.
+///
+/// Счетчики должны существовать до вызова finish.
+class sampler_t
+{
+	samples_t _result;
+
+	const progress::counter_t * const _counters;
+	const std::size_t _count;
+
+	std::mutex _lock;
+	std::condition_variable_any _wakeup_cv;
+
+	std::jthread _thread;
+
+	void
+	take_sample()
+	{
+		sample_t sample;
+		sample._at = run_timeline::steady_clock_t::now();
+		sample._iterations.reserve( _count );
+		for( std::size_t i = 0; i != _count; ++i )
+			sample._iterations.push_back( _counters[ i ].load() );
+
+		_result._samples.push_back( std::move(sample) );
+	}
+
+	void
+	body( std::stop_token stop )
+	{
+		std::unique_lock lock{ _lock };
+		for(;;)
+		{
+			take_sample();
+			(void)_wakeup_cv.wait_for( lock, stop, _result._config._period,
+					[]{ return false; } );
+			if( stop.stop_requested() )
+				break;
+		}
+
+		// Последний снимок -- уже после остановки рабочих нитей.
+		take_sample();
+	}
+
+public:
+	sampler_t(
+		config_t config,
+		const progress::counter_t * counters,
+		std::size_t count )
+		: _counters{ counters }
+		, _count{ count }
+	{
+		_result._config = std::move(config);
+		_result._samples.reserve( 1024u );
+
+		_thread = std::jthread{
+				[this]( std::stop_token stop ) { body( stop ); } };
+	}
+
+	~sampler_t()
+	{
+		_thread.request_stop();
+	}
+
+	sampler_t( const sampler_t & ) = delete;
+	sampler_t & operator=( const sampler_t & ) = delete;
+
+	/// Остановить опрос и получить собранные данные.
+	[[nodiscard]] samples_t
+	finish()
+	{
+		_thread.request_stop();
+		_thread.join();
+		return std::move(_result);
+	}
+};
+
+/// Пропускная способность одной нити на одном интервале между
+/// соседними снимками.
+struct interval_t
+{
+	/// Границы интервала в секундах от сигнала на старт.
+	double _from_s{};
+	double _to_s{};
+
+	/// Итераций в секунду.
+	double _rate{};
+
+	/// Попадает ли интервал целиком в промежуток работы нити.
+	///
+	/// Первый и последний интервалы с ненулевым продвижением нить
+	/// отработала лишь частично, они показываются, но в медиану не
+	/// входят и медленными не считаются.
+	bool _full{ false };
+
+	/// Ниже ли пропускная способность заданной доли от медианы.
+	bool _slow{ false };
+};
+
+/// Ряд значений для одной нити.
+struct worker_series_t
+{
+	std::vector< interval_t > _intervals;
+
+	/// Медиана по полным интервалам. Пусто, если полных интервалов нет
+	/// (нить отработала быстрее двух периодов опроса).
+	std::optional< double > _median_rate;
+};
+
+/// Построить ряды значений для всех нитей.
+[[nodiscard]] inline std::vector< worker_series_t >
+analyze(
+	const samples_t & data,
+	run_timeline::steady_clock_t::time_point released_at )
+{
+	const auto seconds_since_release = [&]( auto at ) {
+		return std::chrono::duration< double >( at - released_at ).count();
+	};
+
+	const auto & samples = data._samples;
+	const auto workers = samples.empty() ? 0u : samples.front()._iterations.size();
+
+	std::vector< worker_series_t > result( workers );
+	for( std::size_t w = 0; w != workers; ++w )
+	{
+		auto & series = result[ w ];
+
+		std::optional< std::size_t > first_active;
+		std::size_t last_active{};
+		for( std::size_t k = 1; k < samples.size(); ++k )
+		{
+			const auto & prev = samples[ k - 1u ];
+			const auto & cur = samples[ k ];
+
+			interval_t i;
+			i._from_s = seconds_since_release( prev._at );
+			i._to_s = seconds_since_release( cur._at );
+			const auto delta = cur._iterations[ w ] - prev._iterations[ w ];
+			if( i._to_s > i._from_s )
+				i._rate = static_cast< double >( delta ) / (i._to_s - i._from_s);
+			series._intervals.push_back( i );
+
+			if( delta )
+			{
+				if( !first_active )
+					first_active = series._intervals.size() - 1u;
+				last_active = series._intervals.size() - 1u;
+			}
+		}
+
+		if( !first_active )
+			continue;
+
+		std::vector< double > rates;
+		for( auto k = *first_active + 1u; k < last_active; ++k )
+		{
+			series._intervals[ k ]._full = true;
+			rates.push_back( series._intervals[ k ]._rate );
+		}
+		if( rates.empty() )
+			continue;
+
+		std::sort( rates.begin(), rates.end() );
+		const auto n = rates.size();
+		series._median_rate = (n % 2u) ? rates[ n / 2u ]
+				: (rates[ n / 2u - 1u ] + rates[ n / 2u ]) / 2.0;
+
+		for( auto & i : series._intervals )
+			i._slow = i._full
+					&& i._rate < *series._median_rate * data._config._slow_fraction;
+	}
+
+	return result;
+}
+
+/// Печать рядов значений и медленных интервалов.
+inline void
+report(
+	std::ostream & to,
+	const samples_t & data,
+	run_timeline::steady_clock_t::time_point released_at )
+{
+	const auto all = analyze( data, released_at );
+
+	to << "throughput samples (period " << data._config._period.count()
+			<< "ms, iterations/s, `*` -- below "
+			<< std::fixed << std::setprecision( 0 )
+			<< data._config._slow_fraction * 100.0 << "% of median, "
+			<< "`~` -- partial interval):" << std::defaultfloat << std::endl;
+
+	constexpr std::size_t per_line = 8u;
+	for( std::size_t w = 0; w != all.size(); ++w )
+	{
+		const auto & series = all[ w ];
+
+		to << "  #" << (w + 1) << ": median ";
+		if( series._median_rate )
+			to << std::scientific << std::setprecision( 3 )
+					<< *series._median_rate << std::defaultfloat;
+		else
+			to << "n/a (too few samples)";
+
+		for( std::size_t k = 0; k != series._intervals.size(); ++k )
+		{
+			const auto & i = series._intervals[ k ];
+			if( 0u == k % per_line )
+				to << "\n     ";
+			to << ' ' << std::scientific << std::setprecision( 2 ) << i._rate
+					<< std::defaultfloat
+					<< (i._slow ? '*' : (i._full ? ' ' : '~'));
+		}
+		to << std::endl;
+
+		for( const auto & i : series._intervals )
+			if( i._slow )
+				to << "  #" << (w + 1) << ": SLOW interval "
+						<< std::fixed << std::setprecision( 3 )
+						<< i._from_s << "-" << i._to_s << "s: "
+						<< std::scientific << std::setprecision( 3 ) << i._rate
+						<< " it/s (" << std::fixed << std::setprecision( 0 )
+						<< i._rate / *series._median_rate * 100.0
+						<< "% of median)" << std::defaultfloat << std::endl;
+	}
+}
+
+} /* namespace progress_sampler */
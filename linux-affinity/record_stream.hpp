@@ -0,0 +1,378 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../templated-script/script.hpp"
+#include "../templated-script/verifier.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace record_stream
+{
+
+/// Формат входного файла.
+enum class format_t
+{
+	/// Значения типа T подряд, запись за записью, без заголовка.
+	binary,
+	/// Текст с заголовком из имен колонок, значения разделены запятыми.
+	csv
+};
+
+/// Входной файл, отображенный в память только для чтения.
+class mapped_file_t
+{
+	const char * _data{ nullptr };
+	std::size_t _size{};
+
+public:
+	explicit mapped_file_t( const std::string & file_name )
+	{
+		const int fd = open( file_name.c_str(), O_RDONLY | O_CLOEXEC );
+		if( fd < 0 )
+			throw std::runtime_error{ "unable to open input file: " + file_name
+					+ ", error: " + std::strerror( errno ) };
+
+		struct stat st{};
+		if( 0 != fstat( fd, &st ) )
+		{
+			const int err = errno;
+			close( fd );
+			throw std::runtime_error{ "fstat failed for: " + file_name
+					+ ", error: " + std::strerror( err ) };
+		}
+
+		_size = static_cast< std::size_t >( st.st_size );
+		if( _size )
+		{
+			void * p = mmap( nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0 );
+			if( MAP_FAILED == p )
+			{
+				const int err = errno;
+				close( fd );
+				throw std::runtime_error{ "mmap failed for: " + file_name
+						+ ", error: " + std::strerror( err ) };
+			}
+			(void)madvise( p, _size, MADV_SEQUENTIAL );
+			_data = static_cast< const char * >( p );
+		}
+
+		// Отображение остается действительным и после закрытия файла.
+		close( fd );
+	}
+
+	~mapped_file_t()
+	{
+		if( _data )
+			munmap( const_cast< char * >( _data ), _size );
+	}
+
+	mapped_file_t( const mapped_file_t & ) = delete;
+	mapped_file_t & operator=( const mapped_file_t & ) = delete;
+
+	[[nodiscard]] const char *
+	data() const noexcept { return _data; }
+
+	[[nodiscard]] std::size_t
+	size() const noexcept { return _size; }
+};
+
+/// Фрагмент входных данных, который обрабатывается одной нитью
+/// целиком. Содержит только целые записи.
+struct chunk_t
+{
+	const char * _begin{};
+	const char * _end{};
+};
+
+/// Разметка входного файла: имена колонок и фрагменты.
+struct layout_t
+{
+	std::vector< std::string > _columns;
+	std::vector< chunk_t > _chunks;
+};
+
+namespace impl
+{
+
+[[nodiscard]] inline std::string_view
+trim( std::string_view what )
+{
+	while( !what.empty() && (' ' == what.front() || '\t' == what.front()) )
+		what.remove_prefix( 1u );
+	while( !what.empty() && (' ' == what.back() || '\t' == what.back()
+			|| '\r' == what.back()) )
+		what.remove_suffix( 1u );
+	return what;
+}
+
+[[nodiscard]] inline std::vector< std::string >
+split_header( std::string_view header )
+{
+	std::vector< std::string > result;
+	for(;;)
+	{
+		const auto comma = header.find( ',' );
+		result.emplace_back( trim( header.substr( 0, comma ) ) );
+		if( std::string_view::npos == comma )
+			break;
+		header.remove_prefix( comma + 1u );
+	}
+	return result;
+}
+
+/// Конец строки, начинающейся в from (позиция после '\n').
+[[nodiscard]] inline const char *
+end_of_line( const char * from, const char * end ) noexcept
+{
+	const auto * nl = static_cast< const char * >(
+			std::memchr( from, '\n', static_cast< std::size_t >( end - from ) ) );
+	return nl ? nl + 1 : end;
+}
+
+} /* namespace impl */
+
+/// Разбить бинарный файл на фрагменты примерно по chunk_bytes байт.
+template< typename T >
+[[nodiscard]] layout_t
+make_binary_layout(
+	const mapped_file_t & file,
+	std::vector< std::string > columns,
+	std::size_t chunk_bytes )
+{
+	if( columns.empty() )
+		throw std::runtime_error{ "column names are required for binary input" };
+
+	const std::size_t record_size = columns.size() * sizeof(T);
+	if( file.size() % record_size )
+		throw std::runtime_error{ "binary input size "
+				+ std::to_string( file.size() )
+				+ " isn't a multiple of record size "
+				+ std::to_string( record_size ) };
+
+	const std::size_t records_per_chunk =
+			std::max< std::size_t >( 1u, chunk_bytes / record_size );
+
+	layout_t result{ std::move(columns), {} };
+	const char * end = file.data() + file.size();
+	for( const char * p = file.data(); p != end; )
+	{
+		const auto left = static_cast< std::size_t >( end - p ) / record_size;
+		const char * next = p + std::min( left, records_per_chunk ) * record_size;
+		result._chunks.push_back( { p, next } );
+		p = next;
+	}
+	return result;
+}
+
+/// Разбить CSV-файл на фрагменты примерно по chunk_bytes байт.
+///
+/// Границы фрагментов сдвигаются на начало следующей строки.
+[[nodiscard]] inline layout_t
+make_csv_layout( const mapped_file_t & file, std::size_t chunk_bytes )
+{
+	const char * begin = file.data();
+	const char * end = begin + file.size();
+	if( begin == end )
+		throw std::runtime_error{ "CSV input is empty" };
+
+	const char * data_begin = impl::end_of_line( begin, end );
+	layout_t result{
+			impl::split_header( std::string_view{ begin,
+					static_cast< std::size_t >( data_begin - begin ) } ),
+			{}
+		};
+
+	for( const char * p = data_begin; p != end; )
+	{
+		const char * next = static_cast< std::size_t >( end - p ) <= chunk_bytes ?
+				end : impl::end_of_line( p + chunk_bytes, end );
+		result._chunks.push_back( { p, next } );
+		p = next;
+	}
+	return result;
+}
+
+/// Выполнение скрипта для каждой записи.
+///
+/// Входные колонки и выходные переменные создаются в контексте
+/// один раз, после чего значения пишутся и читаются через ссылки
+/// на переменные, без поиска по имени для каждой записи. Контекст
+/// переиспользуется между записями, поэтому скрипт сам должен
+/// инициализировать свои переменные.
+///
+/// Скрипт должен пройти статическую проверку, в которой входные
+/// колонки считаются уже получившими значения. Поэтому он выполняется
+/// без проверок наличия переменных.
+template< typename T >
+class record_executor_t
+{
+	script::verified_script_t<T> _script;
+	script::exec_context_t<T> _ctx;
+	std::vector< T * > _inputs;
+	std::vector< T * > _outputs;
+
+	/// Значения полей текущей записи CSV.
+	std::vector< T > _parsed;
+
+	void
+	exec_current( std::vector< T > & outputs )
+	{
+		_script.script()->exec_unchecked( _ctx );
+		for( const T * o : _outputs )
+			outputs.push_back( *o );
+	}
+
+public:
+	record_executor_t(
+		script::verified_script_t<T> script,
+		const std::vector< std::string > & inputs,
+		const std::vector< std::string > & outputs )
+		: _script{ std::move(script) }
+		, _parsed( inputs.size() )
+	{
+		for( const auto & name : _script.predefined() )
+			if( inputs.end() == std::find( inputs.begin(), inputs.end(), name ) )
+				throw std::invalid_argument{
+						"record_executor_t: script expects unknown input: "
+						+ name };
+
+		for( const auto & name : inputs )
+			_ctx.assign_to( name, T{} );
+		for( const auto & name : outputs )
+			_ctx.assign_to( name, T{} );
+
+		// Ссылки на элементы unordered_map остаются действительными
+		// при добавлении новых элементов.
+		for( const auto & name : inputs )
+			_inputs.push_back( &_ctx.get_mutable_ref( name ) );
+		for( const auto & name : outputs )
+			_outputs.push_back( &_ctx.get_mutable_ref( name ) );
+	}
+
+	[[nodiscard]] std::size_t
+	outputs_count() const noexcept { return _outputs.size(); }
+
+	/// Обработать фрагмент бинарного файла.
+	///
+	/// Возвращает количество обработанных записей.
+	std::size_t
+	process_binary( const chunk_t & chunk, std::vector< T > & outputs )
+	{
+		// Начало отображения выровнено на страницу, а размер записи
+		// кратен sizeof(T), поэтому значения можно читать на месте.
+		const auto * values = reinterpret_cast< const T * >( chunk._begin );
+		const auto * end = reinterpret_cast< const T * >( chunk._end );
+		const std::size_t columns = _inputs.size();
+
+		std::size_t records{};
+		for( ; values != end; values += columns, ++records )
+		{
+			for( std::size_t c = 0; c != columns; ++c )
+				*_inputs[ c ] = values[ c ];
+			exec_current( outputs );
+		}
+		return records;
+	}
+
+	/// Обработать фрагмент CSV-файла.
+	///
+	/// Пустые строки пропускаются. Возвращает количество
+	/// обработанных записей.
+	std::size_t
+	process_csv( const chunk_t & chunk, std::vector< T > & outputs )
+	{
+		std::size_t records{};
+		for( const char * line = chunk._begin; line != chunk._end; )
+		{
+			const char * next = impl::end_of_line( line, chunk._end );
+			const std::string_view text = impl::trim( std::string_view{
+					line, static_cast< std::size_t >( next - line ) -
+							('\n' == next[ -1 ] ? 1u : 0u) } );
+			line = next;
+			if( text.empty() )
+				continue;
+
+			std::size_t column{};
+			const char * p = text.data();
+			const char * const text_end = text.data() + text.size();
+			for(;; ++column)
+			{
+				const char * comma = static_cast< const char * >( std::memchr(
+						p, ',', static_cast< std::size_t >( text_end - p ) ) );
+				const char * field_end = comma ? comma : text_end;
+				const auto field = impl::trim( std::string_view{
+						p, static_cast< std::size_t >( field_end - p ) } );
+
+				if( column >= _parsed.size() )
+					throw std::runtime_error{ "too many fields in CSV record: "
+							+ std::string{ text } };
+
+				const auto [ ptr, ec ] = std::from_chars(
+						field.data(), field.data() + field.size(),
+						_parsed[ column ] );
+				if( std::errc{} != ec || ptr != field.data() + field.size() )
+					throw std::runtime_error{ "unable to parse CSV field `"
+							+ std::string{ field } + "`" };
+
+				if( !comma )
+					break;
+				p = comma + 1;
+			}
+
+			if( column + 1u != _parsed.size() )
+				throw std::runtime_error{ "too few fields in CSV record: "
+						+ std::string{ text } };
+
+			for( std::size_t c = 0; c != _parsed.size(); ++c )
+				*_inputs[ c ] = _parsed[ c ];
+			exec_current( outputs );
+			++records;
+		}
+		return records;
+	}
+};
+
+/// Результаты обработки одного фрагмента.
+template< typename T >
+struct chunk_results_t
+{
+	/// Значения выходных переменных, запись за записью.
+	std::vector< T > _outputs;
+	std::size_t _records{};
+};
+
+/// Раздача фрагментов рабочим нитям.
+///
+/// Нити берут фрагменты по одному в порядке следования, пока они
+/// не закончатся, поэтому более быстрые нити обрабатывают больше
+/// фрагментов.
+class chunk_dispenser_t
+{
+	alignas(64) std::atomic< std::size_t > _next{ 0 };
+	const std::size_t _total;
+
+public:
+	explicit chunk_dispenser_t( std::size_t total ) : _total{ total } {}
+
+	/// Индекс следующего фрагмента, либо total, если фрагменты закончились.
+	[[nodiscard]] std::size_t
+	next() noexcept
+	{
+		const auto index = _next.fetch_add( 1u, std::memory_order_relaxed );
+		return index < _total ? index : _total;
+	}
+};
+
+} /* namespace record_stream */
@@ -0,0 +1,961 @@
+#include "run_params.hpp"
+
+#include "../templated-script/engine_names.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+#include <string>
+#include <regex>
+#include <sstream>
+
+namespace run_params
+{
+
+namespace
+{
+
+[[nodiscard]]
+pinning_params_t
+try_parse_adv_pinning_mode( std::string arg_value )
+{
+	using sregex_iterator_t = std::sregex_iterator;
+	using smatch_t = std::smatch;
+	const auto regex_kind = std::regex::ECMAScript;
+
+	const auto to_core_index = [](
+			const sregex_iterator_t & it,
+			std::size_t capture_index = 1 )
+	{
+		return static_cast< core_index_t >( std::stoul(
+				smatch_t{ *it }.str( capture_index ) ) );
+	};
+
+	const auto make_it = [](
+			const std::string & from,
+			const std::regex & regex )
+	{
+		return sregex_iterator_t{ from.begin(), from.end(), regex };
+	};
+
+	const sregex_iterator_t not_found{};
+
+	// Сперва самые простые случаи: pin:fast и pin:1+.
+	if( "fast" == arg_value )
+		return seq_pinning_t{ 0u, true };
+
+	const std::regex simple_start_from{ R"(^(\d+)\+$)", regex_kind };
+
+	if( auto it = make_it( arg_value, simple_start_from );
+			it != not_found )
+	{
+		return seq_pinning_t{ to_core_index( it ) };
+	}
+
+	// Теперь более сложный случай с перечислением конкретных ядер.
+	// Т.е. pin:1 или pin:1, или pin:1,2 или pin:1,2,4,5 и т.д.
+	const std::regex one_selected_core{ R"(^(\d+)$)", regex_kind };
+	const std::regex selected_core_with_comma{ R"(^(\d+),(.*)$)", regex_kind };
+
+	selective_pinning_t selected;
+	while( !arg_value.empty() )
+	{
+		if( auto it_simple = make_it( arg_value, one_selected_core );
+				it_simple != not_found )
+		{
+			selected._cores.push_back( to_core_index( it_simple ) );
+
+			// Продолжать нет мысла.
+			arg_value.clear();
+		}
+		else if( auto it_with_comma =
+				make_it( arg_value, selected_core_with_comma );
+				it_with_comma != not_found )
+		{
+			selected._cores.push_back( to_core_index( it_with_comma ) );
+
+			// Продолжаем с остатком, если таковой есть.
+			arg_value = smatch_t{ *it_with_comma }.str( 2 );
+		}
+		else
+			throw std::runtime_error{
+					"unable to parse enumeration of core indexes, problem "
+					"with substring: `" + arg_value + "`"
+			};
+	}
+
+	return { std::move(selected) };
+}
+
+/// Функция для разбора перечня количества нитей для режима `sweep`.
+///
+/// Принимает значение с уже вырезанным префиксом `sweep:`. Перечень
+/// может содержать как отдельные значения, так и диапазоны.
+/// Например: `1,2,4,8` или `1-4,6,8`.
+[[nodiscard]]
+std::vector< unsigned >
+try_parse_sweep_threads_counts( const std::string & arg_value )
+{
+	constexpr auto regex_kind = std::regex::ECMAScript;
+	const std::regex single_value{ R"(^(\d+)$)", regex_kind };
+	const std::regex range{ R"(^(\d+)-(\d+)$)", regex_kind };
+
+	std::vector< unsigned > result;
+
+	std::string::size_type from{};
+	while( from <= arg_value.size() )
+	{
+		const auto comma = std::min(
+				arg_value.find( ',', from ), arg_value.size() );
+		const std::string item = arg_value.substr( from, comma - from );
+		from = comma + 1u;
+
+		std::smatch match;
+		if( std::regex_match( item, match, single_value ) )
+		{
+			result.push_back(
+					static_cast< unsigned >( std::stoul( match.str( 1 ) ) ) );
+		}
+		else if( std::regex_match( item, match, range ) )
+		{
+			const auto first = static_cast< unsigned >(
+					std::stoul( match.str( 1 ) ) );
+			const auto last = static_cast< unsigned >(
+					std::stoul( match.str( 2 ) ) );
+			if( first > last )
+				throw std::runtime_error{
+						"invalid range of thread counts: `" + item + "`" };
+
+			for( auto n = first; n <= last; ++n )
+				result.push_back( n );
+		}
+		else
+			throw std::runtime_error{
+					"unable to parse thread counts for sweep, problem "
+					"with substring: `" + item + "`"
+			};
+	}
+
+	std::sort( result.begin(), result.end() );
+	result.erase( std::unique( result.begin(), result.end() ), result.end() );
+
+	if( result.empty() || 0u == result.front() )
+		throw std::runtime_error{ "thread counts for sweep can't contain 0" };
+
+	return result;
+}
+
+[[nodiscard]]
+args_parsing_result_t
+try_parse_cmd_line_args( int argc, char ** argv )
+{
+	using namespace std::string_view_literals;
+
+	constexpr std::string_view just_pin{ "pin" };
+	constexpr std::string_view no_pin{ "nopin" };
+	constexpr std::string_view sweep_prefix{ "sweep:" };
+	constexpr std::string_view pin_prefix{ "pin:" };
+	constexpr std::string_view warmup_prefix{ "warmup:" };
+	constexpr std::string_view reps_prefix{ "reps:" };
+	constexpr std::string_view json_prefix{ "json:" };
+	constexpr std::string_view csv_prefix{ "csv:" };
+	constexpr std::string_view sample_prefix{ "sample:" };
+	constexpr std::string_view sysfs_prefix{ "sysfs:" };
+	constexpr std::string_view trace_prefix{ "trace:" };
+	constexpr std::string_view progress_prefix{ "progress:" };
+	constexpr std::string_view slow_below_prefix{ "slow-below:" };
+	constexpr std::string_view trace_loops_prefix{ "trace-loops:" };
+	constexpr std::string_view baselines_prefix{ "baselines:" };
+	constexpr std::string_view save_baseline_prefix{ "save-baseline:" };
+	constexpr std::string_view compare_baseline_prefix{ "compare-baseline:" };
+	constexpr std::string_view threshold_prefix{ "threshold:" };
+	constexpr std::string_view alpha_prefix{ "alpha:" };
+	constexpr std::string_view allow_host_mismatch{ "allow-host-mismatch" };
+	constexpr std::string_view array_prefix{ "array:" };
+	constexpr std::string_view script_prefix{ "script:" };
+	constexpr std::string_view engine_prefix{ "engine:" };
+	constexpr std::string_view differential{ "differential" };
+	constexpr std::string_view checkpoint_prefix{ "checkpoint:" };
+	constexpr std::string_view checkpoint_out_prefix{ "checkpoint-out:" };
+	constexpr std::string_view resume_prefix{ "resume:" };
+	constexpr std::string_view array_passes_prefix{ "array-passes:" };
+	constexpr std::string_view huge_pages{ "huge-pages" };
+	constexpr std::string_view stream_prefix{ "stream:" };
+	constexpr std::string_view stream_format_prefix{ "stream-format:" };
+	constexpr std::string_view stream_out_prefix{ "stream-out:" };
+	constexpr std::string_view columns_prefix{ "columns:" };
+	constexpr std::string_view chunk_prefix{ "chunk:" };
+	constexpr std::string_view workers_prefix{ "workers:" };
+	constexpr std::string_view memory_prefix{ "memory:" };
+	constexpr std::string_view batch_prefix{ "batch:" };
+	constexpr std::string_view batch_weights_prefix{ "batch-weights:" };
+
+	const auto to_unsigned = []( std::string_view what ) {
+		return static_cast< unsigned >( std::stoul( std::string{ what } ) );
+	};
+	const auto to_double = []( std::string_view what ) {
+		return std::stod( std::string{ what } );
+	};
+
+	args_parsing_result_t result{ help_requested_t{} };
+	if( 1 == argc )
+	{
+		// Нет смысла продолжать.
+		return result;
+	}
+
+	run_params_t run_params;
+
+	// Все указанные способы привязки. В обычном режиме используется
+	// последний из них, а в режиме `sweep` -- все.
+	std::vector< pinning_params_t > pinnings;
+
+	// Параметры массива могут идти в любом порядке, поэтому
+	// собираются отдельно.
+	std::optional< std::size_t > array_elements;
+	std::optional< unsigned > array_passes;
+	bool array_huge_pages = false;
+
+	// Пачка заданий тоже.
+	std::optional< std::size_t > batch_jobs;
+	checkpoint_params_t checkpoint;
+	std::optional< batch_weights_t > batch_weights;
+
+	// Аналогично и для потоковой обработки.
+	std::optional< std::string > stream_file;
+	std::optional< std::string > stream_format;
+	stream_params_t stream;
+
+	for( int i = 1; i < argc; ++i )
+	{
+		const std::string_view current{ argv[ i ] };
+		if( current == "-h"sv || current == "--help"sv )
+		{
+			// Нет смысла продолжать.
+			return result;
+		}
+		else if( just_pin == current )
+		{
+			// Нужен самый простой режим пиннинга, без наворотов.
+			pinnings.push_back( seq_pinning_t{} );
+		}
+		else if( no_pin == current )
+		{
+			// Явное указание на то, что привязка не нужна.
+			pinnings.push_back( no_pinning_t{} );
+		}
+		else if( current.starts_with( pin_prefix ) )
+		{
+			pinnings.push_back( try_parse_adv_pinning_mode(
+					std::string{ current.substr( pin_prefix.size() ) } ) );
+		}
+		else if( current.starts_with( sample_prefix ) )
+		{
+			run_params._sampling_period_ms = to_unsigned(
+					current.substr( sample_prefix.size() ) );
+		}
+		else if( current.starts_with( sysfs_prefix ) )
+		{
+			run_params._sysfs_root =
+					std::string{ current.substr( sysfs_prefix.size() ) };
+		}
+		else if( current.starts_with( progress_prefix ) )
+		{
+			run_params._progress_period_ms = to_unsigned(
+					current.substr( progress_prefix.size() ) );
+		}
+		else if( current.starts_with( slow_below_prefix ) )
+		{
+			run_params._slow_fraction = to_double(
+					current.substr( slow_below_prefix.size() ) );
+		}
+		else if( current.starts_with( trace_prefix ) )
+		{
+			run_params._trace_file =
+					std::string{ current.substr( trace_prefix.size() ) };
+		}
+		else if( current.starts_with( trace_loops_prefix ) )
+		{
+			run_params._trace_loops_us = to_unsigned(
+					current.substr( trace_loops_prefix.size() ) );
+		}
+		else if( huge_pages == current )
+		{
+			array_huge_pages = true;
+		}
+		else if( current.starts_with( array_passes_prefix ) )
+		{
+			array_passes = to_unsigned(
+					current.substr( array_passes_prefix.size() ) );
+		}
+		else if( current.starts_with( script_prefix ) )
+		{
+			run_params._script =
+					std::string{ current.substr( script_prefix.size() ) };
+		}
+		else if( current.starts_with( engine_prefix ) )
+		{
+			run_params._engine =
+					std::string{ current.substr( engine_prefix.size() ) };
+		}
+		else if( differential == current )
+		{
+			run_params._differential = true;
+		}
+		else if( current.starts_with( checkpoint_out_prefix ) )
+		{
+			checkpoint._output_file =
+					std::string{ current.substr( checkpoint_out_prefix.size() ) };
+		}
+		else if( current.starts_with( checkpoint_prefix ) )
+		{
+			checkpoint._pause_after_ms = to_unsigned(
+					current.substr( checkpoint_prefix.size() ) );
+		}
+		else if( current.starts_with( resume_prefix ) )
+		{
+			checkpoint._resume_file =
+					std::string{ current.substr( resume_prefix.size() ) };
+		}
+		else if( current.starts_with( array_prefix ) )
+		{
+			array_elements = static_cast< std::size_t >( std::stoull(
+					std::string{ current.substr( array_prefix.size() ) } ) );
+		}
+		else if( current.starts_with( stream_format_prefix ) )
+		{
+			stream_format =
+					std::string{ current.substr( stream_format_prefix.size() ) };
+		}
+		else if( current.starts_with( stream_out_prefix ) )
+		{
+			stream._output_file =
+					std::string{ current.substr( stream_out_prefix.size() ) };
+		}
+		else if( current.starts_with( stream_prefix ) )
+		{
+			stream_file = std::string{ current.substr( stream_prefix.size() ) };
+		}
+		else if( current.starts_with( columns_prefix ) )
+		{
+			std::string_view names = current.substr( columns_prefix.size() );
+			for(;;)
+			{
+				const auto comma = names.find( ',' );
+				stream._columns.emplace_back( names.substr( 0, comma ) );
+				if( std::string_view::npos == comma )
+					break;
+				names.remove_prefix( comma + 1u );
+			}
+		}
+		else if( current.starts_with( chunk_prefix ) )
+		{
+			stream._chunk_bytes = 1024u * static_cast< std::size_t >(
+					std::stoull( std::string{
+							current.substr( chunk_prefix.size() ) } ) );
+		}
+		else if( current.starts_with( workers_prefix ) )
+		{
+			run_params._workers.clear();
+			std::string_view kinds = current.substr( workers_prefix.size() );
+			for(;;)
+			{
+				const auto comma = kinds.find( ',' );
+				const auto kind = kinds.substr( 0, comma );
+				if( "threads"sv == kind )
+					run_params._workers.push_back( workers_kind_t::threads );
+				else if( "processes"sv == kind )
+					run_params._workers.push_back( workers_kind_t::processes );
+				else
+					throw std::runtime_error{
+							"unknown workers kind: `" + std::string{ kind } + "`" };
+				if( std::string_view::npos == comma )
+					break;
+				kinds.remove_prefix( comma + 1u );
+			}
+		}
+		else if( current.starts_with( memory_prefix ) )
+		{
+			run_params._memory.clear();
+			std::string_view kinds = current.substr( memory_prefix.size() );
+			for(;;)
+			{
+				const auto comma = kinds.find( ',' );
+				const auto kind = kinds.substr( 0, comma );
+				if( const auto k = thread_arena::from_string( kind ) )
+					run_params._memory.push_back( *k );
+				else
+					throw std::runtime_error{
+							"unknown memory kind: `" + std::string{ kind } + "`" };
+				if( std::string_view::npos == comma )
+					break;
+				kinds.remove_prefix( comma + 1u );
+			}
+		}
+		else if( current.starts_with( batch_weights_prefix ) )
+		{
+			const auto kind = current.substr( batch_weights_prefix.size() );
+			if( "measured"sv == kind )
+				batch_weights = batch_weights_t::measured;
+			else if( "sysfs"sv == kind )
+				batch_weights = batch_weights_t::sysfs;
+			else
+				throw std::runtime_error{
+						"unknown batch weights: `" + std::string{ kind } + "`" };
+		}
+		else if( current.starts_with( batch_prefix ) )
+		{
+			batch_jobs = static_cast< std::size_t >( std::stoull(
+					std::string{ current.substr( batch_prefix.size() ) } ) );
+		}
+		else if( allow_host_mismatch == current )
+		{
+			run_params._baseline._allow_host_mismatch = true;
+		}
+		else if( current.starts_with( baselines_prefix ) )
+		{
+			run_params._baseline._directory =
+					std::string{ current.substr( baselines_prefix.size() ) };
+		}
+		else if( current.starts_with( save_baseline_prefix ) )
+		{
+			run_params._baseline._save_as =
+					std::string{ current.substr( save_baseline_prefix.size() ) };
+		}
+		else if( current.starts_with( compare_baseline_prefix ) )
+		{
+			run_params._baseline._compare_with =
+					std::string{ current.substr( compare_baseline_prefix.size() ) };
+		}
+		else if( current.starts_with( threshold_prefix ) )
+		{
+			run_params._baseline._threshold_percent = to_double(
+					current.substr( threshold_prefix.size() ) );
+		}
+		else if( current.starts_with( alpha_prefix ) )
+		{
+			run_params._baseline._alpha = to_double(
+					current.substr( alpha_prefix.size() ) );
+		}
+		else if( current.starts_with( sweep_prefix ) )
+		{
+			run_params._sweep = sweep_params_t{
+					try_parse_sweep_threads_counts(
+							std::string{ current.substr( sweep_prefix.size() ) } ),
+					{}
+				};
+		}
+		else if( current.starts_with( warmup_prefix ) )
+		{
+			run_params._warmup_runs = to_unsigned(
+					current.substr( warmup_prefix.size() ) );
+		}
+		else if( current.starts_with( reps_prefix ) )
+		{
+			run_params._repetitions = to_unsigned(
+					current.substr( reps_prefix.size() ) );
+		}
+		else if( current.starts_with( json_prefix ) )
+		{
+			run_params._json_output_file =
+					std::string{ current.substr( json_prefix.size() ) };
+		}
+		else if( current.starts_with( csv_prefix ) )
+		{
+			run_params._csv_output_file =
+					std::string{ current.substr( csv_prefix.size() ) };
+		}
+		else
+		{
+			// Возможно, это количество тредов.
+			run_params._threads_count = static_cast< unsigned >(
+					std::stoul( std::string{ current } ) );
+		}
+	}
+
+	if( !pinnings.empty() )
+		run_params._pinning = pinnings.back();
+
+	if( array_elements )
+		run_params._array = array_workload_params_t{
+				*array_elements, array_passes.value_or( 1u ), array_huge_pages };
+	else if( array_passes || array_huge_pages )
+		throw std::runtime_error{
+				"array-passes and huge-pages require array:<elements>" };
+
+	if( checkpoint._pause_after_ms || checkpoint._resume_file )
+		run_params._checkpoint = std::move(checkpoint);
+	else if( checkpoint._output_file )
+		throw std::runtime_error{
+				"checkpoint-out requires checkpoint:<ms>" };
+
+	if( batch_jobs )
+		run_params._batch = batch_params_t{
+				*batch_jobs, batch_weights.value_or( batch_weights_t::measured ) };
+	else if( batch_weights )
+		throw std::runtime_error{ "batch-weights requires batch:<jobs>" };
+
+	if( stream_file )
+	{
+		stream._input_file = std::move(*stream_file);
+		if( stream_format )
+		{
+			if( "binary"sv == *stream_format )
+				stream._binary = true;
+			else if( "csv"sv != *stream_format )
+				throw std::runtime_error{
+						"unknown stream format: `" + *stream_format + "`" };
+		}
+		else
+			stream._binary = !stream._input_file.ends_with( ".csv" );
+		run_params._stream = std::move(stream);
+	}
+	else if( stream_format || stream._output_file || !stream._columns.empty() )
+		throw std::runtime_error{
+				"stream-format, stream-out and columns require stream:<file>" };
+
+	if( run_params._sweep )
+	{
+		if( pinnings.empty() )
+			pinnings.push_back( no_pinning_t{} );
+		run_params._sweep->_pinnings = std::move(pinnings);
+	}
+
+	result = std::move(run_params);
+
+	return result;
+}
+
+/// Специальный визитор для проверки корректности результата
+/// разбора аргументов командной строки.
+struct args_checker_visitor_t
+{
+	void
+	operator()( const help_requested_t & ) const
+	{
+		// Все нормально, ничего не нужно делать.
+	}
+
+	void
+	operator()( const run_params_t & params ) const
+	{
+		// В режиме `sweep` количество нитей задается перечнем.
+		// Если количество рабочих нитей не задано, то оно определяется
+		// по перечню ядер для привязки или по доступным процессу
+		// ресурсам. Но явно заданный ноль -- это ошибка.
+		if( !params._sweep && params._threads_count
+				&& 0 == params._threads_count.value() )
+		{
+			throw std::runtime_error{ "thread count can't be 0" };
+		}
+
+		if( !params._repetitions )
+			throw std::runtime_error{ "number of repetitions can't be 0" };
+
+		if( params._sampling_period_ms && 0u == *params._sampling_period_ms )
+			throw std::runtime_error{ "sampling period can't be 0" };
+
+		if( params._sweep && params._json_output_file )
+			throw std::runtime_error{
+					"JSON output isn't supported in sweep mode, use CSV" };
+
+		check_baseline_params( params );
+
+		if( params._array &&
+				(params._array->_elements < 2u || !params._array->_passes) )
+			throw std::runtime_error{
+					"array needs at least 2 elements and 1 pass" };
+
+		if( params._script && params._array )
+			throw std::runtime_error{
+					"script and array can't be combined, use script:array:N" };
+
+		if( params._stream )
+			check_stream_params( params );
+
+		check_workers( params );
+		check_memory( params );
+		check_trace( params );
+		check_progress( params );
+
+		if( params._batch )
+			check_batch_params( params );
+
+		check_engine_params( params );
+
+		if( params._checkpoint )
+			check_checkpoint_params( params );
+	}
+
+	static void
+	check_checkpoint_params( const run_params_t & params )
+	{
+		const auto & checkpoint = *params._checkpoint;
+
+		if( checkpoint._pause_after_ms && checkpoint._resume_file )
+			throw std::runtime_error{
+					"checkpoint and resume can't be combined" };
+
+		if( params._sweep || params._stream || params._batch
+				|| params._differential || params._sampling_period_ms
+				|| params._json_output_file || params._csv_output_file
+				|| params._baseline._save_as || params._baseline._compare_with
+				|| params._trace_file || params._progress_period_ms )
+			throw std::runtime_error{
+					"checkpoint and resume can't be combined with sweep, "
+					"stream, batch, differential, sample, json, csv, "
+					"baselines, trace and progress" };
+	}
+
+	static void
+	check_engine_params( const run_params_t & params )
+	{
+		// Имя проверяется здесь, чтобы ошибка в нем не обнаружилась
+		// уже после сбора сведений о системе.
+		script::engines::ensure_known( params._engine );
+
+		if( params._stream && "tree" != params._engine )
+			throw std::runtime_error{
+					"stream mode supports only the tree engine" };
+
+		if( params._differential
+				&& (params._sweep || params._stream || params._batch
+						|| params._sampling_period_ms || params._json_output_file
+						|| params._csv_output_file || params._baseline._save_as
+						|| params._baseline._compare_with || params._trace_file
+						|| params._progress_period_ms) )
+			throw std::runtime_error{
+					"differential mode can't be combined with sweep, stream, "
+					"batch, sample, json, csv, baselines, trace and progress" };
+	}
+
+	static void
+	check_progress( const run_params_t & params )
+	{
+		if( !(params._slow_fraction > 0.0 && params._slow_fraction <= 1.0) )
+			throw std::runtime_error{ "slow-below has to be in (0, 1]" };
+		if( !params._progress_period_ms )
+			return;
+
+		if( 0u == *params._progress_period_ms )
+			throw std::runtime_error{ "progress period can't be 0" };
+		if( params._stream )
+			throw std::runtime_error{
+					"progress isn't supported in stream mode" };
+		for( const auto w : params._workers )
+			if( workers_kind_t::threads != w )
+				throw std::runtime_error{
+						"progress is supported only for threads as workers" };
+	}
+
+	static void
+	check_trace( const run_params_t & params )
+	{
+		if( params._trace_loops_us && !params._trace_file )
+			throw std::runtime_error{ "trace-loops requires trace:<file>" };
+		if( !params._trace_file )
+			return;
+
+		if( params._trace_file->empty() )
+			throw std::runtime_error{ "trace file name can't be empty" };
+		if( params._sweep || params._stream )
+			throw std::runtime_error{
+					"trace isn't supported in sweep and stream modes" };
+		if( workers_kind_t::threads != params._workers.front() )
+			throw std::runtime_error{
+					"trace is supported only for threads as workers" };
+	}
+
+	static void
+	check_workers( const run_params_t & params )
+	{
+		const auto & workers = params._workers;
+		if( workers.empty() )
+			throw std::runtime_error{ "workers kind has to be specified" };
+		if( 2u == workers.size() && workers[ 0 ] == workers[ 1 ] )
+			throw std::runtime_error{ "workers kinds must not repeat" };
+		if( workers.size() > 2u || (!params._sweep && workers.size() > 1u) )
+			throw std::runtime_error{
+					"several workers kinds are allowed only in sweep mode" };
+		if( params._stream && workers_kind_t::threads != workers.front() )
+			throw std::runtime_error{
+					"stream mode supports only threads as workers" };
+	}
+
+	static void
+	check_memory( const run_params_t & params )
+	{
+		const auto & memory = params._memory;
+		if( memory.empty() )
+			throw std::runtime_error{ "memory kind has to be specified" };
+		for( std::size_t i = 0; i != memory.size(); ++i )
+			for( std::size_t j = i + 1u; j != memory.size(); ++j )
+				if( memory[ i ] == memory[ j ] )
+					throw std::runtime_error{ "memory kinds must not repeat" };
+		if( !params._sweep && memory.size() > 1u )
+			throw std::runtime_error{
+					"several memory kinds are allowed only in sweep mode" };
+		if( params._stream
+				&& thread_arena::arena_kind_t::global_heap != memory.front() )
+			throw std::runtime_error{
+					"stream mode supports only malloc as memory kind" };
+	}
+
+	static void
+	check_stream_params( const run_params_t & params )
+	{
+		const auto & stream = *params._stream;
+
+		if( params._sweep || params._array || params._script
+				|| params._sampling_period_ms
+				|| params._json_output_file || params._csv_output_file
+				|| params._baseline._save_as || params._baseline._compare_with )
+			throw std::runtime_error{
+					"stream mode can't be combined with sweep, array, script, "
+					"sample, json, csv and baselines" };
+
+		if( stream._binary && stream._columns.empty() )
+			throw std::runtime_error{
+					"column names are required for binary stream input" };
+		if( !stream._binary && !stream._columns.empty() )
+			throw std::runtime_error{
+					"column names are taken from the CSV header" };
+		for( const auto & c : stream._columns )
+			if( c.empty() )
+				throw std::runtime_error{ "column name can't be empty" };
+
+		if( !stream._chunk_bytes )
+			throw std::runtime_error{ "chunk size can't be 0" };
+	}
+
+	static void
+	check_batch_params( const run_params_t & params )
+	{
+		if( params._sweep || params._stream || params._sampling_period_ms
+				|| params._json_output_file || params._csv_output_file
+				|| params._baseline._save_as || params._baseline._compare_with
+				|| params._trace_file || params._progress_period_ms )
+			throw std::runtime_error{
+					"batch mode can't be combined with sweep, stream, sample, "
+					"json, csv, baselines, trace and progress" };
+
+		if( workers_kind_t::threads != params._workers.front()
+				|| thread_arena::arena_kind_t::global_heap
+						!= params._memory.front() )
+			throw std::runtime_error{
+					"batch mode supports only threads as workers and malloc "
+					"as memory kind" };
+
+		if( !params._batch->_jobs )
+			throw std::runtime_error{ "number of batch jobs can't be 0" };
+	}
+
+	static void
+	check_baseline_params( const run_params_t & params )
+	{
+		const auto & baseline = params._baseline;
+
+		const auto check_name = []( const std::optional< std::string > & name ) {
+			if( name && (name->empty()
+					|| std::string::npos != name->find_first_of( "/\\" )) )
+				throw std::runtime_error{
+						"invalid baseline name: `" + *name + "`" };
+		};
+		check_name( baseline._save_as );
+		check_name( baseline._compare_with );
+
+		if( params._sweep && (baseline._save_as || baseline._compare_with) )
+			throw std::runtime_error{
+					"baselines aren't supported in sweep mode" };
+
+		if( baseline._threshold_percent < 0.0 )
+			throw std::runtime_error{ "regression threshold can't be negative" };
+
+		if( baseline._alpha <= 0.0 || baseline._alpha >= 1.0 )
+			throw std::runtime_error{ "alpha has to be in range (0, 1)" };
+	}
+};
+
+/// Проверить корректность аргументов.
+///
+/// Бросает исключение в случае ошибки.
+void
+ensure_valid_params( const args_parsing_result_t & params )
+{
+	std::visit( args_checker_visitor_t{}, params );
+}
+
+} /* namespace anonymous */
+
+[[nodiscard]]
+std::string
+to_string( const pinning_params_t & pinning )
+{
+	struct visitor_t
+	{
+		[[nodiscard]] std::string
+		operator()( const no_pinning_t & ) const
+		{
+			return "none";
+		}
+
+		[[nodiscard]] std::string
+		operator()( const seq_pinning_t & params ) const
+		{
+			if( params._fastest_first )
+				return "seq:fast";
+			return "seq:" + std::to_string( params._start_from ) + "+";
+		}
+
+		[[nodiscard]] std::string
+		operator()( const selective_pinning_t & params ) const
+		{
+			std::string result{ "selected:" };
+			for( std::size_t i = 0; i != params._cores.size(); ++i )
+			{
+				if( i )
+					result += ',';
+				result += std::to_string( params._cores[ i ] );
+			}
+			return result;
+		}
+	};
+
+	return std::visit( visitor_t{}, pinning );
+}
+
+[[nodiscard]]
+const char *
+to_string( workers_kind_t kind ) noexcept
+{
+	return workers_kind_t::processes == kind ? "processes" : "threads";
+}
+
+/// Разобрать коммандную строку и получить параметры для работы.
+[[nodiscard]]
+args_parsing_result_t
+parse_cmd_line_args( int argc, char ** argv )
+{
+	const auto parsing_result = try_parse_cmd_line_args( argc, argv );
+	ensure_valid_params( parsing_result );
+	return parsing_result;
+}
+
+[[nodiscard]]
+scenario_t
+parse_scenario_file( const std::string & file_name )
+{
+	std::ifstream file{ file_name };
+	if( !file )
+		throw std::runtime_error{ "unable to open scenario file: " + file_name };
+
+	scenario_t result;
+
+	std::string line;
+	for( unsigned line_number = 1u; std::getline( file, line ); ++line_number )
+	{
+		const auto fail = [&]( const std::string & what ) {
+			throw std::runtime_error{ file_name + ":"
+					+ std::to_string( line_number ) + ": " + what };
+		};
+
+		const auto first = line.find_first_not_of( " \t\r" );
+		if( std::string::npos == first || '#' == line[ first ] )
+			continue;
+
+		const auto colon = line.find( ':' );
+		if( std::string::npos == colon )
+			fail( "`<axis>: <values>` expected" );
+
+		std::string key = line.substr( first, colon - first );
+		key.erase( key.find_last_not_of( " \t" ) + 1u );
+
+		std::vector< std::string > values;
+		{
+			std::istringstream stream{ line.substr( colon + 1u ) };
+			for( std::string v; stream >> v; )
+				values.push_back( std::move(v) );
+		}
+		if( values.empty() )
+			fail( "no values for `" + key + "`" );
+
+		const auto to_unsigned = [&]( const std::string & v ) {
+			if( v.empty() || std::string::npos != v.find_first_not_of( "0123456789" ) )
+				fail( "unsigned number expected: `" + v + "`" );
+			return static_cast< unsigned >( std::stoul( v ) );
+		};
+		const auto single = [&] {
+			if( 1u != values.size() )
+				fail( "exactly one value expected for `" + key + "`" );
+			return values.front();
+		};
+
+		try
+		{
+			if( "script" == key )
+				result._scripts = values;
+			else if( "type" == key )
+			{
+				for( const auto & v : values )
+					if( "int" != v && "double" != v )
+						fail( "unknown value type: `" + v + "`" );
+				result._value_types = values;
+			}
+			else if( "engine" == key )
+				result._engines = values;
+			else if( "threads" == key )
+			{
+				std::string joined;
+				for( const auto & v : values )
+					joined += (joined.empty() ? "" : ",") + v;
+				result._threads_counts = try_parse_sweep_threads_counts( joined );
+			}
+			else if( "pinning" == key )
+			{
+				result._pinnings.clear();
+				for( const auto & v : values )
+				{
+					if( "nopin" == v )
+						result._pinnings.push_back( no_pinning_t{} );
+					else if( "pin" == v )
+						result._pinnings.push_back( seq_pinning_t{} );
+					else if( v.starts_with( "pin:" ) )
+						result._pinnings.push_back(
+								try_parse_adv_pinning_mode( v.substr( 4u ) ) );
+					else
+						fail( "unknown pinning: `" + v + "`" );
+				}
+			}
+			else if( "reps" == key )
+			{
+				result._repetitions.clear();
+				for( const auto & v : values )
+					if( !result._repetitions.emplace_back( to_unsigned( v ) ) )
+						fail( "number of repetitions can't be 0" );
+			}
+			else if( "warmup" == key )
+				result._warmup_runs = to_unsigned( single() );
+			else if( "sysfs" == key )
+				result._sysfs_root = single();
+			else if( "csv" == key )
+				result._csv_output_file = single();
+			else
+				fail( "unknown axis: `" + key + "`" );
+		}
+		catch( const std::invalid_argument & x )
+		{
+			fail( x.what() );
+		}
+		catch( const std::out_of_range & x )
+		{
+			fail( x.what() );
+		}
+	}
+
+	return result;
+}
+
+} /* namespace run_params */
+
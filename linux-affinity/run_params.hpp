@@ -0,0 +1,376 @@
+#pragma once
+
+#include "../common/thread_arena.hpp"
+
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace run_params
+{
+
+/// Тип для представления индекса ядра.
+using core_index_t = unsigned int;
+
+/// Для случая, когда привязываться вообще не нужно.
+struct no_pinning_t
+{};
+
+/// Для случая, когда нужно привязывать к имеющимся ядрам
+/// последовательно.
+struct seq_pinning_t
+{
+	/// С какого ядра начинать.
+	core_index_t _start_from{};
+
+	/// Нужно ли сперва занимать самые производительные ядра (P-ядра
+	/// гибридных процессоров).
+	bool _fastest_first{ false };
+};
+
+/// Для случая, когда нужно привязывать к конкретным ядрам.
+struct selective_pinning_t
+{
+	std::vector< core_index_t > _cores;
+};
+
+/// Информация о том, нужно ли привязывать рабочие нити к конкретным
+/// ядрам или нет.
+using pinning_params_t = std::variant<
+		no_pinning_t,
+		seq_pinning_t,
+		selective_pinning_t
+	>;
+
+/// Параметры для режима прогона с разным количеством рабочих нитей.
+struct sweep_params_t
+{
+	/// Для какого количества нитей нужно выполнять замеры.
+	///
+	/// Значения идут в порядке возрастания и не повторяются.
+	std::vector< unsigned > _threads_counts;
+
+	/// Какие способы привязки нужно проверить.
+	///
+	/// Для каждого способа привязки выполняется прогон для всех
+	/// значений из _threads_counts.
+	std::vector< pinning_params_t > _pinnings;
+};
+
+/// Параметры для выполнения скрипта, работающего с массивом,
+/// вместо обычного демо-скрипта.
+struct array_workload_params_t
+{
+	/// Количество элементов массива у каждой рабочей нити.
+	std::size_t _elements{};
+
+	/// Сколько раз массив обрабатывается целиком.
+	unsigned _passes{ 1 };
+
+	/// Нужно ли размещать массив в huge pages.
+	bool _huge_pages{ false };
+};
+
+/// Параметры для потоковой обработки записей из входного файла.
+struct stream_params_t
+{
+	/// Входной файл.
+	std::string _input_file;
+
+	/// Является ли входной файл бинарным (иначе -- CSV).
+	bool _binary{ false };
+
+	/// Имена колонок для бинарного файла.
+	///
+	/// Для CSV имена колонок берутся из заголовка.
+	std::vector< std::string > _columns{};
+
+	/// Файл для сохранения значений выходных переменных в формате CSV.
+	///
+	/// Если пусто, то значения не сохраняются.
+	std::optional< std::string > _output_file{};
+
+	/// Размер фрагмента входных данных в байтах.
+	std::size_t _chunk_bytes{ 1024u * 1024u };
+};
+
+/// Откуда брать производительность ядер при разделении пачки заданий.
+enum class batch_weights_t
+{
+	/// По времени выполнения одного задания на каждом ядре
+	/// (калибровочный прогон).
+	measured,
+	/// По классам ядер из sysfs (cpu_capacity или cpuinfo_max_freq).
+	sysfs
+};
+
+/// Параметры для выполнения пачки заданий, разделенной между рабочими
+/// нитями пропорционально производительности их ядер.
+struct batch_params_t
+{
+	/// Сколько раз нужно выполнить скрипт всеми нитями в сумме.
+	std::size_t _jobs{};
+
+	batch_weights_t _weights{ batch_weights_t::measured };
+};
+
+/// Параметры приостановки выполнения скрипта и его продолжения со
+/// снимка (см. checkpoint.hpp).
+struct checkpoint_params_t
+{
+	/// Через сколько миллисекунд после старта приостановить скрипт.
+	///
+	/// Если пусто, то выполнение продолжается со снимка из
+	/// _resume_file.
+	std::optional< unsigned > _pause_after_ms{};
+
+	/// Куда записать снимок. Если пусто, то выполнение сразу
+	/// продолжается со снимка в другой нити.
+	std::optional< std::string > _output_file{};
+
+	/// Откуда взять снимок для продолжения выполнения.
+	std::optional< std::string > _resume_file{};
+};
+
+/// Параметры для сохранения результатов в качестве эталона и
+/// сравнения с ранее сохраненным эталоном.
+struct baseline_params_t
+{
+	/// Каталог, в котором хранятся эталоны.
+	std::string _directory{ "baselines" };
+
+	/// Под каким именем сохранить результаты как эталон.
+	///
+	/// Если пусто, то результаты как эталон не сохраняются.
+	std::optional< std::string > _save_as{};
+
+	/// С каким эталоном нужно сравнить результаты.
+	///
+	/// Если пусто, то сравнение не выполняется.
+	std::optional< std::string > _compare_with{};
+
+	/// На сколько процентов должна ухудшиться медиана, чтобы
+	/// это считалось регрессией.
+	double _threshold_percent{ 5.0 };
+
+	/// Уровень значимости для проверки различий.
+	double _alpha{ 0.05 };
+
+	/// Разрешено ли сравнивать с эталоном, полученным на другом железе.
+	bool _allow_host_mismatch{ false };
+};
+
+/// Получить текстовое описание способа привязки.
+///
+/// Используется при сохранении конфигурации запуска вместе с результатами.
+[[nodiscard]]
+std::string
+to_string( const pinning_params_t & pinning );
+
+/// Чем являются рабочие, выполняющие скрипт.
+enum class workers_kind_t
+{
+	/// Рабочие нити одного процесса.
+	threads,
+	/// Отдельные процессы, созданные через fork. У каждого свое
+	/// адресное пространство, свой аллокатор и свои таблицы страниц.
+	processes
+};
+
+/// Получить текстовое описание вида рабочих.
+[[nodiscard]]
+const char *
+to_string( workers_kind_t kind ) noexcept;
+
+/// Информация о том, сколько нитей нужно создать и к каким ядрам их
+/// нужно привязывать (если вообще нужно).
+struct run_params_t
+{
+	/// Сколько рабочих нитей нужно создать.
+	///
+	/// Может отсутствовать если задан selective_pinning_t с
+	/// перечнем конкретных ядер.
+	std::optional< unsigned > _threads_count{};
+
+	/// Нужно ли привязывать нити к ядрам и если нужно то как именно.
+	pinning_params_t _pinning{ no_pinning_t{} };
+
+	/// Какими рабочими выполнять скрипт.
+	///
+	/// В режиме `sweep` может быть задано оба вида, тогда замеры
+	/// выполняются для каждого из них. В остальных режимах -- только
+	/// один вид.
+	std::vector< workers_kind_t > _workers{ workers_kind_t::threads };
+
+	/// Откуда рабочие берут память под скрипт и контекст выполнения.
+	///
+	/// Как и для _workers, несколько вариантов можно задать только
+	/// в режиме `sweep`.
+	std::vector< thread_arena::arena_kind_t > _memory{
+			thread_arena::arena_kind_t::global_heap };
+
+	/// Сколько прогонов нужно сделать для прогрева.
+	///
+	/// Результаты этих прогонов в статистику не попадают.
+	unsigned _warmup_runs{ 0 };
+
+	/// Сколько прогонов нужно сделать для сбора статистики.
+	unsigned _repetitions{ 1 };
+
+	/// Имя файла для сохранения результатов в формате JSON.
+	///
+	/// Если пусто, то результаты в JSON не сохраняются.
+	std::optional< std::string > _json_output_file{};
+
+	/// Имя файла для сохранения сводной статистики в формате CSV.
+	///
+	/// Если пусто, то результаты в CSV не сохраняются.
+	std::optional< std::string > _csv_output_file{};
+
+	/// Период опроса частоты процессоров и термозон в миллисекундах.
+	///
+	/// Если пусто, то опрос не выполняется.
+	std::optional< unsigned > _sampling_period_ms{};
+
+	/// Корень sysfs для опроса частоты процессоров и термозон.
+	std::string _sysfs_root{ "/sys" };
+
+	/// Период опроса счетчиков продвижения рабочих нитей в
+	/// миллисекундах.
+	///
+	/// Если пусто, то продвижение не отслеживается.
+	std::optional< unsigned > _progress_period_ms{};
+
+	/// Доля от медианной пропускной способности нити, ниже которой
+	/// интервал считается медленным.
+	double _slow_fraction{ 0.8 };
+
+	/// Имя файла для временной шкалы работы нитей в формате Chrome
+	/// trace events.
+	///
+	/// Если пусто, то временная шкала не записывается.
+	std::optional< std::string > _trace_file{};
+
+	/// Порог продолжительности циклов while_loop_t в микросекундах,
+	/// начиная с которого циклы попадают на временную шкалу.
+	///
+	/// Если пусто, то циклы не записываются.
+	std::optional< unsigned > _trace_loops_us{};
+
+	/// Параметры для режима прогона с разным количеством нитей.
+	///
+	/// Если пусто, то выполняется обычный прогон с _threads_count
+	/// нитями и привязкой _pinning.
+	std::optional< sweep_params_t > _sweep{};
+
+	/// Параметры работы с эталонами.
+	baseline_params_t _baseline{};
+
+	/// Параметры скрипта для работы с массивом.
+	///
+	/// Если пусто, то выполняется обычный демо-скрипт.
+	std::optional< array_workload_params_t > _array{};
+
+	/// Имя скрипта из библиотеки (см. script_library.hpp).
+	///
+	/// Если пусто, то выполняется демо-скрипт или скрипт для работы
+	/// с массивом.
+	std::optional< std::string > _script{};
+
+	/// Параметры потоковой обработки записей.
+	///
+	/// Если пусто, то выполняется обычный прогон скрипта.
+	std::optional< stream_params_t > _stream{};
+
+	/// Параметры выполнения пачки заданий.
+	///
+	/// Если пусто, то каждая нить выполняет скрипт один раз.
+	std::optional< batch_params_t > _batch{};
+
+	/// Чем выполнять скрипт (см. engines.hpp).
+	std::string _engine{ "tree" };
+
+	/// Нужно ли вместо замеров сравнить результаты и скорость всех
+	/// движков.
+	bool _differential{ false };
+
+	/// Параметры приостановки и продолжения выполнения.
+	///
+	/// Если пусто, то скрипт выполняется без остановок.
+	std::optional< checkpoint_params_t > _checkpoint{};
+};
+
+/// Индикатор того, что была запрошена помощь по параметрам командной строки.
+struct help_requested_t
+{};
+
+/// Тип для результата разбора командной строки.
+using args_parsing_result_t = std::variant<
+		help_requested_t,
+		run_params_t
+	>;
+
+/// Разобрать коммандную строку и получить параметры для работы.
+[[nodiscard]]
+args_parsing_result_t
+parse_cmd_line_args( int argc, char ** argv );
+
+/// Описание матрицы замеров из файла сценария.
+///
+/// Каждое поле -- ось матрицы. Выполняются все сочетания значений
+/// осей (декартово произведение).
+struct scenario_t
+{
+	/// Имена скриптов из библиотеки (см. script_library.hpp).
+	std::vector< std::string > _scripts{ "demo" };
+
+	/// Типы значений: `int` и/или `double`.
+	std::vector< std::string > _value_types{ "int" };
+
+	/// Чем выполнять скрипт.
+	std::vector< std::string > _engines{ "tree" };
+
+	/// Количество рабочих нитей.
+	std::vector< unsigned > _threads_counts{ 1u };
+
+	/// Способы привязки нитей к ядрам.
+	std::vector< pinning_params_t > _pinnings{ no_pinning_t{} };
+
+	/// Количество замеряемых прогонов.
+	std::vector< unsigned > _repetitions{ 1u };
+
+	/// Сколько прогонов нужно сделать для прогрева перед каждым
+	/// сочетанием.
+	unsigned _warmup_runs{ 0 };
+
+	/// Корень sysfs.
+	std::string _sysfs_root{ "/sys" };
+
+	/// Файл для сохранения сводной таблицы в формате CSV.
+	std::optional< std::string > _csv_output_file{};
+};
+
+/// Прочитать файл сценария.
+///
+/// Формат: строки вида `<ось>: <значение> <значение> ...`, пустые
+/// строки и строки, начинающиеся с `#`, пропускаются. Например:
+///
+/// \code
+/// script: demo array:200000 vars:4096
+/// type: int double
+/// engine: tree bytecode
+/// threads: 1-4,8
+/// pinning: nopin pin pin:fast pin:0,2,4
+/// reps: 5
+/// warmup: 1
+/// csv: nightly.csv
+/// \endcode
+///
+/// Значения `pinning` записываются так же, как в командной строке.
+[[nodiscard]]
+scenario_t
+parse_scenario_file( const std::string & file_name );
+
+} /* namespace run_params */
+
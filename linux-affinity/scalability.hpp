@@ -0,0 +1,409 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace scalability
+{
+
+/// Результат замеров для одного количества нитей.
+struct point_t
+{
+	/// Количество рабочих нитей.
+	unsigned _threads{};
+
+	/// Медиана времени работы самой медленной нити, в секундах.
+	double _seconds{};
+
+	/// Пропускная способность: итераций цикла скрипта в секунду
+	/// суммарно по всем нитям.
+	double _throughput{};
+
+	/// Ускорение относительно самого маленького количества нитей.
+	double _speedup{};
+
+	/// Эффективность распараллеливания (_speedup / _threads).
+	double _efficiency{};
+};
+
+/// Коэффициенты модели масштабируемости.
+///
+/// Модель описывается формулой Universal Scalability Law:
+///
+/// S(n) = n / (1 + alpha*(n-1) + beta*n*(n-1))
+///
+/// Закон Амдала является частным случаем с beta=0, при этом
+/// alpha -- это доля последовательной части работы.
+struct model_t
+{
+	/// Коэффициент конкуренции (contention).
+	double _alpha{};
+
+	/// Коэффициент когерентности (coherence).
+	double _beta{};
+
+	/// Коэффициент детерминации по предсказанным значениям ускорения.
+	double _r_squared{};
+
+	/// Предсказанное моделью ускорение для n нитей.
+	[[nodiscard]] double
+	predict( double n ) const
+	{
+		return n / (1.0 + _alpha * (n - 1.0) + _beta * n * (n - 1.0));
+	}
+};
+
+/// Серия замеров для одного способа привязки.
+struct series_t
+{
+	/// Описание способа привязки.
+	std::string _pinning;
+
+	/// Чем были рабочие: нитями или процессами.
+	std::string _workers;
+
+	/// Откуда рабочие брали память.
+	std::string _memory;
+
+	std::vector< point_t > _points;
+
+	/// Аппроксимация законом Амдала (нужно хотя бы 2 точки).
+	std::optional< model_t > _amdahl;
+
+	/// Аппроксимация USL (нужно хотя бы 3 точки).
+	std::optional< model_t > _usl;
+};
+
+namespace impl
+{
+
+[[nodiscard]] inline double
+r_squared( const std::vector< point_t > & points, const model_t & model )
+{
+	double mean{};
+	for( const auto & p : points )
+		mean += p._speedup;
+	mean /= static_cast< double >( points.size() );
+
+	double ss_res{};
+	double ss_tot{};
+	for( const auto & p : points )
+	{
+		const double predicted = model.predict( p._threads );
+		ss_res += (p._speedup - predicted) * (p._speedup - predicted);
+		ss_tot += (p._speedup - mean) * (p._speedup - mean);
+	}
+
+	return ss_tot > 0.0 ? 1.0 - ss_res / ss_tot : 1.0;
+}
+
+} /* namespace impl */
+
+/// Аппроксимация законом Амдала.
+///
+/// Используется линеаризация n/S(n) - 1 = alpha*(n-1), после чего
+/// alpha находится методом наименьших квадратов.
+[[nodiscard]] inline std::optional< model_t >
+fit_amdahl( const std::vector< point_t > & points )
+{
+	if( points.size() < 2u )
+		return std::nullopt;
+
+	double sxy{};
+	double sxx{};
+	for( const auto & p : points )
+	{
+		const double n = p._threads;
+		const double x = n - 1.0;
+		const double y = n / p._speedup - 1.0;
+		sxy += x * y;
+		sxx += x * x;
+	}
+	if( sxx <= 0.0 )
+		return std::nullopt;
+
+	model_t result;
+	result._alpha = std::max( 0.0, sxy / sxx );
+	result._r_squared = impl::r_squared( points, result );
+	return result;
+}
+
+/// Аппроксимация законом USL.
+///
+/// Используется линеаризация n/S(n) - 1 = alpha*(n-1) + beta*n*(n-1),
+/// после чего alpha и beta находятся методом наименьших квадратов.
+/// Отрицательные коэффициенты не имеют физического смысла, поэтому
+/// в таком случае коэффициент обнуляется, а второй пересчитывается.
+[[nodiscard]] inline std::optional< model_t >
+fit_usl( const std::vector< point_t > & points )
+{
+	if( points.size() < 3u )
+		return std::nullopt;
+
+	double s11{}, s12{}, s22{}, s1y{}, s2y{};
+	for( const auto & p : points )
+	{
+		const double n = p._threads;
+		const double x1 = n - 1.0;
+		const double x2 = n * (n - 1.0);
+		const double y = n / p._speedup - 1.0;
+		s11 += x1 * x1;
+		s12 += x1 * x2;
+		s22 += x2 * x2;
+		s1y += x1 * y;
+		s2y += x2 * y;
+	}
+
+	const double det = s11 * s22 - s12 * s12;
+	if( std::abs( det ) < 1e-12 )
+		return std::nullopt;
+
+	model_t result;
+	result._alpha = (s1y * s22 - s2y * s12) / det;
+	result._beta = (s2y * s11 - s1y * s12) / det;
+
+	if( result._alpha < 0.0 )
+	{
+		result._alpha = 0.0;
+		result._beta = s22 > 0.0 ? std::max( 0.0, s2y / s22 ) : 0.0;
+	}
+	else if( result._beta < 0.0 )
+	{
+		result._beta = 0.0;
+		result._alpha = s11 > 0.0 ? std::max( 0.0, s1y / s11 ) : 0.0;
+	}
+
+	result._r_squared = impl::r_squared( points, result );
+	return result;
+}
+
+/// Сформировать серию по результатам замеров.
+///
+/// Точки должны идти в порядке возрастания количества нитей.
+/// Базой для вычисления ускорения является первая точка: считается,
+/// что на ней каждая нить работает с идеальной эффективностью.
+[[nodiscard]] inline series_t
+make_series(
+	std::string pinning,
+	std::string workers,
+	std::string memory,
+	const std::vector< unsigned > & threads,
+	const std::vector< double > & seconds,
+	long long iterations_per_thread )
+{
+	series_t result;
+	result._pinning = std::move(pinning);
+	result._workers = std::move(workers);
+	result._memory = std::move(memory);
+
+	for( std::size_t i = 0; i != threads.size(); ++i )
+	{
+		point_t p;
+		p._threads = threads[ i ];
+		p._seconds = seconds[ i ];
+		p._throughput = p._seconds > 0.0 ?
+				static_cast< double >( iterations_per_thread ) * p._threads
+						/ p._seconds
+				: 0.0;
+		result._points.push_back( p );
+	}
+
+	if( !result._points.empty() && result._points.front()._throughput > 0.0 )
+	{
+		const auto & base = result._points.front();
+		const double per_thread_base = base._throughput / base._threads;
+		for( auto & p : result._points )
+		{
+			p._speedup = p._throughput / per_thread_base;
+			p._efficiency = p._speedup / p._threads;
+		}
+
+		result._amdahl = fit_amdahl( result._points );
+		result._usl = fit_usl( result._points );
+	}
+
+	return result;
+}
+
+namespace impl
+{
+
+inline void
+print_model(
+	std::ostream & to,
+	const char * name,
+	const std::optional< model_t > & model )
+{
+	to << "  " << name << ": ";
+	if( !model )
+	{
+		to << "not enough points" << std::endl;
+		return;
+	}
+
+	to << "alpha=" << model->_alpha;
+	if( model->_beta > 0.0 )
+	{
+		to << " beta=" << model->_beta
+				<< " peak at n=" << std::sqrt( (1.0 - model->_alpha) / model->_beta );
+	}
+	to << " R^2=" << model->_r_squared << std::endl;
+}
+
+} /* namespace impl */
+
+/// Печать результатов в виде таблицы.
+inline void
+print_series( std::ostream & to, const series_t & series )
+{
+	to << "scalability for pinning `" << series._pinning << "`, workers: "
+		<< series._workers << ", memory: " << series._memory << "\n"
+		<< "  threads     seconds    iters/sec   speedup  efficiency"
+			"   amdahl      usl\n";
+
+	for( const auto & p : series._points )
+	{
+		to << "  " << std::setw( 7 ) << p._threads
+				<< std::fixed
+				<< std::setw( 12 ) << std::setprecision( 6 ) << p._seconds
+				<< std::scientific
+				<< std::setw( 13 ) << std::setprecision( 4 ) << p._throughput
+				<< std::fixed << std::setprecision( 3 )
+				<< std::setw( 10 ) << p._speedup
+				<< std::setw( 12 ) << p._efficiency;
+
+		to << std::setw( 9 );
+		if( series._amdahl )
+			to << series._amdahl->predict( p._threads );
+		else
+			to << "-";
+
+		to << std::setw( 9 );
+		if( series._usl )
+			to << series._usl->predict( p._threads );
+		else
+			to << "-";
+
+		to << std::defaultfloat << "\n";
+	}
+
+	to << std::setprecision( 6 );
+	impl::print_model( to, "Amdahl (alpha = serial fraction)", series._amdahl );
+	impl::print_model( to, "USL (alpha = contention, beta = coherence)",
+			series._usl );
+}
+
+/// Сравнение серий, полученных при одном и том же способе привязки,
+/// но с разными рабочими (нити или процессы) или разными источниками
+/// памяти (malloc или арены).
+///
+/// Базой служит первая серия для каждого способа привязки, с ней
+/// сравниваются все остальные. Для каждого количества рабочих,
+/// замеренного в обеих сериях, печатается отношение времени серии ко
+/// времени базы: значения меньше единицы означают, что серия
+/// справилась быстрее (например, из-за отсутствия общего аллокатора).
+inline void
+print_comparison(
+	std::ostream & to,
+	const std::vector< series_t > & all_series )
+{
+	const auto label = []( const series_t & s ) {
+		return s._workers + "/" + s._memory;
+	};
+
+	for( std::size_t b = 0; b != all_series.size(); ++b )
+	{
+		const auto & base = all_series[ b ];
+
+		// База -- только первая серия с таким способом привязки.
+		bool is_first = true;
+		for( std::size_t i = 0; i != b; ++i )
+			if( all_series[ i ]._pinning == base._pinning )
+				is_first = false;
+		if( !is_first )
+			continue;
+
+		for( std::size_t o = b + 1u; o != all_series.size(); ++o )
+		{
+			const auto & other = all_series[ o ];
+			if( other._pinning != base._pinning )
+				continue;
+
+			to << label( other ) << " vs " << label( base )
+				<< " for pinning `" << base._pinning << "`:\n"
+				<< "  workers     base,s    other,s  ratio  speedup(b)"
+					"  speedup(o)\n";
+			for( const auto & p : base._points )
+				for( const auto & q : other._points )
+					if( p._threads == q._threads )
+						to << "  " << std::setw( 7 ) << p._threads
+								<< std::fixed << std::setprecision( 6 )
+								<< std::setw( 11 ) << p._seconds
+								<< std::setw( 11 ) << q._seconds
+								<< std::setprecision( 3 )
+								<< std::setw( 7 )
+								<< (p._seconds > 0.0 ? q._seconds / p._seconds : 0.0)
+								<< std::setw( 12 ) << p._speedup
+								<< std::setw( 12 ) << q._speedup
+								<< std::defaultfloat << "\n";
+		}
+	}
+	to << std::flush;
+}
+
+/// Сохранение всех серий в формате CSV для построения графиков.
+///
+/// Для каждой точки сохраняются также коэффициенты моделей и
+/// предсказанные ими значения ускорения.
+inline void
+write_csv(
+	const std::string & file_name,
+	const std::string & value_type,
+	const std::vector< series_t > & all_series )
+{
+	std::ofstream file{ file_name, std::ios::out | std::ios::trunc };
+	if( !file )
+		throw std::runtime_error{ "unable to open output file: " + file_name };
+
+	file << std::setprecision( 9 );
+	file << "value_type,pinning,workers,memory,threads,seconds,throughput,speedup,"
+			"efficiency,"
+			"amdahl_alpha,amdahl_speedup,usl_alpha,usl_beta,usl_speedup\n";
+
+	for( const auto & series : all_series )
+		for( const auto & p : series._points )
+		{
+			file << value_type << ",\"" << series._pinning << "\","
+					<< series._workers << ','
+					<< series._memory << ','
+					<< p._threads << ','
+					<< p._seconds << ','
+					<< p._throughput << ','
+					<< p._speedup << ','
+					<< p._efficiency << ',';
+
+			if( series._amdahl )
+				file << series._amdahl->_alpha << ','
+						<< series._amdahl->predict( p._threads ) << ',';
+			else
+				file << ",,";
+
+			if( series._usl )
+				file << series._usl->_alpha << ','
+						<< series._usl->_beta << ','
+						<< series._usl->predict( p._threads );
+			else
+				file << ",,";
+
+			file << '\n';
+		}
+}
+
+} /* namespace scalability */
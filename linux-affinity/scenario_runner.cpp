@@ -0,0 +1,477 @@
+#include "do_work.hpp"
+
+#include <condition_variable>
+#include <latch>
+#include <mutex>
+#include <syncstream>
+
+namespace scenario_runner
+{
+
+using linux_affinity::impl::workload_t;
+
+using cores_t = std::vector< std::optional< run_params::core_index_t > >;
+
+/// Рабочие нити, которые создаются один раз и выполняют все сочетания
+/// сценария.
+///
+/// Перед каждым заданием нить привязывается к своему ядру или, если
+/// привязка не нужна, возвращается к маске всего процесса.
+class worker_pool_t
+{
+public:
+	/// Задание, которое выполняется каждой из задействованных нитей.
+	///
+	/// Получает индекс нити и описание ошибки привязки к ядру. Задание
+	/// вызывается и тогда, когда привязка не удалась: оно должно хотя
+	/// бы прибыть к общему барьеру, иначе остальные нити никогда не
+	/// стартуют.
+	using task_t = std::function< void(
+			std::size_t, const std::optional< std::string > & ) >;
+
+private:
+	/// Маска процесса на момент создания нитей.
+	cpu_set_t _process_mask;
+
+	std::mutex _lock;
+	std::condition_variable _wakeup_cv;
+	std::condition_variable _done_cv;
+
+	/// Номер текущего задания. Нити просыпаются при его изменении.
+	std::uint64_t _generation{};
+
+	/// Параметры текущего задания.
+	const task_t * _task{};
+	const cores_t * _cores{};
+
+	/// Сколько задействованных нитей уже закончили текущее задание.
+	std::size_t _finished{};
+
+	bool _shutdown{ false };
+
+	std::vector< std::jthread > _threads;
+
+	void
+	apply_affinity( std::optional< run_params::core_index_t > core )
+	{
+		if( core )
+			linux_affinity::impl::pin_to_core( *core );
+		else if( const int rc = pthread_setaffinity_np( pthread_self(),
+				sizeof(_process_mask), &_process_mask ); 0 != rc )
+			throw std::runtime_error{
+					std::string{ "pthread_setaffinity_np failed, error: " }
+					+ std::strerror( rc ) };
+	}
+
+	void
+	body( std::size_t index )
+	{
+		std::uint64_t seen{};
+		for(;;)
+		{
+			std::unique_lock lock{ _lock };
+			_wakeup_cv.wait( lock,
+					[&]{ return _shutdown || seen != _generation; } );
+			if( _shutdown )
+				return;
+			seen = _generation;
+			if( index >= _cores->size() )
+				continue;
+
+			const auto & task = *_task;
+			const auto core = (*_cores)[ index ];
+			lock.unlock();
+
+			// Если привязка не удалась, то задание все равно вызывается
+			// с описанием ошибки, чтобы оно прибыло к барьеру и отметило
+			// свои результаты как незаполненные.
+			std::optional< std::string > affinity_error;
+			try
+			{
+				apply_affinity( core );
+			}
+			catch( const std::exception & x )
+			{
+				affinity_error = x.what();
+			}
+
+			try
+			{
+				task( index, affinity_error );
+			}
+			catch( const std::exception & x )
+			{
+				std::osyncstream{ std::cerr }
+						<< "worker_pool_t: exception caught: " << x.what()
+						<< std::endl;
+			}
+
+			lock.lock();
+			if( ++_finished == _cores->size() )
+				_done_cv.notify_one();
+		}
+	}
+
+public:
+	explicit worker_pool_t( std::size_t size )
+	{
+		CPU_ZERO( &_process_mask );
+		if( 0 != sched_getaffinity( 0, sizeof(_process_mask), &_process_mask ) )
+			throw std::runtime_error{ "sched_getaffinity failed" };
+
+		_threads.reserve( size );
+		for( std::size_t i = 0; i != size; ++i )
+			_threads.emplace_back( [this, i] { body( i ); } );
+	}
+
+	~worker_pool_t()
+	{
+		{
+			std::lock_guard lock{ _lock };
+			_shutdown = true;
+		}
+		_wakeup_cv.notify_all();
+	}
+
+	worker_pool_t( const worker_pool_t & ) = delete;
+	worker_pool_t & operator=( const worker_pool_t & ) = delete;
+
+	[[nodiscard]] std::size_t
+	size() const noexcept { return _threads.size(); }
+
+	/// Выполнить task на первых cores.size() нитях и дождаться их.
+	void
+	run( const cores_t & cores, const task_t & task )
+	{
+		if( cores.size() > _threads.size() )
+			throw std::runtime_error{ "too many workers requested from pool" };
+
+		std::unique_lock lock{ _lock };
+		_task = &task;
+		_cores = &cores;
+		_finished = 0u;
+		++_generation;
+		_wakeup_cv.notify_all();
+		_done_cv.wait( lock, [&]{ return _finished == cores.size(); } );
+	}
+};
+
+/// Результат одного сочетания значений осей.
+struct point_t
+{
+	std::string _script;
+	std::string _value_type;
+	std::string _engine;
+	std::size_t _threads{};
+	std::string _pinning;
+	unsigned _repetitions{};
+
+	/// Время работы самой медленной нити (makespan) по прогонам.
+	stats::summary_t _makespan{};
+
+	/// Медианное время на одну итерацию циклов скрипта, наносекунды.
+	double _ns_per_iter{};
+
+	/// Пусто, если все прогоны завершились успешно.
+	std::optional< std::string > _failure{};
+};
+
+/// Разобрать имя скрипта и получить параметры для make_workload.
+///
+/// Параметры скрипта должны помещаться в T, поэтому проверка зависит
+/// от типа значений.
+template< typename T >
+void
+apply_script_name( const std::string & name, run_params::run_params_t & params )
+{
+	// Имя проверяется сразу, а не при создании скрипта.
+	(void)script_library::make< T >( name );
+	params._array.reset();
+	params._script = name;
+}
+
+/// Проверить значения осей до начала замеров, чтобы ошибка в сценарии
+/// не обнаружилась через несколько часов работы.
+void
+check_scenario( const run_params::scenario_t & scenario )
+{
+	run_params::run_params_t params;
+	for( const auto & type : scenario._value_types )
+		for( const auto & s : scenario._scripts )
+			if( "int" == type )
+				apply_script_name< int >( s, params );
+			else
+				apply_script_name< double >( s, params );
+	for( const auto & e : scenario._engines )
+		script::engines::ensure_known( e );
+}
+
+/// Выполнение одного сочетания на рабочих нитях пула.
+template< typename T >
+[[nodiscard]]
+point_t
+measure_point(
+	worker_pool_t & pool,
+	const workload_t<T> & workload,
+	const cores_t & cores,
+	unsigned warmup_runs,
+	point_t point )
+{
+	using linux_affinity::impl::to_seconds;
+
+	struct worker_result_t
+	{
+		std::chrono::steady_clock::duration _time{};
+		bool _completed{ false };
+
+		/// Почему нить не смогла выполнить скрипт.
+		std::optional< std::string > _error{};
+
+		/// Расхождение значений переменных с ожидаемыми.
+		std::optional< std::string > _mismatch{};
+	};
+
+	std::vector< double > makespans;
+	for( unsigned run = 0; run != warmup_runs + point._repetitions; ++run )
+	{
+		std::vector< worker_result_t > results( cores.size() );
+		std::latch start_latch{ static_cast< std::ptrdiff_t >( cores.size() ) };
+
+		const worker_pool_t::task_t task = [&](
+				std::size_t index,
+				const std::optional< std::string > & affinity_error ) {
+			if( affinity_error )
+			{
+				results[ index ]._error = *affinity_error;
+				start_latch.count_down();
+				return;
+			}
+			start_latch.arrive_and_wait();
+
+			const auto started_at = std::chrono::steady_clock::now();
+			script::exec_context_t<T> ctx;
+			script::engines::execute( *workload._prepared, ctx );
+			results[ index ]._time = std::chrono::steady_clock::now() - started_at;
+			results[ index ]._completed = true;
+			results[ index ]._mismatch = script_library::check_final_values(
+					workload._name, workload._expected, ctx );
+		};
+		pool.run( cores, task );
+
+		double makespan = 0.0;
+		for( std::size_t i = 0; i != results.size(); ++i )
+		{
+			if( !results[ i ]._completed )
+			{
+				point._failure = "worker #" + std::to_string( i + 1 ) + " failed";
+				if( results[ i ]._error )
+					*point._failure += ": " + *results[ i ]._error;
+				return point;
+			}
+			if( results[ i ]._mismatch )
+			{
+				point._failure = "worker #" + std::to_string( i + 1 )
+						+ ": wrong final values: " + *results[ i ]._mismatch;
+				return point;
+			}
+			makespan = std::max( makespan, to_seconds( results[ i ]._time ) );
+		}
+		if( run >= warmup_runs )
+			makespans.push_back( makespan );
+	}
+
+	point._makespan = stats::summarize( makespans );
+	if( workload._loop_iterations )
+		point._ns_per_iter = point._makespan._median * 1e9
+				/ static_cast< double >( workload._loop_iterations );
+	return point;
+}
+
+/// Все сочетания для одного типа значений.
+template< typename T >
+void
+measure_all(
+	const run_params::scenario_t & scenario,
+	worker_pool_t & pool,
+	std::vector< point_t > & points )
+{
+	const std::string value_type{
+			linux_affinity::impl::value_type_name<T>() };
+
+	for( const auto & script_name : scenario._scripts )
+	{
+		run_params::run_params_t params;
+		params._sysfs_root = scenario._sysfs_root;
+		apply_script_name< T >( script_name, params );
+
+		for( const auto & engine : scenario._engines )
+		{
+			params._engine = engine;
+			const auto workload =
+					linux_affinity::impl::make_workload<T>( params );
+
+			for( const auto & pinning : scenario._pinnings )
+				for( const auto n : scenario._threads_counts )
+					for( const auto reps : scenario._repetitions )
+					{
+						point_t point{ script_name, value_type, engine, n,
+								run_params::to_string( pinning ), reps };
+						std::osyncstream{ std::cout } << "=== " << script_name
+								<< ", " << value_type << ", " << engine << ", "
+								<< n << " thread(s), pinning `" << point._pinning
+								<< "`, reps: " << reps << std::endl;
+						try
+						{
+							// Как и в режиме sweep: нитей не может быть
+							// больше, чем явно перечисленных ядер.
+							run_params::run_params_t point_params;
+							point_params._threads_count = n;
+							point_params._pinning = pinning;
+							point_params._sysfs_root = scenario._sysfs_root;
+							if( linux_affinity::impl::detect_threads_count(
+									point_params ) != n )
+								throw std::runtime_error{
+										"not enough cores specified for "
+										+ std::to_string( n ) + " thread(s)" };
+
+							const auto cores =
+									linux_affinity::impl::detect_worker_cores(
+											n, pinning, scenario._sysfs_root );
+							point = measure_point<T>( pool, workload, cores,
+									scenario._warmup_runs, std::move(point) );
+						}
+						catch( const std::exception & x )
+						{
+							point._failure = x.what();
+						}
+						points.push_back( std::move(point) );
+					}
+		}
+	}
+}
+
+/// Печать сводной таблицы.
+void
+print_points( std::ostream & to, const std::vector< point_t > & points )
+{
+	to << "\nscenario results (makespan -- time of the slowest worker):\n"
+			<< std::left
+			<< std::setw( 18 ) << "script" << std::setw( 8 ) << "type"
+			<< std::setw( 10 ) << "engine" << std::setw( 8 ) << "threads"
+			<< std::setw( 14 ) << "pinning" << std::setw( 6 ) << "reps"
+			<< std::right
+			<< std::setw( 12 ) << "median, s" << std::setw( 12 ) << "min, s"
+			<< std::setw( 12 ) << "p90, s" << std::setw( 13 ) << "ns/iter"
+			<< "  status" << std::endl;
+
+	for( const auto & p : points )
+	{
+		to << std::left
+				<< std::setw( 18 ) << p._script << std::setw( 8 ) << p._value_type
+				<< std::setw( 10 ) << p._engine << std::setw( 8 ) << p._threads
+				<< std::setw( 14 ) << p._pinning << std::setw( 6 ) << p._repetitions
+				<< std::right;
+		if( p._failure )
+		{
+			to << std::setw( 49 ) << "-" << "  FAILED: " << *p._failure
+					<< std::endl;
+			continue;
+		}
+		to << std::fixed << std::setprecision( 6 )
+				<< std::setw( 12 ) << p._makespan._median
+				<< std::setw( 12 ) << p._makespan._min
+				<< std::setw( 12 ) << p._makespan._p90
+				<< std::setprecision( 3 ) << std::setw( 13 ) << p._ns_per_iter
+				<< std::defaultfloat << "  ok" << std::endl;
+	}
+}
+
+void
+write_csv( const std::string & file_name, const std::vector< point_t > & points )
+{
+	std::ofstream file{ file_name, std::ios::out | std::ios::trunc };
+	if( !file )
+		throw std::runtime_error{ "unable to open output file: " + file_name };
+
+	file << "script,value_type,engine,threads,pinning,reps,"
+			"median_s,min_s,p90_s,ns_per_iter,status\n";
+	file << std::setprecision( 9 );
+	for( const auto & p : points )
+	{
+		file << p._script << ',' << p._value_type << ',' << p._engine << ','
+				<< p._threads << ",\"" << p._pinning << "\"," << p._repetitions
+				<< ',';
+		if( p._failure )
+			file << ",,,,failed\n";
+		else
+			file << p._makespan._median << ',' << p._makespan._min << ','
+					<< p._makespan._p90 << ',' << p._ns_per_iter << ",ok\n";
+	}
+
+	if( !file )
+		throw std::runtime_error{ "unable to write file: " + file_name };
+}
+
+} /* namespace scenario_runner */
+
+int main(int argc, char ** argv)
+{
+	using namespace scenario_runner;
+
+	if( 2 != argc )
+	{
+		std::cout << "Usage:\n\t" << argv[0] << " <scenario-file>\n\n"
+				"Runs every combination of the axes listed in the scenario\n"
+				"file in one process on a persistent pool of worker threads\n"
+				"and prints one consolidated table. Format:\n\n"
+				"\t# comment\n"
+				"\tscript: demo array:200000 nested vars:4096\n"
+				"\ttype: int double\n"
+				"\tengine: tree bytecode\n"
+				"\tthreads: 1-4,8\n"
+				"\tpinning: nopin pin pin:fast pin:0,2,4\n"
+				"\treps: 5\n"
+				"\twarmup: 1\n"
+				"\tsysfs: /sys\n"
+				"\tcsv: nightly.csv\n\n"
+				"Script names:\n\n"
+				<< script_library::names_help() << std::endl;
+		return 2;
+	}
+
+	try
+	{
+		const auto scenario = run_params::parse_scenario_file( argv[ 1 ] );
+		check_scenario( scenario );
+
+		linux_affinity::impl::collect_and_report_some_system_info(
+				scenario._sysfs_root );
+
+		worker_pool_t pool{ *std::max_element(
+				scenario._threads_counts.begin(),
+				scenario._threads_counts.end() ) };
+
+		std::vector< point_t > points;
+		for( const auto & type : scenario._value_types )
+			if( "int" == type )
+				measure_all< int >( scenario, pool, points );
+			else
+				measure_all< double >( scenario, pool, points );
+
+		print_points( std::cout, points );
+
+		if( scenario._csv_output_file )
+			write_csv( *scenario._csv_output_file, points );
+
+		for( const auto & p : points )
+			if( p._failure )
+				return 1;
+	}
+	catch(const std::exception & x)
+	{
+		std::cerr << "main: exception caught: " << x.what() << std::endl;
+		return 2;
+	}
+
+	return 0;
+}
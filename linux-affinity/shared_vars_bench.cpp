@@ -0,0 +1,419 @@
+#include "do_work.hpp"
+
+#include "../templated-script/shared_vars.hpp"
+
+#include <map>
+#include <syncstream>
+
+namespace shared_vars_bench
+{
+
+using script::shared::strategy_t;
+
+/// Все способы хранения, которые сравниваются.
+inline constexpr strategy_t all_strategies[]{
+	strategy_t::single_atomic,
+	strategy_t::padded_shards,
+	strategy_t::packed_shards,
+	strategy_t::combining_tree
+};
+
+/// Как нити изменяют разделяемую переменную.
+enum class mode_t
+{
+	/// Прямые вызовы add() в цикле: только стоимость самой переменной.
+	direct,
+	/// Через increment_by_t в демо-скрипте.
+	script
+};
+
+[[nodiscard]] const char *
+to_string( mode_t mode )
+{
+	return mode_t::direct == mode ? "direct" : "script";
+}
+
+/// Сколько изменений делает каждая нить.
+[[nodiscard]] long long
+ops_per_thread( mode_t mode )
+{
+	return mode_t::direct == mode ? 20'000'000 : 2'000'000;
+}
+
+/// Замеры для одного сочетания параметров.
+struct point_t
+{
+	strategy_t _strategy;
+	mode_t _mode;
+	std::string _value_type;
+	std::string _pinning;
+	std::size_t _threads{};
+
+	/// Медиана по прогонам времени самой медленной нити на одно
+	/// изменение, в наносекундах.
+	double _ns_per_op{};
+
+	/// Суммарное количество изменений в секунду по всем нитям.
+	double _ops_per_second{};
+
+	/// Промахи L1D на одно изменение (если счетчик доступен).
+	std::optional< double > _l1d_misses_per_op{};
+
+	/// Совпало ли итоговое значение с ожидаемым во всех прогонах.
+	bool _correct{ true };
+};
+
+struct thread_result_t
+{
+	double _seconds{};
+	perf_counters::counter_values_t _counters;
+};
+
+template< typename T >
+void
+thread_body(
+	std::size_t worker_index,
+	std::optional< run_params::core_index_t > core_index,
+	start_barrier::start_sync_t & start_latch,
+	mode_t mode,
+	script::shared::variable_t<T> & shared,
+	const script::statement_shptr_t<T> & stm,
+	thread_result_t & result )
+{
+	bool prepared = false;
+	std::optional< perf_counters::thread_counters_t > counters;
+	script::exec_context_t<T> ctx;
+	try
+	{
+		if( core_index )
+			linux_affinity::impl::pin_to_core( *core_index );
+		counters.emplace();
+		ctx.bind_shared( worker_index, shared_counter_demo_script_variable, shared );
+		prepared = true;
+	}
+	catch( const std::exception & x )
+	{
+		std::osyncstream{ std::cerr } << "thread_body: " << x.what() << std::endl;
+	}
+
+	if( start_barrier::wakeup_type_t::normal !=
+			start_latch.arrive_and_wait( worker_index ) || !prepared )
+		return;
+
+	const auto ops = ops_per_thread( mode );
+	const auto started_at = std::chrono::steady_clock::now();
+	counters->start();
+	if( mode_t::direct == mode )
+	{
+		for( long long i = 0; i != ops; ++i )
+			shared.add( worker_index, T{ 1 } );
+	}
+	else
+		script::execute( stm, ctx );
+	result._counters = counters->stop();
+	result._seconds = linux_affinity::impl::to_seconds(
+			std::chrono::steady_clock::now() - started_at );
+}
+
+template< typename T >
+[[nodiscard]] point_t
+measure_point(
+	const run_params::run_params_t & params,
+	const std::vector< std::optional< run_params::core_index_t > > & cores,
+	const run_params::pinning_params_t & pinning,
+	strategy_t strategy,
+	mode_t mode )
+{
+	const auto threads_count = cores.size();
+	const auto ops = ops_per_thread( mode );
+	const auto stm = make_shared_counter_demo_script<T>( ops );
+
+	point_t result{ strategy, mode,
+			linux_affinity::impl::value_type_name<T>(),
+			run_params::to_string( pinning ), threads_count };
+
+	std::vector< double > slowest;
+	std::vector< double > misses;
+	for( unsigned run = 0; run != params._warmup_runs + params._repetitions; ++run )
+	{
+		auto shared = script::shared::make_variable<T>( strategy, threads_count );
+		std::vector< thread_result_t > results( threads_count );
+		{
+			start_barrier::start_sync_t start_latch{ threads_count };
+			std::vector< std::jthread > threads;
+			start_barrier::start_sync_t::wakeup_controller_t wakeup_controller{
+					start_latch };
+			for( std::size_t i = 0; i != threads_count; ++i )
+				threads.emplace_back( thread_body<T>, i, cores[ i ],
+						std::ref( start_latch ), mode, std::ref( *shared ),
+						std::cref( stm ), std::ref( results[ i ] ) );
+			(void)wakeup_controller.wakeup_threads();
+		}
+
+		if( run < params._warmup_runs )
+			continue;
+
+		const T expected = static_cast<T>( ops ) * static_cast<T>( threads_count );
+		result._correct = result._correct && shared->read() == expected;
+
+		double max_seconds{};
+		double total_misses{};
+		bool misses_available = true;
+		for( const auto & r : results )
+		{
+			max_seconds = std::max( max_seconds, r._seconds );
+			if( const auto v = r._counters.get(
+					perf_counters::counter_kind_t::l1d_read_misses ) )
+				total_misses += static_cast< double >( *v );
+			else
+				misses_available = false;
+		}
+		slowest.push_back( max_seconds );
+		if( misses_available )
+			misses.push_back( total_misses
+					/ static_cast< double >( ops * static_cast< long long >( threads_count ) ) );
+	}
+
+	const double seconds = stats::summarize( slowest )._median;
+	result._ns_per_op = seconds * 1e9 / static_cast< double >( ops );
+	result._ops_per_second = seconds > 0.0 ?
+			static_cast< double >( ops ) * static_cast< double >( threads_count )
+				/ seconds : 0.0;
+	if( !misses.empty() )
+		result._l1d_misses_per_op = stats::summarize( misses )._median;
+
+	return result;
+}
+
+/// Во сколько раз должна вырасти стоимость изменения, чтобы это
+/// считалось признаком false sharing.
+inline constexpr double false_sharing_ratio = 1.5;
+
+/// Поиск признаков false sharing.
+///
+/// Сравниваются части, лежащие вплотную, с частями в отдельных
+/// строках кэша при том же количестве нитей и способе привязки.
+/// Кроме того, для способов, в которых нити не изменяют общих
+/// данных на каждом шаге, отмечается рост стоимости изменения
+/// относительно одной нити. Эта проверка не выполняется, если нитей
+/// больше, чем доступных процессоров: там рост стоимости объясняется
+/// тем, что нити делят процессоры.
+void
+report_false_sharing(
+	std::ostream & to,
+	const std::vector< point_t > & points,
+	std::size_t available_cpus )
+{
+	using key_t = std::tuple< std::string, std::string, int, std::size_t >;
+	std::map< std::pair< key_t, strategy_t >, const point_t * > index;
+	for( const auto & p : points )
+		index[ { key_t{ p._value_type, p._pinning,
+				static_cast< int >( p._mode ), p._threads }, p._strategy } ] = &p;
+
+	const auto find = [&]( const point_t & p, strategy_t s, std::size_t threads )
+			-> const point_t * {
+		const auto it = index.find( { key_t{ p._value_type, p._pinning,
+				static_cast< int >( p._mode ), threads }, s } );
+		return it == index.end() ? nullptr : it->second;
+	};
+
+	to << "false sharing analysis:" << std::endl;
+	bool found = false;
+	for( const auto & p : points )
+	{
+		if( p._threads < 2u )
+			continue;
+
+		if( strategy_t::packed_shards == p._strategy )
+			if( const auto * padded = find( p, strategy_t::padded_shards, p._threads ) )
+			{
+				const double ratio = p._ns_per_op / padded->_ns_per_op;
+				if( ratio > false_sharing_ratio )
+				{
+					found = true;
+					to << "  " << p._value_type << ", " << to_string( p._mode )
+							<< ", " << p._threads << " thread(s), pinning `"
+							<< p._pinning << "`: packed shards are "
+							<< std::fixed << std::setprecision(2) << ratio
+							<< "x slower than padded ones";
+					if( p._l1d_misses_per_op && padded->_l1d_misses_per_op )
+						to << " (L1D misses/op: " << std::setprecision(3)
+								<< *p._l1d_misses_per_op << " vs "
+								<< *padded->_l1d_misses_per_op << ")";
+					to << std::defaultfloat << " -- false sharing" << std::endl;
+				}
+			}
+
+		if( p._threads > available_cpus )
+			continue;
+
+		if( strategy_t::padded_shards == p._strategy
+				|| strategy_t::combining_tree == p._strategy )
+			if( const auto * single = find( p, p._strategy, 1u ) )
+			{
+				const double ratio = p._ns_per_op / single->_ns_per_op;
+				if( ratio > false_sharing_ratio )
+				{
+					found = true;
+					to << "  " << p._value_type << ", " << to_string( p._mode )
+							<< ", " << script::shared::to_string( p._strategy )
+							<< ", pinning `" << p._pinning << "`: cost per op grows "
+							<< std::fixed << std::setprecision(2) << ratio
+							<< "x from 1 to " << p._threads << " thread(s)"
+							<< std::defaultfloat
+							<< " -- possible false sharing"
+							<< std::endl;
+				}
+			}
+	}
+	if( !found )
+		to << "  nothing suspicious" << std::endl;
+}
+
+void
+print_points( std::ostream & to, const std::vector< point_t > & points )
+{
+	to << std::left << std::setw( 7 ) << "type"
+			<< std::setw( 7 ) << "mode"
+			<< std::setw( 16 ) << "strategy"
+			<< std::setw( 14 ) << "pinning" << std::right
+			<< std::setw( 8 ) << "threads"
+			<< std::setw( 10 ) << "ns/op"
+			<< std::setw( 12 ) << "Mops/s"
+			<< std::setw( 9 ) << "scaling"
+			<< std::setw( 12 ) << "L1D-miss/op" << std::endl;
+
+	for( const auto & p : points )
+	{
+		// Масштабируемость относительно одной нити с тем же способом.
+		std::optional< double > scaling;
+		for( const auto & base : points )
+			if( 1u == base._threads && base._strategy == p._strategy
+					&& base._mode == p._mode && base._pinning == p._pinning
+					&& base._value_type == p._value_type
+					&& base._ops_per_second > 0.0 )
+				scaling = p._ops_per_second / base._ops_per_second;
+
+		to << std::left << std::setw( 7 ) << p._value_type
+				<< std::setw( 7 ) << to_string( p._mode )
+				<< std::setw( 16 ) << script::shared::to_string( p._strategy )
+				<< std::setw( 14 ) << p._pinning << std::right
+				<< std::setw( 8 ) << p._threads
+				<< std::fixed << std::setprecision( 2 )
+				<< std::setw( 10 ) << p._ns_per_op
+				<< std::setw( 12 ) << p._ops_per_second / 1e6
+				<< std::setw( 9 );
+		if( scaling )
+			to << *scaling;
+		else
+			to << "n/a";
+		to << std::setw( 12 ) << std::setprecision( 3 );
+		if( p._l1d_misses_per_op )
+			to << *p._l1d_misses_per_op;
+		else
+			to << "n/a";
+		to << std::defaultfloat << (p._correct ? "" : "  WRONG RESULT") << std::endl;
+	}
+}
+
+void
+write_csv( const std::string & file_name, const std::vector< point_t > & points )
+{
+	std::ofstream file{ file_name, std::ios::out | std::ios::trunc };
+	if( !file )
+		throw std::runtime_error{ "unable to open output file: " + file_name };
+
+	file << "value_type,mode,strategy,pinning,threads,ns_per_op,ops_per_second,"
+			"l1d_misses_per_op,correct\n" << std::setprecision( 9 );
+	for( const auto & p : points )
+	{
+		file << p._value_type << ',' << to_string( p._mode ) << ','
+				<< script::shared::to_string( p._strategy ) << ",\""
+				<< p._pinning << "\"," << p._threads << ','
+				<< p._ns_per_op << ',' << p._ops_per_second << ',';
+		if( p._l1d_misses_per_op )
+			file << *p._l1d_misses_per_op;
+		file << ',' << (p._correct ? 1 : 0) << '\n';
+	}
+}
+
+template< typename T >
+void
+measure_all(
+	const run_params::run_params_t & params,
+	std::vector< point_t > & points )
+{
+	const auto & sweep = *params._sweep;
+	for( const auto & pinning : sweep._pinnings )
+		for( const auto n : sweep._threads_counts )
+		{
+			run_params::run_params_t point_params{ params };
+			point_params._threads_count = n;
+			point_params._pinning = pinning;
+			if( linux_affinity::impl::detect_threads_count( point_params ) != n )
+				continue;
+
+			const auto cores = linux_affinity::impl::detect_worker_cores(
+					n, pinning, params._sysfs_root );
+			for( const auto mode : { mode_t::direct, mode_t::script } )
+				for( const auto strategy : all_strategies )
+				{
+					points.push_back( measure_point<T>(
+							params, cores, pinning, strategy, mode ) );
+					std::osyncstream{ std::cout }
+							<< linux_affinity::impl::value_type_name<T>() << ", "
+							<< to_string( mode ) << ", "
+							<< script::shared::to_string( strategy ) << ", "
+							<< n << " thread(s), pinning `"
+							<< run_params::to_string( pinning ) << "`: "
+							<< points.back()._ns_per_op << " ns/op" << std::endl;
+				}
+		}
+}
+
+} /* namespace shared_vars_bench */
+
+int main(int argc, char ** argv)
+{
+	using namespace shared_vars_bench;
+
+	try
+	{
+		const auto parsed = run_params::parse_cmd_line_args( argc, argv );
+		const auto * params = std::get_if< run_params::run_params_t >( &parsed );
+		if( !params || !params->_sweep )
+		{
+			std::cout << "Usage:\n\t" << argv[0]
+					<< " sweep:<thread-counts> [nopin] [pin[:<core-index(es)>]]..."
+					" [warmup:N] [reps:N] [csv:<file>]\n\n"
+					"Measures the cost of updates of a shared variable for every\n"
+					"storage strategy, thread count and pinning policy, both by\n"
+					"direct calls and through increment_by_t in a script.\n"
+					"For example:\n\n\t" << argv[0]
+					<< " sweep:1-8 nopin pin reps:3 csv:shared.csv" << std::endl;
+			return params ? 2 : 0;
+		}
+
+		std::vector< point_t > points;
+		measure_all< int >( *params, points );
+		measure_all< double >( *params, points );
+
+		print_points( std::cout, points );
+		report_false_sharing( std::cout, points,
+				cpu_budget::detect( params->_sysfs_root )._capacity );
+
+		if( params->_csv_output_file )
+			write_csv( *params->_csv_output_file, points );
+
+		for( const auto & p : points )
+			if( !p._correct )
+				return 1;
+	}
+	catch(const std::exception & x)
+	{
+		std::cerr << "main: exception caught: " << x.what() << std::endl;
+		return 2;
+	}
+
+	return 0;
+}
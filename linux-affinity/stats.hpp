@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace stats
+{
+
+/// Сводная статистика по набору замеров.
+struct summary_t
+{
+	/// Сколько замеров осталось после отбрасывания выбросов.
+	std::size_t _samples{};
+	/// Сколько замеров было отброшено как выбросы.
+	std::size_t _rejected{};
+
+	double _min{};
+	double _median{};
+	double _p90{};
+	double _p99{};
+	double _mean{};
+	double _stddev{};
+
+	/// Границы 95% доверительного интервала для медианы,
+	/// полученные методом bootstrap.
+	double _ci95_low{};
+	double _ci95_high{};
+};
+
+/// Квантиль по уже отсортированному набору значений
+/// (линейная интерполяция между соседними элементами).
+[[nodiscard]] inline double
+quantile_of_sorted( const std::vector< double > & sorted, double q )
+{
+	if( sorted.empty() )
+		return 0.0;
+
+	const double pos = q * static_cast< double >( sorted.size() - 1u );
+	const auto lo = static_cast< std::size_t >( std::floor( pos ) );
+	const auto hi = std::min( lo + 1u, sorted.size() - 1u );
+	const double frac = pos - static_cast< double >( lo );
+
+	return sorted[ lo ] + (sorted[ hi ] - sorted[ lo ]) * frac;
+}
+
+/// Отбросить выбросы по правилу Тьюки (за пределами 1.5*IQR).
+///
+/// Возвращает отсортированный набор оставшихся значений.
+/// При количестве замеров меньше 4-х ничего не отбрасывается.
+[[nodiscard]] inline std::vector< double >
+reject_outliers( std::vector< double > samples )
+{
+	std::sort( samples.begin(), samples.end() );
+	if( samples.size() < 4u )
+		return samples;
+
+	const double q1 = quantile_of_sorted( samples, 0.25 );
+	const double q3 = quantile_of_sorted( samples, 0.75 );
+	const double iqr = q3 - q1;
+	const double low_fence = q1 - 1.5 * iqr;
+	const double high_fence = q3 + 1.5 * iqr;
+
+	std::vector< double > result;
+	result.reserve( samples.size() );
+	for( const double v : samples )
+		if( v >= low_fence && v <= high_fence )
+			result.push_back( v );
+
+	return result;
+}
+
+/// Вычислить сводную статистику по набору замеров.
+///
+/// Генератор для bootstrap инициализируется фиксированным значением,
+/// чтобы повторный расчет по тем же данным давал тот же результат.
+[[nodiscard]] inline summary_t
+summarize(
+	const std::vector< double > & raw_samples,
+	std::size_t bootstrap_resamples = 2000u )
+{
+	summary_t result;
+
+	const auto samples = reject_outliers( raw_samples );
+	result._samples = samples.size();
+	result._rejected = raw_samples.size() - samples.size();
+	if( samples.empty() )
+		return result;
+
+	result._min = samples.front();
+	result._median = quantile_of_sorted( samples, 0.5 );
+	result._p90 = quantile_of_sorted( samples, 0.9 );
+	result._p99 = quantile_of_sorted( samples, 0.99 );
+
+	double sum{};
+	for( const double v : samples )
+		sum += v;
+	result._mean = sum / static_cast< double >( samples.size() );
+
+	if( samples.size() > 1u )
+	{
+		double sq_sum{};
+		for( const double v : samples )
+			sq_sum += (v - result._mean) * (v - result._mean);
+		result._stddev = std::sqrt(
+				sq_sum / static_cast< double >( samples.size() - 1u ) );
+	}
+
+	// Bootstrap для медианы.
+	std::mt19937_64 generator{ 0x5eed'1234'abcd'0001ull };
+	std::uniform_int_distribution< std::size_t > index_dist{
+			0u, samples.size() - 1u };
+
+	std::vector< double > medians;
+	medians.reserve( bootstrap_resamples );
+	std::vector< double > resample( samples.size() );
+	for( std::size_t i = 0; i != bootstrap_resamples; ++i )
+	{
+		for( auto & v : resample )
+			v = samples[ index_dist( generator ) ];
+		std::sort( resample.begin(), resample.end() );
+		medians.push_back( quantile_of_sorted( resample, 0.5 ) );
+	}
+	std::sort( medians.begin(), medians.end() );
+	result._ci95_low = quantile_of_sorted( medians, 0.025 );
+	result._ci95_high = quantile_of_sorted( medians, 0.975 );
+
+	return result;
+}
+
+/// Результат U-критерия Манна-Уитни.
+struct mann_whitney_t
+{
+	/// Значение статистики U для второй выборки: количество пар,
+	/// в которых значение из второй выборки больше значения из
+	/// первой (совпадающие значения считаются за половину).
+	double _u{};
+
+	/// Одностороннее p-value для гипотезы о том, что значения второй
+	/// выборки в целом больше значений первой.
+	double _p_greater{ 1.0 };
+
+	/// Было ли p-value вычислено точно (иначе -- нормальная
+	/// аппроксимация).
+	bool _exact{ false };
+};
+
+namespace impl
+{
+
+/// Точное распределение статистики U при отсутствии совпадений.
+///
+/// Возвращает вероятность P(U >= u) для выборок размером n1 и n2.
+[[nodiscard]] inline double
+exact_mann_whitney_upper_tail( std::size_t n1, std::size_t n2, std::size_t u )
+{
+	const std::size_t max_u = n1 * n2;
+	// counts[m][n][k] -- количество расстановок m элементов первой
+	// выборки и n элементов второй, дающих U == k. Для экономии
+	// памяти хранится только текущий и предыдущий слой по m.
+	using layer_t = std::vector< std::vector< double > >;
+	layer_t prev( n2 + 1u, std::vector< double >( max_u + 1u ) );
+	for( std::size_t n = 0; n <= n2; ++n )
+		prev[ n ][ 0 ] = 1.0;
+
+	for( std::size_t m = 1; m <= n1; ++m )
+	{
+		layer_t current( n2 + 1u, std::vector< double >( max_u + 1u ) );
+		current[ 0 ][ 0 ] = 1.0;
+		for( std::size_t n = 1; n <= n2; ++n )
+			for( std::size_t k = 0; k <= m * n; ++k )
+			{
+				// Самый большой элемент либо из второй выборки (тогда
+				// он больше всех m элементов первой), либо из первой.
+				current[ n ][ k ] = (k >= m ? current[ n - 1u ][ k - m ] : 0.0)
+						+ prev[ n ][ k ];
+			}
+		prev = std::move(current);
+	}
+
+	const auto & distribution = prev[ n2 ];
+	const double total = std::accumulate(
+			distribution.begin(), distribution.end(), 0.0 );
+	const double tail = std::accumulate(
+			distribution.begin() + static_cast< std::ptrdiff_t >( u ),
+			distribution.end(), 0.0 );
+
+	return tail / total;
+}
+
+} /* namespace impl */
+
+/// U-критерий Манна-Уитни для проверки того, что значения выборки
+/// current в целом больше значений выборки baseline.
+///
+/// Для небольших выборок без совпадающих значений p-value
+/// вычисляется точно, иначе используется нормальная аппроксимация
+/// с поправкой на совпадения и на непрерывность.
+[[nodiscard]] inline mann_whitney_t
+mann_whitney_u(
+	const std::vector< double > & baseline,
+	const std::vector< double > & current )
+{
+	constexpr std::size_t max_exact_size = 20u;
+
+	mann_whitney_t result;
+
+	const std::size_t n1 = baseline.size();
+	const std::size_t n2 = current.size();
+	if( !n1 || !n2 )
+		return result;
+
+	// Значение и признак принадлежности ко второй выборке.
+	std::vector< std::pair< double, bool > > all;
+	all.reserve( n1 + n2 );
+	for( const double v : baseline )
+		all.emplace_back( v, false );
+	for( const double v : current )
+		all.emplace_back( v, true );
+	std::sort( all.begin(), all.end(),
+			[]( const auto & a, const auto & b ) { return a.first < b.first; } );
+
+	// Сумма рангов второй выборки с усреднением рангов у совпадений.
+	double rank_sum{};
+	double ties_correction{};
+	for( std::size_t i = 0; i != all.size(); )
+	{
+		std::size_t j = i;
+		while( j != all.size() && all[ j ].first == all[ i ].first )
+			++j;
+
+		const double tied = static_cast< double >( j - i );
+		const double average_rank = static_cast< double >( i + j + 1u ) / 2.0;
+		for( std::size_t k = i; k != j; ++k )
+			if( all[ k ].second )
+				rank_sum += average_rank;
+		ties_correction += tied * tied * tied - tied;
+
+		i = j;
+	}
+
+	const double d1 = static_cast< double >( n1 );
+	const double d2 = static_cast< double >( n2 );
+	result._u = rank_sum - d2 * (d2 + 1.0) / 2.0;
+
+	if( 0.0 == ties_correction && n1 <= max_exact_size && n2 <= max_exact_size )
+	{
+		result._exact = true;
+		result._p_greater = impl::exact_mann_whitney_upper_tail(
+				n1, n2, static_cast< std::size_t >( std::llround( result._u ) ) );
+		return result;
+	}
+
+	const double n = d1 + d2;
+	const double variance = d1 * d2 / 12.0 *
+			((n + 1.0) - ties_correction / (n * (n - 1.0)));
+	if( variance <= 0.0 )
+		// Все значения совпадают, различий нет.
+		return result;
+
+	const double z = (result._u - d1 * d2 / 2.0 - 0.5) / std::sqrt( variance );
+	result._p_greater = 0.5 * std::erfc( z / std::sqrt( 2.0 ) );
+
+	return result;
+}
+
+} /* namespace stats */
@@ -0,0 +1,496 @@
+#pragma once
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "../common/run_timeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sysfs_sampler
+{
+
+/// Параметры для периодического опроса sysfs.
+struct config_t
+{
+	/// Корень sysfs.
+	///
+	/// Может указывать на подготовленный заранее каталог с фиктивным
+	/// содержимым, чтобы проверять работу без реального оборудования.
+	std::string _sysfs_root{ "/sys" };
+
+	/// Период опроса.
+	std::chrono::milliseconds _period{ 100 };
+
+	/// Для каких процессоров нужно снимать частоту.
+	std::vector< unsigned > _cpus;
+
+	/// На каком процессоре должна работать нить опроса.
+	///
+	/// Если пусто, то нить опроса ни к чему не привязывается.
+	std::optional< unsigned > _sampler_cpu;
+
+	/// Доля от максимальной частоты процессора, ниже которой
+	/// процессор считается притормаживаемым (throttled).
+	double _throttle_fraction{ 0.8 };
+};
+
+/// Один снимок состояния.
+struct sample_t
+{
+	run_timeline::steady_clock_t::time_point _at;
+
+	/// Текущая частота каждого процессора в кГц, в том же порядке,
+	/// что и в config_t::_cpus.
+	std::vector< std::optional< unsigned long > > _cpu_khz;
+
+	/// Текущий governor каждого процессора.
+	std::vector< std::string > _governors;
+
+	/// Температура каждой термозоны в тысячных долях градуса.
+	std::vector< std::optional< long > > _zone_millicelsius;
+};
+
+/// Описание термозоны.
+struct thermal_zone_t
+{
+	/// Имя каталога, например, thermal_zone0.
+	std::string _name;
+
+	/// Содержимое файла type.
+	std::string _type;
+
+	/// Температура срабатывания пассивного охлаждения (если есть).
+	std::optional< long > _passive_trip_millicelsius;
+};
+
+/// Все собранные за время прогона данные.
+struct samples_t
+{
+	config_t _config;
+
+	/// Максимальная частота каждого процессора (cpuinfo_max_freq).
+	std::vector< std::optional< unsigned long > > _cpu_max_khz;
+
+	std::vector< thermal_zone_t > _zones;
+
+	std::vector< sample_t > _samples;
+};
+
+namespace impl
+{
+
+/// Обертка для файлового дескриптора.
+class file_descriptor_t
+{
+	int _fd{ -1 };
+
+public:
+	file_descriptor_t() = default;
+
+	explicit file_descriptor_t( const std::filesystem::path & path )
+		: _fd{ ::open( path.c_str(), O_RDONLY | O_CLOEXEC ) }
+	{}
+
+	~file_descriptor_t()
+	{
+		if( -1 != _fd )
+			::close( _fd );
+	}
+
+	file_descriptor_t( file_descriptor_t && other ) noexcept
+		: _fd{ std::exchange( other._fd, -1 ) }
+	{}
+
+	file_descriptor_t &
+	operator=( file_descriptor_t && other ) noexcept
+	{
+		std::swap( _fd, other._fd );
+		return *this;
+	}
+
+	/// Прочитать содержимое файла с самого начала.
+	///
+	/// Для атрибутов sysfs повторное чтение с нулевого смещения
+	/// возвращает актуальное значение, поэтому файл не нужно
+	/// переоткрывать на каждом опросе.
+	[[nodiscard]] std::optional< std::string >
+	read_value() const
+	{
+		if( -1 == _fd )
+			return std::nullopt;
+
+		char buf[ 128 ];
+		const auto rc = ::pread( _fd, buf, sizeof(buf) - 1u, 0 );
+		if( rc <= 0 )
+			return std::nullopt;
+
+		std::string result( buf, static_cast< std::size_t >( rc ) );
+		while( !result.empty() &&
+				('\n' == result.back() || ' ' == result.back()) )
+			result.pop_back();
+		return result;
+	}
+};
+
+template< typename Integer >
+[[nodiscard]] std::optional< Integer >
+to_integer( const std::optional< std::string > & what )
+{
+	if( !what )
+		return std::nullopt;
+	try
+	{
+		if constexpr( std::is_same_v< Integer, long > )
+			return std::stol( *what );
+		else
+			return std::stoul( *what );
+	}
+	catch( const std::exception & )
+	{
+		return std::nullopt;
+	}
+}
+
+inline void
+pin_current_thread( unsigned cpu )
+{
+	cpu_set_t cpu_set;
+	CPU_ZERO( &cpu_set );
+	CPU_SET( cpu, &cpu_set );
+	(void)pthread_setaffinity_np( pthread_self(), sizeof(cpu_set), &cpu_set );
+}
+
+} /* namespace impl */
+
+/// Нить для периодического опроса частоты процессоров и температуры.
+///
+/// Опрос начинается в конструкторе и заканчивается в finish().
+class sampler_t
+{
+	samples_t _result;
+
+	std::vector< impl::file_descriptor_t > _freq_files;
+	std::vector< impl::file_descriptor_t > _governor_files;
+	std::vector< impl::file_descriptor_t > _zone_files;
+
+	std::mutex _lock;
+	std::condition_variable_any _wakeup_cv;
+
+	std::jthread _thread;
+
+	void
+	discover()
+	{
+		namespace fs = std::filesystem;
+		const fs::path root{ _result._config._sysfs_root };
+
+		for( const auto cpu : _result._config._cpus )
+		{
+			const auto cpufreq = root / "devices/system/cpu"
+					/ ("cpu" + std::to_string( cpu )) / "cpufreq";
+			_freq_files.emplace_back( cpufreq / "scaling_cur_freq" );
+			_governor_files.emplace_back( cpufreq / "scaling_governor" );
+			_result._cpu_max_khz.push_back(
+					impl::to_integer< unsigned long >(
+							impl::file_descriptor_t{ cpufreq / "cpuinfo_max_freq" }
+									.read_value() ) );
+		}
+
+		const auto thermal = root / "class/thermal";
+		std::error_code ec;
+		std::vector< fs::path > zone_dirs;
+		for( const auto & entry : fs::directory_iterator{ thermal, ec } )
+			if( entry.path().filename().string().starts_with( "thermal_zone" ) )
+				zone_dirs.push_back( entry.path() );
+		std::sort( zone_dirs.begin(), zone_dirs.end() );
+
+		for( const auto & dir : zone_dirs )
+		{
+			thermal_zone_t zone;
+			zone._name = dir.filename().string();
+			zone._type = impl::file_descriptor_t{ dir / "type" }
+					.read_value().value_or( "unknown" );
+
+			// Ищем первую точку срабатывания пассивного охлаждения.
+			for( int i = 0; ; ++i )
+			{
+				const auto prefix = "trip_point_" + std::to_string( i );
+				const auto type = impl::file_descriptor_t{
+						dir / (prefix + "_type") }.read_value();
+				if( !type )
+					break;
+				if( "passive" == *type )
+				{
+					zone._passive_trip_millicelsius = impl::to_integer< long >(
+							impl::file_descriptor_t{ dir / (prefix + "_temp") }
+									.read_value() );
+					break;
+				}
+			}
+
+			_result._zones.push_back( std::move(zone) );
+			_zone_files.emplace_back( dir / "temp" );
+		}
+	}
+
+	void
+	take_sample()
+	{
+		sample_t sample;
+		sample._at = run_timeline::steady_clock_t::now();
+
+		for( std::size_t i = 0; i != _freq_files.size(); ++i )
+		{
+			sample._cpu_khz.push_back( impl::to_integer< unsigned long >(
+					_freq_files[ i ].read_value() ) );
+			sample._governors.push_back(
+					_governor_files[ i ].read_value().value_or( "?" ) );
+		}
+
+		for( const auto & f : _zone_files )
+			sample._zone_millicelsius.push_back(
+					impl::to_integer< long >( f.read_value() ) );
+
+		_result._samples.push_back( std::move(sample) );
+	}
+
+	void
+	body( std::stop_token stop )
+	{
+		if( _result._config._sampler_cpu )
+			impl::pin_current_thread( *_result._config._sampler_cpu );
+
+		std::unique_lock lock{ _lock };
+		for(;;)
+		{
+			take_sample();
+			(void)_wakeup_cv.wait_for( lock, stop, _result._config._period,
+					[]{ return false; } );
+			if( stop.stop_requested() )
+				break;
+		}
+
+		// Последний снимок -- уже после остановки рабочих нитей.
+		take_sample();
+	}
+
+public:
+	explicit sampler_t( config_t config )
+	{
+		_result._config = std::move(config);
+		discover();
+		_result._samples.reserve( 1024u );
+
+		_thread = std::jthread{
+				[this]( std::stop_token stop ) { body( stop ); } };
+	}
+
+	~sampler_t()
+	{
+		_thread.request_stop();
+	}
+
+	sampler_t( const sampler_t & ) = delete;
+	sampler_t & operator=( const sampler_t & ) = delete;
+
+	/// Остановить опрос и получить собранные данные.
+	[[nodiscard]] samples_t
+	finish()
+	{
+		_thread.request_stop();
+		_thread.join();
+		return std::move(_result);
+	}
+};
+
+/// Выбрать процессор для нити опроса так, чтобы он не пересекался
+/// с процессорами рабочих нитей.
+///
+/// Берется процессор с наибольшим номером из доступных процессу.
+/// Если все доступные процессоры заняты рабочими нитями, то
+/// возвращается пустое значение.
+[[nodiscard]] inline std::optional< unsigned >
+select_sampler_cpu( const std::vector< unsigned > & worker_cpus )
+{
+	cpu_set_t cpu_set;
+	CPU_ZERO( &cpu_set );
+	if( 0 != sched_getaffinity( 0, sizeof(cpu_set), &cpu_set ) )
+		return std::nullopt;
+
+	for( int cpu = CPU_SETSIZE - 1; cpu >= 0; --cpu )
+		if( CPU_ISSET( cpu, &cpu_set ) &&
+				worker_cpus.end() == std::find(
+						worker_cpus.begin(), worker_cpus.end(),
+						static_cast< unsigned >( cpu ) ) )
+			return static_cast< unsigned >( cpu );
+
+	return std::nullopt;
+}
+
+/// Все процессоры, доступные процессу.
+[[nodiscard]] inline std::vector< unsigned >
+allowed_cpus()
+{
+	std::vector< unsigned > result;
+
+	cpu_set_t cpu_set;
+	CPU_ZERO( &cpu_set );
+	if( 0 == sched_getaffinity( 0, sizeof(cpu_set), &cpu_set ) )
+		for( int cpu = 0; cpu != CPU_SETSIZE; ++cpu )
+			if( CPU_ISSET( cpu, &cpu_set ) )
+				result.push_back( static_cast< unsigned >( cpu ) );
+
+	return result;
+}
+
+namespace impl
+{
+
+[[nodiscard]] inline double
+seconds_between(
+	run_timeline::steady_clock_t::time_point from,
+	run_timeline::steady_clock_t::time_point to )
+{
+	return std::chrono::duration< double >( to - from ).count();
+}
+
+} /* namespace impl */
+
+/// Печать данных о частоте процессора за указанный интервал
+/// (как правило, за время работы одной из нитей).
+///
+/// Снимки, в которых частота была ниже заданной доли от максимальной,
+/// объединяются в интервалы притормаживания. Время интервалов
+/// указывается относительно начала интервала.
+inline void
+report_for_cpu(
+	std::ostream & to,
+	const samples_t & data,
+	const std::string & label,
+	unsigned cpu,
+	const run_timeline::interval_t & interval )
+{
+	const auto & cpus = data._config._cpus;
+	const auto it = std::find( cpus.begin(), cpus.end(), cpu );
+	if( it == cpus.end() )
+		return;
+	const auto cpu_pos = static_cast< std::size_t >( it - cpus.begin() );
+	const auto max_khz = data._cpu_max_khz[ cpu_pos ];
+
+	to << "  " << label << " cpu " << cpu << ": ";
+
+	unsigned long min_khz{}, peak_khz{};
+	double sum_khz{};
+	std::size_t count{};
+	std::size_t throttled{};
+	std::string governor;
+
+	// Интервалы притормаживания, в секундах от старта нити.
+	std::vector< std::pair< double, double > > throttled_intervals;
+	bool in_throttled = false;
+
+	for( const auto & s : data._samples )
+	{
+		if( s._at < interval._started_at || s._at > interval._finished_at )
+			continue;
+
+		const auto khz = s._cpu_khz[ cpu_pos ];
+		if( !khz )
+			continue;
+
+		governor = s._governors[ cpu_pos ];
+		min_khz = count ? std::min( min_khz, *khz ) : *khz;
+		peak_khz = std::max( peak_khz, *khz );
+		sum_khz += static_cast< double >( *khz );
+		++count;
+
+		const double offset = impl::seconds_between(
+				interval._started_at, s._at );
+		const bool is_throttled = max_khz && static_cast< double >( *khz ) <
+				data._config._throttle_fraction * static_cast< double >( *max_khz );
+		if( is_throttled )
+		{
+			++throttled;
+			if( in_throttled )
+				throttled_intervals.back().second = offset;
+			else
+				throttled_intervals.emplace_back( offset, offset );
+		}
+		in_throttled = is_throttled;
+	}
+
+	if( !count )
+	{
+		to << "no frequency samples" << std::endl;
+		return;
+	}
+
+	to << "governor=" << governor
+			<< ", MHz min/avg/max: " << (min_khz / 1000u)
+			<< "/" << static_cast< unsigned long >( sum_khz / count / 1000.0 )
+			<< "/" << (peak_khz / 1000u);
+	if( max_khz )
+		to << " (cpuinfo_max: " << (*max_khz / 1000u) << ")";
+	to << ", samples: " << count;
+
+	if( throttled )
+	{
+		to << ", THROTTLED: " << throttled << " sample(s) in";
+		for( const auto & [from, till] : throttled_intervals )
+			to << std::fixed << std::setprecision(3)
+					<< " [" << from << "s.." << till << "s]"
+					<< std::defaultfloat;
+	}
+
+	to << std::endl;
+}
+
+/// Печать максимальной температуры термозон за время прогона.
+inline void
+report_thermal( std::ostream & to, const samples_t & data )
+{
+	for( std::size_t z = 0; z != data._zones.size(); ++z )
+	{
+		const auto & zone = data._zones[ z ];
+		std::optional< long > peak;
+		for( const auto & s : data._samples )
+			if( const auto t = s._zone_millicelsius[ z ]; t )
+				peak = peak ? std::max( *peak, *t ) : *t;
+
+		to << "  " << zone._name << " (" << zone._type << "): ";
+		if( peak )
+			to << std::fixed << std::setprecision(1)
+					<< "max " << (*peak / 1000.0) << "C" << std::defaultfloat;
+		else
+			to << "n/a";
+
+		if( zone._passive_trip_millicelsius )
+		{
+			to << std::fixed << std::setprecision(1)
+					<< ", passive trip "
+					<< (*zone._passive_trip_millicelsius / 1000.0) << "C"
+					<< std::defaultfloat;
+			if( peak && *peak >= *zone._passive_trip_millicelsius )
+				to << ", TRIP POINT REACHED";
+		}
+
+		to << std::endl;
+	}
+}
+
+} /* namespace sysfs_sampler */
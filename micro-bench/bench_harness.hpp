@@ -0,0 +1,201 @@
+#pragma once
+
+#if defined(__linux__)
+	#include "../linux-affinity/perf_counters.hpp"
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+	#define MICRO_BENCH_HAS_TSC 1
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace micro_bench
+{
+
+/// Не дать компилятору выбросить вычисление значения или
+/// сделать предположения о нем.
+template< typename T >
+inline void
+do_not_optimize( T & value )
+{
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile( "" : "+r,m"(value) : : "memory" );
+#else
+	volatile T * p = &value;
+	(void)*p;
+#endif
+}
+
+/// Результат замера одного случая.
+struct measurement_t
+{
+	std::string _name;
+
+	/// Время на одну операцию в наносекундах.
+	double _ns_per_op{};
+
+	/// Такты на одну операцию (если удалось их посчитать).
+	std::optional< double > _cycles_per_op{};
+};
+
+/// Счетчик тактов процессора.
+///
+/// На Linux используется аппаратный счетчик циклов через perf_event_open,
+/// если он недоступен, то на x86 используется TSC (его частота
+/// фиксирована и может не совпадать с реальной частотой ядра).
+class cycle_counter_t
+{
+#if defined(__linux__)
+	perf_counters::thread_counters_t _perf;
+#endif
+#if defined(MICRO_BENCH_HAS_TSC)
+	std::uint64_t _tsc_started{};
+#endif
+
+	/// Есть ли аппаратный счетчик циклов.
+	bool _has_perf_cycles{ false };
+
+public:
+	cycle_counter_t()
+	{
+#if defined(__linux__)
+		_perf.start();
+		_has_perf_cycles = _perf.stop().get(
+				perf_counters::counter_kind_t::cycles ).has_value();
+#endif
+	}
+
+	[[nodiscard]] std::string
+	source_name() const
+	{
+		if( _has_perf_cycles )
+			return "perf cycles";
+#if defined(MICRO_BENCH_HAS_TSC)
+		return "TSC ticks";
+#else
+		return "n/a";
+#endif
+	}
+
+	void
+	start()
+	{
+#if defined(__linux__)
+		if( _has_perf_cycles )
+		{
+			_perf.start();
+			return;
+		}
+#endif
+#if defined(MICRO_BENCH_HAS_TSC)
+		_tsc_started = __rdtsc();
+#endif
+	}
+
+	[[nodiscard]] std::optional< std::uint64_t >
+	stop()
+	{
+#if defined(__linux__)
+		if( _has_perf_cycles )
+			return _perf.stop().get( perf_counters::counter_kind_t::cycles );
+#endif
+#if defined(MICRO_BENCH_HAS_TSC)
+		return __rdtsc() - _tsc_started;
+#else
+		return std::nullopt;
+#endif
+	}
+};
+
+/// Выполнить замер.
+///
+/// Функция f должна выполнить ops операций. Делается несколько
+/// повторов, в качестве результата берется самый быстрый.
+template< typename F >
+[[nodiscard]] measurement_t
+measure(
+	cycle_counter_t & cycles,
+	std::string name,
+	std::uint64_t ops,
+	F && f )
+{
+	constexpr int repetitions = 5;
+
+	measurement_t result{ std::move(name) };
+	std::optional< double > best_ns;
+	for( int i = 0; i != repetitions; ++i )
+	{
+		const auto started_at = std::chrono::steady_clock::now();
+		cycles.start();
+		f();
+		const auto spent_cycles = cycles.stop();
+		const auto finished_at = std::chrono::steady_clock::now();
+
+		const double ns = std::chrono::duration< double, std::nano >(
+				finished_at - started_at ).count();
+		if( !best_ns || ns < *best_ns )
+		{
+			best_ns = ns;
+			result._ns_per_op = ns / static_cast< double >( ops );
+			if( spent_cycles )
+				result._cycles_per_op = static_cast< double >( *spent_cycles )
+						/ static_cast< double >( ops );
+		}
+	}
+
+	return result;
+}
+
+/// Печать таблицы результатов.
+///
+/// Первая строка считается эталоном, относительно которого
+/// вычисляется коэффициент замедления.
+inline void
+print_table(
+	std::ostream & to,
+	const std::string & title,
+	const std::string & cycles_source,
+	const std::vector< measurement_t > & rows )
+{
+	to << title << " (cycles: " << cycles_source << ")\n"
+			<< "  " << std::left << std::setw( 48 ) << "case" << std::right
+			<< std::setw( 10 ) << "ns/op"
+			<< std::setw( 12 ) << "cycles/op"
+			<< std::setw( 11 ) << "x native" << "\n";
+
+	const double base = rows.empty() ? 0.0 : rows.front()._ns_per_op;
+	for( const auto & r : rows )
+	{
+		to << "  " << std::left << std::setw( 48 ) << r._name << std::right
+				<< std::fixed << std::setprecision( 3 )
+				<< std::setw( 10 ) << r._ns_per_op;
+		to << std::setw( 12 );
+		if( r._cycles_per_op )
+			to << *r._cycles_per_op;
+		else
+			to << "n/a";
+		to << std::setw( 11 );
+		if( base > 0.0 )
+			to << (r._ns_per_op / base);
+		else
+			to << "n/a";
+		to << std::defaultfloat << "\n";
+	}
+
+	to << std::flush;
+}
+
+} /* namespace micro_bench */
@@ -0,0 +1,54 @@
+#include "../no-templates/script_doubles.hpp"
+
+#include "node_benchmarks.hpp"
+
+#include <string>
+
+namespace
+{
+
+/// Описание реализации скрипта без шаблонов для run_node_benchmarks.
+struct no_templates_variant_t
+{
+	using value_t = double;
+	using context_t = script::exec_context_t;
+	using statement_shptr_t = script::statement_shptr_t;
+	using expression_shptr_t = script::logical_expression_shptr_t;
+
+	using assign_to_t = script::statements::assign_to_t;
+	using increment_by_t = script::statements::increment_by_t;
+	using compound_stmt_t = script::statements::compound_stmt_t;
+	using while_loop_t = script::statements::while_loop_t;
+	using less_than_t = script::expressions::less_than_t;
+
+	static void
+	assign( context_t & ctx, const std::string & name, value_t value )
+	{
+		ctx.assign_to( name, value );
+	}
+};
+
+} /* namespace anonymous */
+
+int main(int argc, char ** argv)
+{
+	try
+	{
+		const std::uint64_t ops = (2 == argc) ?
+				std::stoull( argv[1] ) : std::uint64_t{ 5'000'000 };
+
+		micro_bench::cycle_counter_t cycles;
+
+		micro_bench::print_table( std::cout,
+				"no-templates, double, ops: " + std::to_string( ops ),
+				cycles.source_name(),
+				micro_bench::run_node_benchmarks< no_templates_variant_t >(
+						cycles, ops ) );
+	}
+	catch(const std::exception & x)
+	{
+		std::cerr << "main: exception caught: " << x.what() << std::endl;
+	}
+
+	return 0;
+}
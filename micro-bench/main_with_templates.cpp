@@ -0,0 +1,131 @@
+#include "../templated-script/script.hpp"
+#include "../templated-script/verifier.hpp"
+
+#include "node_benchmarks.hpp"
+
+#include <iomanip>
+#include <string>
+
+namespace
+{
+
+/// Описание реализации скрипта на шаблонах для run_node_benchmarks.
+template< typename T >
+struct with_templates_variant_t
+{
+	using value_t = T;
+	using context_t = script::exec_context_t<T>;
+	using statement_shptr_t = script::statement_shptr_t<T>;
+	using expression_shptr_t = script::logical_expression_shptr_t<T>;
+
+	using assign_to_t = script::statements::assign_to_t<T>;
+	using increment_by_t = script::statements::increment_by_t<T>;
+	using compound_stmt_t = script::statements::compound_stmt_t<T>;
+	using while_loop_t = script::statements::while_loop_t<T>;
+	using less_than_t = script::expressions::less_than_t<T>;
+
+	static void
+	assign( context_t & ctx, const std::string & name, T value )
+	{
+		ctx.assign_to( name, value );
+	}
+};
+
+/// Замеры того, какую часть стоимости итерации цикла составляют
+/// проверки наличия переменных, убираемые для проверенных скриптов.
+///
+/// Первая строка -- итерация цикла с проверками, вторая -- та же
+/// итерация без них, третья -- разница между ними.
+template< typename T >
+[[nodiscard]] std::vector< micro_bench::measurement_t >
+run_verification_benchmarks(
+	micro_bench::cycle_counter_t & cycles,
+	std::uint64_t ops )
+{
+	using namespace script::statements;
+	using script::expressions::less_than_t;
+
+	const std::string var_name{ "j" };
+	auto verified = script::verify( script::statement_shptr_t<T>{
+			std::make_shared< while_loop_t<T> >(
+					std::make_shared< less_than_t<T> >(
+							var_name, static_cast< T >( ops ) ),
+					std::make_shared< increment_by_t<T> >( var_name, 1 ) ) },
+			{ var_name } );
+	auto loop = verified.script();
+	micro_bench::do_not_optimize( loop );
+
+	std::vector< micro_bench::measurement_t > rows;
+	rows.push_back( micro_bench::measure( cycles,
+			"while_loop_t iteration, checked", ops, [&] {
+				script::exec_context_t<T> ctx;
+				ctx.assign_to( var_name, 0 );
+				loop->exec( ctx );
+			} ) );
+	rows.push_back( micro_bench::measure( cycles,
+			"while_loop_t iteration, verified (unchecked)", ops, [&] {
+				script::exec_context_t<T> ctx;
+				ctx.assign_to( var_name, 0 );
+				loop->exec_unchecked( ctx );
+			} ) );
+	rows.push_back( micro_bench::impl::difference(
+			"(derived) removed checks", rows[ 0 ], { &rows[ 1 ] } ) );
+
+	return rows;
+}
+
+/// Печать замеров run_verification_benchmarks.
+void
+print_verification_table(
+	const std::string & title,
+	micro_bench::cycle_counter_t & cycles,
+	const std::vector< micro_bench::measurement_t > & rows )
+{
+	micro_bench::print_table( std::cout, title, cycles.source_name(), rows );
+	std::cout << "  removed checks account for " << std::fixed
+			<< std::setprecision( 1 )
+			<< rows[ 2 ]._ns_per_op / rows[ 0 ]._ns_per_op * 100.0
+			<< "% of the per-iteration cost" << std::defaultfloat << std::endl;
+}
+
+} /* namespace anonymous */
+
+int main(int argc, char ** argv)
+{
+	try
+	{
+		const std::uint64_t ops = (2 == argc) ?
+				std::stoull( argv[1] ) : std::uint64_t{ 5'000'000 };
+
+		micro_bench::cycle_counter_t cycles;
+
+		micro_bench::print_table( std::cout,
+				"with-templates, int, ops: " + std::to_string( ops ),
+				cycles.source_name(),
+				micro_bench::run_node_benchmarks<
+						with_templates_variant_t<int> >( cycles, ops ) );
+
+		micro_bench::print_table( std::cout,
+				"with-templates, double, ops: " + std::to_string( ops ),
+				cycles.source_name(),
+				micro_bench::run_node_benchmarks<
+						with_templates_variant_t<double> >( cycles, ops ) );
+
+		print_verification_table(
+				"with-templates, int, verified script, ops: "
+					+ std::to_string( ops ),
+				cycles,
+				run_verification_benchmarks< int >( cycles, ops ) );
+		print_verification_table(
+				"with-templates, double, verified script, ops: "
+					+ std::to_string( ops ),
+				cycles,
+				run_verification_benchmarks< double >( cycles, ops ) );
+	}
+	catch(const std::exception & x)
+	{
+		std::cerr << "main: exception caught: " << x.what() << std::endl;
+	}
+
+	return 0;
+}
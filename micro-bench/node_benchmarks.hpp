@@ -0,0 +1,155 @@
+#pragma once
+
+#include "bench_harness.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace micro_bench
+{
+
+namespace impl
+{
+
+/// Разница между двумя замерами.
+///
+/// Используется для оценки накладных расходов на диспетчеризацию
+/// составных узлов: из стоимости составного узла вычитается стоимость
+/// вложенных в него узлов.
+[[nodiscard]] inline measurement_t
+difference(
+	std::string name,
+	const measurement_t & total,
+	const std::vector< const measurement_t * > & parts )
+{
+	measurement_t result{ std::move(name), total._ns_per_op, total._cycles_per_op };
+	for( const auto * p : parts )
+	{
+		result._ns_per_op -= p->_ns_per_op;
+		if( result._cycles_per_op && p->_cycles_per_op )
+			*result._cycles_per_op -= *p->_cycles_per_op;
+		else
+			result._cycles_per_op.reset();
+	}
+	return result;
+}
+
+} /* namespace impl */
+
+/// Замеры стоимости отдельных видов узлов скрипта.
+///
+/// Variant описывает реализацию скрипта (с шаблонами или без) и
+/// должен содержать следующие имена:
+///
+/// - value_t -- тип значений;
+/// - context_t, statement_shptr_t, expression_shptr_t;
+/// - assign_to_t, increment_by_t, compound_stmt_t, while_loop_t,
+///   less_than_t;
+/// - статический метод assign(context_t &, name, value).
+///
+/// Первой строкой в результатах идет итерация эквивалентного цикла
+/// на чистом C++, она служит эталоном.
+template< typename Variant >
+[[nodiscard]] std::vector< measurement_t >
+run_node_benchmarks(
+	cycle_counter_t & cycles,
+	std::uint64_t ops )
+{
+	using value_t = typename Variant::value_t;
+	using context_t = typename Variant::context_t;
+	using statement_shptr_t = typename Variant::statement_shptr_t;
+	using expression_shptr_t = typename Variant::expression_shptr_t;
+
+	const std::string var_name{ "j" };
+	const auto limit = static_cast< value_t >( ops );
+
+	std::vector< measurement_t > rows;
+
+	// Эталон: тот же цикл, что и в демо-скрипте, но без интерпретатора.
+	rows.push_back( measure( cycles, "native loop iteration", ops, [&] {
+			value_t j{};
+			auto l = limit;
+			do_not_optimize( l );
+			while( j < l )
+			{
+				j += 1;
+				do_not_optimize( j );
+			}
+		} ) );
+
+	// Все узлы хранятся через указатели на базовые типы, а сами
+	// указатели скрываются от оптимизатора, чтобы вызовы не были
+	// девиртуализированы.
+	const auto hide = []( auto ptr ) {
+		do_not_optimize( ptr );
+		return ptr;
+	};
+
+	statement_shptr_t assign = hide( statement_shptr_t{
+			std::make_shared< typename Variant::assign_to_t >( var_name, 0 ) } );
+	rows.push_back( measure( cycles, "assign_to_t", ops, [&] {
+			context_t ctx;
+			for( std::uint64_t i = 0; i != ops; ++i )
+				assign->exec( ctx );
+		} ) );
+
+	statement_shptr_t increment = hide( statement_shptr_t{
+			std::make_shared< typename Variant::increment_by_t >( var_name, 1 ) } );
+	rows.push_back( measure( cycles, "increment_by_t", ops, [&] {
+			context_t ctx;
+			Variant::assign( ctx, var_name, 0 );
+			for( std::uint64_t i = 0; i != ops; ++i )
+				increment->exec( ctx );
+		} ) );
+	const auto increment_row = rows.back();
+
+	expression_shptr_t less_than = hide( expression_shptr_t{
+			std::make_shared< typename Variant::less_than_t >( var_name, limit ) } );
+	rows.push_back( measure( cycles, "less_than_t", ops, [&] {
+			context_t ctx;
+			Variant::assign( ctx, var_name, 0 );
+			unsigned sink{};
+			for( std::uint64_t i = 0; i != ops; ++i )
+				sink += less_than->exec( ctx ) ? 1u : 0u;
+			do_not_optimize( sink );
+		} ) );
+	const auto less_than_row = rows.back();
+
+	statement_shptr_t compound = hide( statement_shptr_t{
+			std::make_shared< typename Variant::compound_stmt_t >(
+					std::vector< statement_shptr_t >{ increment } ) } );
+	rows.push_back( measure( cycles, "compound_stmt_t{ increment_by_t }", ops, [&] {
+			context_t ctx;
+			Variant::assign( ctx, var_name, 0 );
+			for( std::uint64_t i = 0; i != ops; ++i )
+				compound->exec( ctx );
+		} ) );
+	const auto compound_row = rows.back();
+
+	statement_shptr_t loop = hide( statement_shptr_t{
+			std::make_shared< typename Variant::while_loop_t >(
+					less_than, increment ) } );
+	rows.push_back( measure( cycles,
+			"while_loop_t{ less_than_t, increment_by_t }", ops, [&] {
+			context_t ctx;
+			Variant::assign( ctx, var_name, 0 );
+			loop->exec( ctx );
+		} ) );
+	const auto loop_row = rows.back();
+
+	// Оценки накладных расходов на диспетчеризацию составных узлов.
+	// Они приблизительны: в пределах погрешности замеров (и из-за
+	// разного поведения предсказателя переходов) могут быть
+	// отрицательными.
+	rows.push_back( impl::difference(
+			"(derived) compound_stmt_t dispatch",
+			compound_row, { &increment_row } ) );
+	rows.push_back( impl::difference(
+			"(derived) while_loop_t iteration dispatch",
+			loop_row, { &less_than_row, &increment_row } ) );
+
+	return rows;
+}
+
+} /* namespace micro_bench */
@@ -1,3 +1,5 @@
+#include "script_ints.hpp"
+
 #include <chrono>
 #include <iomanip>
 #include <iostream>
@@ -28,204 +30,6 @@
 
 #endif
 
-namespace script
-{
-
-class exec_context_t
-{
-	std::unordered_map<std::string, int> _vars;
-
-public:
-	exec_context_t() = default;
-
-	void
-	assign_to(
-		const std::string & name,
-		int value)
-	{
-		_vars[name] = value;
-	}
-
-	int &
-	get_for_modification(const std::string & name)
-	{
-		auto it = _vars.find(name);
-		if( it == _vars.end() )
-			throw std::runtime_error{ "there is no such variable: " + name };
-
-		return it->second;
-	}
-};
-
-class statement_t : public std::enable_shared_from_this< statement_t >
-{
-public:
-	virtual ~statement_t() = default;
-
-	virtual void
-	exec(exec_context_t & ctx) const = 0;
-};
-
-using statement_shptr_t = std::shared_ptr< statement_t >;
-
-class logical_expression_t
-	: public std::enable_shared_from_this< logical_expression_t >
-{
-public:
-	virtual ~logical_expression_t() = default;
-
-	[[nodiscard]]
-	virtual bool
-	exec(exec_context_t & ctx) const = 0;
-};
-
-using logical_expression_shptr_t = std::shared_ptr< logical_expression_t >;
-
-namespace statements
-{
-
-class compound_stmt_t final : public statement_t
-{
-	const std::vector< statement_shptr_t > _statements;
-
-public:
-	compound_stmt_t(
-		std::vector< statement_shptr_t > statements)
-		: _statements{ std::move(statements) }
-	{}
-
-	void
-	exec(exec_context_t & ctx) const override
-	{
-		for(const auto & stm : _statements)
-			stm->exec(ctx);
-	}
-};
-
-class while_loop_t final : public statement_t
-{
-	const logical_expression_shptr_t _condition;
-	const statement_shptr_t _body;
-
-public:
-	while_loop_t(
-		logical_expression_shptr_t condition,
-		statement_shptr_t body)
-		: _condition{ std::move(condition) }
-		, _body{ std::move(body) }
-	{}
-
-	void
-	exec(exec_context_t & ctx) const override
-	{
-		while( _condition->exec(ctx) )
-		{
-			_body->exec(ctx);
-		}
-	}
-};
-
-class assign_to_t final : public statement_t
-{
-	const std::string _var_name;
-	const int _value;
-
-public:
-	assign_to_t(
-		std::string var_name,
-		int value)
-		: _var_name{ std::move(var_name) }
-		, _value{ value }
-	{}
-
-	void
-	exec(exec_context_t & ctx) const override
-	{
-		ctx.assign_to(_var_name, _value);
-	}
-};
-
-class increment_by_t final : public statement_t
-{
-	const std::string _var_name;
-	const int _value_to_add;
-
-public:
-	increment_by_t(
-		std::string var_name,
-		int value_to_add)
-		: _var_name{ std::move(var_name) }
-		, _value_to_add{ value_to_add }
-	{}
-
-	void
-	exec(exec_context_t & ctx) const override
-	{
-		ctx.get_for_modification(_var_name) += _value_to_add;
-	}
-};
-
-class print_value_t final : public statement_t
-{
-	const std::string _var_name;
-
-public:
-	print_value_t(
-		std::string var_name)
-		: _var_name{ std::move(var_name) }
-	{}
-
-	void
-	exec(exec_context_t & ctx) const override
-	{
-		const auto & v = ctx.get_for_modification(_var_name);
-		std::cout << _var_name << "=" << v << std::endl;
-	}
-};
-
-} /* namespace statements */
-
-namespace expressions
-{
-
-class less_than_t final : public logical_expression_t
-{
-	const std::string _var_name;
-	const int _value;
-
-public:
-	less_than_t(
-		std::string var_name,
-		int value)
-		: _var_name{ std::move(var_name) }
-		, _value{ value }
-	{}
-
-	bool
-	exec(exec_context_t & ctx) const override
-	{
-		return ctx.get_for_modification(_var_name) < _value;
-	}
-};
-
-} /* namespace expressions */
-
-void
-execute(const statement_shptr_t & what)
-{
-	try
-	{
-		exec_context_t ctx;
-		what->exec(ctx);
-	}
-	catch(const std::exception & x)
-	{
-		std::cerr << "exception caught: " << x.what() << std::endl;
-	}
-}
-
-} /* namespace script */
-
 [[nodiscard]] script::statement_shptr_t
 make_demo_script()
 {
@@ -0,0 +1,202 @@
+#pragma once
+
+#if defined(__linux__)
+	#include <sys/mman.h>
+#endif
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace script
+{
+
+/// Выравнивание элементов массивов (размер строки кэша).
+inline constexpr std::size_t array_alignment = 64u;
+
+/// Как на самом деле была выделена память под массив.
+enum class array_memory_kind_t
+{
+	/// Обычная память с выравниванием на array_alignment.
+	regular,
+	/// Память из пула huge pages (MAP_HUGETLB).
+	huge_pages,
+	/// Обычная память, для которой запрошены transparent huge pages.
+	transparent_huge_pages
+};
+
+[[nodiscard]] inline const char *
+to_string( array_memory_kind_t kind )
+{
+	switch( kind )
+	{
+	case array_memory_kind_t::regular: return "regular";
+	case array_memory_kind_t::huge_pages: return "huge pages";
+	case array_memory_kind_t::transparent_huge_pages:
+		return "transparent huge pages";
+	}
+	return "unknown";
+}
+
+/// Непрерывный массив значений типа T с выравниванием на
+/// array_alignment.
+///
+/// Если запрошены huge pages, то на Linux сперва делается попытка
+/// взять память из пула huge pages, а если это не удалось, то память
+/// выравнивается на размер huge page и для нее запрашиваются
+/// transparent huge pages. На других платформах huge pages не
+/// используются.
+template< typename T >
+class array_storage_t
+{
+	static_assert( std::is_trivially_copyable_v< T > );
+
+	/// Размер huge page, на который выравнивается память.
+	static constexpr std::size_t huge_page_size = 2u * 1024u * 1024u;
+
+	T * _data{ nullptr };
+	std::size_t _size{};
+
+	/// Сколько байт было выделено на самом деле.
+	std::size_t _allocated_bytes{};
+
+	array_memory_kind_t _kind{ array_memory_kind_t::regular };
+
+	void
+	allocate( bool huge_pages )
+	{
+		const std::size_t bytes = _size * sizeof(T);
+		if( !bytes )
+			return;
+
+#if defined(__linux__)
+		if( huge_pages )
+		{
+			const std::size_t rounded =
+					(bytes + huge_page_size - 1u) / huge_page_size * huge_page_size;
+
+			if( void * p = mmap( nullptr, rounded,
+					PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+					MAP_FAILED != p )
+			{
+				_data = static_cast< T * >( p );
+				_allocated_bytes = rounded;
+				_kind = array_memory_kind_t::huge_pages;
+				return;
+			}
+
+			if( void * p = std::aligned_alloc( huge_page_size, rounded ) )
+			{
+				(void)madvise( p, rounded, MADV_HUGEPAGE );
+				_data = static_cast< T * >( p );
+				_allocated_bytes = rounded;
+				_kind = array_memory_kind_t::transparent_huge_pages;
+				return;
+			}
+
+			throw std::bad_alloc{};
+		}
+#else
+		(void)huge_pages;
+#endif
+
+		_data = static_cast< T * >( ::operator new(
+				bytes, std::align_val_t{ array_alignment } ) );
+		_allocated_bytes = bytes;
+		_kind = array_memory_kind_t::regular;
+	}
+
+	void
+	release() noexcept
+	{
+		if( !_data )
+			return;
+
+		switch( _kind )
+		{
+		case array_memory_kind_t::regular:
+			::operator delete( _data, std::align_val_t{ array_alignment } );
+		break;
+
+#if defined(__linux__)
+		case array_memory_kind_t::huge_pages:
+			(void)munmap( _data, _allocated_bytes );
+		break;
+#endif
+
+		default:
+			std::free( _data );
+		}
+
+		_data = nullptr;
+	}
+
+public:
+	array_storage_t(
+		std::size_t size,
+		T initial_value,
+		bool huge_pages )
+		: _size{ size }
+	{
+		allocate( huge_pages );
+		std::uninitialized_fill_n( _data, _size, initial_value );
+	}
+
+	~array_storage_t()
+	{
+		release();
+	}
+
+	array_storage_t( array_storage_t && other ) noexcept
+		: _data{ std::exchange( other._data, nullptr ) }
+		, _size{ std::exchange( other._size, 0u ) }
+		, _allocated_bytes{ std::exchange( other._allocated_bytes, 0u ) }
+		, _kind{ other._kind }
+	{}
+
+	array_storage_t &
+	operator=( array_storage_t && other ) noexcept
+	{
+		if( this != &other )
+		{
+			release();
+			_data = std::exchange( other._data, nullptr );
+			_size = std::exchange( other._size, 0u );
+			_allocated_bytes = std::exchange( other._allocated_bytes, 0u );
+			_kind = other._kind;
+		}
+		return *this;
+	}
+
+	array_storage_t( const array_storage_t & ) = delete;
+	array_storage_t & operator=( const array_storage_t & ) = delete;
+
+	[[nodiscard]] std::size_t
+	size() const noexcept { return _size; }
+
+	[[nodiscard]] array_memory_kind_t
+	memory_kind() const noexcept { return _kind; }
+
+	[[nodiscard]] T *
+	data() noexcept { return _data; }
+
+	[[nodiscard]] const T *
+	data() const noexcept { return _data; }
+
+	/// Доступ к элементу с проверкой индекса.
+	[[nodiscard]] T &
+	at( std::size_t index, const std::string & array_name )
+	{
+		if( index >= _size )
+			throw std::runtime_error{ "index " + std::to_string( index )
+					+ " is out of range for array: " + array_name };
+		return _data[ index ];
+	}
+};
+
+} /* namespace script */
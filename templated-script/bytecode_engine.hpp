@@ -0,0 +1,485 @@
+#pragma once
+
+#include "engine.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <syncstream>
+#include <vector>
+
+namespace script
+{
+
+namespace engines
+{
+
+/// Компиляция скрипта в байткод.
+///
+/// Дерево скрипта переводится в плоскую последовательность команд, а
+/// имена переменных и массивов -- в номера слотов. При выполнении
+/// значения переменных хранятся в массиве слотов, поэтому поиска в
+/// словарях exec_context_t нет совсем, а виртуальные вызовы узлов
+/// заменяются одним switch.
+///
+/// Перед выполнением в слоты загружаются значения переменных, которые
+/// уже есть в контексте (например, входные колонки), после выполнения
+/// (в том числе прерванного исключением) все получившие значения
+/// переменные и все созданные массивы переносятся в контекст.
+///
+/// Разделяемые переменные не поддерживаются. Итерации циклов
+/// учитываются для progress::loop_tracker_t, но отдельные циклы на
+/// временной шкале trace_events не отмечаются.
+///
+/// Выполнение можно приостановить на переходе назад в начало цикла и
+/// продолжить с той же команды позже (см. checkpoint.hpp).
+namespace bytecode
+{
+
+enum class opcode_t : std::uint8_t
+{
+	/// vars[_var] = _value.
+	assign,
+	/// vars[_var] += _value.
+	increment,
+	/// Печать vars[_var].
+	print,
+	/// Создание массива arrays[_array] из _size значений _value.
+	allocate_array,
+	/// arrays[_array][vars[_var]] = _value.
+	store_at,
+	/// arrays[_array][vars[_var]] += _value.
+	increment_at,
+	/// Переход на _target, если не vars[_var] < _value.
+	jump_unless_less,
+	/// Переход на _target, если не arrays[_array][vars[_var]] < _value.
+	jump_unless_element_less,
+	/// Переход на _target в начало цикла.
+	jump_back,
+	/// Конец программы.
+	halt
+};
+
+template< typename T >
+struct instruction_t
+{
+	opcode_t _op{ opcode_t::halt };
+
+	/// Слот переменной, для операций с массивами -- слот индекса.
+	std::uint32_t _var{};
+
+	/// Слот массива.
+	std::uint32_t _array{};
+
+	/// Номер команды для переходов.
+	std::uint32_t _target{};
+
+	T _value{};
+
+	/// Размер создаваемого массива.
+	std::size_t _size{};
+
+	/// Нужно ли размещать создаваемый массив в huge pages.
+	bool _huge_pages{ false };
+};
+
+template< typename T >
+struct program_t
+{
+	std::vector< instruction_t<T> > _code;
+
+	/// Имена переменных по номерам слотов.
+	std::vector< std::string > _var_names;
+
+	/// Имена массивов по номерам слотов.
+	std::vector< std::string > _array_names;
+};
+
+namespace impl
+{
+
+/// Перевод дерева скрипта в программу.
+///
+/// Обход узлов такой же, как в verifier::impl::analyzer_t.
+template< typename T >
+class compiler_t
+{
+	program_t<T> & _program;
+
+	std::map< std::string, std::uint32_t > _var_slots;
+	std::map< std::string, std::uint32_t > _array_slots;
+
+	[[nodiscard]] static std::uint32_t
+	slot_of(
+		std::map< std::string, std::uint32_t > & slots,
+		std::vector< std::string > & names,
+		const std::string & name )
+	{
+		const auto [it, inserted] = slots.emplace(
+				name, static_cast< std::uint32_t >( names.size() ) );
+		if( inserted )
+			names.push_back( name );
+		return it->second;
+	}
+
+	[[nodiscard]] std::uint32_t
+	var( const std::string & name )
+	{
+		return slot_of( _var_slots, _program._var_names, name );
+	}
+
+	[[nodiscard]] std::uint32_t
+	array( const std::string & name )
+	{
+		return slot_of( _array_slots, _program._array_names, name );
+	}
+
+	[[nodiscard]] std::uint32_t
+	here() const noexcept
+	{
+		return static_cast< std::uint32_t >( _program._code.size() );
+	}
+
+	void
+	emit( instruction_t<T> instruction )
+	{
+		_program._code.push_back( std::move(instruction) );
+	}
+
+	void
+	compile_condition( const logical_expression_shptr_t<T> & what )
+	{
+		namespace expr = expressions;
+		const auto * node = what.get();
+
+		instruction_t<T> i;
+		if( const auto * lt = dynamic_cast< const expr::less_than_t<T> * >( node ) )
+		{
+			i._op = opcode_t::jump_unless_less;
+			i._var = var( lt->var_name() );
+			i._value = lt->value();
+		}
+		else if( const auto * e = dynamic_cast<
+				const expr::element_less_than_t<T> * >( node ) )
+		{
+			i._op = opcode_t::jump_unless_element_less;
+			i._array = array( e->array_name() );
+			i._var = var( e->index_var_name() );
+			i._value = e->value();
+		}
+		else
+			throw std::invalid_argument{
+					"bytecode engine: unsupported expression node" };
+
+		emit( i );
+	}
+
+public:
+	explicit compiler_t( program_t<T> & program ) : _program{ program } {}
+
+	void
+	compile( const statement_shptr_t<T> & what )
+	{
+		namespace stm = statements;
+		const auto * node = what.get();
+
+		instruction_t<T> i;
+		if( const auto * c = dynamic_cast< const stm::compound_stmt_t<T> * >( node ) )
+		{
+			for( const auto & s : c->statements() )
+				compile( s );
+			return;
+		}
+		else if( const auto * w = dynamic_cast< const stm::while_loop_t<T> * >( node ) )
+		{
+			// Условие в начале цикла, переход назад в конце тела.
+			const auto head = here();
+			compile_condition( w->condition() );
+			compile( w->body() );
+
+			i._op = opcode_t::jump_back;
+			i._target = head;
+			emit( i );
+
+			_program._code[ head ]._target = here();
+			return;
+		}
+		else if( const auto * a = dynamic_cast< const stm::assign_to_t<T> * >( node ) )
+		{
+			i._op = opcode_t::assign;
+			i._var = var( a->var_name() );
+			i._value = a->value();
+		}
+		else if( const auto * inc = dynamic_cast< const stm::increment_by_t<T> * >( node ) )
+		{
+			i._op = opcode_t::increment;
+			i._var = var( inc->var_name() );
+			i._value = inc->value_to_add();
+		}
+		else if( const auto * p = dynamic_cast< const stm::print_value_t<T> * >( node ) )
+		{
+			i._op = opcode_t::print;
+			i._var = var( p->var_name() );
+		}
+		else if( const auto * aa = dynamic_cast<
+				const stm::allocate_array_t<T> * >( node ) )
+		{
+			i._op = opcode_t::allocate_array;
+			i._array = array( aa->array_name() );
+			i._size = aa->size();
+			i._value = aa->initial_value();
+			i._huge_pages = aa->huge_pages();
+		}
+		else if( const auto * st = dynamic_cast< const stm::store_at_t<T> * >( node ) )
+		{
+			i._op = opcode_t::store_at;
+			i._array = array( st->array_name() );
+			i._var = var( st->index_var_name() );
+			i._value = st->value();
+		}
+		else if( const auto * ia = dynamic_cast<
+				const stm::increment_at_t<T> * >( node ) )
+		{
+			i._op = opcode_t::increment_at;
+			i._array = array( ia->array_name() );
+			i._var = var( ia->index_var_name() );
+			i._value = ia->value_to_add();
+		}
+		else
+			throw std::invalid_argument{
+					"bytecode engine: unsupported statement node" };
+
+		emit( i );
+	}
+};
+
+} /* namespace impl */
+
+/// Скомпилировать скрипт.
+template< typename T >
+[[nodiscard]] program_t<T>
+compile( const statement_shptr_t<T> & what )
+{
+	program_t<T> result;
+	impl::compiler_t<T>{ result }.compile( what );
+
+	instruction_t<T> halt;
+	halt._op = opcode_t::halt;
+	result._code.push_back( halt );
+
+	return result;
+}
+
+/// Скомпилированный скрипт.
+template< typename T >
+class prepared_t final : public prepared_script_t<T>
+{
+	const program_t<T> _program;
+
+	using arrays_t = std::vector< std::optional< array_storage_t<T> > >;
+
+	/// Элемент массива, индекс которого хранится в слоте.
+	///
+	/// Проверки и тексты исключений такие же, как в
+	/// exec_context_t::get_element_ref_unchecked.
+	[[nodiscard]] T &
+	element(
+		const instruction_t<T> & i,
+		T * vars,
+		arrays_t & arrays ) const
+	{
+		const T index = vars[ i._var ];
+		if( index < T{} )
+			throw std::runtime_error{ "negative index in variable: "
+					+ _program._var_names[ i._var ] };
+
+		return arrays[ i._array ]->at(
+				static_cast< std::size_t >( index ),
+				_program._array_names[ i._array ] );
+	}
+
+	/// Выполнение команд, начиная с pc.
+	///
+	/// Если Pausable и выставлен pause_requested, то выполнение
+	/// останавливается на ближайшем переходе назад в начало цикла.
+	/// Возвращает номер команды, с которой нужно продолжить, или пусто,
+	/// если программа выполнена до конца.
+	template< bool Pausable >
+	[[nodiscard]] std::optional< std::uint32_t >
+	interpret(
+		std::uint32_t pc,
+		T * vars,
+		std::vector< char > & assigned,
+		arrays_t & arrays,
+		[[maybe_unused]] const std::atomic< bool > * pause_requested ) const
+	{
+		progress::loop_tracker_t progress_tracker;
+
+		const auto * code = _program._code.data();
+		for(;;)
+		{
+			const auto & i = code[ pc ];
+			switch( i._op )
+			{
+			case opcode_t::assign:
+				vars[ i._var ] = i._value;
+				assigned[ i._var ] = 1;
+				++pc;
+			break;
+
+			case opcode_t::increment:
+				vars[ i._var ] += i._value;
+				++pc;
+			break;
+
+			case opcode_t::print:
+				std::osyncstream{ std::cout }
+						<< _program._var_names[ i._var ] << "="
+						<< vars[ i._var ] << std::endl;
+				++pc;
+			break;
+
+			case opcode_t::allocate_array:
+				arrays[ i._array ].emplace( i._size, i._value, i._huge_pages );
+				++pc;
+			break;
+
+			case opcode_t::store_at:
+				element( i, vars, arrays ) = i._value;
+				++pc;
+			break;
+
+			case opcode_t::increment_at:
+				element( i, vars, arrays ) += i._value;
+				++pc;
+			break;
+
+			case opcode_t::jump_unless_less:
+				pc = vars[ i._var ] < i._value ? pc + 1u : i._target;
+			break;
+
+			case opcode_t::jump_unless_element_less:
+				pc = element( i, vars, arrays ) < i._value ? pc + 1u : i._target;
+			break;
+
+			case opcode_t::jump_back:
+				progress_tracker.on_back_edge();
+				if constexpr( Pausable )
+					if( pause_requested->load( std::memory_order_relaxed ) )
+						return i._target;
+				pc = i._target;
+			break;
+
+			case opcode_t::halt:
+				return std::nullopt;
+			}
+		}
+	}
+
+	/// Перенести переменные и массивы в контекст.
+	void
+	write_back(
+		exec_context_t<T> & ctx,
+		const std::vector< T > & vars,
+		const std::vector< char > & assigned,
+		arrays_t & arrays ) const
+	{
+		for( std::size_t i = 0; i != vars.size(); ++i )
+			if( assigned[ i ] )
+				ctx.assign_to( _program._var_names[ i ], vars[ i ] );
+		for( std::size_t i = 0; i != arrays.size(); ++i )
+			if( arrays[ i ] )
+				ctx.put_array( _program._array_names[ i ], std::move(*arrays[ i ]) );
+	}
+
+public:
+	explicit prepared_t( program_t<T> program )
+		: _program{ std::move(program) }
+	{}
+
+	[[nodiscard]] const program_t<T> &
+	program() const noexcept { return _program; }
+
+	void
+	run( exec_context_t<T> & ctx ) const override
+	{
+		(void)run_from( ctx, 0u, nullptr );
+	}
+
+	/// Выполнить программу, начиная с команды start_pc.
+	///
+	/// Переменные и массивы берутся из контекста и возвращаются в него
+	/// по завершении или остановке. Если pause_requested не пуст, то
+	/// выполнение можно остановить, выставив его (см. interpret).
+	[[nodiscard]] std::optional< std::uint32_t >
+	run_from(
+		exec_context_t<T> & ctx,
+		std::uint32_t start_pc,
+		const std::atomic< bool > * pause_requested ) const
+	{
+		if( ctx.has_shared() )
+			throw std::invalid_argument{
+					"bytecode engine doesn't support shared variables" };
+		if( start_pc >= _program._code.size() )
+			throw std::invalid_argument{
+					"bytecode engine: start position is out of the program" };
+
+		std::vector< T > vars( _program._var_names.size() );
+		std::vector< char > assigned( vars.size(), 0 );
+		for( std::size_t i = 0; i != vars.size(); ++i )
+			if( const T * v = ctx.find_var( _program._var_names[ i ] ) )
+			{
+				vars[ i ] = *v;
+				assigned[ i ] = 1;
+			}
+
+		arrays_t arrays( _program._array_names.size() );
+		for( std::size_t i = 0; i != arrays.size(); ++i )
+			arrays[ i ] = ctx.take_array( _program._array_names[ i ] );
+
+		std::optional< std::uint32_t > paused_at;
+		try
+		{
+			paused_at = pause_requested
+					? interpret< true >(
+							start_pc, vars.data(), assigned, arrays, pause_requested )
+					: interpret< false >(
+							start_pc, vars.data(), assigned, arrays, nullptr );
+		}
+		catch( ... )
+		{
+			write_back( ctx, vars, assigned, arrays );
+			throw;
+		}
+		write_back( ctx, vars, assigned, arrays );
+
+		return paused_at;
+	}
+};
+
+} /* namespace bytecode */
+
+/// Компиляция в байткод (см. bytecode::prepared_t).
+template< typename T >
+class bytecode_engine_t final : public engine_t<T>
+{
+public:
+	[[nodiscard]]
+	std::string_view
+	name() const noexcept override { return "bytecode"; }
+
+	[[nodiscard]]
+	prepared_script_shptr_t<T>
+	prepare( const verified_script_t<T> & what ) const override
+	{
+		return std::make_shared< bytecode::prepared_t<T> >(
+				bytecode::compile( what.script() ) );
+	}
+};
+
+} /* namespace engines */
+
+} /* namespace script */
@@ -0,0 +1,321 @@
+#pragma once
+
+#include "bytecode_engine.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace script
+{
+
+/// Приостановка выполнения скрипта и его продолжение со снимка.
+///
+/// Выполнение останавливается только на переходе назад в начало цикла
+/// while_loop_t: там все узлы тела уже завершены, и позицию в
+/// программе описывает один номер команды. Поэтому приостановка
+/// поддерживается только для скриптов, скомпилированных в байткод (при
+/// обходе дерева позиция -- это стек вызовов exec_unchecked).
+///
+/// Снимок состоит из позиции и всех переменных и массивов
+/// exec_context_t. Значения хранятся в представлении машины, на
+/// которой снимок сделан, поэтому продолжить выполнение можно в другой
+/// нити или другом процессе на машине той же архитектуры.
+namespace checkpoint
+{
+
+/// Где остановлено выполнение.
+struct position_t
+{
+	/// Отпечаток программы, для которой действительна позиция.
+	std::uint64_t _program_fingerprint{};
+
+	/// Номер команды проверки условия цикла, с которой нужно продолжить.
+	std::uint32_t _pc{};
+};
+
+/// Отпечаток программы: FNV-1a по всем командам и именам.
+///
+/// Снимок можно применить только к той же программе.
+template< typename T >
+[[nodiscard]] std::uint64_t
+fingerprint( const engines::bytecode::program_t<T> & program )
+{
+	std::uint64_t hash = 14695981039346656037ull;
+	const auto mix = [&hash]( const void * data, std::size_t size ) {
+		const auto * bytes = static_cast< const unsigned char * >( data );
+		for( std::size_t i = 0; i != size; ++i )
+		{
+			hash ^= bytes[ i ];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	for( const auto & i : program._code )
+	{
+		mix( &i._op, sizeof(i._op) );
+		mix( &i._var, sizeof(i._var) );
+		mix( &i._array, sizeof(i._array) );
+		mix( &i._target, sizeof(i._target) );
+		mix( &i._value, sizeof(i._value) );
+		mix( &i._size, sizeof(i._size) );
+		mix( &i._huge_pages, sizeof(i._huge_pages) );
+	}
+	for( const auto * names : { &program._var_names, &program._array_names } )
+		for( const auto & n : *names )
+		{
+			mix( n.data(), n.size() );
+			mix( "", 1u );
+		}
+
+	return hash;
+}
+
+/// Выполнить скомпилированный скрипт с возможностью приостановки.
+///
+/// Если from задан, то выполнение продолжается с этой позиции, а
+/// переменные и массивы уже должны быть в ctx (см. restore).
+///
+/// Возвращает позицию, если выполнение было приостановлено выставлением
+/// pause_requested, или пусто, если скрипт выполнен до конца. В обоих
+/// случаях переменные и массивы находятся в ctx.
+template< typename T >
+[[nodiscard]] std::optional< position_t >
+run_pausable(
+	const engines::bytecode::prepared_t<T> & what,
+	exec_context_t<T> & ctx,
+	const std::atomic< bool > & pause_requested,
+	std::optional< position_t > from = std::nullopt )
+{
+	using engines::bytecode::opcode_t;
+
+	const auto & program = what.program();
+	const auto program_fingerprint = fingerprint( program );
+
+	std::uint32_t start_pc = 0u;
+	if( from )
+	{
+		if( from->_program_fingerprint != program_fingerprint )
+			throw std::invalid_argument{
+					"checkpoint: the snapshot was taken for another script" };
+		// Продолжать можно только с проверки условия цикла.
+		if( from->_pc >= program._code.size()
+				|| (opcode_t::jump_unless_less != program._code[ from->_pc ]._op
+					&& opcode_t::jump_unless_element_less
+							!= program._code[ from->_pc ]._op) )
+			throw std::invalid_argument{
+					"checkpoint: the snapshot position isn't a loop head" };
+		start_pc = from->_pc;
+	}
+
+	if( const auto pc = what.run_from( ctx, start_pc, &pause_requested ) )
+		return position_t{ program_fingerprint, *pc };
+	return std::nullopt;
+}
+
+namespace impl
+{
+
+/// Сигнатура и версия формата снимка.
+inline constexpr std::uint32_t magic = 0x504b4353u; // "SCKP"
+inline constexpr std::uint32_t version = 1u;
+
+class writer_t
+{
+	std::string & _to;
+
+public:
+	explicit writer_t( std::string & to ) : _to{ to } {}
+
+	template< typename V >
+	void
+	value( const V & v )
+	{
+		static_assert( std::is_trivially_copyable_v< V > );
+		_to.append( reinterpret_cast< const char * >( &v ), sizeof(V) );
+	}
+
+	void
+	bytes( const void * data, std::size_t size )
+	{
+		_to.append( static_cast< const char * >( data ), size );
+	}
+
+	void
+	string( std::string_view s )
+	{
+		value( static_cast< std::uint32_t >( s.size() ) );
+		bytes( s.data(), s.size() );
+	}
+};
+
+class reader_t
+{
+	std::string_view _from;
+
+	void
+	need( std::size_t size ) const
+	{
+		if( _from.size() < size )
+			throw std::runtime_error{ "checkpoint: truncated snapshot" };
+	}
+
+public:
+	explicit reader_t( std::string_view from ) : _from{ from } {}
+
+	template< typename V >
+	[[nodiscard]] V
+	value()
+	{
+		static_assert( std::is_trivially_copyable_v< V > );
+		need( sizeof(V) );
+		V v;
+		std::memcpy( &v, _from.data(), sizeof(V) );
+		_from.remove_prefix( sizeof(V) );
+		return v;
+	}
+
+	void
+	bytes( void * to, std::size_t size )
+	{
+		need( size );
+		std::memcpy( to, _from.data(), size );
+		_from.remove_prefix( size );
+	}
+
+	[[nodiscard]] std::string
+	string()
+	{
+		const auto size = value< std::uint32_t >();
+		need( size );
+		std::string result{ _from.substr( 0, size ) };
+		_from.remove_prefix( size );
+		return result;
+	}
+
+	[[nodiscard]] bool
+	empty() const noexcept { return _from.empty(); }
+};
+
+/// Описание типа значений, чтобы снимок для int не был применен к
+/// double.
+template< typename T >
+[[nodiscard]] constexpr std::uint32_t
+value_type_tag() noexcept
+{
+	return static_cast< std::uint32_t >( sizeof(T) )
+			| (std::is_floating_point_v< T > ? 0x100u : 0u)
+			| (std::is_signed_v< T > ? 0x200u : 0u);
+}
+
+} /* namespace impl */
+
+/// Что вошло в снимок.
+struct snapshot_info_t
+{
+	std::size_t _vars{};
+	std::size_t _arrays{};
+	std::size_t _array_elements{};
+};
+
+/// Сериализовать позицию и содержимое контекста.
+template< typename T >
+[[nodiscard]] std::string
+serialize(
+	const position_t & position,
+	const exec_context_t<T> & ctx,
+	snapshot_info_t * info = nullptr )
+{
+	std::string result;
+	impl::writer_t out{ result };
+
+	out.value( impl::magic );
+	out.value( impl::version );
+	out.value( impl::value_type_tag<T>() );
+	out.value( position._program_fingerprint );
+	out.value( position._pc );
+
+	snapshot_info_t counts;
+	ctx.for_each_var( [&]( std::string_view, const T & ) { ++counts._vars; } );
+	ctx.for_each_array( [&]( std::string_view, const array_storage_t<T> & a ) {
+			++counts._arrays;
+			counts._array_elements += a.size();
+		} );
+
+	out.value( static_cast< std::uint32_t >( counts._vars ) );
+	ctx.for_each_var( [&]( std::string_view name, const T & value ) {
+			out.string( name );
+			out.value( value );
+		} );
+
+	out.value( static_cast< std::uint32_t >( counts._arrays ) );
+	ctx.for_each_array( [&]( std::string_view name,
+			const array_storage_t<T> & a ) {
+			out.string( name );
+			out.value( static_cast< std::uint8_t >(
+					array_memory_kind_t::regular != a.memory_kind() ) );
+			out.value( static_cast< std::uint64_t >( a.size() ) );
+			out.bytes( a.data(), a.size() * sizeof(T) );
+		} );
+
+	if( info )
+		*info = counts;
+	return result;
+}
+
+/// Восстановить контекст из снимка и получить позицию, с которой
+/// нужно продолжить выполнение (см. run_pausable).
+template< typename T >
+[[nodiscard]] position_t
+restore( std::string_view snapshot, exec_context_t<T> & ctx )
+{
+	impl::reader_t in{ snapshot };
+
+	if( impl::magic != in.value< std::uint32_t >() )
+		throw std::runtime_error{ "checkpoint: not a snapshot" };
+	if( impl::version != in.value< std::uint32_t >() )
+		throw std::runtime_error{ "checkpoint: unsupported snapshot version" };
+	if( impl::value_type_tag<T>() != in.value< std::uint32_t >() )
+		throw std::runtime_error{
+				"checkpoint: the snapshot was taken for another value type" };
+
+	position_t position;
+	position._program_fingerprint = in.value< std::uint64_t >();
+	position._pc = in.value< std::uint32_t >();
+
+	const auto vars = in.value< std::uint32_t >();
+	for( std::uint32_t i = 0; i != vars; ++i )
+	{
+		const auto name = in.string();
+		ctx.assign_to( name, in.value< T >() );
+	}
+
+	const auto arrays = in.value< std::uint32_t >();
+	for( std::uint32_t i = 0; i != arrays; ++i )
+	{
+		const auto name = in.string();
+		const bool huge_pages = 0u != in.value< std::uint8_t >();
+		const auto size = in.value< std::uint64_t >();
+		if( size > snapshot.size() / sizeof(T) )
+			throw std::runtime_error{ "checkpoint: truncated snapshot" };
+
+		array_storage_t<T> storage{
+				static_cast< std::size_t >( size ), T{}, huge_pages };
+		in.bytes( storage.data(), storage.size() * sizeof(T) );
+		ctx.put_array( name, std::move(storage) );
+	}
+
+	if( !in.empty() )
+		throw std::runtime_error{ "checkpoint: unexpected data after snapshot" };
+
+	return position;
+}
+
+} /* namespace checkpoint */
+
+} /* namespace script */
@@ -2,31 +2,220 @@
 
 #include "script.hpp"
 
+#include <memory_resource>
+
+/// Сколько итераций цикла выполняет демо-скрипт.
+inline constexpr long long demo_script_loop_iterations = 1'000'000'000;
+
 template< typename T >
 [[nodiscard]] script::statement_shptr_t<T>
-make_demo_script()
+make_demo_script(
+	std::pmr::memory_resource * resource = std::pmr::get_default_resource() )
 {
 	static const std::string var_name{ "j" };
 
 	std::vector< script::statement_shptr_t<T> > statements;
 
 	statements.push_back(
-			std::make_shared< script::statements::assign_to_t<T> >(
+			script::make_node< script::statements::assign_to_t<T> >( resource,
 					var_name, 0));
 	statements.push_back(
-			std::make_shared< script::statements::while_loop_t<T> >(
-					std::make_shared< script::expressions::less_than_t<T> >(
+			script::make_node< script::statements::while_loop_t<T> >( resource,
+					script::make_node< script::expressions::less_than_t<T> >( resource,
 							var_name,
-							1'000'000'000),
-					std::make_shared< script::statements::increment_by_t<T> >(
+							static_cast<T>(demo_script_loop_iterations)),
+					script::make_node< script::statements::increment_by_t<T> >( resource,
 							var_name, 1)
 			)
 	);
 	statements.push_back(
-			std::make_shared< script::statements::print_value_t<T> >(
+			script::make_node< script::statements::print_value_t<T> >( resource,
 					var_name));
 
-	return std::make_shared< script::statements::compound_stmt_t<T> >(
+	return script::make_node< script::statements::compound_stmt_t<T> >( resource,
 			std::move(statements));
 }
 
+
+/// Параметры демо-скрипта для работы с массивом.
+struct array_demo_params_t
+{
+	/// Количество элементов массива.
+	std::size_t _elements{};
+
+	/// Сколько раз массив обрабатывается целиком.
+	unsigned _passes{ 1 };
+
+	/// Нужно ли размещать массив в huge pages.
+	bool _huge_pages{ false };
+};
+
+/// Сколько итераций циклов выполняет демо-скрипт для работы с массивом.
+///
+/// За каждый проход выполняется запись всех элементов, увеличение
+/// всех элементов и поиск граничного значения в последнем элементе.
+[[nodiscard]] inline long long
+array_demo_script_loop_iterations( const array_demo_params_t & params )
+{
+	const auto n = static_cast< long long >( params._elements );
+	return (3 * n - 1) * static_cast< long long >( params._passes );
+}
+
+/// Сколько байт памяти читает и записывает демо-скрипт для работы
+/// с массивом.
+///
+/// Учитываются заполнение массива при создании (запись), запись
+/// всех элементов, увеличение (чтение и запись) и поиск (чтение).
+/// Чтение строк кэша перед записью не учитывается.
+template< typename T >
+[[nodiscard]] double
+array_demo_script_bytes( const array_demo_params_t & params )
+{
+	const double array_bytes = static_cast< double >(
+			params._elements * sizeof(T) );
+	return array_bytes * (1.0 + 4.0 * static_cast< double >( params._passes ));
+}
+
+template< typename T >
+[[nodiscard]] script::statement_shptr_t<T>
+make_array_demo_script(
+	const array_demo_params_t & params,
+	std::pmr::memory_resource * resource = std::pmr::get_default_resource() )
+{
+	if( params._elements < 2u )
+		throw std::invalid_argument{
+				"make_array_demo_script: at least 2 elements are required" };
+
+	static const std::string array_name{ "a" };
+	static const std::string index_name{ "i" };
+	static const std::string pass_name{ "p" };
+
+	using namespace script::statements;
+	using script::expressions::less_than_t;
+	using script::expressions::element_less_than_t;
+
+	const auto elements = static_cast<T>( params._elements );
+	// После записи и увеличения все элементы равны 2, в последний
+	// элемент записывается граничное значение.
+	const T stored_value = 1;
+	const T sentinel = 3;
+
+	const auto index_loop = [&]( script::statement_shptr_t<T> body ) {
+		return script::make_node< compound_stmt_t<T> >( resource,
+				std::vector< script::statement_shptr_t<T> >{
+					script::make_node< assign_to_t<T> >( resource, index_name, 0 ),
+					script::make_node< while_loop_t<T> >( resource,
+							script::make_node< less_than_t<T> >( resource,
+									index_name, elements ),
+							script::make_node< compound_stmt_t<T> >( resource,
+									std::vector< script::statement_shptr_t<T> >{
+										std::move(body),
+										script::make_node< increment_by_t<T> >( resource,
+												index_name, 1 )
+									} ) )
+				} );
+	};
+
+	std::vector< script::statement_shptr_t<T> > pass;
+	pass.push_back( index_loop( script::make_node< store_at_t<T> >( resource,
+			array_name, index_name, stored_value ) ) );
+	pass.push_back( index_loop( script::make_node< increment_at_t<T> >( resource,
+			array_name, index_name, 1 ) ) );
+	pass.push_back( script::make_node< assign_to_t<T> >( resource,
+			index_name, elements - 1 ) );
+	pass.push_back( script::make_node< store_at_t<T> >( resource,
+			array_name, index_name, sentinel ) );
+	pass.push_back( script::make_node< assign_to_t<T> >( resource, index_name, 0 ) );
+	pass.push_back( script::make_node< while_loop_t<T> >( resource,
+			script::make_node< element_less_than_t<T> >( resource,
+					array_name, index_name, sentinel ),
+			script::make_node< increment_by_t<T> >( resource, index_name, 1 ) ) );
+	pass.push_back( script::make_node< increment_by_t<T> >( resource, pass_name, 1 ) );
+
+	std::vector< script::statement_shptr_t<T> > statements;
+	statements.push_back( script::make_node< allocate_array_t<T> >( resource,
+			array_name, params._elements, 0, params._huge_pages ) );
+	statements.push_back( script::make_node< assign_to_t<T> >( resource, pass_name, 0 ) );
+	// Индекс печатается после цикла по проходам, поэтому он должен
+	// получить значение и на случай, если цикл не выполнится ни разу.
+	statements.push_back( script::make_node< assign_to_t<T> >( resource, index_name, 0 ) );
+	statements.push_back( script::make_node< while_loop_t<T> >( resource,
+			script::make_node< less_than_t<T> >( resource,
+					pass_name, static_cast<T>( params._passes ) ),
+			script::make_node< compound_stmt_t<T> >( resource, std::move(pass) ) ) );
+	statements.push_back( script::make_node< print_value_t<T> >( resource, index_name ) );
+
+	return script::make_node< compound_stmt_t<T> >( resource, std::move(statements) );
+}
+
+/// Имя выходной переменной демо-скрипта для обработки записей.
+inline const std::string record_demo_script_output{ "steps" };
+
+/// Граница, до которой демо-скрипт для обработки записей
+/// увеличивает значения входных колонок.
+inline constexpr long long record_demo_script_limit = 16;
+
+/// Демо-скрипт для обработки одной записи.
+///
+/// Каждая входная колонка увеличивается на единицу, пока не достигнет
+/// record_demo_script_limit, количество увеличений по всем колонкам
+/// записывается в record_demo_script_output.
+template< typename T >
+[[nodiscard]] script::statement_shptr_t<T>
+make_record_demo_script(
+	const std::vector< std::string > & input_columns,
+	std::pmr::memory_resource * resource = std::pmr::get_default_resource() )
+{
+	using namespace script::statements;
+	using script::expressions::less_than_t;
+
+	std::vector< script::statement_shptr_t<T> > statements;
+	statements.push_back( script::make_node< assign_to_t<T> >( resource,
+			record_demo_script_output, 0 ) );
+	for( const auto & column : input_columns )
+	{
+		statements.push_back( script::make_node< while_loop_t<T> >( resource,
+				script::make_node< less_than_t<T> >( resource,
+						column, static_cast<T>( record_demo_script_limit ) ),
+				script::make_node< compound_stmt_t<T> >( resource,
+						std::vector< script::statement_shptr_t<T> >{
+							script::make_node< increment_by_t<T> >( resource, column, 1 ),
+							script::make_node< increment_by_t<T> >( resource,
+									record_demo_script_output, 1 )
+						} ) ) );
+	}
+
+	return script::make_node< compound_stmt_t<T> >( resource, std::move(statements) );
+}
+
+/// Имя разделяемой переменной демо-скрипта со счетчиком.
+inline const std::string shared_counter_demo_script_variable{ "total" };
+
+/// Демо-скрипт, который iterations раз увеличивает разделяемую
+/// переменную shared_counter_demo_script_variable.
+///
+/// Переменная должна быть привязана к контексту до выполнения скрипта.
+template< typename T >
+[[nodiscard]] script::statement_shptr_t<T>
+make_shared_counter_demo_script(
+	long long iterations,
+	std::pmr::memory_resource * resource = std::pmr::get_default_resource() )
+{
+	static const std::string var_name{ "i" };
+
+	using namespace script::statements;
+
+	std::vector< script::statement_shptr_t<T> > statements;
+	statements.push_back( script::make_node< assign_to_t<T> >( resource, var_name, 0 ) );
+	statements.push_back( script::make_node< while_loop_t<T> >( resource,
+			script::make_node< script::expressions::less_than_t<T> >( resource,
+					var_name, static_cast<T>( iterations ) ),
+			script::make_node< compound_stmt_t<T> >( resource,
+					std::vector< script::statement_shptr_t<T> >{
+						script::make_node< increment_by_t<T> >( resource, var_name, 1 ),
+						script::make_node< increment_by_t<T> >( resource,
+								shared_counter_demo_script_variable, 1 )
+					} ) ) );
+
+	return script::make_node< compound_stmt_t<T> >( resource, std::move(statements) );
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "verifier.hpp"
+
+#include <iostream>
+#include <memory>
+#include <string_view>
+
+namespace script
+{
+
+/// Способы выполнения скриптов (движки).
+///
+/// Движок подготавливает проверенный скрипт к выполнению (например,
+/// компилирует его), после чего подготовленный скрипт выполняется в
+/// exec_context_t. Результат выполнения любым движком должен совпадать
+/// с результатом обхода дерева: те же значения переменных и массивов
+/// в контексте и тот же напечатанный текст. Это проверяется
+/// сравнением движков (см. engines.hpp).
+namespace engines
+{
+
+/// Скрипт, подготовленный движком к выполнению.
+///
+/// Подготовленный скрипт не изменяется при выполнении, поэтому его
+/// можно одновременно выполнять на нескольких нитях, у каждой из
+/// которых свой контекст.
+template< typename T >
+class prepared_script_t
+{
+public:
+	virtual ~prepared_script_t() = default;
+
+	/// Выполнить скрипт в контексте.
+	///
+	/// Если выполнение прервано исключением, то в контексте должно
+	/// остаться то же, что оставил бы обход дерева.
+	virtual void
+	run(exec_context_t<T> & ctx) const = 0;
+};
+
+template< typename T >
+using prepared_script_shptr_t = std::shared_ptr< const prepared_script_t<T> >;
+
+/// Движок для выполнения скриптов.
+template< typename T >
+class engine_t
+{
+public:
+	virtual ~engine_t() = default;
+
+	/// Имя для выбора движка и для отчетов.
+	[[nodiscard]]
+	virtual std::string_view
+	name() const noexcept = 0;
+
+	/// Подготовить проверенный скрипт к выполнению.
+	///
+	/// Порождает исключение, если движок не поддерживает какие-то
+	/// узлы скрипта.
+	[[nodiscard]]
+	virtual prepared_script_shptr_t<T>
+	prepare(const verified_script_t<T> & what) const = 0;
+};
+
+template< typename T >
+using engine_shptr_t = std::shared_ptr< const engine_t<T> >;
+
+/// Обход дерева скрипта (statement_t::exec_unchecked).
+///
+/// Эталон, с которым сравниваются остальные движки.
+template< typename T >
+class tree_engine_t final : public engine_t<T>
+{
+	class prepared_t final : public prepared_script_t<T>
+	{
+		const verified_script_t<T> _script;
+
+	public:
+		explicit prepared_t(verified_script_t<T> script)
+			: _script{ std::move(script) }
+		{}
+
+		void
+		run(exec_context_t<T> & ctx) const override
+		{
+			_script.script()->exec_unchecked(ctx);
+		}
+	};
+
+public:
+	[[nodiscard]]
+	std::string_view
+	name() const noexcept override { return "tree"; }
+
+	[[nodiscard]]
+	prepared_script_shptr_t<T>
+	prepare(const verified_script_t<T> & what) const override
+	{
+		return std::make_shared< prepared_t >(what);
+	}
+};
+
+/// Выполнить подготовленный скрипт в уже подготовленном контексте.
+///
+/// Исключения обрабатываются так же, как в script::execute.
+template< typename T >
+void
+execute(const prepared_script_t<T> & what, exec_context_t<T> & ctx)
+{
+	try
+	{
+		what.run(ctx);
+	}
+	catch(const std::exception & x)
+	{
+		std::cerr << "exception caught: " << x.what() << std::endl;
+	}
+}
+
+} /* namespace engines */
+
+} /* namespace script */
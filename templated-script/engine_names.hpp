@@ -0,0 +1,46 @@
+#pragma once
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace script
+{
+
+namespace engines
+{
+
+/// Имена всех движков. Первым идет эталонный обход дерева.
+///
+/// Вынесены отдельно от самих движков, чтобы имя можно было проверить
+/// при разборе параметров, не подключая шаблоны интерпретатора.
+[[nodiscard]] inline const std::vector< std::string_view > &
+names()
+{
+	static const std::vector< std::string_view > all{
+			"tree", "bytecode", "memo" };
+	return all;
+}
+
+/// Проверить, что движок с таким именем есть.
+///
+/// Бросает исключение, если имя неизвестно.
+inline void
+ensure_known( std::string_view name )
+{
+	const auto & all = names();
+	if( std::find( all.begin(), all.end(), name ) != all.end() )
+		return;
+
+	std::string known;
+	for( const auto n : all )
+		known += (known.empty() ? "" : ", ") + std::string{ n };
+	throw std::runtime_error{ "unknown engine: `" + std::string{ name }
+			+ "`, known: " + known };
+}
+
+} /* namespace engines */
+
+} /* namespace script */
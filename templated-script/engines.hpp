@@ -0,0 +1,251 @@
+#pragma once
+
+#include "engine.hpp"
+#include "engine_names.hpp"
+#include "bytecode_engine.hpp"
+#include "memo_engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace script
+{
+
+namespace engines
+{
+
+/// Получить движок по имени.
+///
+/// Бросает исключение, если имя неизвестно.
+template< typename T >
+[[nodiscard]] engine_shptr_t<T>
+make( std::string_view name )
+{
+	if( "tree" == name )
+		return std::make_shared< tree_engine_t<T> >();
+	if( "bytecode" == name )
+		return std::make_shared< bytecode_engine_t<T> >();
+	if( "memo" == name )
+		return std::make_shared< memo_engine_t<T> >();
+
+	ensure_known( name );
+	throw std::logic_error{ "engine `" + std::string{ name }
+			+ "` is listed in names(), but make() can't create it" };
+}
+
+/// Состояние после выполнения скрипта, пригодное для сравнения.
+template< typename T >
+struct outcome_t
+{
+	std::map< std::string, T > _vars;
+	std::map< std::string, std::vector< T > > _arrays;
+
+	/// Все, что было напечатано в std::cout.
+	std::string _output;
+};
+
+/// Снять состояние контекста.
+template< typename T >
+[[nodiscard]] outcome_t<T>
+make_outcome( const exec_context_t<T> & ctx, std::string output )
+{
+	outcome_t<T> result;
+	ctx.for_each_var( [&]( std::string_view name, T value ) {
+			result._vars.emplace( std::string{ name }, value );
+		} );
+	ctx.for_each_array( [&]( std::string_view name,
+			const array_storage_t<T> & storage ) {
+			result._arrays.emplace( std::string{ name }, std::vector< T >(
+					storage.data(), storage.data() + storage.size() ) );
+		} );
+	result._output = std::move(output);
+	return result;
+}
+
+namespace impl
+{
+
+/// Побитовое сравнение значений: для double так различаются -0.0 и
+/// 0.0, а одинаковые NaN считаются равными.
+template< typename T >
+[[nodiscard]] bool
+same_bits( const T & a, const T & b ) noexcept
+{
+	return 0 == std::memcmp( &a, &b, sizeof(T) );
+}
+
+} /* namespace impl */
+
+/// Найти первое расхождение двух состояний.
+///
+/// Возвращает пустое значение, если состояния совпадают в точности.
+template< typename T >
+[[nodiscard]] std::optional< std::string >
+compare( const outcome_t<T> & expected, const outcome_t<T> & actual )
+{
+	std::ostringstream description;
+
+	for( const auto & [name, value] : expected._vars )
+	{
+		const auto it = actual._vars.find( name );
+		if( it == actual._vars.end() )
+			return "variable `" + name + "` is missing";
+		if( !impl::same_bits( value, it->second ) )
+		{
+			description << "variable `" << name << "`: " << it->second
+					<< ", expected " << value;
+			return description.str();
+		}
+	}
+	for( const auto & kv : actual._vars )
+		if( !expected._vars.count( kv.first ) )
+			return "unexpected variable `" + kv.first + "`";
+
+	for( const auto & [name, values] : expected._arrays )
+	{
+		const auto it = actual._arrays.find( name );
+		if( it == actual._arrays.end() )
+			return "array `" + name + "` is missing";
+		if( values.size() != it->second.size() )
+			return "array `" + name + "` has a different size";
+		for( std::size_t i = 0; i != values.size(); ++i )
+			if( !impl::same_bits( values[ i ], it->second[ i ] ) )
+			{
+				description << "array `" << name << "`[" << i << "]: "
+						<< it->second[ i ] << ", expected " << values[ i ];
+				return description.str();
+			}
+	}
+	for( const auto & kv : actual._arrays )
+		if( !expected._arrays.count( kv.first ) )
+			return "unexpected array `" + kv.first + "`";
+
+	if( expected._output != actual._output )
+	{
+		const auto diff = std::mismatch(
+				expected._output.begin(), expected._output.end(),
+				actual._output.begin(), actual._output.end() );
+		description << "printed output differs at offset "
+				<< (diff.first - expected._output.begin());
+		return description.str();
+	}
+
+	return std::nullopt;
+}
+
+/// Перехват всего, что печатается в std::cout.
+///
+/// Печать в скриптах идет через std::osyncstream{ std::cout }, который
+/// берет буфер std::cout в момент создания. Поэтому перехват работает,
+/// только пока другие нити ничего не печатают.
+class cout_capture_t
+{
+	std::ostringstream _captured;
+	std::streambuf * const _original;
+
+public:
+	cout_capture_t()
+		: _original{ std::cout.rdbuf( _captured.rdbuf() ) }
+	{}
+
+	~cout_capture_t()
+	{
+		std::cout.rdbuf( _original );
+	}
+
+	cout_capture_t( const cout_capture_t & ) = delete;
+	cout_capture_t & operator=( const cout_capture_t & ) = delete;
+
+	[[nodiscard]] std::string
+	text() const { return _captured.str(); }
+};
+
+/// Результат сравнения одного движка с эталоном.
+struct differential_result_t
+{
+	std::string _engine;
+
+	/// Медианное время выполнения скрипта.
+	double _median_seconds{};
+
+	/// Время подготовки скрипта (например, компиляции).
+	double _prepare_seconds{};
+
+	/// Расхождение с эталоном. Пусто, если результаты совпали.
+	std::optional< std::string > _mismatch{};
+};
+
+/// Выполнить скрипт на всех движках и сравнить результаты с обходом
+/// дерева.
+///
+/// Каждый движок выполняет скрипт repetitions раз, каждый раз в новом
+/// контексте. Сравниваются итоговые контексты и напечатанный текст
+/// всех выполнений. Первым в результате идет эталон.
+template< typename T >
+[[nodiscard]] std::vector< differential_result_t >
+run_differential( const verified_script_t<T> & what, unsigned repetitions )
+{
+	using clock_t = std::chrono::steady_clock;
+	const auto seconds = []( clock_t::duration d ) {
+		return std::chrono::duration< double >( d ).count();
+	};
+
+	std::vector< differential_result_t > results;
+	std::optional< outcome_t<T> > reference;
+	for( const auto name : names() )
+	{
+		auto & result = results.emplace_back();
+		result._engine = std::string{ name };
+
+		const auto engine = make<T>( name );
+		const auto prepare_started_at = clock_t::now();
+		const auto prepared = engine->prepare( what );
+		result._prepare_seconds = seconds( clock_t::now() - prepare_started_at );
+
+		std::vector< double > times;
+		for( unsigned run = 0; run != std::max( repetitions, 1u ); ++run )
+		{
+			exec_context_t<T> ctx;
+			std::string output;
+			{
+				cout_capture_t capture;
+				const auto started_at = clock_t::now();
+				try
+				{
+					prepared->run( ctx );
+				}
+				catch( const std::exception & x )
+				{
+					// Исключение -- часть результата, оно тоже сравнивается.
+					std::cout << "exception caught: " << x.what() << std::endl;
+				}
+				times.push_back( seconds( clock_t::now() - started_at ) );
+				output = capture.text();
+			}
+
+			auto outcome = make_outcome( ctx, std::move(output) );
+			if( !reference )
+				reference = std::move(outcome);
+			else if( !result._mismatch )
+				result._mismatch = compare( *reference, outcome );
+		}
+
+		std::sort( times.begin(), times.end() );
+		result._median_seconds = times[ times.size() / 2u ];
+	}
+
+	return results;
+}
+
+} /* namespace engines */
+
+} /* namespace script */
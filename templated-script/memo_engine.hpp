@@ -0,0 +1,557 @@
+#pragma once
+
+#include "engine.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace script
+{
+
+namespace engines
+{
+
+/// Запоминание результатов чистых циклов.
+///
+/// Цикл while_loop_t считается чистым, если он работает только со
+/// скалярными переменными: ничего не печатает и не обращается к
+/// массивам. Тогда его результат -- значения изменяемых им переменных
+/// -- полностью определяется начальными значениями переменных, которые
+/// он читает и изменяет. Такие циклы (самые внешние из чистых)
+/// заменяются узлами memo_loop_t, которые перед выполнением цикла ищут
+/// эти начальные значения в кэше и при попадании сразу записывают в
+/// контекст запомненный результат.
+///
+/// Кэш у каждой нити свой (thread_local), поэтому синхронизации при
+/// обращении к нему нет совсем. Размер кэша ограничен: это таблица из
+/// cache_slots ячеек с прямым отображением, новый результат вытесняет
+/// старый из той же ячейки. Кэш живет, пока жива нить, так что
+/// выполнения скрипта одной нитью (например, в режиме batch) попадают
+/// в результаты предыдущих выполнений.
+///
+/// При попадании итерации цикла не учитываются progress::loop_tracker_t
+/// и цикл не отмечается на временной шкале trace_events. Если к
+/// контексту привязаны разделяемые переменные, циклы выполняются без
+/// кэша.
+namespace memo
+{
+
+/// Количество ячеек в кэше каждой нити.
+inline constexpr std::size_t cache_slots = 1024u;
+
+/// Циклы, зависящие от большего количества переменных, не
+/// запоминаются: ключ кэша слишком дорого сравнивать и хранить.
+inline constexpr std::size_t max_key_vars = 64u;
+
+/// Что поддерево скрипта читает и что изменяет.
+struct effects_t
+{
+	/// Переменные, начальные значения которых могут быть прочитаны
+	/// поддеревом до того, как оно само присвоит им значения.
+	std::set< std::string > _reads;
+
+	/// Переменные, которые поддерево может изменить.
+	std::set< std::string > _writes;
+
+	/// Почему поддерево не чистое. Пусто для чистого поддерева.
+	std::optional< std::string > _impurity{};
+
+	[[nodiscard]] bool
+	pure() const noexcept { return !_impurity; }
+};
+
+namespace impl
+{
+
+/// Определение множеств чтения и записи.
+///
+/// Обход узлов такой же, как в verifier::impl::analyzer_t: после
+/// цикла определенными остаются только имена, определенные до него.
+/// Тело цикла анализируется от состояния перед циклом, поэтому
+/// значение, прочитанное на второй итерации, но записанное только
+/// в конце первой, тоже попадает в множество чтения.
+template< typename T >
+class analyzer_t
+{
+	effects_t & _effects;
+
+	void
+	read( const std::string & name, const std::set< std::string > & defined )
+	{
+		if( !defined.count( name ) )
+			_effects._reads.insert( name );
+	}
+
+	void
+	impure( const char * reason )
+	{
+		if( !_effects._impurity )
+			_effects._impurity = reason;
+	}
+
+public:
+	explicit analyzer_t( effects_t & effects ) : _effects{ effects } {}
+
+	void
+	analyze(
+		const logical_expression_shptr_t<T> & what,
+		const std::set< std::string > & defined )
+	{
+		namespace expr = expressions;
+		const auto * node = what.get();
+
+		if( const auto * lt = dynamic_cast< const expr::less_than_t<T> * >( node ) )
+			read( lt->var_name(), defined );
+		else if( dynamic_cast< const expr::element_less_than_t<T> * >( node ) )
+			impure( "reads an array element" );
+		else
+			impure( "unknown expression node" );
+	}
+
+	void
+	analyze(
+		const statement_shptr_t<T> & what,
+		std::set< std::string > & defined )
+	{
+		namespace stm = statements;
+		const auto * node = what.get();
+
+		if( const auto * c = dynamic_cast< const stm::compound_stmt_t<T> * >( node ) )
+		{
+			for( const auto & s : c->statements() )
+				analyze( s, defined );
+		}
+		else if( const auto * w = dynamic_cast< const stm::while_loop_t<T> * >( node ) )
+		{
+			analyze( w->condition(), defined );
+			auto in_body = defined;
+			analyze( w->body(), in_body );
+		}
+		else if( const auto * a = dynamic_cast< const stm::assign_to_t<T> * >( node ) )
+		{
+			_effects._writes.insert( a->var_name() );
+			defined.insert( a->var_name() );
+		}
+		else if( const auto * inc = dynamic_cast< const stm::increment_by_t<T> * >( node ) )
+		{
+			read( inc->var_name(), defined );
+			_effects._writes.insert( inc->var_name() );
+			defined.insert( inc->var_name() );
+		}
+		else if( const auto * p = dynamic_cast< const stm::print_value_t<T> * >( node ) )
+		{
+			read( p->var_name(), defined );
+			impure( "prints a value" );
+		}
+		else if( dynamic_cast< const stm::allocate_array_t<T> * >( node )
+				|| dynamic_cast< const stm::store_at_t<T> * >( node )
+				|| dynamic_cast< const stm::increment_at_t<T> * >( node ) )
+			impure( "works with an array" );
+		else
+			impure( "unknown statement node" );
+	}
+};
+
+} /* namespace impl */
+
+/// Определить, что поддерево читает и что изменяет.
+template< typename T >
+[[nodiscard]] effects_t
+analyze( const statement_shptr_t<T> & what )
+{
+	effects_t result;
+	std::set< std::string > defined;
+	impl::analyzer_t<T>{ result }.analyze( what, defined );
+	return result;
+}
+
+/// Статистика обращений к кэшу.
+struct stats_t
+{
+	/// Сколько раз результат цикла был взят из кэша.
+	std::uint64_t _hits{};
+
+	/// Сколько раз цикл пришлось выполнить.
+	std::uint64_t _misses{};
+
+	/// Сколько раз цикл был выполнен без кэша из-за разделяемых
+	/// переменных.
+	std::uint64_t _bypassed{};
+
+	/// Сколько запомненных результатов было вытеснено новыми.
+	std::uint64_t _evictions{};
+
+	/// Оценка сэкономленного времени: время выполнения цикла при
+	/// промахе за вычетом времени, потраченного на попадание.
+	double _saved_seconds{};
+
+	[[nodiscard]] double
+	hit_rate() const noexcept
+	{
+		const auto lookups = _hits + _misses;
+		return lookups ? static_cast< double >( _hits ) / lookups : 0.0;
+	}
+
+	stats_t &
+	operator+=( const stats_t & o ) noexcept
+	{
+		_hits += o._hits;
+		_misses += o._misses;
+		_bypassed += o._bypassed;
+		_evictions += o._evictions;
+		_saved_seconds += o._saved_seconds;
+		return *this;
+	}
+
+	[[nodiscard]] friend stats_t
+	operator-( stats_t a, const stats_t & b ) noexcept
+	{
+		a._hits -= b._hits;
+		a._misses -= b._misses;
+		a._bypassed -= b._bypassed;
+		a._evictions -= b._evictions;
+		a._saved_seconds -= b._saved_seconds;
+		return a;
+	}
+};
+
+namespace impl
+{
+
+[[nodiscard]] inline stats_t &
+mutable_thread_stats() noexcept
+{
+	thread_local stats_t stats;
+	return stats;
+}
+
+/// Новый идентификатор цикла.
+///
+/// Идентификаторы не используются повторно, поэтому результаты уже
+/// удаленного цикла в кэше никогда не совпадут с другим циклом.
+[[nodiscard]] inline std::uint64_t
+new_loop_id() noexcept
+{
+	static std::atomic< std::uint64_t > last{ 0u };
+	return last.fetch_add( 1u, std::memory_order_relaxed ) + 1u;
+}
+
+/// Начальные значения или результат: отсутствующая переменная
+/// отличается от любого значения.
+template< typename T >
+using values_t = std::vector< std::optional< T > >;
+
+/// Побитовое сравнение, как в engines::compare: для double так
+/// различаются -0.0 и 0.0, а одинаковые NaN совпадают.
+template< typename T >
+[[nodiscard]] bool
+same_values( const values_t<T> & a, const values_t<T> & b ) noexcept
+{
+	if( a.size() != b.size() )
+		return false;
+	for( std::size_t i = 0; i != a.size(); ++i )
+	{
+		if( a[ i ].has_value() != b[ i ].has_value() )
+			return false;
+		if( a[ i ] && 0 != std::memcmp( &*a[ i ], &*b[ i ], sizeof(T) ) )
+			return false;
+	}
+	return true;
+}
+
+template< typename T >
+struct slot_t
+{
+	/// Идентификатор цикла. Ноль для пустой ячейки.
+	std::uint64_t _loop_id{};
+
+	std::uint64_t _hash{};
+
+	values_t<T> _inputs;
+	values_t<T> _outputs;
+
+	/// Сколько выполнялся цикл при промахе.
+	double _cost_seconds{};
+};
+
+template< typename T >
+struct thread_cache_t
+{
+	std::vector< slot_t<T> > _slots{ cache_slots };
+
+	/// Ключ текущего обращения. Хранится здесь, чтобы не выделять
+	/// память при каждом обращении.
+	values_t<T> _key;
+};
+
+template< typename T >
+[[nodiscard]] thread_cache_t<T> &
+thread_cache()
+{
+	thread_local thread_cache_t<T> cache;
+	return cache;
+}
+
+} /* namespace impl */
+
+/// Статистика кэша текущей нити с момента ее старта.
+///
+/// Чтобы получить статистику одного выполнения, нужно вычесть
+/// значение, снятое перед ним.
+[[nodiscard]] inline stats_t
+thread_stats() noexcept
+{
+	return impl::mutable_thread_stats();
+}
+
+/// Чистый цикл, результат которого берется из кэша нити.
+template< typename T >
+class memo_loop_t final : public statement_t<T>
+{
+	const std::uint64_t _id{ impl::new_loop_id() };
+	const statement_shptr_t<T> _loop;
+
+	/// Ключ кэша: все прочитанные и все измененные переменные.
+	///
+	/// Измененные переменные входят в ключ, даже если цикл их не
+	/// читает: при нуле итераций их значения остаются прежними.
+	const std::vector< std::string > _key_vars;
+
+	/// Номера измененных переменных в _key_vars.
+	const std::vector< std::size_t > _outputs;
+
+	template< typename Exec >
+	void
+	run( exec_context_t<T> & ctx, Exec && exec ) const
+	{
+		using clock_t = std::chrono::steady_clock;
+		auto & stats = impl::mutable_thread_stats();
+
+		if( ctx.has_shared() )
+		{
+			++stats._bypassed;
+			exec();
+			return;
+		}
+
+		const auto started_at = clock_t::now();
+		auto & cache = impl::thread_cache<T>();
+		auto & key = cache._key;
+		key.resize( _key_vars.size() );
+
+		// FNV-1a по идентификатору цикла и начальным значениям.
+		std::uint64_t hash = 14695981039346656037ull;
+		const auto mix = [&hash]( const void * data, std::size_t size ) {
+			const auto * bytes = static_cast< const unsigned char * >( data );
+			for( std::size_t i = 0; i != size; ++i )
+			{
+				hash ^= bytes[ i ];
+				hash *= 1099511628211ull;
+			}
+		};
+		mix( &_id, sizeof(_id) );
+		for( std::size_t i = 0; i != _key_vars.size(); ++i )
+		{
+			const T * value = ctx.find_var( _key_vars[ i ] );
+			const unsigned char present = value ? 1u : 0u;
+			mix( &present, 1u );
+			if( value )
+			{
+				key[ i ] = *value;
+				mix( value, sizeof(T) );
+			}
+			else
+				key[ i ].reset();
+		}
+
+		auto & slot = cache._slots[ hash % cache._slots.size() ];
+		if( slot._loop_id == _id && slot._hash == hash
+				&& impl::same_values( slot._inputs, key ) )
+		{
+			for( const auto i : _outputs )
+				if( slot._outputs[ i ] )
+					ctx.assign_to( _key_vars[ i ], *slot._outputs[ i ] );
+
+			++stats._hits;
+			const std::chrono::duration< double > spent{
+					clock_t::now() - started_at };
+			if( slot._cost_seconds > spent.count() )
+				stats._saved_seconds += slot._cost_seconds - spent.count();
+			return;
+		}
+
+		// Исключение из цикла просто выходит наружу, в кэш ничего не
+		// попадает.
+		exec();
+
+		++stats._misses;
+		if( 0u != slot._loop_id )
+			++stats._evictions;
+
+		slot._loop_id = _id;
+		slot._hash = hash;
+		slot._inputs = key;
+		slot._outputs.resize( _key_vars.size() );
+		for( const auto i : _outputs )
+		{
+			const T * value = ctx.find_var( _key_vars[ i ] );
+			slot._outputs[ i ] = value
+					? std::optional< T >{ *value } : std::nullopt;
+		}
+		slot._cost_seconds = std::chrono::duration< double >(
+				clock_t::now() - started_at ).count();
+	}
+
+	[[nodiscard]] static std::vector< std::string >
+	key_vars_of( const effects_t & effects )
+	{
+		std::set< std::string > all{ effects._reads };
+		all.insert( effects._writes.begin(), effects._writes.end() );
+		return { all.begin(), all.end() };
+	}
+
+	[[nodiscard]] static std::vector< std::size_t >
+	outputs_of(
+		const std::vector< std::string > & key_vars,
+		const effects_t & effects )
+	{
+		std::vector< std::size_t > result;
+		for( std::size_t i = 0; i != key_vars.size(); ++i )
+			if( effects._writes.count( key_vars[ i ] ) )
+				result.push_back( i );
+		return result;
+	}
+
+public:
+	memo_loop_t(
+		statement_shptr_t<T> loop,
+		const effects_t & effects )
+		: _loop{ std::move(loop) }
+		, _key_vars{ key_vars_of( effects ) }
+		, _outputs{ outputs_of( _key_vars, effects ) }
+	{}
+
+	void
+	exec( exec_context_t<T> & ctx ) const override
+	{
+		run( ctx, [&] { _loop->exec( ctx ); } );
+	}
+
+	void
+	exec_unchecked( exec_context_t<T> & ctx ) const override
+	{
+		run( ctx, [&] { _loop->exec_unchecked( ctx ); } );
+	}
+};
+
+namespace impl
+{
+
+/// Замена самых внешних чистых циклов на memo_loop_t.
+///
+/// Узлы, в которых ничего не заменено, используются как есть.
+template< typename T >
+[[nodiscard]] statement_shptr_t<T>
+memoize(
+	const statement_shptr_t<T> & what,
+	std::vector< effects_t > & memoized )
+{
+	namespace stm = statements;
+	const auto * node = what.get();
+
+	if( const auto * c = dynamic_cast< const stm::compound_stmt_t<T> * >( node ) )
+	{
+		bool changed = false;
+		std::vector< statement_shptr_t<T> > statements;
+		for( const auto & s : c->statements() )
+		{
+			statements.push_back( memoize( s, memoized ) );
+			changed = changed || statements.back() != s;
+		}
+		return changed
+				? std::make_shared< stm::compound_stmt_t<T> >(
+						std::move(statements) )
+				: what;
+	}
+	else if( const auto * w = dynamic_cast< const stm::while_loop_t<T> * >( node ) )
+	{
+		auto effects = analyze( what );
+		std::set< std::string > key_vars{ effects._reads };
+		key_vars.insert( effects._writes.begin(), effects._writes.end() );
+		if( effects.pure() && key_vars.size() <= max_key_vars )
+		{
+			auto result = std::make_shared< memo_loop_t<T> >( what, effects );
+			memoized.push_back( std::move(effects) );
+			return result;
+		}
+
+		auto body = memoize( w->body(), memoized );
+		return body != w->body()
+				? std::make_shared< stm::while_loop_t<T> >(
+						w->condition(), std::move(body) )
+				: what;
+	}
+
+	return what;
+}
+
+} /* namespace impl */
+
+/// Скрипт, в котором чистые циклы заменены на memo_loop_t.
+template< typename T >
+class prepared_t final : public prepared_script_t<T>
+{
+	/// Исходное дерево, узлы которого используются в _root.
+	const verified_script_t<T> _script;
+
+	std::vector< effects_t > _memoized;
+	statement_shptr_t<T> _root;
+
+public:
+	explicit prepared_t( verified_script_t<T> script )
+		: _script{ std::move(script) }
+	{
+		_root = impl::memoize( _script.script(), _memoized );
+	}
+
+	/// Что читают и изменяют запоминаемые циклы.
+	[[nodiscard]] const std::vector< effects_t > &
+	memoized_loops() const noexcept { return _memoized; }
+
+	void
+	run( exec_context_t<T> & ctx ) const override
+	{
+		_root->exec_unchecked( ctx );
+	}
+};
+
+} /* namespace memo */
+
+/// Обход дерева с запоминанием результатов чистых циклов (см.
+/// memo::prepared_t).
+template< typename T >
+class memo_engine_t final : public engine_t<T>
+{
+public:
+	[[nodiscard]]
+	std::string_view
+	name() const noexcept override { return "memo"; }
+
+	[[nodiscard]]
+	prepared_script_shptr_t<T>
+	prepare( const verified_script_t<T> & what ) const override
+	{
+		return std::make_shared< memo::prepared_t<T> >( what );
+	}
+};
+
+} /* namespace engines */
+
+} /* namespace script */
@@ -1,8 +1,20 @@
 #pragma once
 
+#include "array_storage.hpp"
+#include "shared_vars.hpp"
+
+#include "../common/alloc_accounting.hpp"
+#include "../common/progress_counters.hpp"
+#include "../common/trace_events.hpp"
+
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <stdexcept>
+#include <string>
+#include <string_view>
 #include <syncstream>
 #include <thread>
 #include <unordered_map>
@@ -11,31 +23,347 @@
 namespace script
 {
 
+namespace impl
+{
+
+/// Хэш для поиска в словарях с ключами std::pmr::string по
+/// std::string без создания временных строк.
+struct name_hash_t
+{
+	using is_transparent = void;
+
+	[[nodiscard]] std::size_t
+	operator()(std::string_view name) const noexcept
+	{
+		return std::hash<std::string_view>{}(name);
+	}
+};
+
+/// Сравнение имен, хранящихся в строках с разными аллокаторами.
+struct name_equal_t
+{
+	using is_transparent = void;
+
+	[[nodiscard]] bool
+	operator()(std::string_view a, std::string_view b) const noexcept
+	{
+		return a == b;
+	}
+};
+
+/// Словарь, узлы и ключи которого размещаются в memory_resource
+/// контекста.
+template< typename V >
+using names_map_t = std::pmr::unordered_map<
+		std::pmr::string, V, name_hash_t, name_equal_t >;
+
+/// До какого размера словаря имя ищется перебором, без вычисления хэша.
+///
+/// Прозрачный поиск в std::unordered_map всегда вычисляет хэш всего
+/// имени, а поиск по std::string в libstdc++ для маленьких словарей
+/// просто сравнивает имена. В типичном скрипте всего несколько
+/// переменных, и на каждой итерации цикла к ним обращаются по
+/// несколько раз, поэтому без перебора обход дерева заметно
+/// замедляется. Порог такой же, как в libstdc++.
+inline constexpr std::size_t small_map_size = 20u;
+
+/// Сравнение имен при поиске перебором.
+///
+/// Имена обычно короткие и различаются уже первым символом, поэтому
+/// memcmp вызывается только для остатка имен длиннее одного символа.
+[[nodiscard]] inline bool
+same_name(std::string_view a, std::string_view b) noexcept
+{
+	if( a.size() != b.size() )
+		return false;
+	if( a.empty() )
+		return true;
+	if( a.front() != b.front() )
+		return false;
+
+	return 1u == a.size()
+			|| 0 == std::memcmp(a.data() + 1, b.data() + 1, a.size() - 1u);
+}
+
+/// Поиск имени в большом словаре.
+///
+/// Вынесен отдельно, чтобы код перебора в find_name оставался
+/// коротким.
+template< typename Map >
+[[nodiscard]] auto
+find_hashed_name(Map & map, std::string_view name)
+{
+	return map.find(name);
+}
+
+/// Поиск имени в словаре контекста.
+template< typename Map >
+[[nodiscard]] auto
+find_name(Map & map, std::string_view name)
+{
+	if( map.size() > small_map_size )
+		return find_hashed_name(map, name);
+
+	auto it = map.begin();
+	for( ; it != map.end(); ++it )
+		if( same_name(it->first, name) )
+			break;
+	return it;
+}
+
+} /* namespace impl */
+
+/// Контекст выполнения скрипта.
+///
+/// Все словари контекста берут память из memory_resource, указанного
+/// при создании (по умолчанию -- из глобального хипа). Так рабочие
+/// нити могут работать со своими собственными аренами (см.
+/// common/thread_arena.hpp). Память под массивы выделяется отдельно,
+/// см. array_storage_t.
 template< typename T >
 class exec_context_t
 {
-	std::unordered_map<std::string, T> _vars;
+	impl::names_map_t<T> _vars;
+	impl::names_map_t<array_storage_t<T>> _arrays;
+
+	/// Разделяемые с другими рабочими нитями переменные.
+	impl::names_map_t<shared::variable_t<T> *> _shared;
+
+	/// От имени какой нити изменяются разделяемые переменные.
+	std::size_t _worker_index{};
+
+	[[nodiscard]] shared::variable_t<T> *
+	find_shared(const std::string & name) const
+	{
+		if( _shared.empty() )
+			return nullptr;
+
+		auto it = impl::find_name(_shared, name);
+		return it == _shared.end() ? nullptr : it->second;
+	}
 
 public:
-	exec_context_t() = default;
+	explicit exec_context_t(
+		std::pmr::memory_resource * resource = std::pmr::get_default_resource())
+		: _vars{ resource }
+		, _arrays{ resource }
+		, _shared{ resource }
+	{}
+
+	/// Привязать к контексту разделяемую переменную.
+	///
+	/// Разделяемую переменную можно только увеличивать (через
+	/// increment_by_t) и читать.
+	void
+	bind_shared(
+		std::size_t worker_index,
+		const std::string & name,
+		shared::variable_t<T> & var)
+	{
+		_worker_index = worker_index;
+		if( auto it = impl::find_name(_shared, name); it != _shared.end() )
+			it->second = &var;
+		else
+			_shared.emplace(name, &var);
+	}
 
 	void
 	assign_to(
 		const std::string & name,
 		T value)
 	{
-		_vars[name] = value;
+		if( find_shared(name) )
+			throw std::runtime_error{
+					"shared variable can only be incremented: " + name };
+
+		if( auto it = impl::find_name(_vars, name); it != _vars.end() )
+			it->second = value;
+		else
+			_vars.emplace(name, value);
+	}
+
+	void
+	increment(
+		const std::string & name,
+		T value)
+	{
+		if( auto * shared = find_shared(name) )
+			shared->add(_worker_index, value);
+		else
+			get_mutable_ref(name) += value;
+	}
+
+	/// Значение переменной, в том числе разделяемой.
+	[[nodiscard]] T
+	value_of(const std::string & name)
+	{
+		if( const auto * shared = find_shared(name) )
+			return shared->read();
+
+		return get_mutable_ref(name);
+	}
+
+	/// Есть ли привязанные разделяемые переменные.
+	[[nodiscard]] bool
+	has_shared() const noexcept { return !_shared.empty(); }
+
+	/// Значение переменной, если она есть (разделяемые не учитываются).
+	[[nodiscard]] const T *
+	find_var(const std::string & name) const
+	{
+		auto it = impl::find_name(_vars, name);
+		return it == _vars.end() ? nullptr : &it->second;
+	}
+
+	/// Перебрать все переменные (без разделяемых).
+	///
+	/// Используется для сравнения состояний после выполнения скрипта
+	/// разными способами (см. engines.hpp).
+	template< typename F >
+	void
+	for_each_var(F && f) const
+	{
+		for( const auto & [name, value] : _vars )
+			f(std::string_view{ name }, value);
+	}
+
+	/// Перебрать все массивы.
+	template< typename F >
+	void
+	for_each_array(F && f) const
+	{
+		for( const auto & [name, storage] : _arrays )
+			f(std::string_view{ name }, storage);
+	}
+
+	/// Забрать массив из контекста.
+	///
+	/// Пусто, если массива с таким именем нет.
+	[[nodiscard]] std::optional< array_storage_t<T> >
+	take_array(const std::string & name)
+	{
+		auto it = impl::find_name(_arrays, name);
+		if( it == _arrays.end() )
+			return std::nullopt;
+
+		std::optional< array_storage_t<T> > result{ std::move(it->second) };
+		_arrays.erase(it);
+		return result;
+	}
+
+	/// Поместить в контекст уже заполненный массив.
+	///
+	/// Массив с таким же именем заменяется.
+	void
+	put_array(
+		const std::string & name,
+		array_storage_t<T> storage)
+	{
+		if( auto it = impl::find_name(_arrays, name); it != _arrays.end() )
+			it->second = std::move(storage);
+		else
+			_arrays.emplace(name, std::move(storage));
 	}
 
 	T &
 	get_mutable_ref(const std::string & name)
 	{
-		auto it = _vars.find(name);
+		auto it = impl::find_name(_vars, name);
 		if( it == _vars.end() )
 			throw std::runtime_error{ "there is no such variable: " + name };
 
 		return it->second;
 	}
+
+	void
+	create_array(
+		const std::string & name,
+		std::size_t size,
+		T initial_value,
+		bool huge_pages)
+	{
+		array_storage_t<T> storage{ size, initial_value, huge_pages };
+		if( auto it = impl::find_name(_arrays, name); it != _arrays.end() )
+			it->second = std::move(storage);
+		else
+			_arrays.emplace(name, std::move(storage));
+	}
+
+	array_storage_t<T> &
+	get_array(const std::string & name)
+	{
+		auto it = impl::find_name(_arrays, name);
+		if( it == _arrays.end() )
+			throw std::runtime_error{ "there is no such array: " + name };
+
+		return it->second;
+	}
+
+	/// Доступ к переменной без проверки ее наличия.
+	///
+	/// Можно использовать только при выполнении скриптов, прошедших
+	/// статическую проверку (см. verifier.hpp): она доказывает, что
+	/// к моменту обращения переменная уже получила значение.
+	T &
+	get_ref_unchecked(const std::string & name)
+	{
+		return impl::find_name(_vars, name)->second;
+	}
+
+	/// Аналог increment для проверенных скриптов.
+	void
+	increment_unchecked(
+		const std::string & name,
+		T value)
+	{
+		if( _shared.empty() )
+			get_ref_unchecked(name) += value;
+		else
+			increment(name, value);
+	}
+
+	/// Аналог value_of для проверенных скриптов.
+	[[nodiscard]] T
+	value_of_unchecked(const std::string & name)
+	{
+		if( _shared.empty() )
+			return get_ref_unchecked(name);
+
+		return value_of(name);
+	}
+
+	/// Элемент массива, индекс которого хранится в скалярной переменной.
+	T &
+	get_element_ref(
+		const std::string & array_name,
+		const std::string & index_var_name)
+	{
+		const T index = get_mutable_ref(index_var_name);
+		if( index < T{} )
+			throw std::runtime_error{ "negative index in variable: "
+					+ index_var_name };
+
+		return get_array(array_name).at(
+				static_cast<std::size_t>(index), array_name);
+	}
+
+	/// Аналог get_element_ref для проверенных скриптов.
+	///
+	/// Не проверяется только наличие массива и индексной переменной,
+	/// значение индекса по-прежнему проверяется.
+	T &
+	get_element_ref_unchecked(
+		const std::string & array_name,
+		const std::string & index_var_name)
+	{
+		const T index = get_ref_unchecked(index_var_name);
+		if( index < T{} )
+			throw std::runtime_error{ "negative index in variable: "
+					+ index_var_name };
+
+		return impl::find_name(_arrays, array_name)->second.at(
+				static_cast<std::size_t>(index), array_name);
+	}
 };
 
 template< typename T >
@@ -46,6 +374,16 @@ public:
 
 	virtual void
 	exec(exec_context_t<T> & ctx) const = 0;
+
+	/// Выполнение в составе скрипта, прошедшего статическую проверку.
+	///
+	/// Обращения к переменным выполняются без проверки их наличия.
+	/// По умолчанию то же самое, что и exec.
+	virtual void
+	exec_unchecked(exec_context_t<T> & ctx) const
+	{
+		exec(ctx);
+	}
 };
 
 template< typename T >
@@ -61,11 +399,34 @@ public:
 	[[nodiscard]]
 	virtual bool
 	exec(exec_context_t<T> & ctx) const = 0;
+
+	/// Аналог statement_t::exec_unchecked.
+	[[nodiscard]]
+	virtual bool
+	exec_unchecked(exec_context_t<T> & ctx) const
+	{
+		return exec(ctx);
+	}
 };
 
 template< typename T >
 using logical_expression_shptr_t = std::shared_ptr< logical_expression_t<T> >;
 
+/// Создать узел скрипта, разместив его в памяти из resource.
+///
+/// Узел и его счетчик ссылок размещаются одним блоком, как и при
+/// std::make_shared. Память возвращается в resource при удалении
+/// последней ссылки на узел, поэтому resource должен жить дольше
+/// скрипта.
+template< typename Node, typename... Args >
+[[nodiscard]] std::shared_ptr< Node >
+make_node(std::pmr::memory_resource * resource, Args &&... args)
+{
+	return std::allocate_shared< Node >(
+			std::pmr::polymorphic_allocator< Node >{ resource },
+			std::forward< Args >(args)...);
+}
+
 namespace statements
 {
 
@@ -80,12 +441,22 @@ public:
 		: _statements{ std::move(statements) }
 	{}
 
+	[[nodiscard]] const std::vector< statement_shptr_t<T> > &
+	statements() const noexcept { return _statements; }
+
 	void
 	exec(exec_context_t<T> & ctx) const override
 	{
 		for(const auto & stm : _statements)
 			stm->exec(ctx);
 	}
+
+	void
+	exec_unchecked(exec_context_t<T> & ctx) const override
+	{
+		for(const auto & stm : _statements)
+			stm->exec_unchecked(ctx);
+	}
 };
 
 template< typename T >
@@ -102,12 +473,43 @@ public:
 		, _body{ std::move(body) }
 	{}
 
+	[[nodiscard]] const logical_expression_shptr_t<T> &
+	condition() const noexcept { return _condition; }
+
+	[[nodiscard]] const statement_shptr_t<T> &
+	body() const noexcept { return _body; }
+
 	void
 	exec(exec_context_t<T> & ctx) const override
 	{
+		// Долгие циклы отмечаются на временной шкале, если нить ее ведет.
+		trace_events::loop_span_t loop_span;
+		// Итерации учитываются, если за продвижением нити следят.
+		progress::loop_tracker_t progress_tracker;
 		while( _condition->exec(ctx) )
 		{
+#if defined(SCRIPT_INTERPRETER_ALLOC_ACCOUNTING)
+			// Аллокации в теле цикла повторяются на каждой итерации,
+			// поэтому они учитываются отдельно.
+			alloc_accounting::loop_body_scope_t loop_body_scope;
+#endif
 			_body->exec(ctx);
+			progress_tracker.on_back_edge();
+		}
+	}
+
+	void
+	exec_unchecked(exec_context_t<T> & ctx) const override
+	{
+		trace_events::loop_span_t loop_span;
+		progress::loop_tracker_t progress_tracker;
+		while( _condition->exec_unchecked(ctx) )
+		{
+#if defined(SCRIPT_INTERPRETER_ALLOC_ACCOUNTING)
+			alloc_accounting::loop_body_scope_t loop_body_scope;
+#endif
+			_body->exec_unchecked(ctx);
+			progress_tracker.on_back_edge();
 		}
 	}
 };
@@ -126,6 +528,12 @@ public:
 		, _value{ value }
 	{}
 
+	[[nodiscard]] const std::string &
+	var_name() const noexcept { return _var_name; }
+
+	[[nodiscard]] T
+	value() const noexcept { return _value; }
+
 	void
 	exec(exec_context_t<T> & ctx) const override
 	{
@@ -147,10 +555,22 @@ public:
 		, _value_to_add{ value_to_add }
 	{}
 
+	[[nodiscard]] const std::string &
+	var_name() const noexcept { return _var_name; }
+
+	[[nodiscard]] T
+	value_to_add() const noexcept { return _value_to_add; }
+
 	void
 	exec(exec_context_t<T> & ctx) const override
 	{
-		ctx.get_mutable_ref(_var_name) += _value_to_add;
+		ctx.increment(_var_name, _value_to_add);
+	}
+
+	void
+	exec_unchecked(exec_context_t<T> & ctx) const override
+	{
+		ctx.increment_unchecked(_var_name, _value_to_add);
 	}
 };
 
@@ -165,13 +585,142 @@ public:
 		: _var_name{ std::move(var_name) }
 	{}
 
+	[[nodiscard]] const std::string &
+	var_name() const noexcept { return _var_name; }
+
 	void
 	exec(exec_context_t<T> & ctx) const override
 	{
-		const auto & v = ctx.get_mutable_ref(_var_name);
+		const auto v = ctx.value_of(_var_name);
 		std::osyncstream{ std::cout }
 				<< _var_name << "=" << v << std::endl;
 	}
+
+	void
+	exec_unchecked(exec_context_t<T> & ctx) const override
+	{
+		const auto v = ctx.value_of_unchecked(_var_name);
+		std::osyncstream{ std::cout }
+				<< _var_name << "=" << v << std::endl;
+	}
+};
+
+template< typename T >
+class allocate_array_t final : public statement_t<T>
+{
+	const std::string _array_name;
+	const std::size_t _size;
+	const T _initial_value;
+	const bool _huge_pages;
+
+public:
+	allocate_array_t(
+		std::string array_name,
+		std::size_t size,
+		T initial_value,
+		bool huge_pages = false)
+		: _array_name{ std::move(array_name) }
+		, _size{ size }
+		, _initial_value{ initial_value }
+		, _huge_pages{ huge_pages }
+	{}
+
+	[[nodiscard]] const std::string &
+	array_name() const noexcept { return _array_name; }
+
+	[[nodiscard]] std::size_t
+	size() const noexcept { return _size; }
+
+	[[nodiscard]] T
+	initial_value() const noexcept { return _initial_value; }
+
+	[[nodiscard]] bool
+	huge_pages() const noexcept { return _huge_pages; }
+
+	void
+	exec(exec_context_t<T> & ctx) const override
+	{
+		ctx.create_array(_array_name, _size, _initial_value, _huge_pages);
+	}
+};
+
+template< typename T >
+class store_at_t final : public statement_t<T>
+{
+	const std::string _array_name;
+	const std::string _index_var_name;
+	const T _value;
+
+public:
+	store_at_t(
+		std::string array_name,
+		std::string index_var_name,
+		T value)
+		: _array_name{ std::move(array_name) }
+		, _index_var_name{ std::move(index_var_name) }
+		, _value{ value }
+	{}
+
+	[[nodiscard]] const std::string &
+	array_name() const noexcept { return _array_name; }
+
+	[[nodiscard]] const std::string &
+	index_var_name() const noexcept { return _index_var_name; }
+
+	[[nodiscard]] T
+	value() const noexcept { return _value; }
+
+	void
+	exec(exec_context_t<T> & ctx) const override
+	{
+		ctx.get_element_ref(_array_name, _index_var_name) = _value;
+	}
+
+	void
+	exec_unchecked(exec_context_t<T> & ctx) const override
+	{
+		ctx.get_element_ref_unchecked(_array_name, _index_var_name) = _value;
+	}
+};
+
+template< typename T >
+class increment_at_t final : public statement_t<T>
+{
+	const std::string _array_name;
+	const std::string _index_var_name;
+	const T _value_to_add;
+
+public:
+	increment_at_t(
+		std::string array_name,
+		std::string index_var_name,
+		T value_to_add)
+		: _array_name{ std::move(array_name) }
+		, _index_var_name{ std::move(index_var_name) }
+		, _value_to_add{ value_to_add }
+	{}
+
+	[[nodiscard]] const std::string &
+	array_name() const noexcept { return _array_name; }
+
+	[[nodiscard]] const std::string &
+	index_var_name() const noexcept { return _index_var_name; }
+
+	[[nodiscard]] T
+	value_to_add() const noexcept { return _value_to_add; }
+
+	void
+	exec(exec_context_t<T> & ctx) const override
+	{
+		ctx.get_element_ref(_array_name, _index_var_name) += _value_to_add;
+	}
+
+	void
+	exec_unchecked(exec_context_t<T> & ctx) const override
+	{
+		ctx.get_element_ref_unchecked(_array_name, _index_var_name)
+				+= _value_to_add;
+	}
 };
 
 } /* namespace statements */
@@ -193,15 +742,84 @@ public:
 		, _value{ value }
 	{}
 
+	[[nodiscard]] const std::string &
+	var_name() const noexcept { return _var_name; }
+
+	[[nodiscard]] T
+	value() const noexcept { return _value; }
+
 	bool
 	exec(exec_context_t<T> & ctx) const override
 	{
-		return ctx.get_mutable_ref(_var_name) < _value;
+		return ctx.value_of(_var_name) < _value;
+	}
+
+	bool
+	exec_unchecked(exec_context_t<T> & ctx) const override
+	{
+		return ctx.value_of_unchecked(_var_name) < _value;
+	}
+};
+
+template< typename T >
+class element_less_than_t final : public logical_expression_t<T>
+{
+	const std::string _array_name;
+	const std::string _index_var_name;
+	const T _value;
+
+public:
+	element_less_than_t(
+		std::string array_name,
+		std::string index_var_name,
+		T value)
+		: _array_name{ std::move(array_name) }
+		, _index_var_name{ std::move(index_var_name) }
+		, _value{ value }
+	{}
+
+	[[nodiscard]] const std::string &
+	array_name() const noexcept { return _array_name; }
+
+	[[nodiscard]] const std::string &
+	index_var_name() const noexcept { return _index_var_name; }
+
+	[[nodiscard]] T
+	value() const noexcept { return _value; }
+
+	bool
+	exec(exec_context_t<T> & ctx) const override
+	{
+		return ctx.get_element_ref(_array_name, _index_var_name) < _value;
+	}
+
+	bool
+	exec_unchecked(exec_context_t<T> & ctx) const override
+	{
+		return ctx.get_element_ref_unchecked(_array_name, _index_var_name)
+				< _value;
 	}
 };
 
 } /* namespace expressions */
 
+/// Выполнить скрипт в уже подготовленном контексте.
+///
+/// Например, в контексте с привязанными разделяемыми переменными.
+template< typename T >
+void
+execute(const statement_shptr_t<T> & what, exec_context_t<T> & ctx)
+{
+	try
+	{
+		what->exec(ctx);
+	}
+	catch(const std::exception & x)
+	{
+		std::cerr << "exception caught: " << x.what() << std::endl;
+	}
+}
+
 template< typename T >
 void
 execute(const statement_shptr_t<T> & what)
@@ -0,0 +1,561 @@
+#pragma once
+
+#include "demo_script.hpp"
+
+#include <functional>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/// Набор скриптов для замеров.
+///
+/// Демо-скрипт с одним счетчиком не нагружает ни большой контекст, ни
+/// вложенные циклы, ни вывод. Здесь собраны скрипты из тех же узлов,
+/// которые выбираются по имени во всех тестовых программах:
+///
+/// - `demo` -- демо-скрипт (см. make_demo_script);
+/// - `array:<elements>` -- скрипт для работы с массивом;
+/// - `nested[:<outer>x<inner>]` -- вложенные циклы;
+/// - `vars[:<count>]` -- много переменных в контексте (1, 16, 256,
+///   4096...), на каждой итерации увеличивается каждая из них;
+/// - `straight[:<statements>]` -- длинное тело цикла из отдельных
+///   инструкций;
+/// - `print[:<lines>]` -- печать значения на каждой итерации.
+///
+/// Для каждого скрипта известны значения переменных после выполнения,
+/// по которым можно проверить правильность работы.
+namespace script_library
+{
+
+/// Построение скрипта в памяти из указанного ресурса.
+template< typename T >
+using builder_t = std::function< script::statement_shptr_t<T>(
+		std::pmr::memory_resource * ) >;
+
+/// Значение переменной после выполнения скрипта.
+template< typename T >
+struct expected_value_t
+{
+	std::string _name;
+	T _value;
+};
+
+/// Скрипт из библиотеки вместе со сведениями о нем.
+template< typename T >
+struct library_script_t
+{
+	/// Полное имя, например `nested:1000x1000`.
+	std::string _name;
+
+	builder_t<T> _build;
+
+	/// Сколько итераций циклов выполняет скрипт.
+	long long _loop_iterations{};
+
+	/// Сколько байт памяти читает и записывает скрипт, если он
+	/// работает с массивами.
+	std::optional< double > _bytes_processed{};
+
+	/// Сколько строк печатает скрипт.
+	std::size_t _printed_lines{};
+
+	/// Значения переменных после выполнения.
+	std::vector< expected_value_t<T> > _expected;
+};
+
+/// Вложенные циклы: outer итераций внешнего цикла, в каждой из них
+/// inner итераций внутреннего.
+template< typename T >
+[[nodiscard]] script::statement_shptr_t<T>
+make_nested_loops_script(
+	std::size_t outer,
+	std::size_t inner,
+	std::pmr::memory_resource * resource = std::pmr::get_default_resource() )
+{
+	static const std::string outer_name{ "o" };
+	static const std::string inner_name{ "i" };
+	static const std::string sum_name{ "s" };
+
+	using namespace script::statements;
+	using script::expressions::less_than_t;
+	using script::make_node;
+
+	using statements_t = std::vector< script::statement_shptr_t<T> >;
+
+	auto inner_loop = make_node< while_loop_t<T> >( resource,
+			make_node< less_than_t<T> >( resource,
+					inner_name, static_cast<T>( inner ) ),
+			make_node< compound_stmt_t<T> >( resource, statements_t{
+					make_node< increment_by_t<T> >( resource, sum_name, 1 ),
+					make_node< increment_by_t<T> >( resource, inner_name, 1 )
+				} ) );
+
+	return make_node< compound_stmt_t<T> >( resource, statements_t{
+			make_node< assign_to_t<T> >( resource, outer_name, 0 ),
+			make_node< assign_to_t<T> >( resource, inner_name, 0 ),
+			make_node< assign_to_t<T> >( resource, sum_name, 0 ),
+			make_node< while_loop_t<T> >( resource,
+					make_node< less_than_t<T> >( resource,
+							outer_name, static_cast<T>( outer ) ),
+					make_node< compound_stmt_t<T> >( resource, statements_t{
+							make_node< assign_to_t<T> >( resource, inner_name, 0 ),
+							std::move(inner_loop),
+							make_node< increment_by_t<T> >( resource, outer_name, 1 )
+						} ) ),
+			make_node< print_value_t<T> >( resource, sum_name )
+		} );
+}
+
+/// Имя i-й переменной скрипта make_many_vars_script.
+[[nodiscard]] inline std::string
+many_vars_name( std::size_t i )
+{
+	return "v" + std::to_string( i );
+}
+
+/// Скрипт с vars переменными, каждая из которых увеличивается на
+/// каждой из iterations итераций цикла.
+template< typename T >
+[[nodiscard]] script::statement_shptr_t<T>
+make_many_vars_script(
+	std::size_t vars,
+	std::size_t iterations,
+	std::pmr::memory_resource * resource = std::pmr::get_default_resource() )
+{
+	static const std::string counter_name{ "j" };
+
+	using namespace script::statements;
+	using script::expressions::less_than_t;
+	using script::make_node;
+
+	std::vector< script::statement_shptr_t<T> > statements;
+	std::vector< script::statement_shptr_t<T> > body;
+	for( std::size_t i = 0; i != vars; ++i )
+	{
+		statements.push_back( make_node< assign_to_t<T> >( resource,
+				many_vars_name( i ), 0 ) );
+		body.push_back( make_node< increment_by_t<T> >( resource,
+				many_vars_name( i ), 1 ) );
+	}
+	body.push_back( make_node< increment_by_t<T> >( resource, counter_name, 1 ) );
+
+	statements.push_back( make_node< assign_to_t<T> >( resource, counter_name, 0 ) );
+	statements.push_back( make_node< while_loop_t<T> >( resource,
+			make_node< less_than_t<T> >( resource,
+					counter_name, static_cast<T>( iterations ) ),
+			make_node< compound_stmt_t<T> >( resource, std::move(body) ) ) );
+	statements.push_back( make_node< print_value_t<T> >( resource, counter_name ) );
+
+	return make_node< compound_stmt_t<T> >( resource, std::move(statements) );
+}
+
+/// Сколько переменных увеличивает тело цикла make_straight_line_script.
+inline constexpr std::size_t straight_line_vars = 8u;
+
+/// На сколько увеличивается переменная k-й инструкцией тела цикла
+/// make_straight_line_script.
+[[nodiscard]] inline long long
+straight_line_step( std::size_t k )
+{
+	return static_cast< long long >( k % 5u ) + 1;
+}
+
+/// Скрипт, тело цикла которого состоит из statements отдельных
+/// инструкций. Большое тело не помещается в кэш инструкций, если
+/// скрипт компилируется в машинный код.
+template< typename T >
+[[nodiscard]] script::statement_shptr_t<T>
+make_straight_line_script(
+	std::size_t statements_count,
+	std::size_t iterations,
+	std::pmr::memory_resource * resource = std::pmr::get_default_resource() )
+{
+	static const std::string counter_name{ "j" };
+
+	using namespace script::statements;
+	using script::expressions::less_than_t;
+	using script::make_node;
+
+	std::vector< script::statement_shptr_t<T> > statements;
+	for( std::size_t v = 0; v != straight_line_vars; ++v )
+		statements.push_back( make_node< assign_to_t<T> >( resource,
+				"a" + std::to_string( v ), 0 ) );
+
+	std::vector< script::statement_shptr_t<T> > body;
+	for( std::size_t k = 0; k != statements_count; ++k )
+		body.push_back( make_node< increment_by_t<T> >( resource,
+				"a" + std::to_string( k % straight_line_vars ),
+				static_cast<T>( straight_line_step( k ) ) ) );
+	body.push_back( make_node< increment_by_t<T> >( resource, counter_name, 1 ) );
+
+	statements.push_back( make_node< assign_to_t<T> >( resource, counter_name, 0 ) );
+	statements.push_back( make_node< while_loop_t<T> >( resource,
+			make_node< less_than_t<T> >( resource,
+					counter_name, static_cast<T>( iterations ) ),
+			make_node< compound_stmt_t<T> >( resource, std::move(body) ) ) );
+	statements.push_back( make_node< print_value_t<T> >( resource, counter_name ) );
+
+	return make_node< compound_stmt_t<T> >( resource, std::move(statements) );
+}
+
+/// Скрипт, который печатает значение счетчика на каждой из lines
+/// итераций цикла.
+template< typename T >
+[[nodiscard]] script::statement_shptr_t<T>
+make_print_heavy_script(
+	std::size_t lines,
+	std::pmr::memory_resource * resource = std::pmr::get_default_resource() )
+{
+	static const std::string counter_name{ "j" };
+
+	using namespace script::statements;
+	using script::expressions::less_than_t;
+	using script::make_node;
+
+	using statements_t = std::vector< script::statement_shptr_t<T> >;
+
+	return make_node< compound_stmt_t<T> >( resource, statements_t{
+			make_node< assign_to_t<T> >( resource, counter_name, 0 ),
+			make_node< while_loop_t<T> >( resource,
+					make_node< less_than_t<T> >( resource,
+							counter_name, static_cast<T>( lines ) ),
+					make_node< compound_stmt_t<T> >( resource, statements_t{
+							make_node< increment_by_t<T> >( resource, counter_name, 1 ),
+							make_node< print_value_t<T> >( resource, counter_name )
+						} ) )
+		} );
+}
+
+namespace impl
+{
+
+/// Общий объем работы для скриптов `vars` и `straight`: количество
+/// увеличений переменных за все итерации.
+inline constexpr std::size_t increments_budget = 4'000'000u;
+
+/// Параметры скрипта не помещаются в тип значений или в счетчик
+/// итераций.
+[[noreturn]] inline void
+throw_too_large( std::string_view name )
+{
+	throw std::runtime_error{ "invalid script name: `" + std::string{ name }
+			+ "`, parameters are too large for the value type" };
+}
+
+/// Разобрать число из имени скрипта.
+[[nodiscard]] inline std::size_t
+to_size( std::string_view name, std::string_view value )
+{
+	if( value.empty()
+			|| std::string_view::npos != value.find_first_not_of( "0123456789" ) )
+		throw std::runtime_error{ "invalid script name: `"
+				+ std::string{ name } + "`" };
+
+	// Количество итераций хранится в long long, поэтому большие
+	// значения не имеют смысла.
+	if( value.size() > std::numeric_limits< long long >::digits10 )
+		throw_too_large( name );
+
+	const auto result = std::stoull( std::string{ value } );
+	if( !result )
+		throw std::runtime_error{ "invalid script name: `"
+				+ std::string{ name } + "`, parameters can't be 0" };
+	return static_cast< std::size_t >( result );
+}
+
+/// Произведение параметров скрипта с проверкой переполнения.
+[[nodiscard]] inline unsigned long long
+checked_mul( std::string_view name, unsigned long long a, unsigned long long b )
+{
+	if( b && a > std::numeric_limits< unsigned long long >::max() / b )
+		throw_too_large( name );
+	return a * b;
+}
+
+/// Проверить, что значение, до которого доходит счетчик или переменная
+/// скрипта, точно представимо в T.
+template< typename T >
+void
+ensure_fits( std::string_view name, unsigned long long value )
+{
+	if constexpr( std::is_integral_v<T> )
+	{
+		if( value > static_cast< unsigned long long >(
+				std::numeric_limits<T>::max() ) )
+			throw_too_large( name );
+	}
+	else
+	{
+		// Не все целые больше 2^digits представимы точно, и
+		// увеличение на 1 перестает менять значение.
+		constexpr int digits = std::numeric_limits<T>::digits;
+		if constexpr( digits < std::numeric_limits< unsigned long long >::digits )
+			if( value > (1ull << digits) )
+				throw_too_large( name );
+	}
+}
+
+/// Параметр после `<prefix>:` или значение по умолчанию, если имя
+/// совпадает с prefix.
+[[nodiscard]] inline std::optional< std::string_view >
+parameter_of( std::string_view name, std::string_view prefix )
+{
+	if( name == prefix )
+		return std::string_view{};
+	if( name.size() > prefix.size() && name.starts_with( prefix )
+			&& ':' == name[ prefix.size() ] )
+		return name.substr( prefix.size() + 1u );
+	return std::nullopt;
+}
+
+} /* namespace impl */
+
+/// Скрипт для работы с массивом.
+///
+/// Имя совпадает с тем, под которым скрипт сохраняется в отчетах и
+/// эталонах.
+template< typename T >
+[[nodiscard]] library_script_t<T>
+make_array( const array_demo_params_t & params )
+{
+	std::string name = "array:" + std::to_string( params._elements )
+			+ "x" + std::to_string( params._passes )
+			+ (params._huge_pages ? ":huge-pages" : "");
+
+	// Индекс доходит до количества элементов, счетчик проходов -- до
+	// количества проходов.
+	impl::ensure_fits<T>( name, params._elements );
+	impl::ensure_fits<T>( name, params._passes );
+	impl::ensure_fits< long long >( name, impl::checked_mul( name,
+			impl::checked_mul( name, params._elements, 3u ), params._passes ) );
+
+	return {
+			std::move(name),
+			[params]( std::pmr::memory_resource * resource ) {
+				return make_array_demo_script<T>( params, resource );
+			},
+			array_demo_script_loop_iterations( params ),
+			array_demo_script_bytes<T>( params ),
+			1u,
+			{
+				{ "i", static_cast<T>( params._elements - 1u ) },
+				{ "p", static_cast<T>( params._passes ) }
+			}
+		};
+}
+
+/// Получить скрипт по имени.
+///
+/// Бросает исключение, если имя неизвестно или значения переменных
+/// скрипта не помещаются в T.
+template< typename T >
+[[nodiscard]] library_script_t<T>
+make( std::string_view name )
+{
+	if( "demo" == name )
+		return {
+				"demo",
+				[]( std::pmr::memory_resource * resource ) {
+					return make_demo_script<T>( resource );
+				},
+				demo_script_loop_iterations,
+				std::nullopt,
+				1u,
+				{ { "j", static_cast<T>( demo_script_loop_iterations ) } }
+			};
+
+	if( const auto p = impl::parameter_of( name, "array" ); p && !p->empty() )
+	{
+		const auto elements = impl::to_size( name, *p );
+		if( elements < 2u )
+			throw std::runtime_error{ "invalid script name: `"
+					+ std::string{ name } + "`, at least 2 elements are required" };
+		return make_array<T>( array_demo_params_t{ elements } );
+	}
+
+	if( const auto p = impl::parameter_of( name, "nested" ) )
+	{
+		std::size_t outer = 1000u;
+		std::size_t inner = 1000u;
+		if( !p->empty() )
+		{
+			const auto x = p->find( 'x' );
+			if( std::string_view::npos == x )
+				throw std::runtime_error{ "invalid script name: `"
+						+ std::string{ name } + "`, nested:<outer>x<inner> expected" };
+			outer = impl::to_size( name, p->substr( 0, x ) );
+			inner = impl::to_size( name, p->substr( x + 1u ) );
+		}
+		// Сумма доходит до outer * inner, а вместе с итерациями
+		// внешнего цикла выполняется outer * (inner + 1) итераций.
+		const auto sum = impl::checked_mul( name, outer, inner );
+		impl::ensure_fits<T>( name, outer );
+		impl::ensure_fits<T>( name, inner );
+		impl::ensure_fits<T>( name, sum );
+		impl::ensure_fits< long long >( name,
+				impl::checked_mul( name, outer, inner + 1u ) );
+		return {
+				"nested:" + std::to_string( outer ) + "x" + std::to_string( inner ),
+				[outer, inner]( std::pmr::memory_resource * resource ) {
+					return make_nested_loops_script<T>( outer, inner, resource );
+				},
+				static_cast< long long >( sum + outer ),
+				std::nullopt,
+				1u,
+				{
+					{ "o", static_cast<T>( outer ) },
+					{ "i", static_cast<T>( inner ) },
+					{ "s", static_cast<T>( sum ) }
+				}
+			};
+	}
+
+	if( const auto p = impl::parameter_of( name, "vars" ) )
+	{
+		const std::size_t vars = p->empty() ? 16u : impl::to_size( name, *p );
+		const std::size_t iterations = std::max< std::size_t >(
+				1u, impl::increments_budget / vars );
+		impl::ensure_fits<T>( name, iterations );
+
+		library_script_t<T> result{
+				"vars:" + std::to_string( vars ),
+				[vars, iterations]( std::pmr::memory_resource * resource ) {
+					return make_many_vars_script<T>( vars, iterations, resource );
+				},
+				static_cast< long long >( iterations ),
+				std::nullopt,
+				1u,
+				{ { "j", static_cast<T>( iterations ) } }
+			};
+		for( std::size_t i = 0; i != vars; ++i )
+			result._expected.push_back(
+					{ many_vars_name( i ), static_cast<T>( iterations ) } );
+		return result;
+	}
+
+	if( const auto p = impl::parameter_of( name, "straight" ) )
+	{
+		const std::size_t statements = p->empty()
+				? 256u : impl::to_size( name, *p );
+		const std::size_t iterations = std::max< std::size_t >(
+				1u, impl::increments_budget / statements );
+		impl::ensure_fits<T>( name, iterations );
+
+		library_script_t<T> result{
+				"straight:" + std::to_string( statements ),
+				[statements, iterations]( std::pmr::memory_resource * resource ) {
+					return make_straight_line_script<T>(
+							statements, iterations, resource );
+				},
+				static_cast< long long >( iterations ),
+				std::nullopt,
+				1u,
+				{ { "j", static_cast<T>( iterations ) } }
+			};
+
+		// Сумма шагов для каждой переменной за одну итерацию.
+		std::vector< unsigned long long > per_iteration( straight_line_vars, 0u );
+		for( std::size_t k = 0; k != statements; ++k )
+			per_iteration[ k % straight_line_vars ] +=
+					static_cast< unsigned long long >( straight_line_step( k ) );
+		for( std::size_t v = 0; v != straight_line_vars; ++v )
+		{
+			const auto value = impl::checked_mul(
+					name, per_iteration[ v ], iterations );
+			impl::ensure_fits<T>( name, value );
+			result._expected.push_back(
+					{ "a" + std::to_string( v ), static_cast<T>( value ) } );
+		}
+		return result;
+	}
+
+	if( const auto p = impl::parameter_of( name, "print" ) )
+	{
+		const std::size_t lines = p->empty() ? 1000u : impl::to_size( name, *p );
+		impl::ensure_fits<T>( name, lines );
+		return {
+				"print:" + std::to_string( lines ),
+				[lines]( std::pmr::memory_resource * resource ) {
+					return make_print_heavy_script<T>( lines, resource );
+				},
+				static_cast< long long >( lines ),
+				std::nullopt,
+				lines,
+				{ { "j", static_cast<T>( lines ) } }
+			};
+	}
+
+	throw std::runtime_error{ "unknown script: `" + std::string{ name }
+			+ "`, known: demo, array:<elements>, nested[:<outer>x<inner>], "
+			"vars[:<count>], straight[:<statements>], print[:<lines>]" };
+}
+
+/// Сравнить значения переменных после выполнения скрипта с ожидаемыми.
+///
+/// Возвращает описание первого расхождения или пустое значение, если
+/// расхождений нет.
+template< typename T >
+[[nodiscard]] std::optional< std::string >
+check_final_values(
+	/// Имя скрипта для описания расхождения.
+	const std::string & script_name,
+	const std::vector< expected_value_t<T> > & expected,
+	script::exec_context_t<T> & ctx )
+{
+	for( const auto & e : expected )
+	{
+		T actual{};
+		try
+		{
+			actual = ctx.value_of( e._name );
+		}
+		catch( const std::exception & x )
+		{
+			return script_name + ": " + x.what();
+		}
+
+		if( actual != e._value )
+		{
+			std::ostringstream description;
+			description << script_name << ": " << e._name << "=" << actual
+					<< ", expected " << e._value;
+			return description.str();
+		}
+	}
+
+	return std::nullopt;
+}
+
+template< typename T >
+[[nodiscard]] std::optional< std::string >
+check_final_values(
+	const library_script_t<T> & what,
+	script::exec_context_t<T> & ctx )
+{
+	return check_final_values( what._name, what._expected, ctx );
+}
+
+/// Описание имен скриптов для справки.
+[[nodiscard]] inline const char *
+names_help() noexcept
+{
+	return
+		"demo                      one counter incremented 10^9 times\n"
+		"array:<elements>          write, increment and scan an array\n"
+		"nested[:<outer>x<inner>]  nested loops (default: 1000x1000)\n"
+		"vars[:<count>]            <count> variables incremented on every\n"
+		"                          iteration (default: 16), try 1, 16,\n"
+		"                          256 and 4096\n"
+		"straight[:<statements>]   a loop body of <statements> separate\n"
+		"                          increments (default: 256)\n"
+		"print[:<lines>]           print a value on every iteration\n"
+		"                          (default: 1000)\n";
+}
+
+} /* namespace script_library */
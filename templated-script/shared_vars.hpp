@@ -0,0 +1,308 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace script
+{
+
+namespace shared
+{
+
+/// Размер строки кэша, на который выравниваются данные разных нитей.
+inline constexpr std::size_t cache_line_size = 64u;
+
+/// Способ хранения разделяемой между рабочими нитями переменной.
+enum class strategy_t
+{
+	/// Одно атомарное значение, которое изменяют все нити.
+	single_atomic,
+	/// У каждой нити своя часть значения в отдельной строке кэша,
+	/// при чтении части складываются.
+	padded_shards,
+	/// То же, что и padded_shards, но части лежат вплотную друг к другу.
+	///
+	/// Нужно только для демонстрации эффекта false sharing.
+	packed_shards,
+	/// Дерево объединения: нити изменяют значения в листьях, которые
+	/// периодически переносятся к корню.
+	combining_tree
+};
+
+[[nodiscard]] inline const char *
+to_string( strategy_t strategy )
+{
+	switch( strategy )
+	{
+	case strategy_t::single_atomic: return "single-atomic";
+	case strategy_t::padded_shards: return "padded-shards";
+	case strategy_t::packed_shards: return "packed-shards";
+	case strategy_t::combining_tree: return "combining-tree";
+	}
+	return "unknown";
+}
+
+/// Разделяемая между рабочими нитями переменная.
+///
+/// Нити могут только увеличивать значение. Чтение во время
+/// изменений дает приблизительный результат, точное значение
+/// можно прочитать после того, как изменения закончились.
+template< typename T >
+class variable_t
+{
+public:
+	virtual ~variable_t() = default;
+
+	/// Увеличить значение от имени нити worker_index.
+	virtual void
+	add( std::size_t worker_index, T value ) noexcept = 0;
+
+	[[nodiscard]] virtual T
+	read() const noexcept = 0;
+};
+
+template< typename T >
+using variable_uptr_t = std::unique_ptr< variable_t<T> >;
+
+namespace impl
+{
+
+/// Атомарное значение, занимающее целую строку кэша.
+template< typename T >
+struct alignas(cache_line_size) padded_atomic_t
+{
+	std::atomic< T > _value{};
+};
+
+/// Атомарное увеличение, в том числе для типов с плавающей точкой.
+template< typename T >
+void
+atomic_add( std::atomic< T > & where, T value ) noexcept
+{
+	where.fetch_add( value, std::memory_order_relaxed );
+}
+
+/// Увеличение значения, которое изменяет только одна нить.
+///
+/// Атомарность нужна только для чтения из других нитей, поэтому
+/// вместо read-modify-write достаточно чтения и записи.
+template< typename T >
+void
+owner_add( std::atomic< T > & where, T value ) noexcept
+{
+	where.store( where.load( std::memory_order_relaxed ) + value,
+			std::memory_order_relaxed );
+}
+
+} /* namespace impl */
+
+template< typename T >
+class single_atomic_t final : public variable_t<T>
+{
+	impl::padded_atomic_t<T> _value;
+
+public:
+	void
+	add( std::size_t, T value ) noexcept override
+	{
+		impl::atomic_add( _value._value, value );
+	}
+
+	[[nodiscard]] T
+	read() const noexcept override
+	{
+		return _value._value.load( std::memory_order_relaxed );
+	}
+};
+
+/// Части значения по одной на каждую нить.
+///
+/// Shard -- тип для хранения одной части: с выравниванием на
+/// строку кэша или без него.
+template< typename T, typename Shard >
+class sharded_t final : public variable_t<T>
+{
+	std::unique_ptr< Shard[] > _shards;
+	const std::size_t _count;
+
+public:
+	explicit sharded_t( std::size_t threads_count )
+		: _shards{ std::make_unique< Shard[] >( threads_count ) }
+		, _count{ threads_count }
+	{}
+
+	void
+	add( std::size_t worker_index, T value ) noexcept override
+	{
+		impl::owner_add( _shards[ worker_index ]._value, value );
+	}
+
+	[[nodiscard]] T
+	read() const noexcept override
+	{
+		T result{};
+		for( std::size_t i = 0; i != _count; ++i )
+			result += _shards[ i ]._value.load( std::memory_order_relaxed );
+		return result;
+	}
+};
+
+namespace impl
+{
+
+template< typename T >
+struct packed_atomic_t
+{
+	std::atomic< T > _value{};
+};
+
+} /* namespace impl */
+
+template< typename T >
+using padded_shards_t = sharded_t< T, impl::padded_atomic_t<T> >;
+
+template< typename T >
+using packed_shards_t = sharded_t< T, impl::packed_atomic_t<T> >;
+
+/// Дерево объединения.
+///
+/// Каждая нить копит изменения в своей части (отдельная строка кэша)
+/// и после combine_every изменений переносит накопленное в лист,
+/// общий для fan_in нитей. Лист, получив fan_in переносов, переносит
+/// свое значение в родителя и так далее до корня. Благодаря этому
+/// к узлам верхних уровней обращаются все реже.
+template< typename T >
+class combining_tree_t final : public variable_t<T>
+{
+	struct alignas(cache_line_size) node_t
+	{
+		std::atomic< T > _value{};
+		/// Сколько всего переносов получено от дочерних узлов.
+		std::atomic< std::size_t > _arrivals{};
+		std::size_t _parent{};
+	};
+
+	struct alignas(cache_line_size) local_t
+	{
+		std::atomic< T > _value{};
+		std::size_t _updates{};
+	};
+
+	const std::size_t _fan_in;
+	const std::size_t _combine_every;
+
+	std::unique_ptr< local_t[] > _locals;
+	std::size_t _locals_count{};
+
+	/// Узлы дерева. Сперва идут листья, корень -- последний.
+	std::vector< std::unique_ptr< node_t > > _nodes;
+
+	void
+	propagate( std::size_t node_index, T value ) noexcept
+	{
+		for(;;)
+		{
+			auto & node = *_nodes[ node_index ];
+			impl::atomic_add( node._value, value );
+			if( node._parent == node_index )
+				return;
+
+			// Каждый fan_in-ый прибывший переносит накопленное выше.
+			if( (node._arrivals.fetch_add( 1u, std::memory_order_acq_rel ) + 1u)
+					% _fan_in )
+				return;
+			value = node._value.exchange( T{}, std::memory_order_acq_rel );
+			node_index = node._parent;
+		}
+	}
+
+public:
+	combining_tree_t(
+		std::size_t threads_count,
+		std::size_t fan_in = 4u,
+		std::size_t combine_every = 64u )
+		: _fan_in{ fan_in }
+		, _combine_every{ combine_every }
+		, _locals{ std::make_unique< local_t[] >( threads_count ) }
+		, _locals_count{ threads_count }
+	{
+		if( _fan_in < 2u || !_combine_every )
+			throw std::invalid_argument{
+					"combining_tree_t: fan_in must be at least 2 and "
+					"combine_every can't be 0" };
+
+		// Уровни строятся от листьев к корню.
+		std::size_t level_start = 0;
+		std::size_t level_size = (threads_count + _fan_in - 1u) / _fan_in;
+		for(;;)
+		{
+			for( std::size_t i = 0; i != level_size; ++i )
+				_nodes.push_back( std::make_unique< node_t >() );
+			const std::size_t next_level_start = level_start + level_size;
+			if( 1u == level_size )
+			{
+				_nodes.back()->_parent = _nodes.size() - 1u;
+				break;
+			}
+
+			const std::size_t next_level_size = (level_size + _fan_in - 1u) / _fan_in;
+			for( std::size_t i = 0; i != level_size; ++i )
+				_nodes[ level_start + i ]->_parent = next_level_start + i / _fan_in;
+
+			level_start = next_level_start;
+			level_size = next_level_size;
+		}
+	}
+
+	void
+	add( std::size_t worker_index, T value ) noexcept override
+	{
+		auto & local = _locals[ worker_index ];
+		impl::owner_add( local._value, value );
+		if( ++local._updates == _combine_every )
+		{
+			local._updates = 0u;
+			propagate( worker_index / _fan_in,
+					local._value.exchange( T{}, std::memory_order_acq_rel ) );
+		}
+	}
+
+	[[nodiscard]] T
+	read() const noexcept override
+	{
+		T result{};
+		for( std::size_t i = 0; i != _locals_count; ++i )
+			result += _locals[ i ]._value.load( std::memory_order_relaxed );
+		for( const auto & node : _nodes )
+			result += node->_value.load( std::memory_order_relaxed );
+		return result;
+	}
+};
+
+/// Создать разделяемую переменную с заданным способом хранения.
+template< typename T >
+[[nodiscard]] variable_uptr_t<T>
+make_variable( strategy_t strategy, std::size_t threads_count )
+{
+	switch( strategy )
+	{
+	case strategy_t::single_atomic:
+		return std::make_unique< single_atomic_t<T> >();
+	case strategy_t::padded_shards:
+		return std::make_unique< padded_shards_t<T> >( threads_count );
+	case strategy_t::packed_shards:
+		return std::make_unique< packed_shards_t<T> >( threads_count );
+	case strategy_t::combining_tree:
+		return std::make_unique< combining_tree_t<T> >( threads_count );
+	}
+	throw std::invalid_argument{ "unknown shared variable strategy" };
+}
+
+} /* namespace shared */
+
+} /* namespace script */
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "script.hpp"
+
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace script
+{
+
+namespace verifier
+{
+
+/// Результат статической проверки скрипта.
+struct result_t
+{
+	/// Описания найденных проблем. Пусто, если скрипт корректен.
+	std::vector< std::string > _errors;
+
+	[[nodiscard]] bool
+	ok() const noexcept { return _errors.empty(); }
+};
+
+namespace impl
+{
+
+/// Что известно о скрипте в конкретной точке: какие переменные и
+/// массивы гарантированно получили значение на всех путях к ней.
+struct defined_t
+{
+	std::set< std::string > _vars;
+	std::set< std::string > _arrays;
+};
+
+/// Анализ определенного присваивания (definite assignment).
+///
+/// Обход дерева скрипта в порядке выполнения. Тело цикла может не
+/// выполниться ни разу, поэтому после цикла определенными остаются
+/// только те имена, что были определены до него. Внутри тела
+/// анализ ведется от состояния перед циклом: этого достаточно,
+/// поскольку к началу любой следующей итерации определено не меньше
+/// имен, чем к началу первой.
+template< typename T >
+class analyzer_t
+{
+	result_t & _result;
+
+	void
+	require_var(
+		const defined_t & defined,
+		const std::string & name,
+		const char * node )
+	{
+		if( !defined._vars.count( name ) )
+			_result._errors.push_back( "variable `" + name
+					+ "` may be used before assignment in " + node );
+	}
+
+	void
+	require_array(
+		const defined_t & defined,
+		const std::string & name,
+		const char * node )
+	{
+		if( !defined._arrays.count( name ) )
+			_result._errors.push_back( "array `" + name
+					+ "` may be used before allocation in " + node );
+	}
+
+public:
+	explicit analyzer_t( result_t & result ) : _result{ result } {}
+
+	void
+	check(
+		const logical_expression_shptr_t<T> & what,
+		const defined_t & defined )
+	{
+		namespace expr = expressions;
+		const auto * node = what.get();
+
+		if( const auto * lt = dynamic_cast< const expr::less_than_t<T> * >( node ) )
+			require_var( defined, lt->var_name(), "less_than_t" );
+		else if( const auto * e = dynamic_cast<
+				const expr::element_less_than_t<T> * >( node ) )
+		{
+			require_array( defined, e->array_name(), "element_less_than_t" );
+			require_var( defined, e->index_var_name(), "element_less_than_t" );
+		}
+		else
+			_result._errors.push_back( "unsupported expression node" );
+	}
+
+	void
+	check(
+		const statement_shptr_t<T> & what,
+		defined_t & defined )
+	{
+		namespace stm = statements;
+		const auto * node = what.get();
+
+		if( const auto * c = dynamic_cast< const stm::compound_stmt_t<T> * >( node ) )
+		{
+			for( const auto & s : c->statements() )
+				check( s, defined );
+		}
+		else if( const auto * w = dynamic_cast< const stm::while_loop_t<T> * >( node ) )
+		{
+			check( w->condition(), defined );
+			auto body_defined = defined;
+			check( w->body(), body_defined );
+		}
+		else if( const auto * a = dynamic_cast< const stm::assign_to_t<T> * >( node ) )
+			defined._vars.insert( a->var_name() );
+		else if( const auto * i = dynamic_cast< const stm::increment_by_t<T> * >( node ) )
+			require_var( defined, i->var_name(), "increment_by_t" );
+		else if( const auto * p = dynamic_cast< const stm::print_value_t<T> * >( node ) )
+			require_var( defined, p->var_name(), "print_value_t" );
+		else if( const auto * aa = dynamic_cast<
+				const stm::allocate_array_t<T> * >( node ) )
+			defined._arrays.insert( aa->array_name() );
+		else if( const auto * st = dynamic_cast< const stm::store_at_t<T> * >( node ) )
+		{
+			require_array( defined, st->array_name(), "store_at_t" );
+			require_var( defined, st->index_var_name(), "store_at_t" );
+		}
+		else if( const auto * ia = dynamic_cast<
+				const stm::increment_at_t<T> * >( node ) )
+		{
+			require_array( defined, ia->array_name(), "increment_at_t" );
+			require_var( defined, ia->index_var_name(), "increment_at_t" );
+		}
+		else
+			_result._errors.push_back( "unsupported statement node" );
+	}
+};
+
+} /* namespace impl */
+
+/// Проверить, что каждое чтение и изменение переменной (и каждое
+/// обращение к массиву) на всех путях выполнения предваряется
+/// присваиванием (выделением массива).
+///
+/// predefined -- переменные, которые получают значения до начала
+/// выполнения скрипта (например, входные колонки или разделяемые
+/// переменные).
+template< typename T >
+[[nodiscard]] result_t
+check(
+	const statement_shptr_t<T> & script,
+	const std::vector< std::string > & predefined = {} )
+{
+	result_t result;
+	impl::defined_t defined;
+	defined._vars.insert( predefined.begin(), predefined.end() );
+
+	impl::analyzer_t<T>{ result }.check( script, defined );
+
+	return result;
+}
+
+} /* namespace verifier */
+
+/// Скрипт, прошедший статическую проверку.
+///
+/// Может быть получен только через verify, поэтому его наличие
+/// гарантирует, что все обращения к переменным корректны, и скрипт
+/// можно выполнять без проверок наличия переменных.
+template< typename T >
+class verified_script_t
+{
+	statement_shptr_t<T> _script;
+	std::vector< std::string > _predefined;
+
+	verified_script_t(
+		statement_shptr_t<T> script,
+		std::vector< std::string > predefined )
+		: _script{ std::move(script) }
+		, _predefined{ std::move(predefined) }
+	{}
+
+	template< typename U >
+	friend verified_script_t<U>
+	verify( statement_shptr_t<U>, std::vector< std::string > );
+
+public:
+	[[nodiscard]] const statement_shptr_t<T> &
+	script() const noexcept { return _script; }
+
+	/// Переменные, которые должны получить значения до выполнения.
+	[[nodiscard]] const std::vector< std::string > &
+	predefined() const noexcept { return _predefined; }
+};
+
+/// Проверить скрипт.
+///
+/// Порождает исключение std::invalid_argument со списком всех
+/// найденных проблем, если скрипт не прошел проверку.
+template< typename T >
+[[nodiscard]] verified_script_t<T>
+verify(
+	statement_shptr_t<T> script,
+	std::vector< std::string > predefined = {} )
+{
+	const auto result = verifier::check( script, predefined );
+	if( !result.ok() )
+	{
+		std::string message{ "script verification failed:" };
+		for( const auto & e : result._errors )
+			message += "\n  " + e;
+		throw std::invalid_argument{ message };
+	}
+
+	return { std::move(script), std::move(predefined) };
+}
+
+/// Выполнить проверенный скрипт в уже подготовленном контексте.
+///
+/// Все переменные из what.predefined() должны быть в контексте.
+template< typename T >
+void
+execute(const verified_script_t<T> & what, exec_context_t<T> & ctx)
+{
+	try
+	{
+		what.script()->exec_unchecked(ctx);
+	}
+	catch(const std::exception & x)
+	{
+		// Наличие переменных доказано, но значения индексов массивов
+		// по-прежнему проверяются во время выполнения.
+		std::cerr << "exception caught: " << x.what() << std::endl;
+	}
+}
+
+template< typename T >
+void
+execute(const verified_script_t<T> & what)
+{
+	if( !what.predefined().empty() )
+		throw std::invalid_argument{
+				"script with predefined variables requires a context" };
+
+	exec_context_t<T> ctx;
+	execute(what, ctx);
+}
+
+} /* namespace script */
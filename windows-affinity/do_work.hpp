@@ -5,6 +5,8 @@
 
 #include "../templated-script/script.hpp"
 #include "../templated-script/demo_script.hpp"
+#include "../templated-script/script_library.hpp"
+#include "../templated-script/engines.hpp"
 
 #include "run_params.hpp"
 
@@ -45,7 +47,8 @@ exec_demo_script_thread_body(
 	/// привязки нити к ядру не выполняется.
 	std::optional<run_params::core_index_t> core_index,
 	std::latch & start_latch,
-	const script::statement_shptr_t<T> & stm,
+	const script::engines::prepared_script_t<T> & prepared,
+	const script_library::library_script_t<T> & what,
 	std::chrono::steady_clock::duration & time_receiver)
 {
 	try
@@ -55,11 +58,17 @@ exec_demo_script_thread_body(
 
 		start_latch.arrive_and_wait();
 
+		script::exec_context_t<T> ctx;
 		const auto started_at = std::chrono::steady_clock::now();
-		script::execute(stm);
+		script::engines::execute(prepared, ctx);
 		const auto finished_at = std::chrono::steady_clock::now();
 
 		time_receiver = finished_at - started_at;
+
+		if( const auto mismatch = script_library::check_final_values( what, ctx ) )
+			std::osyncstream{ std::cerr }
+					<< "exec_demo_script_thread_body: wrong final values: "
+					<< *mismatch << std::endl;
 	}
 	catch( const std::exception & x)
 	{
@@ -289,8 +298,14 @@ do_main_work( const run_params::run_params_t & params )
 	std::osyncstream{ std::cout }
 			<< "thread(s) to be used: " << threads_count << std::endl;
 
-	// Сам демо-скрипт для выполнения.
-	const auto demo_script = make_demo_script<T>();
+	// Сам скрипт для выполнения.
+	const auto library_script = script_library::make<T>( params._script_name );
+	const auto engine = script::engines::make<T>( params._engine );
+	const auto demo_script = engine->prepare( script::verify(
+			library_script._build( std::pmr::get_default_resource() ) ) );
+	std::osyncstream{ std::cout }
+			<< "script to be used: " << library_script._name
+			<< ", engine: " << engine->name() << std::endl;
 
 	// Вспомогательный объект для вычисления ядер, к которым может
 	// потребоваться привязка рабочих нитей.
@@ -332,7 +347,8 @@ do_main_work( const run_params::run_params_t & params )
 				exec_demo_script_thread_body<T>,
 				core_index,
 				std::ref(start_latch),
-				std::cref(demo_script),
+				std::cref(*demo_script),
+				std::cref(library_script),
 				std::ref(times[i])
 			}
 		);
@@ -369,7 +385,8 @@ public:
 	{
 		std::osyncstream{ std::cout } << "Usage:\n\t"
 			<< _argv_0
-			<< " [thread_count] [pin[:<core-index(es)>]]\n\n"
+			<< " [thread_count] [pin[:<core-index(es)>]] [script:<name>]"
+				" [engine:<name>]\n\n"
 			<< "where `pin` can be in one of the following formats:\n\n"
 				"pin             pin threads to logical processes sequentially\n"
 				"                starting from 0\n"
@@ -379,6 +396,14 @@ public:
 				"pin:I,J,K[,..]  pin thread only to specified logical processes\n"
 				"                For example: pin:0,1,3,4\n"
 				"\n"
+			<< "script:<name>   run a script from the library instead of the\n"
+				"                demo script, names:\n\n"
+			<< script_library::names_help()
+			<< "\n"
+			<< "engine:tree      walk the script tree (default)\n"
+				"engine:bytecode  compile the script to bytecode\n"
+				"engine:memo      take results of pure loops from a cache\n"
+				"\n"
 				"NOTE: `thread_count` is optional only if `pin` with enumeration\n"
 				"of logical processors is used. It means that:\n\n"
 			<< "\t" << _argv_0 << " pin:0,2,4\n\n"
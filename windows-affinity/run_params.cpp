@@ -89,6 +89,8 @@ try_parse_cmd_line_args( int argc, char ** argv )
 
 	constexpr std::string_view just_pin{ "pin" };
 	constexpr std::string_view pin_prefix{ "pin:" };
+	constexpr std::string_view script_prefix{ "script:" };
+	constexpr std::string_view engine_prefix{ "engine:" };
 
 	args_parsing_result_t result{ help_requested_t{} };
 	if( 1 == argc )
@@ -117,6 +119,16 @@ try_parse_cmd_line_args( int argc, char ** argv )
 			run_params._pinning = try_parse_adv_pinning_mode(
 					std::string{ current.substr( pin_prefix.size() ) } );
 		}
+		else if( current.starts_with( script_prefix ) )
+		{
+			run_params._script_name =
+					std::string{ current.substr( script_prefix.size() ) };
+		}
+		else if( current.starts_with( engine_prefix ) )
+		{
+			run_params._engine =
+					std::string{ current.substr( engine_prefix.size() ) };
+		}
 		else
 		{
 			// Возможно, это количество тредов.
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <optional>
+#include <string>
 #include <variant>
 #include <vector>
 
@@ -48,6 +49,12 @@ struct run_params_t
 
 	/// Нужно ли привязывать нити к ядрам и если нужно то как именно.
 	pinning_params_t _pinning{ no_pinning_t{} };
+
+	/// Имя скрипта из библиотеки (см. script_library.hpp).
+	std::string _script_name{ "demo" };
+
+	/// Чем выполнять скрипт (см. engines.hpp).
+	std::string _engine{ "tree" };
 };
 
 /// Индикатор того, что была запрошена помощь по параметрам командной строки.
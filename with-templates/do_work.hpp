@@ -2,6 +2,11 @@
 
 #include "../templated-script/script.hpp"
 #include "../templated-script/demo_script.hpp"
+#include "../templated-script/script_library.hpp"
+#include "../templated-script/engines.hpp"
+
+#include "../common/start_barrier.hpp"
+#include "../common/run_timeline.hpp"
 
 #include "raise_thread_priority.hpp"
 
@@ -11,16 +16,27 @@
 template< typename T >
 void
 exec_demo_script_thread_body(
-	const script::statement_shptr_t<T> & stm,
-	std::chrono::steady_clock::duration & time_receiver)
+	std::size_t worker_index,
+	start_barrier::start_sync_t & start_latch,
+	const script::engines::prepared_script_t<T> & prepared,
+	const script_library::library_script_t<T> & what,
+	run_timeline::interval_t & interval_receiver)
 {
 	raise_thread_priority();
 
+	const auto wakeup_type = start_latch.arrive_and_wait( worker_index );
+	if( start_barrier::wakeup_type_t::should_shutdown == wakeup_type )
+		return;
+
+	script::exec_context_t<T> ctx;
 	const auto started_at = std::chrono::steady_clock::now();
-	script::execute(stm);
+	script::engines::execute(prepared, ctx);
 	const auto finished_at = std::chrono::steady_clock::now();
 
-	time_receiver = finished_at - started_at;
+	interval_receiver = { started_at, finished_at };
+
+	if( const auto mismatch = script_library::check_final_values( what, ctx ) )
+		std::cerr << "wrong final values: " << *mismatch << std::endl;
 }
 
 template< typename T >
@@ -28,44 +44,67 @@ void
 do_work(int argc, char ** argv)
 {
 	std::size_t threads_count{ 4 };
-	if( 2 == argc )
+	if( 2 <= argc )
 	{
 		threads_count = std::stoul(argv[1]);
 		if( 0 == threads_count )
 			throw std::runtime_error{ "number of threads can't 0" };
 	}
 
-	std::cout << "thread(s) to be used: " << threads_count << std::endl;
+	// Второй аргумент -- имя скрипта из библиотеки, третий -- имя
+	// движка для его выполнения.
+	const auto library_script = script_library::make<T>(
+			3 <= argc ? argv[2] : "demo" );
+	const auto engine = script::engines::make<T>(
+			4 <= argc ? argv[3] : "tree" );
+
+	std::cout << "thread(s) to be used: " << threads_count
+			<< ", script: " << library_script._name
+			<< ", engine: " << engine->name() << std::endl;
+
+	start_barrier::start_sync_t start_latch{ threads_count };
+
+	std::vector< run_timeline::interval_t > intervals( threads_count );
+
+	const auto demo_script = engine->prepare( script::verify(
+			library_script._build( std::pmr::get_default_resource() ) ) );
 
 	std::vector< std::jthread > threads;
 	threads.reserve(threads_count);
 
-	std::vector< std::chrono::steady_clock::duration > times{
-			threads_count,
-			std::chrono::steady_clock::duration::zero()
-	};
-
-	const auto demo_script = make_demo_script<T>();
+	// Должен быть разрушен раньше threads, чтобы при исключении
+	// рабочие нити получили сигнал на завершение.
+	start_barrier::start_sync_t::wakeup_controller_t wakeup_controller{
+			start_latch };
 
 	for( std::size_t i = 0; i != threads_count; ++i )
 	{
 		threads.push_back(
 			std::jthread{
 				exec_demo_script_thread_body<T>,
-				std::cref(demo_script),
-				std::ref(times[i])
+				i,
+				std::ref(start_latch),
+				std::cref(*demo_script),
+				std::cref(library_script),
+				std::ref(intervals[i])
 			}
 		);
 	}
 
+	const auto released_at = wakeup_controller.wakeup_threads();
+
 	for( auto & thr : threads )
 		thr.join();
 
-	for( const auto & d : times )
+	for( const auto & i : intervals )
 	{
 		const double as_seconds = std::chrono::duration_cast<
-				std::chrono::milliseconds >(d).count() / 1000.0;
+				std::chrono::milliseconds >(
+						i._finished_at - i._started_at).count() / 1000.0;
 		std::cout << std::setprecision(4) << as_seconds << std::endl;
 	}
+
+	run_timeline::print_summary( std::cout,
+			run_timeline::summarize( intervals, released_at ) );
 }
 